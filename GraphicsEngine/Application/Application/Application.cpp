@@ -2,6 +2,7 @@
 #include "GraphicsEngine/CameraAnimation.h"
 #include "GraphicsEngine/FogAnimation.h"
 
+#include <cfloat>
 #include <functional>
 #include "GraphicsEngine/KeyAnimation.h"
 #include "GraphicsEngine/GeneralAnimation.h"
@@ -79,30 +80,12 @@ int Application::Run()
 		camera->RotateWorldY(-mouseDeltaX * mouseSensibility);
 		camera->RotateWorldX(-mouseDeltaY * mouseSensibility);
 
-		//const auto& terrain = m_graphics.GetScene()->GetTerrain();
-
 		// Clamp camera to the ground:
 		/*XMFLOAT3 position;
 		XMStoreFloat3(&position, camera->GetPosition());
 		auto terrainHeight = m_graphics.GetScene()->GetTerrain().GetTerrainHeight(position.x, position.z);
 		camera->SetPosition(position.x, 5.0f + terrainHeight, position.z);*/
 
-		// Ray collision with terrain:
-		/*{
-			auto ray = camera->CreateRay();
-			const std::vector<VertexTypes::PositionVertexType>* vertices;
-			const std::vector<uint32_t>* indices;
-			terrain.GetMeshData(vertices, indices);
-			float distance;
-			if (ray.IntersectsTriangleMesh<VertexTypes::PositionVertexType, uint32_t>(*vertices, *indices, distance))
-			{
-				XMFLOAT3 intersection;
-				XMStoreFloat3(&intersection, ray.CalculatePoint(distance));
-				auto debugString = L"Intersected Position: (" + std::to_wstring(intersection.x) + L", " + std::to_wstring(intersection.y) + +L", " + std::to_wstring(intersection.z) + L")\n";
-				OutputDebugStringW(debugString.c_str());
-			}
-		}*/
-
 		if (!m_animationBuildMode)
 		{
 			m_animationManager.FixedUpdate(m_timer);
@@ -142,6 +125,10 @@ int Application::Run()
 		extraCaption << L"FPS: " << std::to_wstring(timer.GetFramesPerSecond());
 		extraCaption << L" | Total Time: " << timer.GetTotalMilliseconds();
 		//if (!m_animationBuildMode) extraCaption << L" | V: " << std::to_wstring(m_graphics.GetVisibleInstances());
+#ifdef _DEBUG
+		auto allocations = m_graphics.GetAllocationStatistics().GetTotal();
+		extraCaption << L" | Allocations: " << allocations.Allocations << L" (" << allocations.AllocatedBytes << L" B)";
+#endif
 		extraCaption << L" | " << camera->ToWString();
 
 		m_window.SetWindowExtraCaption(extraCaption.str());
@@ -257,6 +244,21 @@ void Application::OnKeyboardKeyDown(const void* sender, const DXInputHandler::Ke
 	{
 		m_graphics.SetDebugWindowMode(Graphics::DebugMode::TerrainNoNormalMapping);
 	}
+#ifdef _DEBUG
+	else if (eventArgs.Key == DIK_X)
+	{
+		// Pick the terrain position the camera is looking at:
+		auto ray = pCamera->CreateRay();
+		float distance;
+		if (pScene->GetTerrain().Intersects(ray, FLT_MAX, distance))
+		{
+			XMFLOAT3 intersection;
+			XMStoreFloat3(&intersection, ray.CalculatePoint(distance));
+			auto debugString = L"Intersected Position: (" + std::to_wstring(intersection.x) + L", " + std::to_wstring(intersection.y) + L", " + std::to_wstring(intersection.z) + L")\n";
+			OutputDebugStringW(debugString.c_str());
+		}
+	}
+#endif
 	else
 	{
 		/*if(eventArgs.UserInput)
@@ -311,6 +313,14 @@ Application::Application() :
 	m_input.SubscribeToOnKeyDownEvents(DIK_9, std::bind(&Application::OnKeyboardKeyDown, this, _1, _2));
 	m_input.SubscribeToOnKeyDownEvents(DIK_O, std::bind(&Application::OnKeyboardKeyDown, this, _1, _2));
 
+#ifdef _DEBUG
+	// Print the terrain position the camera is looking at:
+	m_input.SubscribeToOnKeyDownEvents(DIK_X, std::bind(&Application::OnKeyboardKeyDown, this, _1, _2));
+
+	// Report the allocations made by the engine in each frame:
+	m_graphics.SetAllocationTrackingState(true);
+#endif
+
 	m_soundManager.Create2DSoundFromWaveFile("MainSound", L"Sounds/Cloud Atlas 21 - Cloud Atlas Finale.wav");
 	m_soundManager.Play2DSound("MainSound");
 
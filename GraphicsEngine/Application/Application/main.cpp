@@ -1,5 +1,8 @@
 #include "Application.h"
 
+// The allocations of the application and of the static libraries it links are reported to the allocation tracker:
+#include "Common/AllocationHook.h"
+
 using namespace Win32Application;
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pScmdline, int iCmdshow)
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "AllocationTracker.h"
+
+#include <cstdlib>
+#include <new>
+
+// Replaces the global operator new and delete of the module, so that its allocations are reported to the AllocationTracker.
+// Include this file in exactly one source file owned by each executable or DLL which should be tracked, and never in a static
+// library, as every binary linking the library would then define the operators twice. While tracking is disabled, the only
+// cost is checking a flag.
+
+void* operator new(size_t size)
+{
+	Common::AllocationTracker::OnAllocation(size);
+
+	// Zero sized allocations must still return unique pointers:
+	if (size == 0)
+		size = 1;
+
+	while (true)
+	{
+		auto pointer = std::malloc(size);
+		if (pointer != nullptr)
+			return pointer;
+
+		auto newHandler = std::get_new_handler();
+		if (newHandler == nullptr)
+			throw std::bad_alloc();
+		newHandler();
+	}
+}
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	try
+	{
+		return operator new(size);
+	}
+	catch (const std::bad_alloc&)
+	{
+		return nullptr;
+	}
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void* pointer) noexcept
+{
+	if (pointer == nullptr)
+		return;
+
+	Common::AllocationTracker::OnDeallocation();
+	std::free(pointer);
+}
+void operator delete[](void* pointer) noexcept
+{
+	operator delete(pointer);
+}
+void operator delete(void* pointer, size_t) noexcept
+{
+	operator delete(pointer);
+}
+void operator delete[](void* pointer, size_t) noexcept
+{
+	operator delete(pointer);
+}
+void operator delete(void* pointer, const std::nothrow_t&) noexcept
+{
+	operator delete(pointer);
+}
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept
+{
+	operator delete(pointer);
+}
@@ -0,0 +1,136 @@
+#include "AllocationTracker.h"
+
+#include <assert.h>
+#include <atomic>
+
+using namespace Common;
+using namespace std;
+
+namespace
+{
+	struct AtomicStatistics
+	{
+		atomic<size_t> Allocations;
+		atomic<size_t> AllocatedBytes;
+		atomic<size_t> Deallocations;
+	};
+
+	void AssertNoAllocations(const char*, size_t allocations)
+	{
+		assert(allocations == 0 && "A no-allocation scope allocated");
+	}
+
+	// The counters are only touched through the operators of AllocationHook.h, so they must not need dynamic initialization:
+	atomic<bool> s_enabled { false };
+	array<AtomicStatistics, static_cast<size_t>(AllocationTag::Count)> s_currentFrame;
+	AllocationTracker::FrameStatistics s_lastFrame;
+	atomic<AllocationTracker::FailureHandler> s_failureHandler { &AssertNoAllocations };
+
+	thread_local AllocationTag s_threadTag = AllocationTag::Untagged;
+	thread_local size_t s_threadAllocations = 0;
+}
+
+const AllocationTracker::Statistics& AllocationTracker::FrameStatistics::Get(AllocationTag tag) const
+{
+	return Tags[static_cast<size_t>(tag)];
+}
+AllocationTracker::Statistics AllocationTracker::FrameStatistics::GetTotal() const
+{
+	Statistics total;
+	for (const auto& statistics : Tags)
+	{
+		total.Allocations += statistics.Allocations;
+		total.AllocatedBytes += statistics.AllocatedBytes;
+		total.Deallocations += statistics.Deallocations;
+	}
+
+	return total;
+}
+
+AllocationTracker::TagScope::TagScope(AllocationTag tag) :
+	m_previousTag(s_threadTag)
+{
+	s_threadTag = tag;
+}
+AllocationTracker::TagScope::~TagScope()
+{
+	s_threadTag = m_previousTag;
+}
+
+AllocationTracker::NoAllocationScope::NoAllocationScope(const char* name) :
+	m_name(name),
+	m_firstAllocation(s_threadAllocations)
+{
+}
+AllocationTracker::NoAllocationScope::~NoAllocationScope()
+{
+	auto allocations = GetAllocations();
+	if (allocations != 0)
+		s_failureHandler.load()(m_name, allocations);
+}
+size_t AllocationTracker::NoAllocationScope::GetAllocations() const
+{
+	return s_threadAllocations - m_firstAllocation;
+}
+
+void AllocationTracker::SetEnabled(bool enabled)
+{
+	s_enabled.store(enabled, memory_order_relaxed);
+}
+bool AllocationTracker::IsEnabled()
+{
+	return s_enabled.load(memory_order_relaxed);
+}
+
+void AllocationTracker::OnAllocation(size_t size)
+{
+	if (!IsEnabled())
+		return;
+
+	auto& statistics = s_currentFrame[static_cast<size_t>(s_threadTag)];
+	statistics.Allocations.fetch_add(1, memory_order_relaxed);
+	statistics.AllocatedBytes.fetch_add(size, memory_order_relaxed);
+	++s_threadAllocations;
+}
+void AllocationTracker::OnDeallocation()
+{
+	if (!IsEnabled())
+		return;
+
+	s_currentFrame[static_cast<size_t>(s_threadTag)].Deallocations.fetch_add(1, memory_order_relaxed);
+}
+
+void AllocationTracker::BeginFrame()
+{
+	for (size_t tag = 0; tag < s_currentFrame.size(); ++tag)
+	{
+		auto& current = s_currentFrame[tag];
+		auto& last = s_lastFrame.Tags[tag];
+		last.Allocations = current.Allocations.exchange(0, memory_order_relaxed);
+		last.AllocatedBytes = current.AllocatedBytes.exchange(0, memory_order_relaxed);
+		last.Deallocations = current.Deallocations.exchange(0, memory_order_relaxed);
+	}
+}
+const AllocationTracker::FrameStatistics& AllocationTracker::GetLastFrameStatistics()
+{
+	return s_lastFrame;
+}
+AllocationTracker::FrameStatistics AllocationTracker::GetCurrentFrameStatistics()
+{
+	FrameStatistics frameStatistics;
+	for (size_t tag = 0; tag < s_currentFrame.size(); ++tag)
+	{
+		const auto& current = s_currentFrame[tag];
+		auto& statistics = frameStatistics.Tags[tag];
+		statistics.Allocations = current.Allocations.load(memory_order_relaxed);
+		statistics.AllocatedBytes = current.AllocatedBytes.load(memory_order_relaxed);
+		statistics.Deallocations = current.Deallocations.load(memory_order_relaxed);
+	}
+
+	return frameStatistics;
+}
+
+void AllocationTracker::SetFailureHandler(FailureHandler failureHandler)
+{
+	s_failureHandler.store(failureHandler != nullptr ? failureHandler : &AssertNoAllocations);
+}
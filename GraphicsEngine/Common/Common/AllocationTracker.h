@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace Common
+{
+	// Subsystem which an allocation is attributed to:
+	enum class AllocationTag : uint8_t
+	{
+		Untagged,
+		Scene,
+		Culling,
+		Rendering,
+		Resources,
+		Terrain,
+		Count
+	};
+
+	// Counts the heap allocations of a module, by tag and by frame. The allocations are reported by the global operator new
+	// and delete of AllocationHook.h, so a module is only tracked if one of its own source files includes that file, and only once
+	// tracking is enabled.
+	// Each module which links the Common library has its own counters.
+	class AllocationTracker
+	{
+	public:
+		struct Statistics
+		{
+			size_t Allocations = 0;
+			size_t AllocatedBytes = 0;
+			size_t Deallocations = 0;
+		};
+
+		struct FrameStatistics
+		{
+			std::array<Statistics, static_cast<size_t>(AllocationTag::Count)> Tags;
+
+			const Statistics& Get(AllocationTag tag) const;
+			Statistics GetTotal() const;
+		};
+
+		// Called when a no-allocation scope is left after allocating:
+		using FailureHandler = void(*)(const char* scopeName, size_t allocations);
+
+		// Attributes the allocations of the current thread to a tag, until the scope is left:
+		class TagScope
+		{
+		public:
+			explicit TagScope(AllocationTag tag);
+			TagScope(const TagScope&) = delete;
+			TagScope& operator=(const TagScope&) = delete;
+			~TagScope();
+
+		private:
+			AllocationTag m_previousTag;
+		};
+
+		// Marks a region of a hot path which must not allocate in the steady state. If the current thread allocates while the
+		// scope is alive, the failure handler is called when the scope is left. Allocations made by other threads, such as the
+		// workers of a thread pool, are not checked.
+		class NoAllocationScope
+		{
+		public:
+			explicit NoAllocationScope(const char* name);
+			NoAllocationScope(const NoAllocationScope&) = delete;
+			NoAllocationScope& operator=(const NoAllocationScope&) = delete;
+			~NoAllocationScope();
+
+			size_t GetAllocations() const;
+
+		private:
+			const char* m_name;
+			size_t m_firstAllocation;
+		};
+
+	public:
+		static void SetEnabled(bool enabled);
+		static bool IsEnabled();
+
+		static void OnAllocation(size_t size);
+		static void OnDeallocation();
+
+		// Stores the counters of the frame which ended and starts counting a new one:
+		static void BeginFrame();
+		static const FrameStatistics& GetLastFrameStatistics();
+		static FrameStatistics GetCurrentFrameStatistics();
+
+		// The default handler asserts:
+		static void SetFailureHandler(FailureHandler failureHandler);
+	};
+}
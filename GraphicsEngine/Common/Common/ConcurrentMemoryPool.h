@@ -0,0 +1,289 @@
+#pragma once
+
+#include <assert.h>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace GraphicsEngine
+{
+	// Memory pool which can be used from several threads at once. Like PagedMemoryPool, it grows by pages which are only
+	// released when the pool is destroyed, so elements never move while they are in use.
+	// The available elements form a lock-free stack. Its head packs the index of the top element with a tag which changes
+	// on every update, so a thread whose top element was popped and pushed back in between fails to update the head (ABA).
+	// A mutex is only taken to add pages.
+	// Threads which allocate a lot can use a Cache, which keeps some available elements for a single thread.
+	template<typename Type, size_t PageSize, size_t MaxPageCount = 4096>
+	class ConcurrentMemoryPool
+	{
+	private:
+		static_assert(PageSize * MaxPageCount < UINT32_MAX, "Elements are referenced by 32-bit indices");
+		static constexpr uint32_t s_nullIndex = UINT32_MAX;
+
+		struct Slot
+		{
+			// The element is stored at the beginning of its slot:
+			typename std::aligned_storage<sizeof(Type), alignof(Type)>::type Storage;
+			std::atomic<uint32_t> Next;
+			uint32_t Index;
+			bool Initialized;
+		};
+		using Page = std::array<Slot, PageSize>;
+
+	public:
+		// Available elements owned by a single thread. The elements are taken from and given back to the pool in batches.
+		// Elements can be deleted by any thread and through any cache, regardless of where they were created.
+		template<size_t CacheSize = 64>
+		class Cache
+		{
+			static_assert(CacheSize >= 2, "The cache exchanges half of its elements with the pool");
+
+		public:
+			explicit Cache(ConcurrentMemoryPool& pool) :
+				m_pool(pool)
+			{
+			}
+			Cache(const Cache&) = delete;
+			Cache& operator=(const Cache&) = delete;
+			~Cache()
+			{
+				Flush(m_count);
+				m_pool.m_activeElements.fetch_add(m_activeElementsDelta, std::memory_order_relaxed);
+			}
+
+			template<typename... ArgumentsType>
+			Type& NewElement(ArgumentsType&&... arguments)
+			{
+				// Take up to half a cache of elements from the pool when the cache is empty:
+				if (m_count == 0)
+					m_count = m_pool.PopAvailable(CacheSize / 2, m_first);
+
+				auto& slot = m_pool.GetSlot(m_first);
+				m_first = slot.Next.load(std::memory_order_relaxed);
+				--m_count;
+				++m_activeElementsDelta;
+
+				return Initialize(slot, std::forward<ArgumentsType>(arguments)...);
+			}
+
+			void DeleteElement(Type& element)
+			{
+				auto& slot = m_pool.GetSlot(element);
+				Shutdown(slot);
+				--m_activeElementsDelta;
+
+				slot.Next.store(m_first, std::memory_order_relaxed);
+				m_first = slot.Index;
+
+				// Give half of the elements back when the cache is full:
+				if (++m_count == CacheSize)
+					Flush(CacheSize / 2);
+			}
+
+		private:
+			void Flush(size_t count)
+			{
+				if (count == 0)
+					return;
+
+				// Detach the first elements of the cache and push them as a single chain:
+				auto first = m_first;
+				auto last = m_first;
+				for (size_t i = 1; i < count; ++i)
+					last = m_pool.GetSlot(last).Next.load(std::memory_order_relaxed);
+				m_first = m_pool.GetSlot(last).Next.load(std::memory_order_relaxed);
+				m_count -= count;
+
+				m_pool.PushAvailable(first, last);
+			}
+
+		private:
+			ConcurrentMemoryPool& m_pool;
+			uint32_t m_first = s_nullIndex;
+			size_t m_count = 0;
+
+			// Merged into the pool when the cache is destroyed, so that the threads don't share a counter:
+			ptrdiff_t m_activeElementsDelta = 0;
+		};
+
+	public:
+		ConcurrentMemoryPool() = default;
+		ConcurrentMemoryPool(const ConcurrentMemoryPool&) = delete;
+		ConcurrentMemoryPool& operator=(const ConcurrentMemoryPool&) = delete;
+		~ConcurrentMemoryPool()
+		{
+			// Destroy the elements which are still in use:
+			for (size_t pageIndex = 0; pageIndex < m_pageCount; ++pageIndex)
+			{
+				for (auto& slot : *m_pages[pageIndex])
+				{
+					if (slot.Initialized)
+						Shutdown(slot);
+				}
+			}
+		}
+
+		template<typename... ArgumentsType>
+		Type& NewElement(ArgumentsType&&... arguments)
+		{
+			auto& slot = GetSlot(PopAvailable());
+			m_activeElements.fetch_add(1, std::memory_order_relaxed);
+
+			return Initialize(slot, std::forward<ArgumentsType>(arguments)...);
+		}
+
+		void DeleteElement(Type& element)
+		{
+			auto& slot = GetSlot(element);
+			Shutdown(slot);
+			m_activeElements.fetch_sub(1, std::memory_order_relaxed);
+
+			PushAvailable(slot.Index, slot.Index);
+		}
+
+		// Adds pages until the pool can hold the given number of elements:
+		void Reserve(size_t capacity)
+		{
+			std::lock_guard<std::mutex> lock(m_pageMutex);
+			while (GetCapacity() < capacity)
+				AddPage();
+		}
+
+		// Elements created or deleted through caches which are still alive are only counted once the caches are destroyed:
+		size_t GetActiveElements() const
+		{
+			return m_activeElements.load(std::memory_order_relaxed);
+		}
+		size_t GetCapacity() const
+		{
+			return m_pageCount.load(std::memory_order_acquire) * PageSize;
+		}
+		size_t GetPageCount() const
+		{
+			return m_pageCount.load(std::memory_order_acquire);
+		}
+		static constexpr size_t GetPageSize()
+		{
+			return PageSize;
+		}
+
+	private:
+		template<typename... ArgumentsType>
+		static Type& Initialize(Slot& slot, ArgumentsType&&... arguments)
+		{
+			auto element = new (&slot.Storage) Type(std::forward<ArgumentsType>(arguments)...);
+			slot.Initialized = true;
+
+			return *element;
+		}
+		static void Shutdown(Slot& slot)
+		{
+			assert(slot.Initialized);
+			reinterpret_cast<Type&>(slot.Storage).~Type();
+			slot.Initialized = false;
+		}
+
+		uint32_t PopAvailable()
+		{
+			uint32_t index;
+			PopAvailable(1, index);
+
+			return index;
+		}
+		// Pops a chain of up to count elements with a single exchange of the head, and returns the number of elements in it:
+		size_t PopAvailable(size_t count, uint32_t& first)
+		{
+			while (true)
+			{
+				auto head = m_head.load(std::memory_order_acquire);
+				while (GetIndex(head) != s_nullIndex)
+				{
+					// If elements are popped by another thread in the meantime, the chain may be stale, but then the tag has changed
+					// and the exchange fails:
+					size_t chainCount = 1;
+					auto next = GetSlot(GetIndex(head)).Next.load(std::memory_order_relaxed);
+					for (; chainCount < count && next != s_nullIndex; ++chainCount)
+						next = GetSlot(next).Next.load(std::memory_order_relaxed);
+
+					if (m_head.compare_exchange_weak(head, Pack(next, GetTag(head) + 1), std::memory_order_acquire, std::memory_order_acquire))
+					{
+						first = GetIndex(head);
+						return chainCount;
+					}
+				}
+
+				// Add a page, unless another thread did while waiting for the lock:
+				std::lock_guard<std::mutex> lock(m_pageMutex);
+				if (GetIndex(m_head.load(std::memory_order_acquire)) == s_nullIndex)
+					AddPage();
+			}
+		}
+		void PushAvailable(uint32_t first, uint32_t last)
+		{
+			auto& lastSlot = GetSlot(last);
+			auto head = m_head.load(std::memory_order_relaxed);
+			do
+			{
+				lastSlot.Next.store(GetIndex(head), std::memory_order_relaxed);
+			} while (!m_head.compare_exchange_weak(head, Pack(first, GetTag(head) + 1), std::memory_order_release, std::memory_order_relaxed));
+		}
+
+		void AddPage()
+		{
+			auto pageIndex = m_pageCount.load(std::memory_order_relaxed);
+			assert(pageIndex < MaxPageCount);
+
+			m_pages[pageIndex] = std::make_unique<Page>();
+			auto& page = *m_pages[pageIndex];
+			auto firstIndex = static_cast<uint32_t>(pageIndex * PageSize);
+			for (size_t i = 0; i < PageSize; ++i)
+			{
+				page[i].Next.store(static_cast<uint32_t>(firstIndex + i + 1), std::memory_order_relaxed);
+				page[i].Index = static_cast<uint32_t>(firstIndex + i);
+				page[i].Initialized = false;
+			}
+			m_pageCount.store(pageIndex + 1, std::memory_order_release);
+
+			// Publishing the elements also publishes the page to the threads which pop them:
+			PushAvailable(firstIndex, static_cast<uint32_t>(firstIndex + PageSize - 1));
+		}
+
+		Slot& GetSlot(uint32_t index) const
+		{
+			return (*m_pages[index / PageSize])[index % PageSize];
+		}
+		static Slot& GetSlot(Type& element)
+		{
+			return reinterpret_cast<Slot&>(element);
+		}
+
+		static uint64_t Pack(uint32_t index, uint32_t tag)
+		{
+			return static_cast<uint64_t>(tag) << 32 | index;
+		}
+		static uint32_t GetIndex(uint64_t head)
+		{
+			return static_cast<uint32_t>(head);
+		}
+		static uint32_t GetTag(uint64_t head)
+		{
+			return static_cast<uint32_t>(head >> 32);
+		}
+
+	private:
+		// The head of the stack of available elements:
+		std::atomic<uint64_t> m_head { Pack(s_nullIndex, 0) };
+
+		std::array<std::unique_ptr<Page>, MaxPageCount> m_pages;
+		std::atomic<size_t> m_pageCount { 0 };
+		std::mutex m_pageMutex;
+
+		std::atomic<size_t> m_activeElements { 0 };
+	};
+}
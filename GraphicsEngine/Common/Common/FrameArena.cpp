@@ -0,0 +1,111 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <assert.h>
+
+using namespace Common;
+using namespace std;
+
+LinearArena::LinearArena(size_t blockSize) :
+	m_blockSize(blockSize)
+{
+}
+
+void* LinearArena::Allocate(size_t size, size_t alignment)
+{
+	assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+	// Find the first block, starting from the current one, with enough space after aligning:
+	while (m_currentBlock < m_blocks.size())
+	{
+		auto& block = m_blocks[m_currentBlock];
+		auto address = reinterpret_cast<uintptr_t>(block.Data.get()) + m_offset;
+		auto alignedAddress = (address + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+		auto alignedOffset = m_offset + static_cast<size_t>(alignedAddress - address);
+		if (alignedOffset + size <= block.Size)
+		{
+			m_offset = alignedOffset + size;
+			m_usedSize += size;
+			m_peakUsedSize = max(m_peakUsedSize, m_usedSize);
+			return block.Data.get() + alignedOffset;
+		}
+
+		++m_currentBlock;
+		m_offset = 0;
+	}
+
+	// Add a block large enough for the allocation, even in the worst alignment case:
+	AddBlock(size + alignment);
+	return Allocate(size, alignment);
+}
+
+void LinearArena::Reset()
+{
+	if (m_blocks.size() > 1)
+	{
+		auto capacity = GetCapacity();
+		m_blocks.clear();
+		AddBlock(capacity);
+	}
+
+	m_currentBlock = 0;
+	m_offset = 0;
+	m_usedSize = 0;
+}
+
+size_t LinearArena::GetUsedSize() const
+{
+	return m_usedSize;
+}
+size_t LinearArena::GetPeakUsedSize() const
+{
+	return m_peakUsedSize;
+}
+size_t LinearArena::GetCapacity() const
+{
+	size_t capacity = 0;
+	for (const auto& block : m_blocks)
+		capacity += block.Size;
+
+	return capacity;
+}
+size_t LinearArena::GetBlockCount() const
+{
+	return m_blocks.size();
+}
+
+void LinearArena::AddBlock(size_t minimumSize)
+{
+	auto size = max(m_blockSize, minimumSize);
+	m_blocks.push_back({ unique_ptr<uint8_t[]>(new uint8_t[size]), size });
+}
+
+FrameArena::FrameArena(size_t blockSize) :
+	m_arenas{ { LinearArena(blockSize), LinearArena(blockSize) } }
+{
+}
+
+void FrameArena::BeginFrame()
+{
+	// The arena of the frame before the previous one is reused:
+	m_currentArena = 1 - m_currentArena;
+	m_arenas[m_currentArena].Reset();
+}
+
+void* FrameArena::Allocate(size_t size, size_t alignment)
+{
+	return GetCurrent().Allocate(size, alignment);
+}
+
+LinearArena& FrameArena::GetCurrent()
+{
+	return m_arenas[m_currentArena];
+}
+const LinearArena& FrameArena::GetCurrent() const
+{
+	return m_arenas[m_currentArena];
+}
+const LinearArena& FrameArena::GetPrevious() const
+{
+	return m_arenas[1 - m_currentArena];
+}
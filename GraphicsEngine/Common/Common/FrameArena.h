@@ -0,0 +1,169 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Common
+{
+	// Bump allocator for transient data. Memory is taken from blocks which are kept when the arena is reset, so once the
+	// blocks are large enough, allocating doesn't touch the heap. Individual allocations are never freed and destructors are
+	// never called, so only trivially destructible types can be created in the arena.
+	class LinearArena
+	{
+	public:
+		explicit LinearArena(size_t blockSize = 1 << 20);
+
+		LinearArena(const LinearArena&) = delete;
+		LinearArena(LinearArena&&) = default;
+		LinearArena& operator=(const LinearArena&) = delete;
+		LinearArena& operator=(LinearArena&&) = default;
+
+		void* Allocate(size_t size, size_t alignment);
+
+		template<typename Type, typename... ArgumentsType>
+		Type* New(ArgumentsType&&... arguments);
+		template<typename Type>
+		Type* NewArray(size_t count);
+
+		// Releases all allocations. If the last use needed several blocks, they are replaced by a single block of the same
+		// total size, so that the next use fits into one block:
+		void Reset();
+
+		size_t GetUsedSize() const;
+		size_t GetPeakUsedSize() const;
+		size_t GetCapacity() const;
+		size_t GetBlockCount() const;
+
+	private:
+		struct Block
+		{
+			std::unique_ptr<uint8_t[]> Data;
+			size_t Size;
+		};
+
+		void AddBlock(size_t minimumSize);
+
+	private:
+		size_t m_blockSize;
+		std::vector<Block> m_blocks;
+		size_t m_currentBlock = 0;
+		size_t m_offset = 0;
+		size_t m_usedSize = 0;
+		size_t m_peakUsedSize = 0;
+	};
+
+	// Pair of arenas which are used in alternate frames, so that the data of a frame is still valid during the next one.
+	// BeginFrame is called once per frame, before anything is allocated for it.
+	class FrameArena
+	{
+	public:
+		explicit FrameArena(size_t blockSize = 1 << 20);
+
+		void BeginFrame();
+
+		void* Allocate(size_t size, size_t alignment);
+
+		template<typename Type, typename... ArgumentsType>
+		Type* New(ArgumentsType&&... arguments);
+		template<typename Type>
+		Type* NewArray(size_t count);
+
+		LinearArena& GetCurrent();
+		const LinearArena& GetCurrent() const;
+		const LinearArena& GetPrevious() const;
+
+	private:
+		std::array<LinearArena, 2> m_arenas;
+		size_t m_currentArena = 0;
+	};
+
+	// Standard allocator which allocates from an arena, so that standard containers can hold transient data.
+	// Deallocating does nothing: the memory is released when the arena is reset, and the containers must not be used after that.
+	template<typename Type>
+	class ArenaAllocator
+	{
+	public:
+		using value_type = Type;
+
+	public:
+		explicit ArenaAllocator(LinearArena& arena) :
+			m_arena(&arena)
+		{
+		}
+		explicit ArenaAllocator(FrameArena& arena) :
+			m_arena(&arena.GetCurrent())
+		{
+		}
+		template<typename OtherType>
+		ArenaAllocator(const ArenaAllocator<OtherType>& other) :
+			m_arena(&other.GetArena())
+		{
+		}
+
+		Type* allocate(size_t count)
+		{
+			return static_cast<Type*>(m_arena->Allocate(count * sizeof(Type), alignof(Type)));
+		}
+		void deallocate(Type*, size_t)
+		{
+		}
+
+		LinearArena& GetArena() const
+		{
+			return *m_arena;
+		}
+
+	private:
+		LinearArena* m_arena;
+	};
+
+	template<typename Type, typename OtherType>
+	bool operator==(const ArenaAllocator<Type>& allocator0, const ArenaAllocator<OtherType>& allocator1)
+	{
+		return &allocator0.GetArena() == &allocator1.GetArena();
+	}
+	template<typename Type, typename OtherType>
+	bool operator!=(const ArenaAllocator<Type>& allocator0, const ArenaAllocator<OtherType>& allocator1)
+	{
+		return !(allocator0 == allocator1);
+	}
+
+	template<typename Type>
+	using ArenaVector = std::vector<Type, ArenaAllocator<Type>>;
+
+	template<typename Type, typename... ArgumentsType>
+	Type* LinearArena::New(ArgumentsType&&... arguments)
+	{
+		static_assert(std::is_trivially_destructible<Type>::value, "Destructors of the objects in an arena are never called");
+
+		return new (Allocate(sizeof(Type), alignof(Type))) Type(std::forward<ArgumentsType>(arguments)...);
+	}
+	template<typename Type>
+	Type* LinearArena::NewArray(size_t count)
+	{
+		static_assert(std::is_trivially_destructible<Type>::value, "Destructors of the objects in an arena are never called");
+
+		auto elements = static_cast<Type*>(Allocate(count * sizeof(Type), alignof(Type)));
+		for (size_t i = 0; i < count; ++i)
+			new (elements + i) Type();
+
+		return elements;
+	}
+
+	template<typename Type, typename... ArgumentsType>
+	Type* FrameArena::New(ArgumentsType&&... arguments)
+	{
+		return GetCurrent().New<Type>(std::forward<ArgumentsType>(arguments)...);
+	}
+	template<typename Type>
+	Type* FrameArena::NewArray(size_t count)
+	{
+		return GetCurrent().NewArray<Type>(count);
+	}
+}
@@ -0,0 +1,56 @@
+#include "MemoryMappedFile.h"
+#include "Helpers.h"
+
+#include <stdexcept>
+
+using namespace Common;
+using namespace std;
+
+MemoryMappedFile::MemoryMappedFile(const std::wstring& filename)
+{
+	m_file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+		throw runtime_error("Couldn't open file " + Helpers::WStringToString(filename));
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_file, &size))
+	{
+		CloseHandle(m_file);
+		throw runtime_error("Couldn't get the size of file " + Helpers::WStringToString(filename));
+	}
+	m_size = static_cast<size_t>(size.QuadPart);
+
+	// Empty files can't be mapped:
+	if (m_size == 0)
+		return;
+
+	m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mapping != nullptr)
+		m_data = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+
+	if (m_data == nullptr)
+	{
+		if (m_mapping != nullptr)
+			CloseHandle(m_mapping);
+		CloseHandle(m_file);
+		throw runtime_error("Couldn't map file " + Helpers::WStringToString(filename));
+	}
+}
+MemoryMappedFile::~MemoryMappedFile()
+{
+	if (m_data != nullptr)
+		UnmapViewOfFile(m_data);
+	if (m_mapping != nullptr)
+		CloseHandle(m_mapping);
+	if (m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+}
+
+const void* MemoryMappedFile::GetData() const
+{
+	return m_data;
+}
+size_t MemoryMappedFile::GetSize() const
+{
+	return m_size;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <windows.h>
+
+namespace Common
+{
+	// Read-only view of the whole content of a file. The pages of the file are only read when they are first accessed,
+	// and they are shared with the file cache of the system instead of being copied into a buffer.
+	class MemoryMappedFile
+	{
+	public:
+		explicit MemoryMappedFile(const std::wstring& filename);
+		MemoryMappedFile(const MemoryMappedFile&) = delete;
+		MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+		~MemoryMappedFile();
+
+		const void* GetData() const;
+		template<typename DataType>
+		const DataType* GetData() const;
+		size_t GetSize() const;
+
+	private:
+		HANDLE m_file = INVALID_HANDLE_VALUE;
+		HANDLE m_mapping = nullptr;
+		const void* m_data = nullptr;
+		size_t m_size = 0;
+	};
+
+	template<typename DataType>
+	const DataType* MemoryMappedFile::GetData() const
+	{
+		return static_cast<const DataType*>(m_data);
+	}
+}
@@ -1,5 +1,8 @@
 ﻿#pragma once
 
+#include <new>
+#include <utility>
+
 namespace GraphicsEngine
 {
 	template<typename Type>
@@ -9,8 +12,13 @@ namespace GraphicsEngine
 		union State
 		{
 			Type Element;
-			MemoryPoolElement* Next = nullptr;
+			MemoryPoolElement* Next;
 
+			// The free slots of a pool hold the link to the next free slot, and their elements are constructed by Initialize:
+			State() :
+				Next(nullptr)
+			{
+			}
 			template<typename... ArgumentsType>
 			explicit State(ArgumentsType&&... arguments) :
 				Element(std::forward<ArgumentsType>(arguments)...)
@@ -35,7 +43,8 @@ namespace GraphicsEngine
 		template<typename... ArgumentsType>
 		void Initialize(ArgumentsType&&... arguments)
 		{
-			m_state.Element = Type(std::forward<ArgumentsType>(arguments)...);
+			// The element was destroyed when it was returned to the pool, so it must be constructed in place:
+			new (&m_state.Element) Type(std::forward<ArgumentsType>(arguments)...);
 			m_initialized = true;
 		}
 
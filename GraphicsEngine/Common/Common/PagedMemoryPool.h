@@ -0,0 +1,135 @@
+#pragma once
+
+#include <assert.h>
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "MemoryPoolElement.h"
+
+namespace GraphicsEngine
+{
+	// Memory pool which grows by pages of elements when it is full. Pages are only released when the pool is destroyed,
+	// so elements never move while they are in use. Elements are constructed in place, when they are requested.
+	template<typename Type, size_t PageSize>
+	class PagedMemoryPool
+	{
+	private:
+		using Page = std::array<MemoryPoolElement<Type>, PageSize>;
+
+	public:
+		PagedMemoryPool() = default;
+		PagedMemoryPool(const PagedMemoryPool&) = delete;
+		PagedMemoryPool& operator=(const PagedMemoryPool&) = delete;
+		~PagedMemoryPool()
+		{
+			// Destroy the elements which are still in use:
+			for (auto& page : m_pages)
+			{
+				for (auto& poolElement : *page)
+				{
+					if (poolElement.IsInitialized())
+						poolElement.Shutdown(nullptr);
+				}
+			}
+		}
+
+		template<typename... ArgumentsType>
+		Type& NewElement(ArgumentsType&&... arguments)
+		{
+			// Add a page when there are no available elements:
+			if (m_firstAvailable == nullptr)
+				AddPage();
+
+			++m_activeElements;
+			if (m_activeElements > m_peakActiveElements)
+				m_peakActiveElements = m_activeElements;
+
+			// Remove new element from the list of available elements:
+			auto& newElement = *m_firstAvailable;
+			m_firstAvailable = newElement.GetNext();
+
+			// Initialize element:
+			newElement.Initialize(std::forward<ArgumentsType>(arguments)...);
+
+			return newElement.GetElement();
+		}
+
+		void DeleteElement(Type& element)
+		{
+			// The element is stored at the beginning of its pool element:
+			auto& poolElement = reinterpret_cast<MemoryPoolElement<Type>&>(element);
+			assert(Contains(poolElement));
+
+			if (poolElement.IsInitialized())
+			{
+				poolElement.Shutdown(m_firstAvailable);
+				m_firstAvailable = &poolElement;
+
+				--m_activeElements;
+			}
+		}
+
+		// Adds pages until the pool can hold the given number of elements, so that they can be requested without allocating:
+		void Reserve(size_t capacity)
+		{
+			while (GetCapacity() < capacity)
+				AddPage();
+		}
+
+		size_t GetActiveElements() const
+		{
+			return m_activeElements;
+		}
+		size_t GetPeakActiveElements() const
+		{
+			return m_peakActiveElements;
+		}
+		size_t GetCapacity() const
+		{
+			return m_pages.size() * PageSize;
+		}
+		size_t GetPageCount() const
+		{
+			return m_pages.size();
+		}
+		size_t GetMemoryUsage() const
+		{
+			return m_pages.size() * sizeof(Page);
+		}
+		static constexpr size_t GetPageSize()
+		{
+			return PageSize;
+		}
+
+	private:
+		void AddPage()
+		{
+			m_pages.push_back(std::make_unique<Page>());
+			auto& page = *m_pages.back();
+
+			// Link the elements of the new page into the list of available elements:
+			for (size_t i = 0; i < PageSize - 1; ++i)
+				page[i].SetNext(&page[i + 1]);
+			page[PageSize - 1].SetNext(m_firstAvailable);
+			m_firstAvailable = &page[0];
+		}
+		bool Contains(const MemoryPoolElement<Type>& poolElement) const
+		{
+			for (const auto& page : m_pages)
+			{
+				if (&poolElement >= page->data() && &poolElement < page->data() + PageSize)
+					return true;
+			}
+
+			return false;
+		}
+
+	private:
+		std::vector<std::unique_ptr<Page>> m_pages;
+		size_t m_activeElements = 0;
+		size_t m_peakActiveElements = 0;
+
+		MemoryPoolElement<Type>* m_firstAvailable = nullptr;
+	};
+}
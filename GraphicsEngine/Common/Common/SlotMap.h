@@ -0,0 +1,244 @@
+#pragma once
+
+#include <assert.h>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace GraphicsEngine
+{
+	// Handle to an element of a slot map. It packs the index of a slot with the generation of the slot when the element was
+	// inserted, so handles to removed elements are detected even after their slot is reused.
+	class SlotMapHandle
+	{
+	public:
+		static constexpr uint32_t IndexBits = 22;
+		static constexpr uint32_t MaxIndex = (1u << IndexBits) - 1;
+		static constexpr uint32_t MaxGeneration = (1u << (32 - IndexBits)) - 1;
+
+	public:
+		SlotMapHandle() = default;
+		SlotMapHandle(uint32_t index, uint32_t generation) :
+			m_value(generation << IndexBits | index)
+		{
+		}
+
+		uint32_t GetIndex() const
+		{
+			return m_value & MaxIndex;
+		}
+		uint32_t GetGeneration() const
+		{
+			return m_value >> IndexBits;
+		}
+
+		// Generations start at one, so a default constructed handle never refers to an element:
+		bool IsNull() const
+		{
+			return m_value == 0;
+		}
+
+		bool operator==(const SlotMapHandle& other) const
+		{
+			return m_value == other.m_value;
+		}
+		bool operator!=(const SlotMapHandle& other) const
+		{
+			return m_value != other.m_value;
+		}
+
+	private:
+		uint32_t m_value = 0;
+	};
+
+	// Container which gives out stable handles to its elements, while keeping the elements contiguous so they can be
+	// iterated and uploaded directly. Elements are removed by moving the last element into their place, so the order of
+	// the elements changes, but the handles stay valid.
+	// Containers which are stored alongside the elements can follow the same moves, through GetIndex and the index
+	// returned by Remove.
+	template<typename Type>
+	class SlotMap
+	{
+	private:
+		struct Slot
+		{
+			// Index of the element, or of the next free slot if the slot is free:
+			uint32_t Index;
+			uint32_t Generation;
+		};
+
+	public:
+		using Handle = SlotMapHandle;
+
+	public:
+		SlotMap() = default;
+
+		template<typename... ArgumentsType>
+		Handle Emplace(ArgumentsType&&... arguments)
+		{
+			// Reuse a free slot, or add one:
+			uint32_t slotIndex;
+			if (m_firstFreeSlot != s_nullIndex)
+			{
+				slotIndex = m_firstFreeSlot;
+				m_firstFreeSlot = m_slots[slotIndex].Index;
+			}
+			else
+			{
+				assert(m_slots.size() <= Handle::MaxIndex);
+				slotIndex = static_cast<uint32_t>(m_slots.size());
+				m_slots.push_back({ 0, 1 });
+			}
+
+			auto& slot = m_slots[slotIndex];
+			slot.Index = static_cast<uint32_t>(m_elements.size());
+			m_elements.emplace_back(std::forward<ArgumentsType>(arguments)...);
+			m_elementSlots.push_back(slotIndex);
+
+			return Handle(slotIndex, slot.Generation);
+		}
+		Handle Insert(const Type& element)
+		{
+			return Emplace(element);
+		}
+
+		// Returns the index that the element had, which now holds the element that was last, if any.
+		// Removing an element which was already removed does nothing and returns the size.
+		size_t Remove(Handle handle)
+		{
+			if (!Contains(handle))
+				return m_elements.size();
+
+			auto& slot = m_slots[handle.GetIndex()];
+			auto index = slot.Index;
+
+			// Move the last element into the place of the removed one:
+			auto lastIndex = static_cast<uint32_t>(m_elements.size() - 1);
+			if (index != lastIndex)
+			{
+				m_elements[index] = std::move(m_elements[lastIndex]);
+				m_elementSlots[index] = m_elementSlots[lastIndex];
+				m_slots[m_elementSlots[index]].Index = index;
+			}
+			m_elements.pop_back();
+			m_elementSlots.pop_back();
+
+			// Invalidate the handles to the slot and make it available. Generations wrap around, skipping zero:
+			slot.Generation = slot.Generation == Handle::MaxGeneration ? 1 : slot.Generation + 1;
+			slot.Index = m_firstFreeSlot;
+			m_firstFreeSlot = handle.GetIndex();
+
+			return index;
+		}
+
+		void Clear()
+		{
+			// Invalidate all handles:
+			for (auto slotIndex : m_elementSlots)
+			{
+				auto& slot = m_slots[slotIndex];
+				slot.Generation = slot.Generation == Handle::MaxGeneration ? 1 : slot.Generation + 1;
+				slot.Index = m_firstFreeSlot;
+				m_firstFreeSlot = slotIndex;
+			}
+
+			m_elements.clear();
+			m_elementSlots.clear();
+		}
+		void Reserve(size_t capacity)
+		{
+			m_elements.reserve(capacity);
+			m_elementSlots.reserve(capacity);
+			m_slots.reserve(capacity);
+		}
+
+		bool Contains(Handle handle) const
+		{
+			return handle.GetIndex() < m_slots.size() && m_slots[handle.GetIndex()].Generation == handle.GetGeneration() && !handle.IsNull();
+		}
+
+		// Returns nullptr if the element was removed:
+		Type* Find(Handle handle)
+		{
+			return Contains(handle) ? &m_elements[m_slots[handle.GetIndex()].Index] : nullptr;
+		}
+		const Type* Find(Handle handle) const
+		{
+			return Contains(handle) ? &m_elements[m_slots[handle.GetIndex()].Index] : nullptr;
+		}
+
+		Type& operator[](Handle handle)
+		{
+			assert(Contains(handle));
+			return m_elements[m_slots[handle.GetIndex()].Index];
+		}
+		const Type& operator[](Handle handle) const
+		{
+			assert(Contains(handle));
+			return m_elements[m_slots[handle.GetIndex()].Index];
+		}
+
+		// Index of the element in the contiguous elements:
+		size_t GetIndex(Handle handle) const
+		{
+			assert(Contains(handle));
+			return m_slots[handle.GetIndex()].Index;
+		}
+		Handle GetHandle(size_t index) const
+		{
+			auto slotIndex = m_elementSlots[index];
+			return Handle(slotIndex, m_slots[slotIndex].Generation);
+		}
+
+		const std::vector<Type>& GetElements() const
+		{
+			return m_elements;
+		}
+		Type& GetElement(size_t index)
+		{
+			return m_elements[index];
+		}
+		const Type& GetElement(size_t index) const
+		{
+			return m_elements[index];
+		}
+		size_t GetSize() const
+		{
+			return m_elements.size();
+		}
+		bool IsEmpty() const
+		{
+			return m_elements.empty();
+		}
+		size_t GetCapacity() const
+		{
+			return m_elements.capacity();
+		}
+
+		typename std::vector<Type>::iterator begin()
+		{
+			return m_elements.begin();
+		}
+		typename std::vector<Type>::iterator end()
+		{
+			return m_elements.end();
+		}
+		typename std::vector<Type>::const_iterator begin() const
+		{
+			return m_elements.begin();
+		}
+		typename std::vector<Type>::const_iterator end() const
+		{
+			return m_elements.end();
+		}
+
+	private:
+		static constexpr uint32_t s_nullIndex = UINT32_MAX;
+
+		std::vector<Type> m_elements;
+		// Slot of each element:
+		std::vector<uint32_t> m_elementSlots;
+		std::vector<Slot> m_slots;
+		uint32_t m_firstFreeSlot = s_nullIndex;
+	};
+}
@@ -0,0 +1,91 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+using namespace Common;
+using namespace std;
+
+ThreadPool::ThreadPool() :
+	ThreadPool(max(thread::hardware_concurrency(), 1U) - 1)
+{
+}
+ThreadPool::ThreadPool(size_t workerThreadCount)
+{
+	m_workerThreads.reserve(workerThreadCount);
+	for (size_t i = 0; i < workerThreadCount; ++i)
+		m_workerThreads.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+ThreadPool::~ThreadPool()
+{
+	// Signal the workers to stop and wait for them:
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wakeCondition.notify_all();
+
+	for (auto& workerThread : m_workerThreads)
+		workerThread.join();
+}
+
+size_t ThreadPool::GetThreadCount() const
+{
+	return m_workerThreads.size() + 1;
+}
+
+void ThreadPool::Run(TaskFunction task, void* function, size_t taskCount)
+{
+	// Only one caller can use the workers at a time:
+	lock_guard<mutex> runLock(m_runMutex);
+
+	// Publish the tasks and wake up the workers:
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_task = task;
+		m_function = function;
+		m_taskCount = taskCount;
+		m_nextTask.store(0, memory_order_relaxed);
+		m_activeWorkerCount = m_workerThreads.size();
+		++m_generation;
+	}
+	m_wakeCondition.notify_all();
+
+	// Help the workers:
+	ExecuteTasks();
+
+	// Wait until all workers are done with the current tasks:
+	unique_lock<mutex> lock(m_mutex);
+	m_doneCondition.wait(lock, [this]() { return m_activeWorkerCount == 0; });
+	m_task = nullptr;
+	m_function = nullptr;
+}
+void ThreadPool::ExecuteTasks()
+{
+	for (auto taskIndex = m_nextTask.fetch_add(1); taskIndex < m_taskCount; taskIndex = m_nextTask.fetch_add(1))
+		m_task(m_function, taskIndex);
+}
+void ThreadPool::WorkerLoop()
+{
+	uint64_t generation = 0;
+	while (true)
+	{
+		// Wait for new tasks:
+		{
+			unique_lock<mutex> lock(m_mutex);
+			m_wakeCondition.wait(lock, [this, generation]() { return m_stop || m_generation != generation; });
+			if (m_stop)
+				return;
+
+			generation = m_generation;
+		}
+
+		ExecuteTasks();
+
+		// Notify the caller if this was the last worker:
+		{
+			lock_guard<mutex> lock(m_mutex);
+			if (--m_activeWorkerCount == 0)
+				m_doneCondition.notify_one();
+		}
+	}
+}
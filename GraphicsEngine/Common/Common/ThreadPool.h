@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace Common
+{
+	// Pool of persistent worker threads which execute indexed tasks. The calling thread also executes tasks,
+	// so a pool created with N worker threads runs on N + 1 threads. ParallelFor must not be called from inside a task.
+	class ThreadPool
+	{
+	public:
+		ThreadPool();
+		explicit ThreadPool(size_t workerThreadCount);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		// Calls function(taskIndex) for every task index in [0, taskCount) and waits until all calls have returned:
+		template<typename FunctionType>
+		void ParallelFor(size_t taskCount, FunctionType&& function);
+
+		size_t GetThreadCount() const;
+
+	private:
+		using TaskFunction = void(*)(void* function, size_t taskIndex);
+
+		void Run(TaskFunction task, void* function, size_t taskCount);
+		void ExecuteTasks();
+		void WorkerLoop();
+
+	private:
+		std::vector<std::thread> m_workerThreads;
+		std::mutex m_runMutex;
+		std::mutex m_mutex;
+		std::condition_variable m_wakeCondition;
+		std::condition_variable m_doneCondition;
+		TaskFunction m_task = nullptr;
+		void* m_function = nullptr;
+		size_t m_taskCount = 0;
+		std::atomic<size_t> m_nextTask { 0 };
+		size_t m_activeWorkerCount = 0;
+		uint64_t m_generation = 0;
+		bool m_stop = false;
+	};
+
+	template<typename FunctionType>
+	void ThreadPool::ParallelFor(size_t taskCount, FunctionType&& function)
+	{
+		if (taskCount == 0)
+			return;
+
+		// Avoid waking up the workers if there is a single task:
+		if (taskCount == 1 || m_workerThreads.empty())
+		{
+			for (size_t i = 0; i < taskCount; ++i)
+				function(i);
+			return;
+		}
+
+		// The function outlives the tasks, so it is referenced instead of being copied into a std::function, which may allocate:
+		using FunctionPointerType = std::remove_reference_t<FunctionType>*;
+		auto task = [](void* function, size_t taskIndex)
+		{
+			(*static_cast<FunctionPointerType>(function))(taskIndex);
+		};
+		Run(task, const_cast<void*>(static_cast<const void*>(std::addressof(function))), taskCount);
+	}
+}
@@ -6,6 +6,8 @@
 #include "../TextureManager.h"
 #include "../VertexTypes.h"
 #include "../ImmutableMeshGeometry.h"
+#include "../MeshSimplifier.h"
+#include "../LevelOfDetailSelector.h"
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -15,6 +17,55 @@ using namespace Common;
 using namespace DirectX;
 using namespace GraphicsEngine;
 
+namespace
+{
+	void AddLevelsOfDetail(const std::vector<VertexTypes::DefaultVertexType>& vertices, std::vector<uint32_t>& indices, SubmeshGeometry& submesh)
+	{
+		// Positions and indices local to the submesh:
+		std::vector<XMFLOAT3> positions(vertices.size() - submesh.BaseVertexLocation);
+		for (size_t i = 0; i < positions.size(); ++i)
+			positions[i] = vertices[submesh.BaseVertexLocation + i].Position;
+		std::vector<uint32_t> levelIndices(indices.begin() + submesh.StartIndexLocation, indices.begin() + submesh.StartIndexLocation + submesh.IndexCount);
+
+		// Vertices at the same position are welded unless they are on a seam of the normals or the texture coordinates:
+		auto attributesEqual = [&vertices, &submesh](uint32_t vertex0, uint32_t vertex1)
+		{
+			const auto& attributes0 = vertices[submesh.BaseVertexLocation + vertex0];
+			const auto& attributes1 = vertices[submesh.BaseVertexLocation + vertex1];
+			return
+				XMVector3NearEqual(XMLoadFloat3(&attributes0.Normal), XMLoadFloat3(&attributes1.Normal), XMVectorReplicate(0.001f)) &&
+				XMVector3NearEqual(XMLoadFloat3(&attributes0.Tangent), XMLoadFloat3(&attributes1.Tangent), XMVectorReplicate(0.001f)) &&
+				XMVector2NearEqual(XMLoadFloat2(&attributes0.TextureCoordinates), XMLoadFloat2(&attributes1.TextureCoordinates), XMVectorReplicate(0.00001f));
+		};
+
+		BoundingBox bounds;
+		BoundingBox::CreateFromPoints(bounds, positions.size(), positions.data(), sizeof(XMFLOAT3));
+		auto size = 2.0f * XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Extents)));
+
+		// Each level divides the triangles of the previous one by a growing ratio, so that the coarsest level has 24 times fewer
+		// triangles than the submesh, and allows a larger error, relative to the size of the submesh:
+		std::array<size_t, LevelOfDetailSelector::MaxLevelCount - 1> reductionRatios = { 2, 3, 4 };
+		std::array<float, LevelOfDetailSelector::MaxLevelCount - 1> maxErrors = { 0.01f, 0.03f, 0.1f };
+		for (size_t level = 0; level < maxErrors.size(); ++level)
+		{
+			auto targetIndexCount = levelIndices.size() / (3 * reductionRatios[level]) * 3;
+			auto simplifiedIndices = MeshSimplifier::Simplify(positions, levelIndices, targetIndexCount, maxErrors[level] * size, attributesEqual);
+
+			// Stop when the simplification doesn't remove enough triangles for the level to be worth it:
+			if (simplifiedIndices.empty() || 10 * simplifiedIndices.size() > 9 * levelIndices.size())
+				break;
+
+			SubmeshGeometry::LevelOfDetail levelOfDetail;
+			levelOfDetail.IndexCount = static_cast<uint32_t>(simplifiedIndices.size());
+			levelOfDetail.StartIndexLocation = static_cast<uint32_t>(indices.size());
+			submesh.LevelsOfDetail.push_back(levelOfDetail);
+
+			indices.insert(indices.end(), simplifiedIndices.begin(), simplifiedIndices.end());
+			levelIndices = std::move(simplifiedIndices);
+		}
+	}
+}
+
 void AssimpImporter::Import(Graphics* graphics, const D3DBase& d3dBase, TextureManager& textureManager, IScene* scene, const std::wstring& filename, AssimpImporter::ImportInfo& importInfo)
 {
 	using namespace Assimp;
@@ -27,6 +78,7 @@ void AssimpImporter::Import(Graphics* graphics, const D3DBase& d3dBase, TextureM
 		aiProcess_CalcTangentSpace |
 		aiProcess_Triangulate |
 		aiProcess_GenSmoothNormals |
+		aiProcess_JoinIdenticalVertices |
 		aiProcess_SplitLargeMeshes |
 		aiProcess_ConvertToLeftHanded |
 		aiProcess_SortByPType;
@@ -126,6 +178,9 @@ void AssimpImporter::AddGeometry(const D3DBase& d3dBase, const std::string& name
 		submesh.StartIndexLocation = startIndexLocation;
 		submesh.BaseVertexLocation = baseVertexLocation;
 		submesh.Bounds = MeshGeometry::CreateBoundingBoxFromMesh(vertices);
+
+		// Add levels of detail after the indices of the submesh:
+		AddLevelsOfDetail(vertices, indices, submesh);
 		geometry->AddSubmesh(mesh->mName.C_Str(), std::move(submesh));
 
 		// Assign material to mesh:
@@ -135,7 +190,7 @@ void AssimpImporter::AddGeometry(const D3DBase& d3dBase, const std::string& name
 
 		// Increment location variables:
 		baseVertexLocation += mesh->mNumVertices;
-		startIndexLocation += mesh->mNumFaces * 3;
+		startIndexLocation = static_cast<uint32_t>(indices.size());
 	}
 
 	// Create vertex and index buffer:
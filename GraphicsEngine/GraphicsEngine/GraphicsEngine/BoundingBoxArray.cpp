@@ -0,0 +1,80 @@
+#include "stdafx.h"
+#include "BoundingBoxArray.h"
+
+using namespace DirectX;
+using namespace GraphicsEngine;
+
+void BoundingBoxArray::Add(const BoundingBox& box)
+{
+	// Grow the padded arrays by a whole group when the last group is full:
+	auto paddedSize = RoundUpToGroupSize(m_size + 1);
+	if (paddedSize != m_components[0].size())
+	{
+		for (auto& component : m_components)
+			component.resize(paddedSize, 0.0f);
+	}
+
+	Set(m_size++, box);
+}
+void BoundingBoxArray::Set(size_t index, const BoundingBox& box)
+{
+	m_components[static_cast<size_t>(Component::CenterX)][index] = box.Center.x;
+	m_components[static_cast<size_t>(Component::CenterY)][index] = box.Center.y;
+	m_components[static_cast<size_t>(Component::CenterZ)][index] = box.Center.z;
+	m_components[static_cast<size_t>(Component::ExtentsX)][index] = box.Extents.x;
+	m_components[static_cast<size_t>(Component::ExtentsY)][index] = box.Extents.y;
+	m_components[static_cast<size_t>(Component::ExtentsZ)][index] = box.Extents.z;
+}
+BoundingBox BoundingBoxArray::Get(size_t index) const
+{
+	return BoundingBox(
+		XMFLOAT3(
+			m_components[static_cast<size_t>(Component::CenterX)][index],
+			m_components[static_cast<size_t>(Component::CenterY)][index],
+			m_components[static_cast<size_t>(Component::CenterZ)][index]
+		),
+		XMFLOAT3(
+			m_components[static_cast<size_t>(Component::ExtentsX)][index],
+			m_components[static_cast<size_t>(Component::ExtentsY)][index],
+			m_components[static_cast<size_t>(Component::ExtentsZ)][index]
+		)
+	);
+}
+void BoundingBoxArray::RemoveLast()
+{
+	if (m_size == 0)
+		return;
+
+	// Reset the removed element, so that padding always contains empty boxes:
+	Set(--m_size, BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f)));
+
+	auto paddedSize = RoundUpToGroupSize(m_size);
+	for (auto& component : m_components)
+		component.resize(paddedSize);
+}
+void BoundingBoxArray::Clear()
+{
+	m_size = 0;
+	for (auto& component : m_components)
+		component.clear();
+}
+void BoundingBoxArray::Reserve(size_t capacity)
+{
+	auto paddedCapacity = RoundUpToGroupSize(capacity);
+	for (auto& component : m_components)
+		component.reserve(paddedCapacity);
+}
+
+size_t BoundingBoxArray::GetSize() const
+{
+	return m_size;
+}
+const float* BoundingBoxArray::GetComponent(Component component) const
+{
+	return m_components[static_cast<size_t>(component)].data();
+}
+
+size_t BoundingBoxArray::RoundUpToGroupSize(size_t count)
+{
+	return (count + GroupSize - 1) / GroupSize * GroupSize;
+}
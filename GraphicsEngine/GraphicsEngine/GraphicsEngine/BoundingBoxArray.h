@@ -0,0 +1,48 @@
+﻿#pragma once
+
+#include <DirectXCollision.h>
+#include <array>
+#include <vector>
+
+namespace GraphicsEngine
+{
+	// Axis-aligned bounding boxes stored as a structure of arrays, so that groups of GroupSize boxes can be
+	// loaded into SIMD registers at once. Each component array is padded to a multiple of GroupSize.
+	class BoundingBoxArray
+	{
+	public:
+		enum class Component
+		{
+			CenterX,
+			CenterY,
+			CenterZ,
+			ExtentsX,
+			ExtentsY,
+			ExtentsZ,
+			Count
+		};
+
+	public:
+		static constexpr size_t GroupSize = 4;
+
+	public:
+		BoundingBoxArray() = default;
+
+		void Add(const DirectX::BoundingBox& box);
+		void Set(size_t index, const DirectX::BoundingBox& box);
+		DirectX::BoundingBox Get(size_t index) const;
+		void RemoveLast();
+		void Clear();
+		void Reserve(size_t capacity);
+
+		size_t GetSize() const;
+		const float* GetComponent(Component component) const;
+
+	private:
+		static size_t RoundUpToGroupSize(size_t count);
+
+	private:
+		size_t m_size = 0;
+		std::array<std::vector<float>, static_cast<size_t>(Component::Count)> m_components;
+	};
+}
@@ -0,0 +1,530 @@
+#pragma once
+
+#include <DirectXCollision.h>
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "ISpatialIndex.h"
+#include "SpatialIndexQueries.h"
+
+namespace GraphicsEngineTester
+{
+	class SpatialIndexTest;
+}
+
+namespace GraphicsEngine
+{
+	// Binary tree of bounding boxes, split with the surface area heuristic evaluated over a fixed number of bins.
+	// Unlike an octree, it adapts to uneven distributions of objects, as splits follow the objects instead of space.
+	// Nodes are stored contiguously, siblings are adjacent and the objects of any subtree form a contiguous range.
+	template<
+		typename Type
+	>
+		class BoundingVolumeHierarchy : public ISpatialIndex<Type>
+	{
+		friend class GraphicsEngineTester::SpatialIndexTest;
+
+	public:
+		static constexpr size_t BinCount = 16;
+
+	private:
+		struct Node
+		{
+			DirectX::BoundingBox Bounds;
+			uint32_t FirstChild;
+			uint32_t ChildCount;
+
+			// Range of the objects of the whole subtree:
+			uint32_t FirstObject;
+			uint32_t ObjectCount;
+		};
+		struct BuildObject
+		{
+			DirectX::XMFLOAT3 Minimum;
+			DirectX::XMFLOAT3 Maximum;
+			DirectX::XMFLOAT3 Centroid;
+			Type* Object;
+		};
+		struct Bin
+		{
+			DirectX::XMVECTOR Minimum;
+			DirectX::XMVECTOR Maximum;
+			uint32_t Count;
+		};
+
+		using Queries = SpatialIndexQueries<Type, Node>;
+
+	public:
+		using RayHit = typename ISpatialIndex<Type>::RayHit;
+		using NearestObject = typename ISpatialIndex<Type>::NearestObject;
+
+		explicit BoundingVolumeHierarchy(size_t objectsPerLeaf) :
+			m_objectsPerLeaf(objectsPerLeaf)
+		{
+		}
+
+		void Build(const std::vector<Type*>& objects) override
+		{
+			using namespace DirectX;
+
+			m_nodes.clear();
+			m_objects.clear();
+			m_objectSlots.clear();
+
+			if (objects.empty())
+				return;
+
+			// Cache the bounds and the centroids of the objects, which are read at every level:
+			m_buildObjects.resize(objects.size());
+			for (size_t i = 0; i < objects.size(); ++i)
+			{
+				const auto& bounds = objects[i]->GetBounds();
+				auto center = XMLoadFloat3(&bounds.Center);
+				auto extents = XMLoadFloat3(&bounds.Extents);
+
+				auto& buildObject = m_buildObjects[i];
+				XMStoreFloat3(&buildObject.Minimum, XMVectorSubtract(center, extents));
+				XMStoreFloat3(&buildObject.Maximum, XMVectorAdd(center, extents));
+				buildObject.Centroid = bounds.Center;
+				buildObject.Object = objects[i];
+			}
+
+			m_nodes.emplace_back();
+			BuildNode(0, 0, static_cast<uint32_t>(m_buildObjects.size()));
+
+			m_objects.reserve(m_buildObjects.size());
+			m_objectSlots.reserve(m_buildObjects.size());
+			for (const auto& buildObject : m_buildObjects)
+			{
+				m_objectSlots.emplace(buildObject.Object, static_cast<uint32_t>(m_objects.size()));
+				m_objects.push_back(buildObject.Object);
+			}
+		}
+		void Clear() override
+		{
+			m_nodes.clear();
+			m_objects.clear();
+			m_objectSlots.clear();
+		}
+
+		// Refits the nodes above the object. The splits stay where the objects were at the last build, so the queries get slower
+		// as the objects move far from there, but they remain exact:
+		bool UpdateObject(Type* object) override
+		{
+			auto objectSlot = m_objectSlots.find(object);
+			if (objectSlot == m_objectSlots.end())
+				return false;
+
+			auto objectIndex = objectSlot->second;
+
+			Queries::FindLeafPath(m_nodes, objectIndex, m_updatePath);
+			Queries::RefitPath(m_nodes, m_objects, m_updatePath);
+			return true;
+		}
+
+		// Adds the object to a leaf, descending into the children whose surface area grows the least. Leaves which have grown
+		// to twice the objects of a built leaf aren't divided, so the hierarchy must be rebuilt:
+		bool InsertObject(Type* object) override
+		{
+			using namespace DirectX;
+
+			if (m_nodes.empty() || m_objectSlots.count(object) != 0)
+				return false;
+
+			const auto& bounds = object->GetBounds();
+			auto center = XMLoadFloat3(&bounds.Center);
+			auto extents = XMLoadFloat3(&bounds.Extents);
+			auto objectMinimum = XMVectorSubtract(center, extents);
+			auto objectMaximum = XMVectorAdd(center, extents);
+
+			m_updatePath.clear();
+			m_updatePath.push_back(0);
+			while (m_nodes[m_updatePath.back()].ChildCount != 0)
+			{
+				const auto& node = m_nodes[m_updatePath.back()];
+				auto bestChild = node.FirstChild;
+				auto bestGrowth = FLT_MAX;
+				for (auto childIndex = node.FirstChild; childIndex < node.FirstChild + node.ChildCount; ++childIndex)
+				{
+					const auto& childBounds = m_nodes[childIndex].Bounds;
+					auto childCenter = XMLoadFloat3(&childBounds.Center);
+					auto childExtents = XMLoadFloat3(&childBounds.Extents);
+					auto childMinimum = XMVectorSubtract(childCenter, childExtents);
+					auto childMaximum = XMVectorAdd(childCenter, childExtents);
+
+					auto growth = CalculateHalfSurfaceArea(XMVectorMin(childMinimum, objectMinimum), XMVectorMax(childMaximum, objectMaximum)) - CalculateHalfSurfaceArea(childMinimum, childMaximum);
+					if (growth < bestGrowth)
+					{
+						bestChild = childIndex;
+						bestGrowth = growth;
+					}
+				}
+				m_updatePath.push_back(bestChild);
+			}
+
+			if (m_nodes[m_updatePath.back()].ObjectCount >= 2 * m_objectsPerLeaf)
+				return false;
+
+			auto objectIndex = Queries::InsertObject(m_nodes, m_objects, m_updatePath, object);
+			Queries::UpdateObjectSlots(m_objects, objectIndex, m_objectSlots);
+			return true;
+		}
+
+		// Removes the object from its leaf. Leaves can't be emptied, so the hierarchy must be rebuilt to remove their last object:
+		bool RemoveObject(Type* object) override
+		{
+			auto objectSlot = m_objectSlots.find(object);
+			if (objectSlot == m_objectSlots.end())
+				return false;
+
+			auto objectIndex = objectSlot->second;
+			Queries::FindLeafPath(m_nodes, objectIndex, m_updatePath);
+			if (m_nodes[m_updatePath.back()].ObjectCount == 1)
+				return false;
+
+			Queries::RemoveObject(m_nodes, m_objects, m_updatePath, objectIndex);
+			m_objectSlots.erase(objectSlot);
+			Queries::UpdateObjectSlots(m_objects, objectIndex, m_objectSlots);
+			return true;
+		}
+
+		// Appends the objects which intersect the frustum to the output:
+		void CalculateIntersections(const Frustum& frustum, std::vector<Type*>& output) const override
+		{
+			CalculateIntersections(frustum, nullptr, output);
+		}
+		void CalculateIntersections(const Frustum& frustum, FrustumCoherence& coherence, std::vector<Type*>& output) const override
+		{
+			CalculateIntersections(frustum, &coherence, output);
+		}
+
+		// Same as above, but the subtrees below the first levels are traversed in parallel, each one writing into its own output:
+		void CalculateIntersections(const Frustum& frustum, Common::ThreadPool& threadPool, std::array<std::vector<Type*>, 8>& outputs) const override
+		{
+			CalculateIntersections(frustum, nullptr, threadPool, outputs);
+		}
+		void CalculateIntersections(const Frustum& frustum, FrustumCoherence& coherence, Common::ThreadPool& threadPool, std::array<std::vector<Type*>, 8>& outputs) const override
+		{
+			CalculateIntersections(frustum, &coherence, threadPool, outputs);
+		}
+
+		size_t CalculateIntersections(const DirectX::BoundingSphere& sphere, Type** output, size_t capacity) const override
+		{
+			return Queries::CalculateIntersections(m_nodes, m_objects, sphere, output, capacity);
+		}
+		size_t CalculateIntersections(const DirectX::BoundingBox& box, Type** output, size_t capacity) const override
+		{
+			return Queries::CalculateIntersections(m_nodes, m_objects, box, output, capacity);
+		}
+		bool CalculateFirstRayHit(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, RayHit& hit) const override
+		{
+			return Queries::CalculateFirstRayHit(m_nodes, m_objects, origin, direction, maxDistance, hit);
+		}
+		size_t CalculateRayHits(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, RayHit* output, size_t capacity) const override
+		{
+			return Queries::CalculateRayHits(m_nodes, m_objects, origin, direction, maxDistance, output, capacity);
+		}
+		size_t CalculateNearestObjects(const DirectX::XMFLOAT3& position, NearestObject* output, size_t count) const override
+		{
+			return Queries::CalculateNearestObjects(m_nodes, m_objects, position, output, count);
+		}
+
+		size_t GetNodeCount() const override
+		{
+			return m_nodes.size();
+		}
+		size_t GetObjectCount() const override
+		{
+			return m_objects.size();
+		}
+		size_t GetMemoryUsage() const override
+		{
+			return m_nodes.capacity() * sizeof(Node) + m_objects.capacity() * sizeof(Type*);
+		}
+
+	private:
+		void BuildNode(uint32_t nodeIndex, uint32_t begin, uint32_t end)
+		{
+			using namespace DirectX;
+
+			// Calculate the bounds of the objects and of their centroids:
+			auto minimum = XMVectorReplicate(FLT_MAX);
+			auto maximum = XMVectorReplicate(-FLT_MAX);
+			auto centroidMinimum = XMVectorReplicate(FLT_MAX);
+			auto centroidMaximum = XMVectorReplicate(-FLT_MAX);
+			for (auto i = begin; i < end; ++i)
+			{
+				const auto& buildObject = m_buildObjects[i];
+				minimum = XMVectorMin(minimum, XMLoadFloat3(&buildObject.Minimum));
+				maximum = XMVectorMax(maximum, XMLoadFloat3(&buildObject.Maximum));
+
+				auto centroid = XMLoadFloat3(&buildObject.Centroid);
+				centroidMinimum = XMVectorMin(centroidMinimum, centroid);
+				centroidMaximum = XMVectorMax(centroidMaximum, centroid);
+			}
+
+			{
+				auto& node = m_nodes[nodeIndex];
+				BoundingBox::CreateFromPoints(node.Bounds, minimum, maximum);
+				node.FirstChild = 0;
+				node.ChildCount = 0;
+				node.FirstObject = begin;
+				node.ObjectCount = end - begin;
+			}
+
+			if (end - begin <= m_objectsPerLeaf)
+				return;
+
+			// Split along the axis where the centroids are spread the most:
+			XMFLOAT3 centroidExtents;
+			XMStoreFloat3(&centroidExtents, XMVectorSubtract(centroidMaximum, centroidMinimum));
+			size_t axis = 0;
+			if (centroidExtents.y > centroidExtents.x)
+				axis = 1;
+			if (centroidExtents.z > (&centroidExtents.x)[axis])
+				axis = 2;
+
+			XMFLOAT3 centroidMinimumCoordinates;
+			XMStoreFloat3(&centroidMinimumCoordinates, centroidMinimum);
+			auto axisMinimum = (&centroidMinimumCoordinates.x)[axis];
+			auto axisExtent = (&centroidExtents.x)[axis];
+
+			uint32_t middle;
+			if (axisExtent <= 0.0f)
+			{
+				// All centroids are equal, so the objects can only be split by count:
+				middle = begin + (end - begin) / 2;
+			}
+			else
+			{
+				auto binScale = static_cast<float>(BinCount) / axisExtent;
+				auto getBinIndex = [axis, axisMinimum, binScale](const BuildObject& buildObject)
+				{
+					auto binIndex = static_cast<size_t>(((&buildObject.Centroid.x)[axis] - axisMinimum) * binScale);
+					return binIndex < BinCount ? binIndex : BinCount - 1;
+				};
+
+				auto splitBinIndex = FindBestSplit(begin, end, getBinIndex);
+
+				// Move the objects of the bins on the left side of the split to the front:
+				auto first = m_buildObjects.begin();
+				auto split = std::partition(first + begin, first + end, [&getBinIndex, splitBinIndex](const BuildObject& buildObject)
+				{
+					return getBinIndex(buildObject) <= splitBinIndex;
+				});
+				middle = static_cast<uint32_t>(split - first);
+
+				// The split may only leave a side empty if the centroids are nearly equal:
+				if (middle == begin || middle == end)
+					middle = begin + (end - begin) / 2;
+			}
+
+			// Create the children next to each other:
+			auto firstChild = static_cast<uint32_t>(m_nodes.size());
+			m_nodes.resize(m_nodes.size() + 2);
+			m_nodes[nodeIndex].FirstChild = firstChild;
+			m_nodes[nodeIndex].ChildCount = 2;
+
+			BuildNode(firstChild, begin, middle);
+			BuildNode(firstChild + 1, middle, end);
+		}
+		template<typename GetBinIndexFunctionType>
+		size_t FindBestSplit(uint32_t begin, uint32_t end, const GetBinIndexFunctionType& getBinIndex) const
+		{
+			using namespace DirectX;
+
+			// Accumulate the bounds and the count of the objects of each bin:
+			std::array<Bin, BinCount> bins;
+			for (auto& bin : bins)
+			{
+				bin.Minimum = XMVectorReplicate(FLT_MAX);
+				bin.Maximum = XMVectorReplicate(-FLT_MAX);
+				bin.Count = 0;
+			}
+			for (auto i = begin; i < end; ++i)
+			{
+				const auto& buildObject = m_buildObjects[i];
+				auto& bin = bins[getBinIndex(buildObject)];
+				bin.Minimum = XMVectorMin(bin.Minimum, XMLoadFloat3(&buildObject.Minimum));
+				bin.Maximum = XMVectorMax(bin.Maximum, XMLoadFloat3(&buildObject.Maximum));
+				++bin.Count;
+			}
+
+			// Sweep from the right to calculate the cost of the right side of each split:
+			std::array<float, BinCount> rightCosts;
+			auto minimum = XMVectorReplicate(FLT_MAX);
+			auto maximum = XMVectorReplicate(-FLT_MAX);
+			uint32_t count = 0;
+			for (auto binIndex = BinCount - 1; binIndex > 0; --binIndex)
+			{
+				const auto& bin = bins[binIndex];
+				minimum = XMVectorMin(minimum, bin.Minimum);
+				maximum = XMVectorMax(maximum, bin.Maximum);
+				count += bin.Count;
+				rightCosts[binIndex - 1] = count == 0 ? 0.0f : count * CalculateHalfSurfaceArea(minimum, maximum);
+			}
+
+			// Sweep from the left and keep the split with the lowest cost. Splits with an empty side are only kept if there
+			// is nothing better, in which case the caller splits by count:
+			size_t bestSplit = 0;
+			auto bestCost = FLT_MAX;
+			minimum = XMVectorReplicate(FLT_MAX);
+			maximum = XMVectorReplicate(-FLT_MAX);
+			count = 0;
+			for (size_t binIndex = 0; binIndex < BinCount - 1; ++binIndex)
+			{
+				const auto& bin = bins[binIndex];
+				minimum = XMVectorMin(minimum, bin.Minimum);
+				maximum = XMVectorMax(maximum, bin.Maximum);
+				count += bin.Count;
+
+				if (count == 0 || count == end - begin)
+					continue;
+
+				auto cost = count * CalculateHalfSurfaceArea(minimum, maximum) + rightCosts[binIndex];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestSplit = binIndex;
+				}
+			}
+
+			return bestSplit;
+		}
+		static float CalculateHalfSurfaceArea(DirectX::FXMVECTOR minimum, DirectX::FXMVECTOR maximum)
+		{
+			using namespace DirectX;
+
+			XMFLOAT3 size;
+			XMStoreFloat3(&size, XMVectorSubtract(maximum, minimum));
+			return size.x * size.y + size.y * size.z + size.z * size.x;
+		}
+
+		void CalculateIntersections(const Frustum& frustum, FrustumCoherence* coherence, std::vector<Type*>& output) const
+		{
+			if (coherence != nullptr)
+				coherence->BeginQuery(m_nodes.size());
+
+			if (m_nodes.empty())
+				return;
+
+			FrustumCoherence::Statistics statistics;
+			CalculateIntersections(frustum, 0, Frustum::AllPlanesMask, coherence, statistics, output);
+
+			if (coherence != nullptr)
+				coherence->AddStatistics(statistics);
+		}
+		void CalculateIntersections(const Frustum& frustum, FrustumCoherence* coherence, Common::ThreadPool& threadPool, std::array<std::vector<Type*>, 8>& outputs) const
+		{
+			for (auto& output : outputs)
+				output.clear();
+
+			if (coherence != nullptr)
+				coherence->BeginQuery(m_nodes.size());
+
+			if (m_nodes.empty())
+				return;
+
+			// The subtrees only test the planes which the root crosses:
+			std::array<FrustumCoherence::Statistics, 8> statistics;
+			auto planeMask = Frustum::AllPlanesMask;
+			if (TestNode(frustum, 0, planeMask, coherence, statistics[0]) == DirectX::ContainmentType::DISJOINT)
+			{
+				if (coherence != nullptr)
+					coherence->AddStatistics(statistics[0]);
+				return;
+			}
+
+			// Replace inner nodes by their children level by level, until there is a subtree for each output:
+			std::array<uint32_t, 8> subtrees;
+			size_t subtreeCount = 1;
+			subtrees[0] = 0;
+			auto expanded = true;
+			while (expanded)
+			{
+				expanded = false;
+				auto levelSubtreeCount = subtreeCount;
+				for (size_t i = 0; i < levelSubtreeCount && subtreeCount < subtrees.size(); ++i)
+				{
+					const auto& node = m_nodes[subtrees[i]];
+					if (node.ChildCount == 0)
+						continue;
+
+					subtrees[i] = node.FirstChild;
+					subtrees[subtreeCount++] = node.FirstChild + 1;
+					expanded = true;
+				}
+			}
+
+			threadPool.ParallelFor(subtreeCount, [this, &frustum, coherence, &subtrees, planeMask, &statistics, &outputs](size_t subtreeIndex)
+			{
+				CalculateIntersections(frustum, subtrees[subtreeIndex], planeMask, coherence, statistics[subtreeIndex], outputs[subtreeIndex]);
+			});
+
+			if (coherence != nullptr)
+			{
+				for (const auto& subtreeStatistics : statistics)
+					coherence->AddStatistics(subtreeStatistics);
+			}
+		}
+		void CalculateIntersections(const Frustum& frustum, uint32_t nodeIndex, uint32_t planeMask, FrustumCoherence* coherence, FrustumCoherence::Statistics& statistics, std::vector<Type*>& output) const
+		{
+			using namespace DirectX;
+
+			const auto& node = m_nodes[nodeIndex];
+
+			// Skip the node if it is outside of the frustum:
+			auto containment = TestNode(frustum, nodeIndex, planeMask, coherence, statistics);
+			if (containment == ContainmentType::DISJOINT)
+				return;
+
+			// If the node is completely inside, all of the objects of its subtree are visible:
+			auto firstObject = m_objects.begin() + node.FirstObject;
+			if (containment == ContainmentType::CONTAINS)
+			{
+				output.insert(output.end(), firstObject, firstObject + node.ObjectCount);
+				return;
+			}
+
+			if (node.ChildCount != 0)
+			{
+				CalculateIntersections(frustum, node.FirstChild, planeMask, coherence, statistics, output);
+				CalculateIntersections(frustum, node.FirstChild + 1, planeMask, coherence, statistics, output);
+			}
+			else
+			{
+				for (auto object = firstObject; object != firstObject + node.ObjectCount; ++object)
+				{
+					if ((*object)->Intersects(frustum))
+						output.push_back(*object);
+				}
+			}
+		}
+		DirectX::ContainmentType TestNode(const Frustum& frustum, uint32_t nodeIndex, uint32_t& planeMask, FrustumCoherence* coherence, FrustumCoherence::Statistics& statistics) const
+		{
+			// Without a viewer state, the planes are tested in their default order:
+			uint8_t firstPlane = 0;
+			auto& nodeFirstPlane = coherence != nullptr ? coherence->GetFirstPlane(nodeIndex) : firstPlane;
+
+			++statistics.BoxTests;
+			return frustum.Contains(m_nodes[nodeIndex].Bounds, planeMask, nodeFirstPlane, statistics.PlaneTests, statistics.IndependentPlaneTests);
+		}
+
+	private:
+		size_t m_objectsPerLeaf;
+
+		std::vector<Node> m_nodes;
+		std::vector<Type*> m_objects;
+
+		// Kept between builds to avoid reallocations:
+		std::vector<BuildObject> m_buildObjects;
+		std::vector<uint32_t> m_updatePath;
+
+		// Index of each object in m_objects, which finds the leaf of a moved object:
+		std::unordered_map<const Type*, uint32_t> m_objectSlots;
+	};
+}
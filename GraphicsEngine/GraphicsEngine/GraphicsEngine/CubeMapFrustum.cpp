@@ -0,0 +1,147 @@
+#include "stdafx.h"
+#include "CubeMapFrustum.h"
+
+#include <array>
+#include <cassert>
+
+using namespace DirectX;
+using namespace GraphicsEngine;
+
+namespace
+{
+	// Sides of the diagonal planes x - y, x + y, x - z, x + z, y - z and y + z which bound each face. For example, the +x face
+	// is where x >= |y| and x >= |z|, that is, on the positive side of the planes x - y, x + y, x - z and x + z:
+	struct FaceSides
+	{
+		uint32_t PositiveSides;
+		uint32_t NegativeSides;
+	};
+	const std::array<FaceSides, CubeMapFrustum::FaceCount> s_faceSides =
+	{
+		FaceSides{ 0x0F, 0x00 },	// +x
+		FaceSides{ 0x00, 0x0F },	// -x
+		FaceSides{ 0x32, 0x01 },	// +y
+		FaceSides{ 0x01, 0x32 },	// -y
+		FaceSides{ 0x28, 0x14 },	// +z
+		FaceSides{ 0x14, 0x28 },	// -z
+	};
+}
+
+CubeMapFrustum::CubeMapFrustum(FXMVECTOR position, float farZ) :
+	m_farZ(farZ)
+{
+	XMStoreFloat3(&m_position, position);
+}
+
+uint32_t CubeMapFrustum::CalculateFaceMask(const BoundingBox& box) const
+{
+	// Position of the box relative to the center of the cube map:
+	auto x = box.Center.x - m_position.x;
+	auto y = box.Center.y - m_position.y;
+	auto z = box.Center.z - m_position.z;
+	const auto& extents = box.Extents;
+
+	// Find the sides of the diagonal planes the box reaches:
+	std::array<float, 6> distances = { x - y, x + y, x - z, x + z, y - z, y + z };
+	std::array<float, 6> radii = { extents.x + extents.y, extents.x + extents.y, extents.x + extents.z, extents.x + extents.z, extents.y + extents.z, extents.y + extents.z };
+	uint32_t positiveSides = 0;
+	uint32_t negativeSides = 0;
+	for (size_t i = 0; i < distances.size(); ++i)
+	{
+		if (distances[i] + radii[i] >= 0.0f)
+			positiveSides |= 1u << i;
+		if (distances[i] - radii[i] <= 0.0f)
+			negativeSides |= 1u << i;
+	}
+
+	// Distances of the nearest point of the box along the view direction of each face:
+	std::array<float, FaceCount> nearestDistances = { x - extents.x, -x - extents.x, y - extents.y, -y - extents.y, z - extents.z, -z - extents.z };
+
+	uint32_t faceMask = 0;
+	for (size_t face = 0; face < FaceCount; ++face)
+	{
+		const auto& sides = s_faceSides[face];
+		if ((positiveSides & sides.PositiveSides) == sides.PositiveSides && (negativeSides & sides.NegativeSides) == sides.NegativeSides && nearestDistances[face] <= m_farZ)
+			faceMask |= 1u << face;
+	}
+
+	return faceMask;
+}
+
+void CubeMapFrustum::CalculateFaceMasks(const BoundingBoxArray& boxes, size_t begin, size_t end, uint8_t* faceMasks) const
+{
+	assert(begin % BoundingBoxArray::GroupSize == 0);
+
+	auto positionX = XMVectorReplicate(m_position.x);
+	auto positionY = XMVectorReplicate(m_position.y);
+	auto positionZ = XMVectorReplicate(m_position.z);
+	auto farZ = XMVectorReplicate(m_farZ);
+
+	const auto* centersX = boxes.GetComponent(BoundingBoxArray::Component::CenterX);
+	const auto* centersY = boxes.GetComponent(BoundingBoxArray::Component::CenterY);
+	const auto* centersZ = boxes.GetComponent(BoundingBoxArray::Component::CenterZ);
+	const auto* extentsX = boxes.GetComponent(BoundingBoxArray::Component::ExtentsX);
+	const auto* extentsY = boxes.GetComponent(BoundingBoxArray::Component::ExtentsY);
+	const auto* extentsZ = boxes.GetComponent(BoundingBoxArray::Component::ExtentsZ);
+
+	for (size_t group = begin; group < end; group += BoundingBoxArray::GroupSize)
+	{
+		// Load the next group of boxes, relative to the center of the cube map:
+		auto x = XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(centersX + group)), positionX);
+		auto y = XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(centersY + group)), positionY);
+		auto z = XMVectorSubtract(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(centersZ + group)), positionZ);
+		auto extentX = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(extentsX + group));
+		auto extentY = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(extentsY + group));
+		auto extentZ = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(extentsZ + group));
+
+		// Find the sides of the diagonal planes the boxes reach:
+		std::array<XMVECTOR, 6> distances =
+		{
+			XMVectorSubtract(x, y), XMVectorAdd(x, y),
+			XMVectorSubtract(x, z), XMVectorAdd(x, z),
+			XMVectorSubtract(y, z), XMVectorAdd(y, z),
+		};
+		auto radiusXY = XMVectorAdd(extentX, extentY);
+		auto radiusXZ = XMVectorAdd(extentX, extentZ);
+		auto radiusYZ = XMVectorAdd(extentY, extentZ);
+		std::array<XMVECTOR, 6> radii = { radiusXY, radiusXY, radiusXZ, radiusXZ, radiusYZ, radiusYZ };
+
+		std::array<XMVECTOR, 6> positiveSides;
+		std::array<XMVECTOR, 6> negativeSides;
+		for (size_t i = 0; i < distances.size(); ++i)
+		{
+			positiveSides[i] = XMVectorGreaterOrEqual(XMVectorAdd(distances[i], radii[i]), XMVectorZero());
+			negativeSides[i] = XMVectorLessOrEqual(XMVectorSubtract(distances[i], radii[i]), XMVectorZero());
+		}
+
+		std::array<XMVECTOR, FaceCount> nearestDistances =
+		{
+			XMVectorSubtract(x, extentX), XMVectorNegate(XMVectorAdd(x, extentX)),
+			XMVectorSubtract(y, extentY), XMVectorNegate(XMVectorAdd(y, extentY)),
+			XMVectorSubtract(z, extentZ), XMVectorNegate(XMVectorAdd(z, extentZ)),
+		};
+
+		// Set the bit of each face whose sides and far plane the boxes reach:
+		auto faceMask = XMVectorZero();
+		for (size_t face = 0; face < FaceCount; ++face)
+		{
+			auto visible = XMVectorLessOrEqual(nearestDistances[face], farZ);
+			const auto& sides = s_faceSides[face];
+			for (size_t i = 0; i < distances.size(); ++i)
+			{
+				if (sides.PositiveSides & (1u << i))
+					visible = XMVectorAndInt(visible, positiveSides[i]);
+				if (sides.NegativeSides & (1u << i))
+					visible = XMVectorAndInt(visible, negativeSides[i]);
+			}
+
+			faceMask = XMVectorOrInt(faceMask, XMVectorAndInt(visible, XMVectorReplicateInt(1u << face)));
+		}
+
+		std::array<uint32_t, BoundingBoxArray::GroupSize> lanes;
+		XMStoreInt4(lanes.data(), faceMask);
+		auto laneCount = end - group < BoundingBoxArray::GroupSize ? end - group : BoundingBoxArray::GroupSize;
+		for (size_t lane = 0; lane < laneCount; ++lane)
+			faceMasks[group - begin + lane] = static_cast<uint8_t>(lanes[lane]);
+	}
+}
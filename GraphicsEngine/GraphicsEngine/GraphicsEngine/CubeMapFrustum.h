@@ -0,0 +1,34 @@
+#pragma once
+
+#include "BoundingBoxArray.h"
+
+#include <DirectXCollision.h>
+#include <cstdint>
+
+namespace GraphicsEngine
+{
+	// The six 90 degrees frusta of a cube map around a position, in the face order of CubeMappingCamera (+x, -x, +y, -y, +z, -z).
+	// The side planes of the faces are the six diagonal planes through the position, so the faces a box is visible from are
+	// found with six plane tests, instead of the 36 needed to test each face frustum on its own.
+	class CubeMapFrustum
+	{
+	public:
+		static constexpr size_t FaceCount = 6;
+		static constexpr uint32_t AllFacesMask = (1u << FaceCount) - 1;
+
+	public:
+		CubeMapFrustum() = default;
+		explicit CubeMapFrustum(DirectX::FXMVECTOR position, float farZ);
+
+		// Returns a mask whose bit i is set if the box may be visible from the face i:
+		uint32_t CalculateFaceMask(const DirectX::BoundingBox& box) const;
+
+		// Writes the face masks of the boxes in the range [begin, end) into faceMasks, starting at faceMasks[0].
+		// The begin index must be a multiple of BoundingBoxArray::GroupSize.
+		void CalculateFaceMasks(const BoundingBoxArray& boxes, size_t begin, size_t end, uint8_t* faceMasks) const;
+
+	private:
+		DirectX::XMFLOAT3 m_position;
+		float m_farZ = 0.0f;
+	};
+}
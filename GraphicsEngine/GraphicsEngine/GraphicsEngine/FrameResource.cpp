@@ -3,6 +3,8 @@
 #include "ShaderBufferTypes.h"
 #include "NormalRenderItem.h"
 
+#include <algorithm>
+
 using namespace Common;
 using namespace GraphicsEngine;
 
@@ -15,7 +17,10 @@ FrameResource::FrameResource(ID3D11Device* device, const std::vector<NormalRende
 	{
 		const auto& instancesData = renderItem->GetInstancesData();
 		if(!instancesData.empty())
+		{
 			InstancesBuffers[renderItem->GetName()].Initialize(device, static_cast<UINT>(stride * instancesData.size()), stride);
+			ShadowInstancesBuffers[renderItem->GetName()].Initialize(device, static_cast<UINT>(stride * instancesData.size()), stride);
+		}
 	}
 		
 	// Initialize material data array:
@@ -37,16 +42,57 @@ FrameResource::FrameResource(ID3D11Device* device, const std::vector<NormalRende
 
 void FrameResource::RealocateInstanceBuffer(ID3D11Device* device, NormalRenderItem* renderItem)
 {
-	auto& instanceBuffer = InstancesBuffers[renderItem->GetName()];
 	auto bufferStride = static_cast<uint32_t>(sizeof(ShaderBufferTypes::InstanceData));
 
 	auto instanceCount = renderItem->GetInstancesData().size();
 
 	auto neededBufferSize = instanceCount * bufferStride;
-	if(instanceBuffer.GetSize() >= neededBufferSize)
-		return;
 
-	// Allocate space for twice as needed:
-	auto targetBufferSize = static_cast<int32_t>(2 * neededBufferSize);
-	instanceBuffer.Initialize(device, targetBufferSize, bufferStride);
+	// The camera and the shadow casters instances buffers hold up to all instances of the render item:
+	for (auto instanceBuffer : { &InstancesBuffers[renderItem->GetName()], &ShadowInstancesBuffers[renderItem->GetName()] })
+	{
+		if (instanceBuffer->GetSize() >= neededBufferSize)
+			continue;
+
+		// Allocate space for twice as needed:
+		auto targetBufferSize = static_cast<int32_t>(2 * neededBufferSize);
+		instanceBuffer->Initialize(device, targetBufferSize, bufferStride);
+	}
+}
+InstanceBuffer& FrameResource::ReserveCubeMapInstanceBuffer(ID3D11Device* device, size_t face, const std::string& renderItemName, size_t instanceCount)
+{
+	auto& instanceBuffer = CubeMapInstancesBuffers[face][renderItemName];
+	auto bufferStride = static_cast<uint32_t>(sizeof(ShaderBufferTypes::InstanceData));
+
+	// Cube map faces only see part of the instances, so their buffers grow with the number of visible instances:
+	auto neededBufferSize = std::max<size_t>(instanceCount, 1) * bufferStride;
+	if (instanceBuffer.GetSize() < neededBufferSize)
+	{
+		// Allocate space for twice as needed:
+		auto targetBufferSize = static_cast<int32_t>(2 * neededBufferSize);
+		instanceBuffer.Initialize(device, targetBufferSize, bufferStride);
+	}
+
+	return instanceBuffer;
+}
+void FrameResource::ReserveTerrainPatchBuffers(ID3D11Device* device, size_t patchCount)
+{
+	// Each patch is drawn from its four corner vertices:
+	auto indexStride = static_cast<uint32_t>(sizeof(uint32_t));
+	auto neededBufferSize = std::max<size_t>(patchCount, 1) * 4 * indexStride;
+	if (TerrainPatchIndices.GetSize() < neededBufferSize)
+	{
+		// Allocate space for twice as needed:
+		auto targetBufferSize = static_cast<uint32_t>(2 * neededBufferSize);
+		TerrainPatchIndices.Initialize(device, targetBufferSize, indexStride);
+	}
+
+	constexpr auto maxPatchCount = static_cast<size_t>(ShaderBufferTypes::TerrainPatchData::MaxPatchCount);
+	auto batchCount = (patchCount + maxPatchCount - 1) / maxPatchCount;
+	constexpr auto patchDataSize = static_cast<uint32_t>(sizeof(ShaderBufferTypes::TerrainPatchData));
+	while (TerrainPatchData.size() < batchCount)
+	{
+		TerrainPatchData.emplace_back();
+		TerrainPatchData.back().Initialize(device, patchDataSize, patchDataSize);
+	}
 }
@@ -6,6 +6,7 @@
 #include <memory>
 #include <unordered_map>
 #include "NormalRenderItem.h"
+#include "CubeMapFrustum.h"
 
 namespace GraphicsEngine
 {
@@ -16,12 +17,19 @@ namespace GraphicsEngine
 		FrameResource(ID3D11Device* device, const std::vector<NormalRenderItem*>& renderItems, SIZE_T materialCount);
 
 		void RealocateInstanceBuffer(ID3D11Device* device, NormalRenderItem* renderItem);
+		InstanceBuffer& ReserveCubeMapInstanceBuffer(ID3D11Device* device, size_t face, const std::string& renderItemName, size_t instanceCount);
+		void ReserveTerrainPatchBuffers(ID3D11Device* device, size_t patchCount);
 
 	public:
 		std::unordered_map<std::string, InstanceBuffer> InstancesBuffers;
+		std::unordered_map<std::string, InstanceBuffer> ShadowInstancesBuffers;
+		std::array<std::unordered_map<std::string, InstanceBuffer>, CubeMapFrustum::FaceCount> CubeMapInstancesBuffers;
 		std::vector<DynamicConstantBuffer> MaterialDataArray;
 		DynamicConstantBuffer MainPassData;
 		DynamicConstantBuffer ShadowPassData;
 		std::array<DynamicConstantBuffer, 6> CubeMapPassData;
+		// Corner indices and edge tessellation factors of the terrain patches selected for the frame, one constant buffer per batch:
+		DynamicIndexBuffer TerrainPatchIndices;
+		std::vector<DynamicConstantBuffer> TerrainPatchData;
 	};
 }
@@ -0,0 +1,188 @@
+#include "stdafx.h"
+#include "Frustum.h"
+
+#include <cassert>
+
+using namespace DirectX;
+using namespace GraphicsEngine;
+
+Frustum::Frustum(CXMMATRIX viewProjectionMatrix)
+{
+	// Extract the planes from the columns of the view projection matrix:
+	auto columns = XMMatrixTranspose(viewProjectionMatrix);
+	std::array<XMVECTOR, PlaneCount> planes =
+	{
+		XMVectorAdd(columns.r[3], columns.r[0]),		// Left
+		XMVectorSubtract(columns.r[3], columns.r[0]),	// Right
+		XMVectorAdd(columns.r[3], columns.r[1]),		// Bottom
+		XMVectorSubtract(columns.r[3], columns.r[1]),	// Top
+		columns.r[2],									// Near
+		XMVectorSubtract(columns.r[3], columns.r[2]),	// Far
+	};
+
+	// Normalize the planes, so that the plane equation returns distances:
+	for (size_t i = 0; i < PlaneCount; ++i)
+		XMStoreFloat4(&m_planes[i], XMPlaneNormalize(planes[i]));
+}
+
+ContainmentType Frustum::Contains(const BoundingBox& box) const
+{
+	auto center = XMVectorSetW(XMLoadFloat3(&box.Center), 1.0f);
+	auto extents = XMLoadFloat3(&box.Extents);
+
+	auto containment = ContainmentType::CONTAINS;
+	for (const auto& plane : m_planes)
+	{
+		auto planeVector = XMLoadFloat4(&plane);
+
+		// Calculate the signed distance of the center and the projected radius of the box:
+		auto distance = XMVectorGetX(XMVector4Dot(planeVector, center));
+		auto radius = XMVectorGetX(XMVector3Dot(XMVectorAbs(planeVector), extents));
+
+		// If the box is completely behind the plane:
+		if (distance + radius < 0.0f)
+			return ContainmentType::DISJOINT;
+
+		// If the box crosses the plane:
+		if (distance - radius < 0.0f)
+			containment = ContainmentType::INTERSECTS;
+	}
+
+	return containment;
+}
+ContainmentType Frustum::Contains(const BoundingBox& box, uint32_t& planeMask, uint8_t& firstPlane, size_t& planeTestCount, size_t& independentPlaneTestCount) const
+{
+	auto center = XMVectorSetW(XMLoadFloat3(&box.Center), 1.0f);
+	auto extents = XMLoadFloat3(&box.Extents);
+	auto isBehindPlane = [this, center, extents](size_t planeIndex)
+	{
+		auto planeVector = XMLoadFloat4(&m_planes[planeIndex]);
+		auto distance = XMVectorGetX(XMVector4Dot(planeVector, center));
+		auto radius = XMVectorGetX(XMVector3Dot(XMVectorAbs(planeVector), extents));
+		return distance + radius < 0.0f;
+	};
+
+	auto initialPlaneMask = planeMask;
+	auto initialFirstPlane = firstPlane;
+	auto initialPlaneTestCount = planeTestCount;
+	for (size_t i = 0; i < PlaneCount; ++i)
+	{
+		// Skip the planes which a parent box is completely inside of:
+		auto planeIndex = (firstPlane + i) % PlaneCount;
+		auto planeBit = 1u << planeIndex;
+		if ((planeMask & planeBit) == 0)
+			continue;
+
+		auto planeVector = XMLoadFloat4(&m_planes[planeIndex]);
+		auto distance = XMVectorGetX(XMVector4Dot(planeVector, center));
+		auto radius = XMVectorGetX(XMVector3Dot(XMVectorAbs(planeVector), extents));
+		++planeTestCount;
+
+		// If the box is completely behind the plane, remember the plane so that it is tested first next time:
+		if (distance + radius < 0.0f)
+		{
+			// Testing from the first plane would have stopped at the first rejecting plane in index order instead.
+			// The planes before it which were already tested here don't reject the box, so only the untested ones are evaluated:
+			for (size_t independentPlaneIndex = 0; independentPlaneIndex <= planeIndex; ++independentPlaneIndex)
+			{
+				if ((initialPlaneMask & (1u << independentPlaneIndex)) == 0)
+					continue;
+
+				++independentPlaneTestCount;
+				auto tested = (independentPlaneIndex + PlaneCount - initialFirstPlane) % PlaneCount < i;
+				if (independentPlaneIndex < planeIndex && !tested && isBehindPlane(independentPlaneIndex))
+					break;
+			}
+
+			firstPlane = static_cast<uint8_t>(planeIndex);
+			return ContainmentType::DISJOINT;
+		}
+
+		// If the box is completely in front of the plane, boxes inside of it don't need to test it:
+		if (distance - radius >= 0.0f)
+			planeMask &= ~planeBit;
+	}
+
+	// Boxes which aren't rejected test the same planes in any order:
+	independentPlaneTestCount += planeTestCount - initialPlaneTestCount;
+	return planeMask == 0 ? ContainmentType::CONTAINS : ContainmentType::INTERSECTS;
+}
+
+size_t Frustum::CalculateVisibleBoxes(const BoundingBoxArray& boxes, size_t begin, size_t end, uint32_t* visibleIndices) const
+{
+	assert(begin % BoundingBoxArray::GroupSize == 0);
+
+	// Replicate every plane component across the lanes of a vector:
+	struct ReplicatedPlane
+	{
+		XMVECTOR NormalX, NormalY, NormalZ, Distance;
+		XMVECTOR AbsNormalX, AbsNormalY, AbsNormalZ;
+	};
+	std::array<ReplicatedPlane, PlaneCount> planes;
+	for (size_t i = 0; i < PlaneCount; ++i)
+	{
+		const auto& plane = m_planes[i];
+		planes[i].NormalX = XMVectorReplicate(plane.x);
+		planes[i].NormalY = XMVectorReplicate(plane.y);
+		planes[i].NormalZ = XMVectorReplicate(plane.z);
+		planes[i].Distance = XMVectorReplicate(plane.w);
+		planes[i].AbsNormalX = XMVectorAbs(planes[i].NormalX);
+		planes[i].AbsNormalY = XMVectorAbs(planes[i].NormalY);
+		planes[i].AbsNormalZ = XMVectorAbs(planes[i].NormalZ);
+	}
+
+	const auto* centersX = boxes.GetComponent(BoundingBoxArray::Component::CenterX);
+	const auto* centersY = boxes.GetComponent(BoundingBoxArray::Component::CenterY);
+	const auto* centersZ = boxes.GetComponent(BoundingBoxArray::Component::CenterZ);
+	const auto* extentsX = boxes.GetComponent(BoundingBoxArray::Component::ExtentsX);
+	const auto* extentsY = boxes.GetComponent(BoundingBoxArray::Component::ExtentsY);
+	const auto* extentsZ = boxes.GetComponent(BoundingBoxArray::Component::ExtentsZ);
+
+	size_t visibleCount = 0;
+	for (size_t group = begin; group < end; group += BoundingBoxArray::GroupSize)
+	{
+		// Load the next group of boxes:
+		auto centerX = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(centersX + group));
+		auto centerY = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(centersY + group));
+		auto centerZ = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(centersZ + group));
+		auto extentX = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(extentsX + group));
+		auto extentY = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(extentsY + group));
+		auto extentZ = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(extentsZ + group));
+
+		// A box is outside if it is completely behind any of the planes:
+		auto outside = XMVectorFalseInt();
+		for (const auto& plane : planes)
+		{
+			auto distance = XMVectorMultiplyAdd(plane.NormalX, centerX, plane.Distance);
+			distance = XMVectorMultiplyAdd(plane.NormalY, centerY, distance);
+			distance = XMVectorMultiplyAdd(plane.NormalZ, centerZ, distance);
+
+			auto radius = XMVectorMultiply(plane.AbsNormalX, extentX);
+			radius = XMVectorMultiplyAdd(plane.AbsNormalY, extentY, radius);
+			radius = XMVectorMultiplyAdd(plane.AbsNormalZ, extentZ, radius);
+
+			outside = XMVectorOrInt(outside, XMVectorLess(XMVectorAdd(distance, radius), XMVectorZero()));
+		}
+
+		// Skip the group if all boxes are outside:
+		if (XMVector4EqualInt(outside, XMVectorTrueInt()))
+			continue;
+
+		// Append the visible boxes without branching on each lane:
+		std::array<uint32_t, BoundingBoxArray::GroupSize> lanes;
+		XMStoreInt4(lanes.data(), outside);
+		auto laneCount = end - group < BoundingBoxArray::GroupSize ? end - group : BoundingBoxArray::GroupSize;
+		for (size_t lane = 0; lane < laneCount; ++lane)
+		{
+			visibleIndices[visibleCount] = static_cast<uint32_t>(group + lane);
+			visibleCount += lanes[lane] == 0 ? 1 : 0;
+		}
+	}
+
+	return visibleCount;
+}
+
+const XMFLOAT4& Frustum::GetPlane(size_t index) const
+{
+	return m_planes[index];
+}
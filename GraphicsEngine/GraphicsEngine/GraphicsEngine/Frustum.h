@@ -0,0 +1,39 @@
+#pragma once
+
+#include "BoundingBoxArray.h"
+
+#include <DirectXCollision.h>
+#include <array>
+#include <cstdint>
+
+namespace GraphicsEngine
+{
+	// Set of 6 planes, in the space where the view projection matrix was built from, whose normals point inward.
+	class Frustum
+	{
+	public:
+		static constexpr size_t PlaneCount = 6;
+		static constexpr uint32_t AllPlanesMask = (1u << PlaneCount) - 1;
+
+	public:
+		Frustum() = default;
+		explicit Frustum(DirectX::CXMMATRIX viewProjectionMatrix);
+
+		DirectX::ContainmentType Contains(const DirectX::BoundingBox& box) const;
+
+		// Same as above, but only tests the planes whose bits are set in planeMask, starting with firstPlane.
+		// On return, planeMask only keeps the planes which the box crosses, as boxes inside of it don't need to test the others,
+		// and firstPlane is the plane which rejected the box, if any. The number of tested planes is added to planeTestCount,
+		// and the number of planes which testing from the first plane would have tested is added to independentPlaneTestCount.
+		DirectX::ContainmentType Contains(const DirectX::BoundingBox& box, uint32_t& planeMask, uint8_t& firstPlane, size_t& planeTestCount, size_t& independentPlaneTestCount) const;
+
+		// Tests the boxes in the range [begin, end) and writes the indices of the non-disjoint ones into visibleIndices.
+		// The begin index must be a multiple of BoundingBoxArray::GroupSize. Returns the number of visible boxes.
+		size_t CalculateVisibleBoxes(const BoundingBoxArray& boxes, size_t begin, size_t end, uint32_t* visibleIndices) const;
+
+		const DirectX::XMFLOAT4& GetPlane(size_t index) const;
+
+	private:
+		std::array<DirectX::XMFLOAT4, PlaneCount> m_planes;
+	};
+}
@@ -0,0 +1,32 @@
+#include "stdafx.h"
+#include "FrustumCoherence.h"
+
+using namespace GraphicsEngine;
+
+size_t FrustumCoherence::Statistics::GetPlaneTestsSaved() const
+{
+	return IndependentPlaneTests - PlaneTests;
+}
+
+void FrustumCoherence::BeginQuery(size_t nodeCount)
+{
+	if (m_firstPlanes.size() != nodeCount)
+		m_firstPlanes.assign(nodeCount, 0);
+
+	m_statistics = Statistics();
+}
+void FrustumCoherence::AddStatistics(const Statistics& statistics)
+{
+	m_statistics.BoxTests += statistics.BoxTests;
+	m_statistics.PlaneTests += statistics.PlaneTests;
+	m_statistics.IndependentPlaneTests += statistics.IndependentPlaneTests;
+}
+
+uint8_t& FrustumCoherence::GetFirstPlane(size_t nodeIndex)
+{
+	return m_firstPlanes[nodeIndex];
+}
+const FrustumCoherence::Statistics& FrustumCoherence::GetStatistics() const
+{
+	return m_statistics;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace GraphicsEngine
+{
+	// Culling results of the previous frame, stored per node of a spatial index by the viewer which queries it.
+	// Camera movements between frames are small, so the plane which rejected a node is likely to reject it again
+	// and is tested first. Planes which a parent node is completely inside of are never tested by its children.
+	class FrustumCoherence
+	{
+	public:
+		struct Statistics
+		{
+			size_t BoxTests = 0;
+			size_t PlaneTests = 0;
+
+			// Plane tests which testing every box from the first plane, without the previous frame, would have made:
+			size_t IndependentPlaneTests = 0;
+
+			// Planes which weren't tested, compared to testing every box from the first plane:
+			size_t GetPlaneTestsSaved() const;
+		};
+
+	public:
+		FrustumCoherence() = default;
+
+		// Prepares a query of a spatial index with the given number of nodes and resets the statistics.
+		// The state of the nodes is kept while the node count doesn't change, as it only affects the order of the tests.
+		void BeginQuery(size_t nodeCount);
+		void AddStatistics(const Statistics& statistics);
+
+		uint8_t& GetFirstPlane(size_t nodeIndex);
+		const Statistics& GetStatistics() const;
+
+	private:
+		std::vector<uint8_t> m_firstPlanes;
+		Statistics m_statistics;
+	};
+}
@@ -4,18 +4,33 @@
 #include "SamplerStateDescConstants.h"
 #include "Terrain.h"
 #include "Common/PerformanceTimer.h"
+#include <algorithm>
 #include <numeric>
 
 using namespace DirectX;
 using namespace GraphicsEngine;
 
-Graphics::Graphics(HWND outputWindow, uint32_t clientWidth, uint32_t clientHeight, bool fullscreen) :
+namespace
+{
+	template<typename RenderItemType>
+	typename std::vector<RenderItemType>::const_iterator FindRenderItem(const std::vector<RenderItemType>& renderItems, const std::unordered_map<std::string, size_t>& renderItemIndices, const std::string& name)
+	{
+		auto location = renderItemIndices.find(name);
+		if (location == renderItemIndices.end())
+			return renderItems.end();
+
+		return renderItems.begin() + location->second;
+	}
+}
+
+Graphics::Graphics(HWND outputWindow, uint32_t clientWidth, uint32_t clientHeight, bool fullscreen, SpatialIndexType spatialIndexType) :
 	m_initialized(false),
 	m_d3dBase(outputWindow, clientWidth, clientHeight, fullscreen),
 	m_pipelineStateManager(m_d3dBase),
 	m_camera(m_d3dBase.GetAspectRatio(), 0.25f * XM_PI, 0.2f, 1500.0f, XMMatrixIdentity()),
 	m_lightManager(),
-	m_octree(32, BoundingBox(XMFLOAT3(0.0f, 256.0f, 0.0f), XMFLOAT3(1024.0f, 512.0f, 1024.0f)), XMFLOAT3(64.0f, 64.0f, 64.0f)),
+	m_spatialIndex(CreateSpatialIndex(spatialIndexType)),
+	m_spatialIndexDirty(true),
 	m_scene(this, m_d3dBase, m_textureManager, m_lightManager),
 	m_frameResources(1, FrameResource(m_d3dBase.GetDevice(), m_normalRenderItems, m_scene.GetMaterials().size())),
 	m_currentFrameResource(&m_frameResources[0]),
@@ -28,6 +43,12 @@ Graphics::Graphics(HWND outputWindow, uint32_t clientWidth, uint32_t clientHeigh
 	m_renderTexture(m_d3dBase.GetDevice(), clientWidth, clientHeight, DXGI_FORMAT_R8G8B8A8_UNORM),
 	m_sceneBounds(XMFLOAT3(0.0f, 256.0f, 0.0f), 725.0f),
 	m_visibleInstances(0),
+	m_parallelCulling(true),
+	m_spatialIndexCulling(true),
+	m_occlusionCuller(256, 144),
+	m_occlusionCulling(true),
+	m_levelOfDetail(true),
+	m_shadowCasterInstances(0),
 	m_debugWindowMode(DebugMode::Hidden),
 	m_enableShadows(true),
 	m_drawTerrainOnly(false),
@@ -39,8 +60,18 @@ Graphics::Graphics(HWND outputWindow, uint32_t clientWidth, uint32_t clientHeigh
 	m_camera.Update();
 	m_camera.RotateWorldY(XM_PI);
 
+	// The terrain hides large parts of the scene, so a coarse version of it is used as occluder:
+	const auto& terrain = m_scene.GetTerrain();
+	const auto& terrainDescription = terrain.GetDescription();
+	m_occlusionCuller.AddHeightMapOccluder(terrain.GetHeightMap(), terrain.GetHeightMapWidth(), terrain.GetHeightMapHeight(), terrainDescription.TerrainWidth, terrainDescription.TerrainDepth, 64);
+
 	SetupDebugMode();
 	InitializeMainPassData();
+
+	// The inside tessellation factor of the terrain patches matches the one used by the hull shader:
+	auto terrainTesselationFactor = 1u << static_cast<uint32_t>(m_mainPassData.MaxTesselationFactor);
+	m_terrainQuadtree = TerrainQuadtree(terrainDescription.TerrainWidth, terrainDescription.TerrainDepth, terrainDescription.CellXCount, terrainDescription.CellZCount, terrainDescription.HeightMapFactor, terrainTesselationFactor);
+	m_terrainQuadtree.SetHeightBounds(&terrain.GetHeightBounds());
 	BindSamplers();
 	//SetupTerrainMeshData();
 
@@ -64,12 +95,20 @@ void Graphics::FixedUpdate(const Common::Timer& timer)
 	auto deltaYaw = deltaSeconds * XM_PI / 48.0f;
 	castShadowsLight->RotateRollPitchYaw(0.0f, deltaYaw, 0.0f);
 
+	Common::AllocationTracker::TagScope allocationTag(Common::AllocationTag::Scene);
 	m_scene.Update(*this, timer);
 }
 void Graphics::RenderUpdate(const Common::Timer& timer)
 {
+	m_frameArena.BeginFrame();
+	Common::AllocationTracker::BeginFrame();
+
 	UpdateCamera();
 	UpdateLights(timer);
+
+	// Cull the terrain patches after the light matrices are updated, so that the shadow view uses the ones of this frame:
+	UpdateTerrain();
+
 	UpdateMainPassData(timer);
 	UpdateShadowPassData(timer);
 	UpdateMaterialData();
@@ -77,19 +116,27 @@ void Graphics::RenderUpdate(const Common::Timer& timer)
 
 	//Common::PerformanceTimer performanceTimer;
 	//performanceTimer.Start();
-	UpdateInstancesDataFrustumCulling();
-	//	UpdateInstancesDataOctreeCulling();
+	if (m_spatialIndexCulling)
+		UpdateInstancesDataOctreeCulling();
+	else
+		UpdateInstancesDataFrustumCulling();
+	UpdateInstancesDataShadowCasterCulling();
 	//performanceTimer.End();
 	//auto elapsedTime = performanceTimer.ElapsedTime<float, std::milli>().count();
 	//auto string = L"ElapsedTime: " + std::to_wstring(elapsedTime) + L"\n";
 	//OutputDebugStringW(string.c_str());
 
 	if(m_cubeMapSkipFramesCurrentCount >= m_cubeMapSkipFramesCount)
+	{
 		UpdateCubeMappingPassData(timer);
+		UpdateInstancesDataCubeMapCulling();
+	}
 }
 
 void Graphics::Render(const Common::Timer& timer)
 {
+	Common::AllocationTracker::TagScope allocationTag(Common::AllocationTag::Rendering);
+
 	auto deviceContext = m_d3dBase.GetDeviceContext();
 
 	m_d3dBase.BeginScene();
@@ -118,27 +165,84 @@ void Graphics::AddNormalRenderItem(std::unique_ptr<NormalRenderItem>&& renderIte
 		m_renderItemLayers[static_cast<SIZE_T>(renderLayer)].push_back(renderItem.get());
 	}
 
+	m_normalRenderItemIndices.emplace(renderItem->GetName(), m_normalRenderItems.size());
 	m_normalRenderItems.push_back(renderItem.get());
+	m_spatialIndexDirty = true;
 
-	for (auto& collider : renderItem->GetColliders())
-		m_octree.AddObject(&collider);
-
+	m_renderItemIndices.emplace(renderItem->GetName(), m_allRenderItems.size());
 	m_allRenderItems.push_back(std::move(renderItem));
 }
 
-void Graphics::AddNormalRenderItemInstance(NormalRenderItem* renderItem, const ShaderBufferTypes::InstanceData& instanceData) const
+NormalRenderItem::InstanceHandle Graphics::AddNormalRenderItemInstance(NormalRenderItem* renderItem, const ShaderBufferTypes::InstanceData& instanceData)
 {
-	renderItem->AddInstance(instanceData);
+	// Insert the collider of the new instance into the spatial index, unless it has to be rebuilt anyway:
+	auto instance = renderItem->AddInstance(instanceData);
+	if (!m_spatialIndexDirty)
+		m_spatialIndexDirty = !m_spatialIndex->InsertObject(&renderItem->GetColliders().back());
 
 	if (m_initialized)
 		m_currentFrameResource->RealocateInstanceBuffer(m_d3dBase.GetDevice(), renderItem);
+
+	return instance;
+}
+void Graphics::SetNormalRenderItemInstance(NormalRenderItem* renderItem, NormalRenderItem::InstanceHandle instance, const ShaderBufferTypes::InstanceData& instanceData)
+{
+	renderItem->SetInstance(instance, instanceData);
+
+	// Refit the spatial index around the moved collider, unless it has to be rebuilt anyway:
+	if (!m_spatialIndexDirty)
+	{
+		auto& collider = renderItem->GetColliders()[renderItem->GetInstanceIndex(instance)];
+		m_spatialIndexDirty = !m_spatialIndex->UpdateObject(&collider);
+	}
+}
+void Graphics::SetNormalRenderItemMesh(NormalRenderItem* renderItem, ImmutableMeshGeometry* mesh, const std::string& submeshName)
+{
+	// The bounds of all the instances change with the mesh, so their colliders must be filed again:
+	renderItem->SetMesh(mesh, submeshName);
+	m_spatialIndexDirty = true;
+}
+void Graphics::RemoveNormalRenderItemInstance(NormalRenderItem* renderItem, NormalRenderItem::InstanceHandle instance)
+{
+	if (!renderItem->ContainsInstance(instance))
+		return;
+
+	// The last instance of the render item takes the place of the removed one, and so does its collider. So the collider of the
+	// last instance leaves the spatial index, and the collider which receives its bounds is refitted:
+	auto instanceIndex = renderItem->GetInstanceIndex(instance);
+	auto& colliders = renderItem->GetColliders();
+	if (!m_spatialIndexDirty)
+		m_spatialIndexDirty = !m_spatialIndex->RemoveObject(&colliders.back());
+
+	renderItem->RemoveInstance(instance);
+	if (!m_spatialIndexDirty && instanceIndex != colliders.size())
+		m_spatialIndexDirty = !m_spatialIndex->UpdateObject(&colliders[instanceIndex]);
+}
+void Graphics::RemoveLastRenderItemInstance(const std::string& renderItemName)
+{
+	// The colliders of the normal render items are in the spatial index:
+	auto normalRenderItem = GetNormalRenderItem(renderItemName);
+	if (normalRenderItem != m_normalRenderItems.end())
+	{
+		auto instanceCount = (*normalRenderItem)->GetInstanceCount();
+		if (instanceCount != 0)
+			RemoveNormalRenderItemInstance(*normalRenderItem, (*normalRenderItem)->GetInstanceHandle(instanceCount - 1));
+
+		return;
+	}
+
+	auto renderItem = GetRenderItem(renderItemName);
+	if (renderItem != m_allRenderItems.end())
+		(*renderItem)->RemoveLastInstance();
 }
 void Graphics::AddBillboardRenderItem(std::unique_ptr<BillboardRenderItem>&& renderItem, std::initializer_list<RenderLayer> renderLayers)
 {
 	for (auto renderLayer : renderLayers)
 		m_renderItemLayers[static_cast<SIZE_T>(renderLayer)].push_back(renderItem.get());
 
+	m_billboardRenderItemIndices.emplace(renderItem->GetName(), m_billboardRenderItems.size());
 	m_billboardRenderItems.push_back(renderItem.get());
+	m_renderItemIndices.emplace(renderItem->GetName(), m_allRenderItems.size());
 	m_allRenderItems.push_back(std::move(renderItem));
 }
 void Graphics::AddBillboardRenderItemInstance(BillboardRenderItem* renderItem, const BillboardMeshGeometry::VertexType& instanceData) const
@@ -150,7 +254,9 @@ void Graphics::AddCubeMappingRenderItem(std::unique_ptr<CubeMappingRenderItem>&&
 	for (auto renderLayer : renderLayers)
 		m_renderItemLayers[static_cast<SIZE_T>(renderLayer)].push_back(renderItem.get());
 
+	m_cubeMappingRenderItemIndices.emplace(renderItem->GetName(), m_cubeMappingRenderItems.size());
 	m_cubeMappingRenderItems.push_back(renderItem.get());
+	m_renderItemIndices.emplace(renderItem->GetName(), m_allRenderItems.size());
 	m_allRenderItems.push_back(std::move(renderItem));
 }
 
@@ -158,6 +264,34 @@ uint32_t Graphics::GetVisibleInstances() const
 {
 	return m_visibleInstances;
 }
+uint32_t Graphics::GetShadowCasterInstances() const
+{
+	return m_shadowCasterInstances;
+}
+const FrustumCoherence::Statistics& Graphics::GetCullingStatistics() const
+{
+	return m_cameraFrustumCoherence.GetStatistics();
+}
+const ISpatialIndex<OctreeCollider>& Graphics::GetSpatialIndex()
+{
+	// Queries must see the instances which changed since the last rebuild:
+	if (m_spatialIndexDirty)
+		RebuildSpatialIndex();
+
+	return *m_spatialIndex;
+}
+Common::FrameArena& Graphics::GetFrameArena()
+{
+	return m_frameArena;
+}
+Common::ThreadPool& Graphics::GetThreadPool()
+{
+	return m_threadPool;
+}
+const Common::AllocationTracker::FrameStatistics& Graphics::GetAllocationStatistics() const
+{
+	return Common::AllocationTracker::GetLastFrameStatistics();
+}
 const std::vector<RenderItem*>& Graphics::GetRenderItems(RenderLayer renderLayer) const
 {
 	return m_renderItemLayers[static_cast<size_t>(renderLayer)];
@@ -165,45 +299,45 @@ const std::vector<RenderItem*>& Graphics::GetRenderItems(RenderLayer renderLayer
 
 std::vector<std::unique_ptr<RenderItem>>::const_iterator Graphics::GetRenderItem(const std::string& name) const
 {
-	auto match = [&name](const std::unique_ptr<RenderItem>& renderItem)
-	{
-		return renderItem->GetName() == name;
-	};
-
-	return std::find_if(m_allRenderItems.begin(), m_allRenderItems.end(), match);
+	return FindRenderItem(m_allRenderItems, m_renderItemIndices, name);
 }
 std::vector<NormalRenderItem*>::const_iterator Graphics::GetNormalRenderItem(const std::string& name) const
 {
-	auto match = [&name](const NormalRenderItem* renderItem)
-	{
-		return renderItem->GetName() == name;
-	};
-
-	return std::find_if(m_normalRenderItems.begin(), m_normalRenderItems.end(), match);
+	return FindRenderItem(m_normalRenderItems, m_normalRenderItemIndices, name);
 }
 std::vector<BillboardRenderItem*>::const_iterator Graphics::GetBillboardRenderItem(const std::string& name) const
 {
-	auto match = [&name](const BillboardRenderItem* renderItem)
-	{
-		return renderItem->GetName() == name;
-	};
-
-	return std::find_if(m_billboardRenderItems.begin(), m_billboardRenderItems.end(), match);
+	return FindRenderItem(m_billboardRenderItems, m_billboardRenderItemIndices, name);
 }
 std::vector<CubeMappingRenderItem*>::const_iterator Graphics::GetCubeMappingRenderItem(const std::string& name) const
 {
-	auto match = [&name](const CubeMappingRenderItem* renderItem)
-	{
-		return renderItem->GetName() == name;
-	};
-
-	return std::find_if(m_cubeMappingRenderItems.begin(), m_cubeMappingRenderItems.end(), match);
+	return FindRenderItem(m_cubeMappingRenderItems, m_cubeMappingRenderItemIndices, name);
 }
 
 void Graphics::SetFogState(bool state)
 {
 	m_fog = state;
 }
+void Graphics::SetParallelCullingState(bool state)
+{
+	m_parallelCulling = state;
+}
+void Graphics::SetSpatialIndexCullingState(bool state)
+{
+	m_spatialIndexCulling = state;
+}
+void Graphics::SetOcclusionCullingState(bool state)
+{
+	m_occlusionCulling = state;
+}
+void Graphics::SetLevelOfDetailState(bool state)
+{
+	m_levelOfDetail = state;
+}
+void Graphics::SetAllocationTrackingState(bool state)
+{
+	Common::AllocationTracker::SetEnabled(state);
+}
 void Graphics::SetFogDistanceParameters(float start, float range)
 {
 	m_mainPassData.FogStart = start;
@@ -278,7 +412,7 @@ void Graphics::SetupTerrainMeshData()
 	deviceContext->DSSetConstantBuffers(2, 1, m_currentFrameResource->MainPassData.GetAddressOf());
 	deviceContext->GSSetConstantBuffers(2, 1, m_currentFrameResource->MainPassData.GetAddressOf());
 	m_pipelineStateManager.SetPipelineState(deviceContext, "TerrainStreamOutput");
-	DrawTerrain();
+	DrawTerrain(TerrainView::Camera);
 
 	StagingBuffer stagingBuffer(m_d3dBase.GetDevice(), streamOutputBuffer.GetSize(), streamOutputBuffer.GetStride());
 	deviceContext->CopyResource(stagingBuffer.Get(), streamOutputBuffer.Get());
@@ -313,19 +447,71 @@ void Graphics::UpdateCamera()
 }
 void Graphics::UpdateInstancesDataFrustumCulling()
 {
-	auto deviceContext = m_d3dBase.GetDeviceContext();
+	Common::AllocationTracker::TagScope allocationTag(Common::AllocationTag::Culling);
 
-	// Get view matrix and calculate its inverse:
-	auto viewMatrix = m_camera.GetViewMatrix();
-	auto viewMatrixDeterminant = XMMatrixDeterminant(viewMatrix);
-	auto inverseViewMatrix = XMMatrixInverse(&viewMatrixDeterminant, viewMatrix);
+	// Build the world space camera frustum:
+	auto viewProjectionMatrix = XMMatrixMultiply(m_camera.GetViewMatrix(), m_camera.GetProjectionMatrix());
+	Frustum cameraFrustum(viewProjectionMatrix);
+
+	// Rasterize the occluders, which the instances inside of the frustum are tested against:
+	if (m_occlusionCulling)
+		m_occlusionCuller.Render(viewProjectionMatrix);
+
+	// The size of the instances on the screen selects their level of detail:
+	auto cameraPosition = m_camera.GetPosition();
+	auto projectionScale = XMVectorGetY(m_camera.GetProjectionMatrix().r[1]);
+
+	// Cull the instances of all render items, splitting large render items across several tasks:
+	BuildCullingTasks(m_visibleInstanceIndices, m_visibleInstanceCounts);
+
+	// The culling output is taken from the frame arena, so the rest of the culling doesn't allocate:
+	Common::AllocationTracker::NoAllocationScope noAllocationScope("Frustum culling");
+	auto cullInstances = [this, &cameraFrustum, &cameraPosition, projectionScale](size_t taskIndex)
+	{
+		auto& task = m_cullingTasks[taskIndex];
+		auto renderItem = m_normalRenderItems[task.RenderItemIndex];
+		const auto& instancesBounds = renderItem->GetInstancesBounds();
+
+		// Each task writes into its own range of the visible indices, so no synchronization is needed:
+		auto visibleIndices = m_visibleInstanceIndices[task.RenderItemIndex] + task.Begin;
+		task.VisibleCount = cameraFrustum.CalculateVisibleBoxes(instancesBounds, task.Begin, task.End, visibleIndices);
 
-	// Build the view space camera frustum:
-	auto viewSpaceCameraFrustum = m_camera.BuildViewSpaceBoundingFrustum();
+		// Discard the instances hidden behind the occluders:
+		if (m_occlusionCulling)
+		{
+			size_t visibleCount = 0;
+			for (size_t i = 0; i < task.VisibleCount; ++i)
+			{
+				if (m_occlusionCuller.IsVisible(instancesBounds.Get(visibleIndices[i])))
+					visibleIndices[visibleCount++] = visibleIndices[i];
+			}
+			task.VisibleCount = visibleCount;
+		}
+
+		// Select the level of detail of the visible instances, which only belong to this task:
+		auto levelCount = m_levelOfDetail ? renderItem->GetLevelOfDetailCount() : 1;
+		for (size_t i = 0; i < task.VisibleCount; ++i)
+		{
+			auto instanceID = visibleIndices[i];
+			auto screenSize = LevelOfDetailSelector::CalculateScreenSize(instancesBounds.Get(instanceID), cameraPosition, projectionScale);
+			renderItem->SetInstanceLevelOfDetail(instanceID, m_levelOfDetailSelector.Select(screenSize, renderItem->GetInstanceLevelOfDetail(instanceID), levelCount));
+		}
+	};
+	RunCullingTasks(m_cullingTasks.size(), cullInstances);
+	MergeCullingTasks(m_visibleInstanceIndices, m_visibleInstanceCounts);
+
+	UpdateVisibleInstancesData();
+	UpdateCubeMapSkipFrames(cameraFrustum);
+}
+void Graphics::UpdateVisibleInstancesData()
+{
+	auto deviceContext = m_d3dBase.GetDeviceContext();
 
 	m_visibleInstances = 0;
-	for (const auto& renderItem : m_normalRenderItems)
+	for (size_t renderItemIndex = 0; renderItemIndex < m_normalRenderItems.size(); ++renderItemIndex)
 	{
+		auto renderItem = m_normalRenderItems[renderItemIndex];
+
 		// Get instances buffer for the current render item:
 		auto location = m_currentFrameResource->InstancesBuffers.find(renderItem->GetName());
 		if (location == m_currentFrameResource->InstancesBuffers.end())
@@ -333,137 +519,482 @@ void Graphics::UpdateInstancesDataFrustumCulling()
 
 		const auto& instancesBuffer = location->second;
 
-		if (renderItem->GetInstancesData().size() == 0)
+		// Render items whose last instance was removed draw nothing, instead of the instances of the previous frame:
+		const auto& instancesData = renderItem->GetInstancesData();
+		if (instancesData.size() == 0)
+		{
+			renderItem->SetVisibleInstanceCount(0);
 			continue;
+		}
 
 		// Map resource:
 		D3D11_MAPPED_SUBRESOURCE mappedResource;
 		instancesBuffer.Map(deviceContext, D3D11_MAP_WRITE_DISCARD, &mappedResource);
 		auto instacesBufferView = reinterpret_cast<ShaderBufferTypes::InstanceData*>(mappedResource.pData);
 
-		// For each instance:
-		auto visibleInstanceCount = 0;
-		for (const auto& instanceData : renderItem->GetInstancesData())
-		{
-			// Get the world matrix of the instance and calculate its inverse:
-			auto worldMatrix = XMLoadFloat4x4(&instanceData.WorldMatrix);
-			auto worldMatrixDeterminant = XMMatrixDeterminant(worldMatrix);
-			auto inverseWorldMatrix = XMMatrixInverse(&worldMatrixDeterminant, worldMatrix);
-
-			// Calculate the matrix which transforms from view space to the instance's local space:
-			auto viewToLocalMatrix = XMMatrixMultiply(inverseViewMatrix, inverseWorldMatrix);
+		// Count the visible instances of each level of detail:
+		auto visibleIndices = m_visibleInstanceIndices[renderItemIndex];
+		auto visibleInstanceCount = m_visibleInstanceCounts[renderItemIndex];
+		std::array<size_t, LevelOfDetailSelector::MaxLevelCount> levelOffsets = {};
+		for (size_t i = 0; i < visibleInstanceCount; ++i)
+			++levelOffsets[renderItem->GetInstanceLevelOfDetail(visibleIndices[i])];
 
-			// Transform camera frustum from view space to local space:
-			BoundingFrustum localSpaceCameraFrustum;
-			viewSpaceCameraFrustum.Transform(localSpaceCameraFrustum, viewToLocalMatrix);
+		renderItem->SetVisibleInstanceCount(visibleInstanceCount);
+		size_t levelOffset = 0;
+		for (size_t level = 0; level < levelOffsets.size(); ++level)
+		{
+			auto levelInstanceCount = levelOffsets[level];
+			renderItem->SetLevelOfDetailInstanceCount(level, levelInstanceCount);
+			levelOffsets[level] = levelOffset;
+			levelOffset += levelInstanceCount;
+		}
 
-			// If the camera frustum intersects the instance bounds:
-			if (localSpaceCameraFrustum.Contains(renderItem->GetSubmesh().Bounds) != ContainmentType::DISJOINT)
-			{
-				// Update instance data:
-				auto& instanceDataView = instacesBufferView[visibleInstanceCount++];
-				instanceDataView.WorldMatrix = instanceData.WorldMatrix;
-			}
+		// Update instance data of the visible instances, grouping them by level of detail:
+		for (size_t i = 0; i < visibleInstanceCount; ++i)
+		{
+			auto instanceID = visibleIndices[i];
+			auto& offset = levelOffsets[renderItem->GetInstanceLevelOfDetail(instanceID)];
+			instacesBufferView[offset++].WorldMatrix = instancesData[instanceID].WorldMatrix;
 		}
-		renderItem->SetVisibleInstanceCount(visibleInstanceCount);
-		m_visibleInstances += visibleInstanceCount;
+		m_visibleInstances += static_cast<uint32_t>(visibleInstanceCount);
 
 		// Unmap resource:
 		instancesBuffer.Unmap(deviceContext);
 	}
+}
+void Graphics::UpdateCubeMapSkipFrames(const Frustum& cameraFrustum)
+{
+	auto cubeMapRenderItem = m_cubeMappingRenderItems[0];
+	const auto& instanceData = cubeMapRenderItem->GetInstanceData();
+
+	auto position = cubeMapRenderItem->GetPosition();
+	auto distance = XMVector3Length(position - m_camera.GetPosition());
+	if (XMVectorGetX(distance) > 30.0f)
+	{
+		m_cubeMapSkipFramesCount = 120;
+		return;
+	}
 
-	// Cube map:
+	// Transform the bounds of the cube map instance to world space:
+	BoundingBox worldSpaceBounds;
+	cubeMapRenderItem->GetSubmesh().Bounds.Transform(worldSpaceBounds, XMLoadFloat4x4(&instanceData.WorldMatrix));
+
+	// If the camera frustum intersects the instance bounds:
+	if (cameraFrustum.Contains(worldSpaceBounds) != ContainmentType::DISJOINT)
 	{
-		auto cubeMapRenderItem = m_cubeMappingRenderItems[0];
-		const auto& instanceData = cubeMapRenderItem->GetInstanceData();
+		m_cubeMapSkipFramesCount = 1;
+	}
+	else
+	{
+		m_cubeMapSkipFramesCount = 120;
+	}
+}
+void Graphics::UpdateInstancesDataOctreeCulling()
+{
+	Common::AllocationTracker::TagScope allocationTag(Common::AllocationTag::Culling);
+
+	if (m_spatialIndexDirty)
+		RebuildSpatialIndex();
 
-		auto position = cubeMapRenderItem->GetPosition();
-		auto distance = XMVector3Length(position - m_camera.GetPosition());
-		if (XMVectorGetX(distance) > 30.0f)
+	// Build the world space camera frustum:
+	auto viewProjectionMatrix = XMMatrixMultiply(m_camera.GetViewMatrix(), m_camera.GetProjectionMatrix());
+	Frustum cameraFrustum(viewProjectionMatrix);
+
+	// Find the visible colliders, traversing the children of the root node in parallel.
+	// The camera moves little between frames, so the planes which rejected the nodes last frame are tested first:
+	if (m_parallelCulling)
+	{
+		m_spatialIndex->CalculateIntersections(cameraFrustum, m_cameraFrustumCoherence, m_threadPool, m_visibleColliders);
+	}
+	else
+	{
+		for (auto& visibleColliders : m_visibleColliders)
+			visibleColliders.clear();
+		m_spatialIndex->CalculateIntersections(cameraFrustum, m_cameraFrustumCoherence, m_visibleColliders[0]);
+	}
+
+	// Each collider is reported once, so the instances can be appended without checking for duplicates:
+	if (m_occlusionCulling)
+		m_occlusionCuller.Render(viewProjectionMatrix);
+	for (const auto& visibleColliders : m_visibleColliders)
+	{
+		for (auto collider : visibleColliders)
 		{
-			m_cubeMapSkipFramesCount = 120;
-			return;
+			// Skip the instances hidden behind the occluders:
+			if (m_occlusionCulling && !m_occlusionCuller.IsVisible(collider->GetBounds()))
+				continue;
+
+			auto renderItem = collider->GetRenderItem();
+			renderItem->InsertVisibleInstance(renderItem->GetInstanceIndex(collider->GetInstance()));
 		}
+	}
 
-		// Get the world matrix of the instance and calculate its inverse:
-		auto worldMatrix = XMLoadFloat4x4(&instanceData.WorldMatrix);
-		auto worldMatrixDeterminant = XMMatrixDeterminant(worldMatrix);
-		auto inverseWorldMatrix = XMMatrixInverse(&worldMatrixDeterminant, worldMatrix);
+	// Gather the visible instances of each render item in a deterministic order.
+	// The arena isn't thread safe, so the visible indices are allocated before the tasks run:
+	m_visibleInstanceIndices.resize(m_normalRenderItems.size());
+	m_visibleInstanceCounts.resize(m_normalRenderItems.size());
+	for (size_t renderItemIndex = 0; renderItemIndex < m_normalRenderItems.size(); ++renderItemIndex)
+	{
+		m_visibleInstanceCounts[renderItemIndex] = m_normalRenderItems[renderItemIndex]->GetVisibleInstances().size();
+		m_visibleInstanceIndices[renderItemIndex] = m_frameArena.NewArray<uint32_t>(m_visibleInstanceCounts[renderItemIndex]);
+	}
+	auto cameraPosition = m_camera.GetPosition();
+	auto projectionScale = XMVectorGetY(m_camera.GetProjectionMatrix().r[1]);
+	auto gatherVisibleInstances = [this, &cameraPosition, projectionScale](size_t renderItemIndex)
+	{
+		auto renderItem = m_normalRenderItems[renderItemIndex];
+		const auto& visibleInstances = renderItem->GetVisibleInstances();
 
-		// Calculate the matrix which transforms from view space to the instance's local space:
-		auto viewToLocalMatrix = XMMatrixMultiply(inverseViewMatrix, inverseWorldMatrix);
+		auto visibleIndices = m_visibleInstanceIndices[renderItemIndex];
+		std::copy(visibleInstances.begin(), visibleInstances.end(), visibleIndices);
+		std::sort(visibleIndices, visibleIndices + visibleInstances.size());
 
-		// Transform camera frustum from view space to local space:
-		BoundingFrustum localSpaceCameraFrustum;
-		viewSpaceCameraFrustum.Transform(localSpaceCameraFrustum, viewToLocalMatrix);
+		renderItem->ClearVisibleInstances();
 
-		// If the camera frustum intersects the instance bounds:
-		if (localSpaceCameraFrustum.Contains(cubeMapRenderItem->GetSubmesh().Bounds) != ContainmentType::DISJOINT)
+		// Select the level of detail of the visible instances, as the frustum culling does:
+		const auto& instancesBounds = renderItem->GetInstancesBounds();
+		auto levelCount = m_levelOfDetail ? renderItem->GetLevelOfDetailCount() : 1;
+		for (size_t i = 0; i < m_visibleInstanceCounts[renderItemIndex]; ++i)
 		{
-			m_cubeMapSkipFramesCount = 1;
-		}
-		else
-		{
-			m_cubeMapSkipFramesCount = 120;
+			auto instanceID = visibleIndices[i];
+			auto screenSize = LevelOfDetailSelector::CalculateScreenSize(instancesBounds.Get(instanceID), cameraPosition, projectionScale);
+			renderItem->SetInstanceLevelOfDetail(instanceID, m_levelOfDetailSelector.Select(screenSize, renderItem->GetInstanceLevelOfDetail(instanceID), levelCount));
 		}
+	};
+	RunCullingTasks(m_normalRenderItems.size(), gatherVisibleInstances);
+
+	UpdateVisibleInstancesData();
+	UpdateCubeMapSkipFrames(cameraFrustum);
+}
+std::unique_ptr<ISpatialIndex<OctreeCollider>> Graphics::CreateSpatialIndex(SpatialIndexType spatialIndexType)
+{
+	switch (spatialIndexType)
+	{
+	case SpatialIndexType::BoundingVolumeHierarchy:
+		return std::make_unique<BoundingVolumeHierarchy<OctreeCollider>>(8);
+
+	case SpatialIndexType::Octree:
+	default:
+		return std::make_unique<LinearOctree<OctreeCollider>>(32, BoundingBox(XMFLOAT3(0.0f, 256.0f, 0.0f), XMFLOAT3(1024.0f, 512.0f, 1024.0f)), XMFLOAT3(64.0f, 64.0f, 64.0f));
 	}
 }
-void Graphics::UpdateInstancesDataOctreeCulling()
+void Graphics::RebuildSpatialIndex()
 {
-	auto deviceContext = m_d3dBase.GetDeviceContext();
+	// Gather the colliders of all instances and rebuild the spatial index in bulk:
+	m_spatialIndexObjects.clear();
+	for (auto renderItem : m_normalRenderItems)
+	{
+		for (auto& collider : renderItem->GetColliders())
+			m_spatialIndexObjects.push_back(&collider);
+	}
+	if (m_parallelCulling)
+		m_spatialIndex->Build(m_spatialIndexObjects, m_threadPool);
+	else
+		m_spatialIndex->Build(m_spatialIndexObjects);
 
-	// Get view matrix and calculate its inverse:
-	auto viewMatrix = m_camera.GetViewMatrix();
-	auto viewMatrixDeterminant = XMMatrixDeterminant(viewMatrix);
-	auto inverseViewMatrix = XMMatrixInverse(&viewMatrixDeterminant, viewMatrix);
+	m_spatialIndexDirty = false;
+}
+void Graphics::UpdateInstancesDataShadowCasterCulling()
+{
+	if (!m_enableShadows)
+		return;
 
-	// Build the view space camera frustum:
-	auto viewSpaceCameraFrustum = m_camera.BuildViewSpaceBoundingFrustum();
+	Common::AllocationTracker::TagScope allocationTag(Common::AllocationTag::Culling);
+	auto deviceContext = m_d3dBase.GetDeviceContext();
 
-	m_octree.CalculateIntersections(viewSpaceCameraFrustum, inverseViewMatrix);
+	// The casters are the instances inside of the light frustum whose shadows can reach the view of the camera:
+	auto castShadowsLight = m_lightManager.GetCastShadowsLights()[0];
+	auto lightDirection = XMVector3Normalize(XMLoadFloat3(&castShadowsLight->GetLightData().Direction));
+	auto lightViewProjectionMatrix = XMMatrixMultiply(castShadowsLight->GetViewMatrix(), castShadowsLight->GetProjectionMatrix());
+	auto cameraViewProjectionMatrix = XMMatrixMultiply(m_camera.GetViewMatrix(), m_camera.GetProjectionMatrix());
+	ShadowCasterVolume shadowCasterVolume(lightDirection, lightViewProjectionMatrix, cameraViewProjectionMatrix);
+
+	// Cull the instances of all render items against the shadow caster volume:
+	BuildCullingTasks(m_shadowCasterIndices, m_shadowCasterCounts);
+	Common::AllocationTracker::NoAllocationScope noAllocationScope("Shadow caster culling");
+	auto cullInstances = [this, &shadowCasterVolume](size_t taskIndex)
+	{
+		auto& task = m_cullingTasks[taskIndex];
+		const auto& instancesBounds = m_normalRenderItems[task.RenderItemIndex]->GetInstancesBounds();
 
-	m_visibleInstances = 0;
-	for (const auto& renderItem : m_normalRenderItems)
+		auto casterIndices = m_shadowCasterIndices[task.RenderItemIndex] + task.Begin;
+		task.VisibleCount = shadowCasterVolume.CalculateShadowCasters(instancesBounds, task.Begin, task.End, casterIndices);
+	};
+	RunCullingTasks(m_cullingTasks.size(), cullInstances);
+	MergeCullingTasks(m_shadowCasterIndices, m_shadowCasterCounts);
+
+	m_shadowCasterInstances = 0;
+	for (size_t renderItemIndex = 0; renderItemIndex < m_normalRenderItems.size(); ++renderItemIndex)
 	{
-		// Get instances buffer for the current render item:
-		auto location = m_currentFrameResource->InstancesBuffers.find(renderItem->GetName());
-		if (location == m_currentFrameResource->InstancesBuffers.end())
+		auto renderItem = m_normalRenderItems[renderItemIndex];
+
+		// Get shadow instances buffer for the current render item:
+		auto location = m_currentFrameResource->ShadowInstancesBuffers.find(renderItem->GetName());
+		if (location == m_currentFrameResource->ShadowInstancesBuffers.end())
 			continue;
 
 		const auto& instancesBuffer = location->second;
 
-		const auto& visibleInstances = renderItem->GetVisibleInstances();
-		if (visibleInstances.empty())
+		const auto& instancesData = renderItem->GetInstancesData();
+		if (instancesData.size() == 0)
+		{
+			renderItem->SetShadowCasterCount(0);
 			continue;
+		}
 
 		// Map resource:
 		D3D11_MAPPED_SUBRESOURCE mappedResource;
 		instancesBuffer.Map(deviceContext, D3D11_MAP_WRITE_DISCARD, &mappedResource);
 		auto instacesBufferView = reinterpret_cast<ShaderBufferTypes::InstanceData*>(mappedResource.pData);
 
-		// Update instance data:
-		auto visibleInstanceCount = 0;
-		for (auto instanceID : visibleInstances)
-		{
-			auto& instanceDataView = instacesBufferView[visibleInstanceCount++];
-			const auto& instanceData = renderItem->GetInstance(instanceID);
-			instanceDataView.WorldMatrix = instanceData.WorldMatrix;
-		}
-		renderItem->ClearVisibleInstances();
+		// Update instance data of the shadow casters:
+		auto casterIndices = m_shadowCasterIndices[renderItemIndex];
+		auto shadowCasterCount = m_shadowCasterCounts[renderItemIndex];
+		for (size_t i = 0; i < shadowCasterCount; ++i)
+			instacesBufferView[i].WorldMatrix = instancesData[casterIndices[i]].WorldMatrix;
 
-		m_visibleInstances += visibleInstanceCount;
-		renderItem->SetVisibleInstanceCount(visibleInstanceCount);
+		renderItem->SetShadowCasterCount(shadowCasterCount);
+		m_shadowCasterInstances += static_cast<uint32_t>(shadowCasterCount);
 
 		// Unmap resource:
 		instancesBuffer.Unmap(deviceContext);
 	}
 }
+void Graphics::UpdateInstancesDataCubeMapCulling()
+{
+	Common::AllocationTracker::TagScope allocationTag(Common::AllocationTag::Culling);
+	auto device = m_d3dBase.GetDevice();
+	auto deviceContext = m_d3dBase.GetDeviceContext();
+
+	const auto& camera = m_cubeMappingRenderItems[0]->GetCamera();
+	CubeMapFrustum cubeMapFrustum(camera.GetPosition(), camera.GetFarZ());
+
+	// The tasks are the same for all faces, so building them once per face only sizes the visible indices of each face:
+	for (size_t face = 0; face < CubeMapFrustum::FaceCount; ++face)
+		BuildCullingTasks(m_cubeMapVisibleInstanceIndices[face], m_cubeMapVisibleInstanceCounts[face]);
+
+	m_cubeMapFaceMasks.resize(m_normalRenderItems.size());
+	for (size_t renderItemIndex = 0; renderItemIndex < m_normalRenderItems.size(); ++renderItemIndex)
+		m_cubeMapFaceMasks[renderItemIndex] = m_frameArena.NewArray<uint8_t>(m_normalRenderItems[renderItemIndex]->GetInstancesBounds().GetSize());
+	m_cubeMapTaskVisibleCounts.resize(m_cullingTasks.size());
+
+	// Find the faces from which each instance is visible in a single pass, and append the instance to the visible indices of those faces:
+	auto cullInstances = [this, &cubeMapFrustum](size_t taskIndex)
+	{
+		const auto& task = m_cullingTasks[taskIndex];
+		const auto& instancesBounds = m_normalRenderItems[task.RenderItemIndex]->GetInstancesBounds();
+
+		auto faceMasks = m_cubeMapFaceMasks[task.RenderItemIndex] + task.Begin;
+		cubeMapFrustum.CalculateFaceMasks(instancesBounds, task.Begin, task.End, faceMasks);
+
+		std::array<uint32_t*, CubeMapFrustum::FaceCount> visibleIndices;
+		for (size_t face = 0; face < CubeMapFrustum::FaceCount; ++face)
+			visibleIndices[face] = m_cubeMapVisibleInstanceIndices[face][task.RenderItemIndex] + task.Begin;
+
+		auto& visibleCounts = m_cubeMapTaskVisibleCounts[taskIndex];
+		visibleCounts.fill(0);
+		for (size_t i = 0; i < task.End - task.Begin; ++i)
+		{
+			for (size_t face = 0; face < CubeMapFrustum::FaceCount; ++face)
+			{
+				visibleIndices[face][visibleCounts[face]] = static_cast<uint32_t>(task.Begin + i);
+				visibleCounts[face] += (faceMasks[i] >> face) & 1;
+			}
+		}
+	};
+	RunCullingTasks(m_cullingTasks.size(), cullInstances);
+
+	for (size_t face = 0; face < CubeMapFrustum::FaceCount; ++face)
+	{
+		// Merge the visible indices of the face:
+		for (size_t taskIndex = 0; taskIndex < m_cullingTasks.size(); ++taskIndex)
+			m_cullingTasks[taskIndex].VisibleCount = m_cubeMapTaskVisibleCounts[taskIndex][face];
+		MergeCullingTasks(m_cubeMapVisibleInstanceIndices[face], m_cubeMapVisibleInstanceCounts[face]);
+
+		for (size_t renderItemIndex = 0; renderItemIndex < m_normalRenderItems.size(); ++renderItemIndex)
+		{
+			auto renderItem = m_normalRenderItems[renderItemIndex];
+			auto visibleInstanceCount = m_cubeMapVisibleInstanceCounts[face][renderItemIndex];
+			renderItem->SetCubeMapFaceInstanceCount(face, visibleInstanceCount);
+			if (visibleInstanceCount == 0)
+				continue;
+
+			// Map resource:
+			const auto& instancesBuffer = m_currentFrameResource->ReserveCubeMapInstanceBuffer(device, face, renderItem->GetName(), visibleInstanceCount);
+			D3D11_MAPPED_SUBRESOURCE mappedResource;
+			instancesBuffer.Map(deviceContext, D3D11_MAP_WRITE_DISCARD, &mappedResource);
+			auto instacesBufferView = reinterpret_cast<ShaderBufferTypes::InstanceData*>(mappedResource.pData);
+
+			// Update instance data of the instances visible from the face:
+			const auto& instancesData = renderItem->GetInstancesData();
+			auto visibleIndices = m_cubeMapVisibleInstanceIndices[face][renderItemIndex];
+			for (size_t i = 0; i < visibleInstanceCount; ++i)
+				instacesBufferView[i].WorldMatrix = instancesData[visibleIndices[i]].WorldMatrix;
+
+			// Unmap resource:
+			instancesBuffer.Unmap(deviceContext);
+		}
+	}
+}
+void Graphics::BuildCullingTasks(std::vector<uint32_t*>& visibleIndices, std::vector<size_t>& visibleCounts)
+{
+	// Number of instances culled by a single task, which must be a multiple of the bounding box group size:
+	static constexpr size_t s_instancesPerTask = 1024;
+	static_assert(s_instancesPerTask % BoundingBoxArray::GroupSize == 0, "Tasks must start at the begin of a group of bounding boxes");
+
+	m_cullingTasks.clear();
+	visibleIndices.resize(m_normalRenderItems.size());
+	visibleCounts.assign(m_normalRenderItems.size(), 0);
+
+	for (size_t renderItemIndex = 0; renderItemIndex < m_normalRenderItems.size(); ++renderItemIndex)
+	{
+		auto instanceCount = m_normalRenderItems[renderItemIndex]->GetInstancesBounds().GetSize();
+		visibleIndices[renderItemIndex] = m_frameArena.NewArray<uint32_t>(instanceCount);
+
+		for (size_t begin = 0; begin < instanceCount; begin += s_instancesPerTask)
+		{
+			auto end = std::min(begin + s_instancesPerTask, instanceCount);
+			m_cullingTasks.push_back({ renderItemIndex, begin, end, 0 });
+		}
+	}
+}
+void Graphics::MergeCullingTasks(std::vector<uint32_t*>& visibleIndices, std::vector<size_t>& visibleCounts)
+{
+	// Tasks are ordered by render item and range, so the visible indices can be compacted in place:
+	for (const auto& task : m_cullingTasks)
+	{
+		auto renderItemVisibleIndices = visibleIndices[task.RenderItemIndex];
+		auto& visibleCount = visibleCounts[task.RenderItemIndex];
+
+		auto taskBegin = renderItemVisibleIndices + task.Begin;
+		std::copy(taskBegin, taskBegin + task.VisibleCount, renderItemVisibleIndices + visibleCount);
+		visibleCount += task.VisibleCount;
+	}
+}
 void Graphics::UpdateBillboards()
 {
 	auto deviceContext = m_d3dBase.GetDeviceContext();
 	for (auto& renderItem : m_billboardRenderItems)
 		renderItem->Update(deviceContext);
 }
+void Graphics::UpdateTerrain()
+{
+	Common::AllocationTracker::TagScope allocationTag(Common::AllocationTag::Terrain);
+
+	XMFLOAT3 cameraPosition;
+	XMStoreFloat3(&cameraPosition, m_camera.GetPosition());
+
+	// Stream the height map tiles around the camera:
+	m_scene.GetTerrain().Update(cameraPosition);
+
+	auto projectionScale = XMVectorGetY(m_camera.GetProjectionMatrix().r[1]);
+	m_terrainQuadtree.Select(cameraPosition, projectionScale, m_terrainPatches);
+
+	CullTerrainPatches();
+	WriteTerrainPatchBuffers();
+}
+void Graphics::CullTerrainPatches()
+{
+	m_terrainQuadtree.CalculatePatchBounds(m_terrainPatches, m_terrainPatchBounds);
+	for (auto& visiblePatches : m_visibleTerrainPatches)
+		visiblePatches.resize(m_terrainPatches.size());
+
+	auto cullAgainstFrustum = [this](TerrainView view, CXMMATRIX viewProjectionMatrix)
+	{
+		Frustum frustum(viewProjectionMatrix);
+		auto& visiblePatches = m_visibleTerrainPatches[static_cast<size_t>(view)];
+		m_terrainPatchRanges[static_cast<size_t>(view)].Count = frustum.CalculateVisibleBoxes(m_terrainPatchBounds, 0, m_terrainPatchBounds.GetSize(), visiblePatches.data());
+	};
+
+	// Cull against the camera frustum:
+	cullAgainstFrustum(TerrainView::Camera, XMMatrixMultiply(m_camera.GetViewMatrix(), m_camera.GetProjectionMatrix()));
+
+	// Cull against the light frustum, if the shadow map is drawn:
+	m_terrainPatchRanges[static_cast<size_t>(TerrainView::Shadow)].Count = 0;
+	if (m_enableShadows)
+	{
+		auto castShadowsLight = m_lightManager.GetCastShadowsLights()[0];
+		cullAgainstFrustum(TerrainView::Shadow, XMMatrixMultiply(castShadowsLight->GetViewMatrix(), castShadowsLight->GetProjectionMatrix()));
+	}
+
+	// The faces of the cube map look in every direction, so only the patches beyond its far plane are culled:
+	{
+		const auto& cubeMapCamera = m_cubeMappingRenderItems[0]->GetCamera();
+		BoundingSphere cubeMapBounds;
+		XMStoreFloat3(&cubeMapBounds.Center, cubeMapCamera.GetPosition());
+		cubeMapBounds.Radius = cubeMapCamera.GetFarZ();
+
+		auto& visiblePatches = m_visibleTerrainPatches[static_cast<size_t>(TerrainView::CubeMap)];
+		size_t visibleCount = 0;
+		for (size_t i = 0; i < m_terrainPatchBounds.GetSize(); ++i)
+		{
+			if (cubeMapBounds.Intersects(m_terrainPatchBounds.Get(i)))
+				visiblePatches[visibleCount++] = static_cast<uint32_t>(i);
+		}
+		m_terrainPatchRanges[static_cast<size_t>(TerrainView::CubeMap)].Count = visibleCount;
+	}
+
+	// Place the patches of each view after the ones of the previous view, starting at a new batch:
+	constexpr auto maxPatchCount = static_cast<size_t>(ShaderBufferTypes::TerrainPatchData::MaxPatchCount);
+	size_t begin = 0;
+	for (auto& range : m_terrainPatchRanges)
+	{
+		range.Begin = begin;
+		begin += (range.Count + maxPatchCount - 1) / maxPatchCount * maxPatchCount;
+	}
+}
+void Graphics::WriteTerrainPatchBuffers()
+{
+	auto deviceContext = m_d3dBase.GetDeviceContext();
+	const auto& lastRange = m_terrainPatchRanges.back();
+	m_currentFrameResource->ReserveTerrainPatchBuffers(m_d3dBase.GetDevice(), lastRange.Begin + lastRange.Count);
+
+	// Index the corners of each visible patch in the vertices of the terrain grid, ordered as the control points of the hull shader:
+	{
+		D3D11_MAPPED_SUBRESOURCE mappedResource;
+		m_currentFrameResource->TerrainPatchIndices.Map(deviceContext, D3D11_MAP_WRITE_DISCARD, &mappedResource);
+
+		auto rowVertexCount = m_terrainQuadtree.GetCellCount() + 1;
+		for (size_t view = 0; view < m_terrainPatchRanges.size(); ++view)
+		{
+			const auto& range = m_terrainPatchRanges[view];
+			auto indices = static_cast<uint32_t*>(mappedResource.pData) + 4 * range.Begin;
+			for (size_t i = 0; i < range.Count; ++i)
+			{
+				const auto& patch = m_terrainPatches[m_visibleTerrainPatches[view][i]];
+				auto topLeftIndex = patch.Row * rowVertexCount + patch.Column;
+				auto bottomLeftIndex = topLeftIndex + patch.Size * rowVertexCount;
+				*indices++ = topLeftIndex;
+				*indices++ = bottomLeftIndex;
+				*indices++ = topLeftIndex + patch.Size;
+				*indices++ = bottomLeftIndex + patch.Size;
+			}
+		}
+
+		m_currentFrameResource->TerrainPatchIndices.Unmap(deviceContext);
+	}
+
+	// Copy the edge tessellation factors of each batch of visible patches, which the hull shader indexes by the primitive ID:
+	constexpr auto maxPatchCount = static_cast<size_t>(ShaderBufferTypes::TerrainPatchData::MaxPatchCount);
+	for (size_t view = 0; view < m_terrainPatchRanges.size(); ++view)
+	{
+		const auto& range = m_terrainPatchRanges[view];
+		for (size_t batchBegin = 0; batchBegin < range.Count; batchBegin += maxPatchCount)
+		{
+			const auto& patchDataBuffer = m_currentFrameResource->TerrainPatchData[(range.Begin + batchBegin) / maxPatchCount];
+
+			D3D11_MAPPED_SUBRESOURCE mappedResource;
+			patchDataBuffer.Map(deviceContext, D3D11_MAP_WRITE_DISCARD, &mappedResource);
+
+			auto patchData = static_cast<ShaderBufferTypes::TerrainPatchData*>(mappedResource.pData);
+			auto batchEnd = std::min(batchBegin + maxPatchCount, range.Count);
+			for (auto i = batchBegin; i < batchEnd; ++i)
+				patchData->EdgeTesselationFactors[i - batchBegin] = m_terrainPatches[m_visibleTerrainPatches[view][i]].EdgeTesselationFactors;
+
+			patchDataBuffer.Unmap(deviceContext);
+		}
+	}
+}
 void Graphics::UpdateMaterialData() const
 {
 	auto deviceContext = m_d3dBase.GetDeviceContext();
@@ -557,11 +1088,11 @@ void Graphics::UpdateMainPassData(const Common::Timer& timer)
 
 	m_currentFrameResource->MainPassData.CopyData(m_d3dBase.GetDeviceContext(), &m_mainPassData, sizeof(ShaderBufferTypes::PassData));
 }
-void Graphics::UpdateShadowPassData(const Common::Timer& timer) const
+void Graphics::UpdateShadowPassData(const Common::Timer& timer)
 {
 	ShaderBufferTypes::PassData passData = m_mainPassData;
 
-	auto castShadowsLights = m_lightManager.GetCastShadowsLights();
+	const auto& castShadowsLights = m_lightManager.GetCastShadowsLights();
 	auto castShadowsLight = castShadowsLights[0];
 
 	auto viewMatrix = castShadowsLight->GetViewMatrix();
@@ -606,7 +1137,7 @@ void Graphics::UpdateShadowPassData(const Common::Timer& timer) const
 
 	m_currentFrameResource->ShadowPassData.CopyData(m_d3dBase.GetDeviceContext(), &passData, sizeof(ShaderBufferTypes::PassData));
 }
-void Graphics::UpdateCubeMappingPassData(const Common::Timer& timer) const
+void Graphics::UpdateCubeMappingPassData(const Common::Timer& timer)
 {
 	auto passData = m_mainPassData;
 
@@ -703,7 +1234,7 @@ void Graphics::DrawInNormalMode()
 	m_shadowMap.ClearDepthStencilView(deviceContext);
 }
 
-void Graphics::DrawRenderItems(RenderLayer renderLayer) const
+void Graphics::DrawRenderItems(RenderLayer renderLayer, size_t cubeMapFace) const
 {
 	auto deviceContext = m_d3dBase.GetDeviceContext();
 
@@ -714,7 +1245,8 @@ void Graphics::DrawRenderItems(RenderLayer renderLayer) const
 	for (auto& renderItem : m_renderItemLayers[static_cast<SIZE_T>(renderLayer)])
 	{
 		// Set instances data:
-		deviceContext->IASetVertexBuffers(1, 1, m_currentFrameResource->InstancesBuffers[renderItem->GetName()].GetAddressOf(), &stride, &offset);
+		auto& instancesBuffers = cubeMapFace < CubeMapFrustum::FaceCount ? m_currentFrameResource->CubeMapInstancesBuffers[cubeMapFace] : m_currentFrameResource->InstancesBuffers;
+		deviceContext->IASetVertexBuffers(1, 1, instancesBuffers[renderItem->GetName()].GetAddressOf(), &stride, &offset);
 
 		// Set material data:
 		auto pMaterial = renderItem->GetMaterial();
@@ -732,7 +1264,38 @@ void Graphics::DrawRenderItems(RenderLayer renderLayer) const
 			deviceContext->PSSetShaderResources(2, 1, pMaterial->SpecularMap->GetAddressOf());
 
 		// Render:
-		renderItem->Render(deviceContext);
+		if (cubeMapFace < CubeMapFrustum::FaceCount)
+			renderItem->RenderCubeMapFace(deviceContext, cubeMapFace);
+		else
+			renderItem->Render(deviceContext);
+	}
+}
+void Graphics::DrawShadowCasters(RenderLayer renderLayer) const
+{
+	auto deviceContext = m_d3dBase.GetDeviceContext();
+
+	UINT stride = sizeof(ShaderBufferTypes::InstanceData);
+	UINT offset = 0;
+
+	// For each render item:
+	for (auto& renderItem : m_renderItemLayers[static_cast<SIZE_T>(renderLayer)])
+	{
+		// Set instances data of the shadow casters:
+		deviceContext->IASetVertexBuffers(1, 1, m_currentFrameResource->ShadowInstancesBuffers[renderItem->GetName()].GetAddressOf(), &stride, &offset);
+
+		// Set material data:
+		auto pMaterial = renderItem->GetMaterial();
+		const auto& materialData = m_currentFrameResource->MaterialDataArray[pMaterial->MaterialIndex];
+		deviceContext->VSSetConstantBuffers(1, 1, materialData.GetAddressOf());
+		deviceContext->GSSetConstantBuffers(1, 1, materialData.GetAddressOf());
+		deviceContext->PSSetConstantBuffers(1, 1, materialData.GetAddressOf());
+
+		// Set the diffuse map, which alpha-clipped casters need:
+		if (pMaterial->DiffuseMap != nullptr)
+			deviceContext->PSSetShaderResources(0, 1, pMaterial->DiffuseMap->GetAddressOf());
+
+		// Render:
+		renderItem->RenderShadowCasters(deviceContext);
 	}
 }
 void Graphics::DrawNonInstancedRenderItems(RenderLayer renderLayer) const
@@ -761,7 +1324,7 @@ void Graphics::DrawNonInstancedRenderItems(RenderLayer renderLayer) const
 		renderItem->RenderNonInstanced(deviceContext);
 	}
 }
-void Graphics::DrawTerrain() const
+void Graphics::DrawTerrain(TerrainView view) const
 {
 	auto deviceContext = m_d3dBase.GetDeviceContext();
 
@@ -789,8 +1352,16 @@ void Graphics::DrawTerrain() const
 			startSlot += numViews;
 		}
 
-		// Render:
-		renderItem->RenderNonInstanced(deviceContext);
+		// Render the patches visible from the view, in batches which fit in a constant buffer. The terrain is added as a normal render item:
+		auto terrainRenderItem = static_cast<const NormalRenderItem*>(renderItem);
+		const auto& range = m_terrainPatchRanges[static_cast<size_t>(view)];
+		constexpr auto maxPatchCount = static_cast<size_t>(ShaderBufferTypes::TerrainPatchData::MaxPatchCount);
+		for (size_t batchBegin = range.Begin; batchBegin < range.Begin + range.Count; batchBegin += maxPatchCount)
+		{
+			auto patchCount = std::min(maxPatchCount, range.Begin + range.Count - batchBegin);
+			deviceContext->HSSetConstantBuffers(3, 1, m_currentFrameResource->TerrainPatchData[batchBegin / maxPatchCount].GetAddressOf());
+			terrainRenderItem->RenderIndexRange(deviceContext, m_currentFrameResource->TerrainPatchIndices.Get(), static_cast<UINT>(4 * patchCount), static_cast<UINT>(4 * batchBegin));
+		}
 	}
 }
 void Graphics::DrawInDebugMode() const
@@ -807,7 +1378,7 @@ void Graphics::DrawInDebugMode() const
 
 	// Draw terrain in debug mode:
 	m_pipelineStateManager.SetPipelineState(deviceContext, m_debugPipelineStateNames.at(m_debugWindowMode));
-	DrawTerrain();
+	DrawTerrain(TerrainView::Camera);
 }
 void Graphics::DrawSceneIntoShadowMap(const ShadowTexture& shadowMap) const
 {
@@ -827,26 +1398,26 @@ void Graphics::DrawSceneIntoShadowMap(const ShadowTexture& shadowMap) const
 	{
 		// Draw opaque:
 		m_pipelineStateManager.SetPipelineState(deviceContext, "OpaqueShadow");
-		DrawRenderItems(RenderLayer::Opaque);
-		DrawRenderItems(RenderLayer::NormalMapping);
-		DrawRenderItems(RenderLayer::NormalSpecularMapping);
-		DrawRenderItems(RenderLayer::OpaqueDynamicReflectors);
+		DrawShadowCasters(RenderLayer::Opaque);
+		DrawShadowCasters(RenderLayer::NormalMapping);
+		DrawShadowCasters(RenderLayer::NormalSpecularMapping);
+		DrawShadowCasters(RenderLayer::OpaqueDynamicReflectors);
 	}
 
 	// Draw terrain:
 	m_pipelineStateManager.SetPipelineState(deviceContext, "TerrainShadow");
-	DrawTerrain();
+	DrawTerrain(TerrainView::Shadow);
 
 	if (!m_drawTerrainOnly)
 	{
 		// Draw transparent:
 		m_pipelineStateManager.SetPipelineState(deviceContext, "TransparentShadow");
-		DrawRenderItems(RenderLayer::Transparent);
+		DrawShadowCasters(RenderLayer::Transparent);
 
 		// Draw alpha-clipped:
 		m_pipelineStateManager.SetPipelineState(deviceContext, "AlphaClippedShadow");
-		DrawRenderItems(RenderLayer::AlphaClipped);
-		DrawRenderItems(RenderLayer::NormalSpecularMappingTransparent);
+		DrawShadowCasters(RenderLayer::AlphaClipped);
+		DrawShadowCasters(RenderLayer::NormalSpecularMappingTransparent);
 	}
 }
 void Graphics::DrawSceneIntoCubeMap(ID3D11DeviceContext* deviceContext, const CubeMapRenderTexture& cubeMap) const
@@ -857,13 +1428,13 @@ void Graphics::DrawSceneIntoCubeMap(ID3D11DeviceContext* deviceContext, const Cu
 		cubeMap.ClearRenderTarget(deviceContext, static_cast<UINT>(i));
 		cubeMap.SetRenderTarget(deviceContext, static_cast<UINT>(i));
 		SetPassData(m_currentFrameResource->CubeMapPassData[i].GetAddressOf());
-		DrawMainScene(false);
+		DrawMainScene(false, i);
 	}
 	m_d3dBase.SetViewport();
 
 	deviceContext->GenerateMips(cubeMap.GetShaderResourceView());
 }
-void Graphics::DrawMainScene(bool drawCubeMapRenderItems) const
+void Graphics::DrawMainScene(bool drawCubeMapRenderItems, size_t cubeMapFace) const
 {
 	auto deviceContext = m_d3dBase.GetDeviceContext();
 
@@ -871,6 +1442,9 @@ void Graphics::DrawMainScene(bool drawCubeMapRenderItems) const
 	auto shadowMapSRV = m_shadowMap.GetShaderResourceView();
 	deviceContext->PSSetShaderResources(3, 1, &shadowMapSRV);
 
+	// The faces of the cube map draw the terrain patches culled for it:
+	auto terrainView = cubeMapFace < CubeMapFrustum::FaceCount ? TerrainView::CubeMap : TerrainView::Camera;
+
 	if (!m_fog)
 	{
 		// Draw Skydome:
@@ -885,21 +1459,21 @@ void Graphics::DrawMainScene(bool drawCubeMapRenderItems) const
 		{
 			// Draw opaque:
 			m_pipelineStateManager.SetPipelineState(deviceContext, "Opaque");
-			DrawRenderItems(RenderLayer::Opaque);
+			DrawRenderItems(RenderLayer::Opaque, cubeMapFace);
 
 			// Draw normal mapped:
 			m_pipelineStateManager.SetPipelineState(deviceContext, "NormalMapping");
-			DrawRenderItems(RenderLayer::NormalMapping);
+			DrawRenderItems(RenderLayer::NormalMapping, cubeMapFace);
 
 			// Draw normal specular mapped:
 			m_pipelineStateManager.SetPipelineState(deviceContext, "NormalSpecularMapping");
-			DrawRenderItems(RenderLayer::NormalSpecularMapping);
+			DrawRenderItems(RenderLayer::NormalSpecularMapping, cubeMapFace);
 
 			// Draw cube mapped:
 			if (drawCubeMapRenderItems)
 			{
 				m_pipelineStateManager.SetPipelineState(deviceContext, "StandardCubeMapping");
-				DrawRenderItems(RenderLayer::OpaqueDynamicReflectors);
+				DrawRenderItems(RenderLayer::OpaqueDynamicReflectors, cubeMapFace);
 			}
 		}
 
@@ -908,21 +1482,21 @@ void Graphics::DrawMainScene(bool drawCubeMapRenderItems) const
 			m_pipelineStateManager.SetPipelineState(deviceContext, "TerrainNoNormalMapping");
 		else
 			m_pipelineStateManager.SetPipelineState(deviceContext, "Terrain");
-		DrawTerrain();
+		DrawTerrain(terrainView);
 
 		if (!m_drawTerrainOnly)
 		{
 			// Draw transparent:
 			m_pipelineStateManager.SetPipelineState(deviceContext, "Transparent");
-			DrawRenderItems(RenderLayer::Transparent);
+			DrawRenderItems(RenderLayer::Transparent, cubeMapFace);
 
 			// Draw alpha-clipped:
 			m_pipelineStateManager.SetPipelineState(deviceContext, "AlphaClipped");
-			DrawRenderItems(RenderLayer::AlphaClipped);
+			DrawRenderItems(RenderLayer::AlphaClipped, cubeMapFace);
 
 			// Draw transparent normal specular mapping:
 			m_pipelineStateManager.SetPipelineState(deviceContext, "NormalSpecularMappingTransparent");
-			DrawRenderItems(RenderLayer::NormalSpecularMappingTransparent);
+			DrawRenderItems(RenderLayer::NormalSpecularMappingTransparent, cubeMapFace);
 
 			// Draw billboards:
 			m_pipelineStateManager.SetPipelineState(deviceContext, "Billboard");
@@ -943,21 +1517,21 @@ void Graphics::DrawMainScene(bool drawCubeMapRenderItems) const
 		{
 			// Draw opaque:
 			m_pipelineStateManager.SetPipelineState(deviceContext, "OpaqueFog");
-			DrawRenderItems(RenderLayer::Opaque);
+			DrawRenderItems(RenderLayer::Opaque, cubeMapFace);
 
 			// Draw normal mapped:
 			m_pipelineStateManager.SetPipelineState(deviceContext, "NormalMappingFog");
-			DrawRenderItems(RenderLayer::NormalMapping);
+			DrawRenderItems(RenderLayer::NormalMapping, cubeMapFace);
 
 			// Draw normal specular mapped:
 			m_pipelineStateManager.SetPipelineState(deviceContext, "NormalSpecularMappingFog");
-			DrawRenderItems(RenderLayer::NormalSpecularMapping);
+			DrawRenderItems(RenderLayer::NormalSpecularMapping, cubeMapFace);
 
 			// Draw cube mapped:
 			if (drawCubeMapRenderItems)
 			{
 				m_pipelineStateManager.SetPipelineState(deviceContext, "StandardCubeMappingFog");
-				DrawRenderItems(RenderLayer::OpaqueDynamicReflectors);
+				DrawRenderItems(RenderLayer::OpaqueDynamicReflectors, cubeMapFace);
 			}
 		}
 
@@ -966,21 +1540,21 @@ void Graphics::DrawMainScene(bool drawCubeMapRenderItems) const
 			m_pipelineStateManager.SetPipelineState(deviceContext, "TerrainNoNormalMappingFog");
 		else
 			m_pipelineStateManager.SetPipelineState(deviceContext, "TerrainFog");
-		DrawTerrain();
+		DrawTerrain(terrainView);
 
 		if (!m_drawTerrainOnly)
 		{
 			// Draw transparent:
 			m_pipelineStateManager.SetPipelineState(deviceContext, "TransparentFog");
-			DrawRenderItems(RenderLayer::Transparent);
+			DrawRenderItems(RenderLayer::Transparent, cubeMapFace);
 
 			// Draw alpha-clipped:
 			m_pipelineStateManager.SetPipelineState(deviceContext, "AlphaClippedFog");
-			DrawRenderItems(RenderLayer::AlphaClipped);
+			DrawRenderItems(RenderLayer::AlphaClipped, cubeMapFace);
 
 			// Draw transparent normal specular mapping:
 			m_pipelineStateManager.SetPipelineState(deviceContext, "NormalSpecularMappingTransparentFog");
-			DrawRenderItems(RenderLayer::NormalSpecularMappingTransparent);
+			DrawRenderItems(RenderLayer::NormalSpecularMappingTransparent, cubeMapFace);
 
 			// Draw billboards:
 			m_pipelineStateManager.SetPipelineState(deviceContext, "BillboardFog");
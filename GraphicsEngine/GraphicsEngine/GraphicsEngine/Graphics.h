@@ -1,6 +1,9 @@
 ﻿#pragma once
 
 #include "Common/Timer.h"
+#include "Common/ThreadPool.h"
+#include "Common/AllocationTracker.h"
+#include "Common/FrameArena.h"
 
 #include "Camera.h"
 #include "D3DBase.h"
@@ -14,11 +17,21 @@
 #include "ShadowTexture.h"
 #include "LightManager.h"
 #include "RenderTexture.h"
-#include "Octree.h"
+#include "LinearOctree.h"
+#include "BoundingVolumeHierarchy.h"
+#include "SpatialIndexType.h"
+#include "Frustum.h"
+#include "FrustumCoherence.h"
+#include "OcclusionCuller.h"
+#include "ShadowCasterVolume.h"
+#include "CubeMapFrustum.h"
+#include "LevelOfDetailSelector.h"
+#include "TerrainQuadtree.h"
 #include "NormalRenderItem.h"
 #include "BillboardRenderItem.h"
 #include "CubeMappingRenderItem.h"
 #include <random>
+#include <unordered_map>
 
 namespace GraphicsEngine
 {
@@ -40,8 +53,35 @@ namespace GraphicsEngine
 			Count
 		};
 
+	private:
+		// Range of instances of a render item, which is culled by a single worker:
+		struct CullingTask
+		{
+			size_t RenderItemIndex;
+			size_t Begin;
+			size_t End;
+			size_t VisibleCount;
+		};
+
+		// Passes which draw their own subset of the terrain patches:
+		enum class TerrainView
+		{
+			Camera,
+			Shadow,
+			CubeMap,
+			Count
+		};
+
+		// Patches of a view in the terrain patch buffers. The range begins with a batch of patch data, as the hull shader indexes
+		// the patch data by the primitive ID, which starts from zero at each draw:
+		struct TerrainPatchRange
+		{
+			size_t Begin;
+			size_t Count;
+		};
+
 	public:
-		explicit Graphics(HWND outputWindow, uint32_t clientWidth, uint32_t clientHeight, bool fullscreen);
+		explicit Graphics(HWND outputWindow, uint32_t clientWidth, uint32_t clientHeight, bool fullscreen, SpatialIndexType spatialIndexType = SpatialIndexType::Octree);
 
 		void OnResize(uint32_t clientWidth, uint32_t clientHeight);
 		void FixedUpdate(const Common::Timer& timer);
@@ -52,11 +92,23 @@ namespace GraphicsEngine
 		DefaultScene* GetScene();
 
 		void AddNormalRenderItem(std::unique_ptr<NormalRenderItem>&& renderItem, std::initializer_list<RenderLayer> renderLayers);
-		void AddNormalRenderItemInstance(NormalRenderItem* renderItem, const ShaderBufferTypes::InstanceData& instanceData) const;
+		NormalRenderItem::InstanceHandle AddNormalRenderItemInstance(NormalRenderItem* renderItem, const ShaderBufferTypes::InstanceData& instanceData);
+		void SetNormalRenderItemInstance(NormalRenderItem* renderItem, NormalRenderItem::InstanceHandle instance, const ShaderBufferTypes::InstanceData& instanceData);
+		void SetNormalRenderItemMesh(NormalRenderItem* renderItem, ImmutableMeshGeometry* mesh, const std::string& submeshName);
+		void RemoveNormalRenderItemInstance(NormalRenderItem* renderItem, NormalRenderItem::InstanceHandle instance);
+		void RemoveLastRenderItemInstance(const std::string& renderItemName);
 		void AddBillboardRenderItem(std::unique_ptr<BillboardRenderItem>&& renderItem, std::initializer_list<RenderLayer> renderLayers);
 		void AddBillboardRenderItemInstance(BillboardRenderItem* renderItem, const BillboardMeshGeometry::VertexType& instanceData) const;
 		void AddCubeMappingRenderItem(std::unique_ptr<CubeMappingRenderItem>&& renderItem, std::initializer_list<RenderLayer> renderLayers);
 		uint32_t GetVisibleInstances() const;
+		uint32_t GetShadowCasterInstances() const;
+		const FrustumCoherence::Statistics& GetCullingStatistics() const;
+		const ISpatialIndex<OctreeCollider>& GetSpatialIndex();
+		// Transient data of the current frame, which stays valid until the end of the next frame:
+		Common::FrameArena& GetFrameArena();
+		Common::ThreadPool& GetThreadPool();
+		// Heap allocations of the engine during the last frame, which are only counted while allocation tracking is enabled:
+		const Common::AllocationTracker::FrameStatistics& GetAllocationStatistics() const;
 		const std::vector<RenderItem*>& GetRenderItems(RenderLayer renderLayer) const;
 		std::vector<std::unique_ptr<RenderItem>>::const_iterator GetRenderItem(const std::string& name) const;
 		std::vector<NormalRenderItem*>::const_iterator GetNormalRenderItem(const std::string& name) const;
@@ -64,6 +116,12 @@ namespace GraphicsEngine
 		std::vector<CubeMappingRenderItem*>::const_iterator GetCubeMappingRenderItem(const std::string& name) const;
 
 		void SetFogState(bool state);
+		void SetParallelCullingState(bool state);
+		// Culls the instances by traversing the spatial index instead of testing all their bounds, which is the default:
+		void SetSpatialIndexCullingState(bool state);
+		void SetOcclusionCullingState(bool state);
+		void SetLevelOfDetailState(bool state);
+		void SetAllocationTrackingState(bool state);
 		void SetFogDistanceParameters(float start, float range);
 		void SetFogColor(const DirectX::XMFLOAT4& color);
 		DebugMode GetDebugWindowMode() const;
@@ -78,13 +136,26 @@ namespace GraphicsEngine
 		void UpdateCamera();
 		void UpdateInstancesDataFrustumCulling();
 		void UpdateInstancesDataOctreeCulling();
+		void UpdateVisibleInstancesData();
+		void UpdateCubeMapSkipFrames(const Frustum& cameraFrustum);
+		void UpdateInstancesDataShadowCasterCulling();
+		void UpdateInstancesDataCubeMapCulling();
+		static std::unique_ptr<ISpatialIndex<OctreeCollider>> CreateSpatialIndex(SpatialIndexType spatialIndexType);
+		void RebuildSpatialIndex();
+		void BuildCullingTasks(std::vector<uint32_t*>& visibleIndices, std::vector<size_t>& visibleCounts);
+		void MergeCullingTasks(std::vector<uint32_t*>& visibleIndices, std::vector<size_t>& visibleCounts);
+		template<typename FunctionType>
+		void RunCullingTasks(size_t taskCount, FunctionType&& function);
 		void UpdateBillboards();
+		void UpdateTerrain();
+		void CullTerrainPatches();
+		void WriteTerrainPatchBuffers();
 		void UpdateMaterialData() const;
 		void UpdateLights(const Common::Timer& timer) const;
 		void InitializeMainPassData();
 		void UpdateMainPassData(const Common::Timer& timer);
-		void UpdateShadowPassData(const Common::Timer& timer) const;
-		void UpdateCubeMappingPassData(const Common::Timer& timer) const;
+		void UpdateShadowPassData(const Common::Timer& timer);
+		void UpdateCubeMappingPassData(const Common::Timer& timer);
 
 		void SetPassData(ID3D11Buffer* const* ppPassDataBuffer) const;
 
@@ -92,11 +163,13 @@ namespace GraphicsEngine
 		void DrawInDebugMode() const;
 		void DrawSceneIntoShadowMap(const ShadowTexture& shadowMap) const;
 		void DrawSceneIntoCubeMap(ID3D11DeviceContext* deviceContext, const CubeMapRenderTexture& cubeMap) const;
-		void DrawMainScene(bool drawCubeMapRenderItems) const;
+		void DrawMainScene(bool drawCubeMapRenderItems, size_t cubeMapFace = CubeMapFrustum::FaceCount) const;
 		void DrawDebugWindow() const;
-		void DrawRenderItems(RenderLayer renderLayer) const;
+		// Draws the instances visible from the camera, or from a face of the dynamic cube map if cubeMapFace is less than CubeMapFrustum::FaceCount:
+		void DrawRenderItems(RenderLayer renderLayer, size_t cubeMapFace = CubeMapFrustum::FaceCount) const;
+		void DrawShadowCasters(RenderLayer renderLayer) const;
 		void DrawNonInstancedRenderItems(RenderLayer renderLayer) const;
-		void DrawTerrain() const;
+		void DrawTerrain(TerrainView view) const;
 
 	private:
 		bool m_initialized = false;
@@ -108,10 +181,19 @@ namespace GraphicsEngine
 		std::vector<BillboardRenderItem*> m_billboardRenderItems;
 		std::vector<CubeMappingRenderItem*> m_cubeMappingRenderItems;
 		std::vector<RenderItem*> m_renderItemLayers[static_cast<SIZE_T>(RenderLayer::Count)];
+		// Indices of the render items in the vectors above, by name:
+		std::unordered_map<std::string, size_t> m_renderItemIndices;
+		std::unordered_map<std::string, size_t> m_normalRenderItemIndices;
+		std::unordered_map<std::string, size_t> m_billboardRenderItemIndices;
+		std::unordered_map<std::string, size_t> m_cubeMappingRenderItemIndices;
 		TextureManager m_textureManager;
 		Camera m_camera;
 		LightManager m_lightManager;
-		Octree<OctreeCollider> m_octree;
+		std::unique_ptr<ISpatialIndex<OctreeCollider>> m_spatialIndex;
+		bool m_spatialIndexDirty;
+		std::vector<OctreeCollider*> m_spatialIndexObjects;
+		// Created before the scene, which uses it while loading:
+		Common::ThreadPool m_threadPool;
 		DefaultScene m_scene;
 
 		std::vector<FrameResource> m_frameResources;
@@ -127,6 +209,32 @@ namespace GraphicsEngine
 		RenderTexture m_renderTexture;
 		DirectX::BoundingSphere m_sceneBounds;
 		uint32_t m_visibleInstances;
+		Common::FrameArena m_frameArena;
+		bool m_parallelCulling;
+		bool m_spatialIndexCulling;
+		std::vector<CullingTask> m_cullingTasks;
+		// The visible indices of each render item are allocated from the frame arena, so they are only valid during the frame:
+		std::vector<uint32_t*> m_visibleInstanceIndices;
+		std::vector<size_t> m_visibleInstanceCounts;
+		std::array<std::vector<OctreeCollider*>, 8> m_visibleColliders;
+		FrustumCoherence m_cameraFrustumCoherence;
+		OcclusionCuller m_occlusionCuller;
+		bool m_occlusionCulling;
+		LevelOfDetailSelector m_levelOfDetailSelector;
+		bool m_levelOfDetail;
+		// The patches are selected from the camera, and culled against the view of each pass:
+		TerrainQuadtree m_terrainQuadtree;
+		std::vector<TerrainQuadtree::Patch> m_terrainPatches;
+		BoundingBoxArray m_terrainPatchBounds;
+		std::array<std::vector<uint32_t>, static_cast<size_t>(TerrainView::Count)> m_visibleTerrainPatches;
+		std::array<TerrainPatchRange, static_cast<size_t>(TerrainView::Count)> m_terrainPatchRanges;
+		uint32_t m_shadowCasterInstances;
+		std::vector<uint32_t*> m_shadowCasterIndices;
+		std::vector<size_t> m_shadowCasterCounts;
+		std::vector<uint8_t*> m_cubeMapFaceMasks;
+		std::vector<std::array<size_t, CubeMapFrustum::FaceCount>> m_cubeMapTaskVisibleCounts;
+		std::array<std::vector<uint32_t*>, CubeMapFrustum::FaceCount> m_cubeMapVisibleInstanceIndices;
+		std::array<std::vector<size_t>, CubeMapFrustum::FaceCount> m_cubeMapVisibleInstanceCounts;
 		ShaderBufferTypes::PassData m_mainPassData;
 		DebugMode m_debugWindowMode;
 		bool m_enableShadows;
@@ -136,4 +244,18 @@ namespace GraphicsEngine
 		uint32_t m_cubeMapSkipFramesCount;
 		uint32_t m_cubeMapSkipFramesCurrentCount;
 	};
+
+	template<typename FunctionType>
+	void Graphics::RunCullingTasks(size_t taskCount, FunctionType&& function)
+	{
+		if (m_parallelCulling)
+		{
+			m_threadPool.ParallelFor(taskCount, std::forward<FunctionType>(function));
+		}
+		else
+		{
+			for (size_t i = 0; i < taskCount; ++i)
+				function(i);
+		}
+	}
 }
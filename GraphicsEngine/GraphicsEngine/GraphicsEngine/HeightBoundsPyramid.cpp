@@ -0,0 +1,222 @@
+#include "stdafx.h"
+#include "HeightBoundsPyramid.h"
+
+#include <DirectXCollision.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace Common;
+using namespace DirectX;
+using namespace GraphicsEngine;
+
+namespace
+{
+	XMFLOAT2 MergeBounds(const XMFLOAT2& bounds, const XMFLOAT2& otherBounds)
+	{
+		return XMFLOAT2(std::min(bounds.x, otherBounds.x), std::max(bounds.y, otherBounds.y));
+	}
+	uint32_t GetCellIndex(float position, float cellExtent, uint32_t cellCount)
+	{
+		return static_cast<uint32_t>(std::min(std::max(std::floor(position / cellExtent), 0.0f), static_cast<float>(cellCount - 1)));
+	}
+}
+
+HeightBoundsPyramid::HeightBoundsPyramid(const std::vector<float>& heightMap, uint32_t width, uint32_t height, float terrainWidth, float terrainDepth) :
+	m_width(width),
+	m_terrainWidth(terrainWidth),
+	m_terrainDepth(terrainDepth),
+	m_cellWidth(terrainWidth / static_cast<float>(width - 1)),
+	m_cellDepth(terrainDepth / static_cast<float>(height - 1))
+{
+	if (width < 2 || height < 2)
+		ThrowEngineException(L"A height map must have at least two texels in each dimension to build its bounds!");
+	if (heightMap.size() != static_cast<size_t>(width) * height)
+		ThrowEngineException(L"Terrain dimensions don't match with the height map dimensions!");
+
+	// Calculate the bounds of each cell from its four texels:
+	Level cells;
+	cells.ColumnCount = width - 1;
+	cells.RowCount = height - 1;
+	cells.Bounds.resize(static_cast<size_t>(cells.ColumnCount) * cells.RowCount);
+	for (uint32_t row = 0; row < cells.RowCount; ++row)
+	{
+		auto topRow = heightMap.data() + static_cast<size_t>(row) * width;
+		auto bottomRow = topRow + width;
+		for (uint32_t column = 0; column < cells.ColumnCount; ++column)
+		{
+			auto minimumHeight = std::min(std::min(topRow[column], topRow[column + 1]), std::min(bottomRow[column], bottomRow[column + 1]));
+			auto maximumHeight = std::max(std::max(topRow[column], topRow[column + 1]), std::max(bottomRow[column], bottomRow[column + 1]));
+			cells.Bounds[static_cast<size_t>(row) * cells.ColumnCount + column] = XMFLOAT2(minimumHeight, maximumHeight);
+		}
+	}
+	m_levels.push_back(std::move(cells));
+
+	// Merge each block of 2x2 nodes into a node of the next level, until a single node is left:
+	while (m_levels.back().ColumnCount > 1 || m_levels.back().RowCount > 1)
+	{
+		const auto& previous = m_levels.back();
+		Level next;
+		next.ColumnCount = (previous.ColumnCount + 1) / 2;
+		next.RowCount = (previous.RowCount + 1) / 2;
+		next.Bounds.resize(static_cast<size_t>(next.ColumnCount) * next.RowCount);
+		for (uint32_t row = 0; row < next.RowCount; ++row)
+		{
+			for (uint32_t column = 0; column < next.ColumnCount; ++column)
+			{
+				auto firstRow = 2 * row;
+				auto lastRow = std::min(2 * row + 1, previous.RowCount - 1);
+				auto firstColumn = 2 * column;
+				auto lastColumn = std::min(2 * column + 1, previous.ColumnCount - 1);
+				auto bounds = MergeBounds(previous.Bounds[firstRow * previous.ColumnCount + firstColumn], previous.Bounds[firstRow * previous.ColumnCount + lastColumn]);
+				bounds = MergeBounds(bounds, MergeBounds(previous.Bounds[lastRow * previous.ColumnCount + firstColumn], previous.Bounds[lastRow * previous.ColumnCount + lastColumn]));
+				next.Bounds[static_cast<size_t>(row) * next.ColumnCount + column] = bounds;
+			}
+		}
+
+		m_levels.push_back(std::move(next));
+	}
+}
+
+uint32_t HeightBoundsPyramid::GetLevelCount() const
+{
+	return static_cast<uint32_t>(m_levels.size());
+}
+
+void HeightBoundsPyramid::GetHeightBounds(float minimumX, float minimumZ, float maximumX, float maximumZ, float& minimumHeight, float& maximumHeight) const
+{
+	minimumHeight = 0.0f;
+	maximumHeight = 0.0f;
+	if (m_levels.empty())
+		return;
+
+	// Find the cells at the corners of the rectangle, the rows growing towards -z:
+	const auto& cells = m_levels.front();
+	auto firstColumn = GetCellIndex(minimumX + 0.5f * m_terrainWidth, m_cellWidth, cells.ColumnCount);
+	auto lastColumn = GetCellIndex(maximumX + 0.5f * m_terrainWidth, m_cellWidth, cells.ColumnCount);
+	auto firstRow = GetCellIndex(0.5f * m_terrainDepth - maximumZ, m_cellDepth, cells.RowCount);
+	auto lastRow = GetCellIndex(0.5f * m_terrainDepth - minimumZ, m_cellDepth, cells.RowCount);
+
+	// Use the finest level at which the rectangle overlaps 2x2 nodes at most:
+	uint32_t level = 0;
+	while (level + 1 < m_levels.size() && ((lastColumn >> level) - (firstColumn >> level) > 1 || (lastRow >> level) - (firstRow >> level) > 1))
+		++level;
+
+	const auto& nodes = m_levels[level];
+	auto bounds = XMFLOAT2(FLT_MAX, -FLT_MAX);
+	for (auto row = firstRow >> level; row <= lastRow >> level; ++row)
+	{
+		for (auto column = firstColumn >> level; column <= lastColumn >> level; ++column)
+			bounds = MergeBounds(bounds, nodes.Bounds[row * nodes.ColumnCount + column]);
+	}
+
+	minimumHeight = bounds.x;
+	maximumHeight = bounds.y;
+}
+
+bool HeightBoundsPyramid::Intersects(const std::vector<float>& heightMap, FXMVECTOR origin, FXMVECTOR direction, float maxDistance, float& distance) const
+{
+	if (m_levels.empty())
+		return false;
+
+	auto rootLevel = static_cast<uint32_t>(m_levels.size() - 1);
+	float entryDistance;
+	if (!IntersectsNodeBounds(origin, direction, rootLevel, 0, 0, entryDistance) || entryDistance > maxDistance)
+		return false;
+
+	distance = maxDistance;
+	return IntersectsNode(heightMap, origin, direction, rootLevel, 0, 0, distance);
+}
+
+bool HeightBoundsPyramid::IntersectsNode(const std::vector<float>& heightMap, FXMVECTOR origin, FXMVECTOR direction, uint32_t level, uint32_t row, uint32_t column, float& distance) const
+{
+	if (level == 0)
+		return IntersectsCell(heightMap, origin, direction, row, column, distance);
+
+	// Sort the children whose bounds the ray crosses by their entry distance:
+	const auto& children = m_levels[level - 1];
+	uint32_t childRows[4];
+	uint32_t childColumns[4];
+	float entryDistances[4];
+	size_t childCount = 0;
+	for (auto childRow = 2 * row; childRow < std::min(2 * row + 2, children.RowCount); ++childRow)
+	{
+		for (auto childColumn = 2 * column; childColumn < std::min(2 * column + 2, children.ColumnCount); ++childColumn)
+		{
+			float entryDistance;
+			if (!IntersectsNodeBounds(origin, direction, level - 1, childRow, childColumn, entryDistance))
+				continue;
+
+			auto index = childCount++;
+			for (; index > 0 && entryDistances[index - 1] > entryDistance; --index)
+			{
+				childRows[index] = childRows[index - 1];
+				childColumns[index] = childColumns[index - 1];
+				entryDistances[index] = entryDistances[index - 1];
+			}
+			childRows[index] = childRow;
+			childColumns[index] = childColumn;
+			entryDistances[index] = entryDistance;
+		}
+	}
+
+	// Visit the nearest children first, stopping at the ones beyond the closest intersection found:
+	auto intersects = false;
+	for (size_t i = 0; i < childCount && entryDistances[i] <= distance; ++i)
+	{
+		if (IntersectsNode(heightMap, origin, direction, level - 1, childRows[i], childColumns[i], distance))
+			intersects = true;
+	}
+
+	return intersects;
+}
+bool HeightBoundsPyramid::IntersectsCell(const std::vector<float>& heightMap, FXMVECTOR origin, FXMVECTOR direction, uint32_t row, uint32_t column, float& distance) const
+{
+	auto topLeft = GetTexelPosition(heightMap, row, column);
+	auto topRight = GetTexelPosition(heightMap, row, column + 1);
+	auto bottomLeft = GetTexelPosition(heightMap, row + 1, column);
+	auto bottomRight = GetTexelPosition(heightMap, row + 1, column + 1);
+
+	// Test the two triangles of the cell:
+	auto intersects = false;
+	float triangleDistance;
+	if (TriangleTests::Intersects(origin, direction, topLeft, topRight, bottomLeft, triangleDistance) && triangleDistance < distance)
+	{
+		distance = triangleDistance;
+		intersects = true;
+	}
+	if (TriangleTests::Intersects(origin, direction, topRight, bottomRight, bottomLeft, triangleDistance) && triangleDistance < distance)
+	{
+		distance = triangleDistance;
+		intersects = true;
+	}
+
+	return intersects;
+}
+bool HeightBoundsPyramid::IntersectsNodeBounds(FXMVECTOR origin, FXMVECTOR direction, uint32_t level, uint32_t row, uint32_t column, float& entryDistance) const
+{
+	const auto& cells = m_levels.front();
+	const auto& nodes = m_levels[level];
+	const auto& bounds = nodes.Bounds[row * nodes.ColumnCount + column];
+
+	// Calculate the cells covered by the node, which are fewer at the last row and column of a level:
+	auto firstColumn = column << level;
+	auto lastColumn = std::min((column + 1) << level, cells.ColumnCount);
+	auto firstRow = row << level;
+	auto lastRow = std::min((row + 1) << level, cells.RowCount);
+
+	auto minimumX = -0.5f * m_terrainWidth + static_cast<float>(firstColumn) * m_cellWidth;
+	auto maximumX = -0.5f * m_terrainWidth + static_cast<float>(lastColumn) * m_cellWidth;
+	auto minimumZ = 0.5f * m_terrainDepth - static_cast<float>(lastRow) * m_cellDepth;
+	auto maximumZ = 0.5f * m_terrainDepth - static_cast<float>(firstRow) * m_cellDepth;
+
+	BoundingBox box;
+	BoundingBox::CreateFromPoints(box, XMVectorSet(minimumX, bounds.x, minimumZ, 0.0f), XMVectorSet(maximumX, bounds.y, maximumZ, 0.0f));
+	return box.Intersects(origin, direction, entryDistance);
+}
+XMVECTOR HeightBoundsPyramid::GetTexelPosition(const std::vector<float>& heightMap, uint32_t row, uint32_t column) const
+{
+	auto x = -0.5f * m_terrainWidth + static_cast<float>(column) * m_cellWidth;
+	auto z = 0.5f * m_terrainDepth - static_cast<float>(row) * m_cellDepth;
+	return XMVectorSet(x, heightMap[static_cast<size_t>(row) * m_width + column], z, 0.0f);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+namespace GraphicsEngine
+{
+	// Quadtree of the minimum and maximum heights of a height map spanning the terrain. Its first level holds the bounds of each
+	// cell between four texels, and each next level the bounds of 2x2 nodes of the previous one, up to a single node. Rays descend
+	// only into the nodes whose bounds they cross, from the nearest to the farthest, and test the triangles of the cells they reach.
+	class HeightBoundsPyramid
+	{
+	public:
+		HeightBoundsPyramid() = default;
+
+		// The first and the last texels of each row and column lie on the borders of the terrain, as for HeightMapSampler:
+		HeightBoundsPyramid(const std::vector<float>& heightMap, uint32_t width, uint32_t height, float terrainWidth, float terrainDepth);
+
+		uint32_t GetLevelCount() const;
+
+		// Calculates a range which contains every height of the terrain inside of the rectangle:
+		void GetHeightBounds(float minimumX, float minimumZ, float maximumX, float maximumZ, float& minimumHeight, float& maximumHeight) const;
+
+		// Finds the closest intersection of a ray with a normalized direction, up to the maximum distance. The height map must be the
+		// one the pyramid was built from:
+		bool Intersects(const std::vector<float>& heightMap, DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float maxDistance, float& distance) const;
+
+	private:
+		struct Level
+		{
+			uint32_t ColumnCount;
+			uint32_t RowCount;
+
+			// Minimum and maximum heights of each node:
+			std::vector<DirectX::XMFLOAT2> Bounds;
+		};
+
+	private:
+		bool IntersectsNode(const std::vector<float>& heightMap, DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, uint32_t level, uint32_t row, uint32_t column, float& distance) const;
+		bool IntersectsCell(const std::vector<float>& heightMap, DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, uint32_t row, uint32_t column, float& distance) const;
+		bool IntersectsNodeBounds(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, uint32_t level, uint32_t row, uint32_t column, float& entryDistance) const;
+		DirectX::XMVECTOR GetTexelPosition(const std::vector<float>& heightMap, uint32_t row, uint32_t column) const;
+
+	private:
+		uint32_t m_width = 0;
+		float m_terrainWidth = 0.0f;
+		float m_terrainDepth = 0.0f;
+		float m_cellWidth = 0.0f;
+		float m_cellDepth = 0.0f;
+		std::vector<Level> m_levels;
+	};
+}
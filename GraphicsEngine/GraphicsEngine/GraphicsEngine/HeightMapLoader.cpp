@@ -0,0 +1,130 @@
+#include "stdafx.h"
+#include "HeightMapLoader.h"
+#include "Common/MemoryMappedFile.h"
+
+#include <algorithm>
+
+using namespace Common;
+using namespace DirectX;
+using namespace GraphicsEngine;
+
+namespace
+{
+	// Number of rows processed by a single task:
+	constexpr uint32_t s_rowsPerTask = 16;
+
+	uint32_t GetTaskCount(uint32_t height)
+	{
+		return (height + s_rowsPerTask - 1) / s_rowsPerTask;
+	}
+
+	void CalculateNormalAndTangent(float upValue, float downValue, float leftValue, float rightValue, float h, XMFLOAT4& normal, XMFLOAT4& tangent)
+	{
+		auto tangentVector = XMVector3Normalize(XMVectorSet(h, upValue - downValue, 0.0f, 0.0f));
+		auto bitangentVector = XMVector3Normalize(XMVectorSet(0.0f, rightValue - leftValue, -h, 0.0f));
+		auto normalVector = XMVector3Cross(tangentVector, bitangentVector);
+
+		XMStoreFloat4(&tangent, tangentVector);
+		XMStoreFloat4(&normal, normalVector);
+	}
+
+	XMVECTOR LoadFloats(const float* values)
+	{
+		return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(values));
+	}
+	void StoreTexels(const XMMATRIX& texels, XMFLOAT4* output)
+	{
+		for (size_t i = 0; i < 4; ++i)
+			XMStoreFloat4(output + i, texels.r[i]);
+	}
+}
+
+void HeightMapLoader::Load(const std::wstring& filename, uint32_t width, uint32_t height, float heightFactor, ThreadPool& threadPool, std::vector<float>& heightMap)
+{
+	MemoryMappedFile file(filename);
+	if (file.GetSize() != static_cast<size_t>(width) * height * sizeof(uint16_t))
+		ThrowEngineException(L"Terrain dimensions don't match with the height map dimensions!");
+
+	ConvertHeights(file.GetData<uint16_t>(), width, height, heightFactor, threadPool, heightMap);
+}
+
+void HeightMapLoader::ConvertHeights(const uint16_t* rawHeights, uint32_t width, uint32_t height, float heightFactor, ThreadPool& threadPool, std::vector<float>& heightMap)
+{
+	heightMap.resize(static_cast<size_t>(width) * height);
+
+	threadPool.ParallelFor(GetTaskCount(height), [rawHeights, width, heightFactor, &heightMap](size_t taskIndex)
+	{
+		auto begin = taskIndex * s_rowsPerTask * width;
+		auto end = std::min(begin + s_rowsPerTask * width, heightMap.size());
+		for (auto index = begin; index < end; ++index)
+			heightMap[index] = heightFactor * static_cast<float>(rawHeights[index]) / 65535.0f;
+	});
+}
+
+void HeightMapLoader::CalculateNormalsAndTangents(const std::vector<float>& heightMap, uint32_t width, uint32_t height, ThreadPool& threadPool, std::vector<XMFLOAT4>& normalMap, std::vector<XMFLOAT4>& tangentMap, float texelSpacing)
+{
+	normalMap.resize(heightMap.size());
+	tangentMap.resize(heightMap.size());
+
+	threadPool.ParallelFor(GetTaskCount(height), [&heightMap, width, height, texelSpacing, &normalMap, &tangentMap](size_t taskIndex)
+	{
+		auto begin = static_cast<uint32_t>(taskIndex) * s_rowsPerTask;
+		auto end = std::min(begin + s_rowsPerTask, height);
+		for (auto row = begin; row < end; ++row)
+		{
+			auto rowOffset = static_cast<size_t>(row) * width;
+			CalculateRowNormalsAndTangents(heightMap, width, height, row, texelSpacing, normalMap.data() + rowOffset, tangentMap.data() + rowOffset);
+		}
+	});
+}
+
+void HeightMapLoader::CalculateRowNormalsAndTangents(const std::vector<float>& heightMap, uint32_t width, uint32_t height, uint32_t row, float texelSpacing, XMFLOAT4* normals, XMFLOAT4* tangents)
+{
+	// Compute the tangent, bitangent and normal vectors.
+	// position = (x, f(x, z), z)
+	// tangent = d(position) / dx = (1.0f, d(f(x, z)) / dx, 0.0f)
+	// bitangent = d(position) / dz = (0.0f, d(f(x, z)) / dz, 1.0f)
+	// Calculate the derivative using the central differences method, with h = 2 * texel_spacing.
+	auto upRow = heightMap.data() + static_cast<size_t>(row == 0 ? height - 1 : row - 1) * width;
+	auto downRow = heightMap.data() + static_cast<size_t>(row == height - 1 ? 0 : row + 1) * width;
+	auto centerRow = heightMap.data() + static_cast<size_t>(row) * width;
+
+	auto h = 2.0f * texelSpacing;
+	auto calculateTexel = [upRow, downRow, centerRow, width, h, normals, tangents](uint32_t column)
+	{
+		auto leftColumn = column == 0 ? width - 1 : column - 1;
+		auto rightColumn = column == width - 1 ? 0 : column + 1;
+		CalculateNormalAndTangent(upRow[column], downRow[column], centerRow[leftColumn], centerRow[rightColumn], h, normals[column], tangents[column]);
+	};
+
+	// The first and the last columns wrap around, so only the columns in between are processed four at a time:
+	calculateTexel(0);
+	uint32_t column = 1;
+	auto hVector = XMVectorReplicate(h);
+	auto hSquared = XMVectorReplicate(h * h);
+	auto zero = XMVectorZero();
+	for (; column + 4 < width; column += 4)
+	{
+		auto verticalDifferences = XMVectorSubtract(LoadFloats(upRow + column), LoadFloats(downRow + column));
+		auto horizontalDifferences = XMVectorSubtract(LoadFloats(centerRow + column + 1), LoadFloats(centerRow + column - 1));
+
+		// Normalize the tangents (h, vertical difference, 0) and the bitangents (0, horizontal difference, -h):
+		auto tangentLengths = XMVectorSqrt(XMVectorMultiplyAdd(verticalDifferences, verticalDifferences, hSquared));
+		auto bitangentLengths = XMVectorSqrt(XMVectorMultiplyAdd(horizontalDifferences, horizontalDifferences, hSquared));
+		auto tangentsX = XMVectorDivide(hVector, tangentLengths);
+		auto tangentsY = XMVectorDivide(verticalDifferences, tangentLengths);
+		auto bitangentsY = XMVectorDivide(horizontalDifferences, bitangentLengths);
+		auto bitangentsZ = XMVectorDivide(XMVectorNegate(hVector), bitangentLengths);
+
+		// normal = tangent x bitangent = (tangent.y * bitangent.z, -tangent.x * bitangent.z, tangent.x * bitangent.y):
+		auto normalsX = XMVectorMultiply(tangentsY, bitangentsZ);
+		auto normalsY = XMVectorNegate(XMVectorMultiply(tangentsX, bitangentsZ));
+		auto normalsZ = XMVectorMultiply(tangentsX, bitangentsY);
+
+		// Each vector holds a component of four texels, so transpose them into a vector per texel:
+		StoreTexels(XMMatrixTranspose(XMMATRIX(tangentsX, tangentsY, zero, zero)), tangents + column);
+		StoreTexels(XMMatrixTranspose(XMMATRIX(normalsX, normalsY, normalsZ, zero)), normals + column);
+	}
+	for (; column < width; ++column)
+		calculateTexel(column);
+}
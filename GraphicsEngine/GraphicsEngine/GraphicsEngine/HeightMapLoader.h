@@ -0,0 +1,30 @@
+#pragma once
+
+#include "Common/ThreadPool.h"
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace GraphicsEngine
+{
+	// Loads raw 16-bit height maps and generates their normal and tangent maps. The work is split across the threads of a
+	// thread pool by rows, and the normals and tangents of four texels of a row are calculated at once.
+	class HeightMapLoader
+	{
+	public:
+		// The height map file is mapped into memory and converted directly into the heights, without reading it into a buffer:
+		static void Load(const std::wstring& filename, uint32_t width, uint32_t height, float heightFactor, Common::ThreadPool& threadPool, std::vector<float>& heightMap);
+
+		// Scales the raw heights from [0, 65535] to [0, heightFactor]:
+		static void ConvertHeights(const uint16_t* rawHeights, uint32_t width, uint32_t height, float heightFactor, Common::ThreadPool& threadPool, std::vector<float>& heightMap);
+
+		// Calculates the tangents and normals of the height map from central differences. The height map wraps around at its borders.
+		// The texel spacing is the distance between two texels in world space:
+		static void CalculateNormalsAndTangents(const std::vector<float>& heightMap, uint32_t width, uint32_t height, Common::ThreadPool& threadPool, std::vector<DirectX::XMFLOAT4>& normalMap, std::vector<DirectX::XMFLOAT4>& tangentMap, float texelSpacing = 1.0f);
+
+	private:
+		static void CalculateRowNormalsAndTangents(const std::vector<float>& heightMap, uint32_t width, uint32_t height, uint32_t row, float texelSpacing, DirectX::XMFLOAT4* normals, DirectX::XMFLOAT4* tangents);
+	};
+}
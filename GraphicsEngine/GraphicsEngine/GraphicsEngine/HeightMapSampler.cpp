@@ -0,0 +1,135 @@
+#include "stdafx.h"
+#include "HeightMapSampler.h"
+
+#include <algorithm>
+
+using namespace Common;
+using namespace DirectX;
+using namespace GraphicsEngine;
+
+namespace
+{
+	// Number of positions sampled at once:
+	constexpr size_t s_laneCount = 4;
+
+	size_t GetRemainingLaneCount(size_t count, size_t first)
+	{
+		return std::min(count - first, s_laneCount);
+	}
+	XMVECTOR LoadFloats(const float* values)
+	{
+		return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(values));
+	}
+}
+
+HeightMapSampler::HeightMapSampler(const std::vector<float>& heightMap, uint32_t width, uint32_t height, float terrainWidth, float terrainDepth) :
+	m_heightMap(&heightMap),
+	m_width(width),
+	m_height(height),
+	m_columnScale(static_cast<float>(width - 1) / terrainWidth),
+	m_rowScale(static_cast<float>(height - 1) / terrainDepth)
+{
+	if (width < 2 || height < 2)
+		ThrowEngineException(L"A height map must have at least two texels in each dimension to be sampled!");
+	if (heightMap.size() != static_cast<size_t>(width) * height)
+		ThrowEngineException(L"Terrain dimensions don't match with the height map dimensions!");
+}
+
+float HeightMapSampler::SampleHeight(float x, float z) const
+{
+	XMFLOAT2 position(x, z);
+	float height;
+	SampleHeights(&position, 1, &height);
+	return height;
+}
+
+void HeightMapSampler::SampleHeights(const XMFLOAT2* positions, size_t count, float* heights) const
+{
+	for (size_t first = 0; first < count; first += s_laneCount)
+	{
+		size_t topLeftIndices[s_laneCount];
+		XMVECTOR u, v;
+		CalculateCells(positions, count, first, topLeftIndices, u, v);
+
+		XMFLOAT4 interpolatedHeights;
+		XMStoreFloat4(&interpolatedHeights, InterpolateHeights(topLeftIndices, u, v));
+		std::copy_n(&interpolatedHeights.x, GetRemainingLaneCount(count, first), heights + first);
+	}
+}
+
+void HeightMapSampler::SampleHeightsAndNormals(const XMFLOAT2* positions, size_t count, const std::vector<XMFLOAT4>& normalMap, float* heights, XMFLOAT3* normals) const
+{
+	for (size_t first = 0; first < count; first += s_laneCount)
+	{
+		size_t topLeftIndices[s_laneCount];
+		XMVECTOR u, v;
+		CalculateCells(positions, count, first, topLeftIndices, u, v);
+
+		XMFLOAT4 interpolatedHeights;
+		XMStoreFloat4(&interpolatedHeights, InterpolateHeights(topLeftIndices, u, v));
+		auto laneCount = GetRemainingLaneCount(count, first);
+		std::copy_n(&interpolatedHeights.x, laneCount, heights + first);
+
+		// The normals don't fit the lanes, so they are interpolated one position at a time:
+		XMFLOAT4 cellU, cellV;
+		XMStoreFloat4(&cellU, u);
+		XMStoreFloat4(&cellV, v);
+		for (size_t lane = 0; lane < laneCount; ++lane)
+		{
+			auto topLeft = topLeftIndices[lane];
+			auto bottomLeft = topLeft + m_width;
+			auto top = XMVectorLerp(XMLoadFloat4(&normalMap[topLeft]), XMLoadFloat4(&normalMap[topLeft + 1]), (&cellU.x)[lane]);
+			auto bottom = XMVectorLerp(XMLoadFloat4(&normalMap[bottomLeft]), XMLoadFloat4(&normalMap[bottomLeft + 1]), (&cellU.x)[lane]);
+			XMStoreFloat3(normals + first + lane, XMVector3Normalize(XMVectorLerp(top, bottom, (&cellV.x)[lane])));
+		}
+	}
+}
+
+void HeightMapSampler::CalculateCells(const XMFLOAT2* positions, size_t count, size_t first, size_t* topLeftIndices, XMVECTOR& u, XMVECTOR& v) const
+{
+	// Gather the positions into a vector of x and a vector of z:
+	XMFLOAT4 x, z;
+	for (size_t lane = 0; lane < s_laneCount; ++lane)
+	{
+		const auto& position = positions[std::min(first + lane, count - 1)];
+		(&x.x)[lane] = position.x;
+		(&z.x)[lane] = position.y;
+	}
+
+	// Map from 0.5f * [-terrain_width, terrain_width] to [0, width - 1] and from 0.5f * [terrain_depth, -terrain_depth] to [0, height - 1]:
+	auto maxColumn = static_cast<float>(m_width - 1);
+	auto maxRow = static_cast<float>(m_height - 1);
+	auto columns = XMVectorClamp(XMVectorMultiplyAdd(XMLoadFloat4(&x), XMVectorReplicate(m_columnScale), XMVectorReplicate(0.5f * maxColumn)), XMVectorZero(), XMVectorReplicate(maxColumn));
+	auto rows = XMVectorClamp(XMVectorMultiplyAdd(XMLoadFloat4(&z), XMVectorReplicate(-m_rowScale), XMVectorReplicate(0.5f * maxRow)), XMVectorZero(), XMVectorReplicate(maxRow));
+
+	// The cells on the last row and column are the ones before them, so that their neighbours are inside of the height map:
+	auto cellColumns = XMVectorMin(XMVectorFloor(columns), XMVectorReplicate(maxColumn - 1.0f));
+	auto cellRows = XMVectorMin(XMVectorFloor(rows), XMVectorReplicate(maxRow - 1.0f));
+	u = XMVectorSubtract(columns, cellColumns);
+	v = XMVectorSubtract(rows, cellRows);
+
+	XMFLOAT4 cellColumnValues, cellRowValues;
+	XMStoreFloat4(&cellColumnValues, cellColumns);
+	XMStoreFloat4(&cellRowValues, cellRows);
+	for (size_t lane = 0; lane < s_laneCount; ++lane)
+		topLeftIndices[lane] = static_cast<size_t>((&cellRowValues.x)[lane]) * m_width + static_cast<size_t>((&cellColumnValues.x)[lane]);
+}
+
+XMVECTOR HeightMapSampler::InterpolateHeights(const size_t* topLeftIndices, FXMVECTOR u, FXMVECTOR v) const
+{
+	// Gather the heights of the corners of the cells:
+	const auto& heightMap = *m_heightMap;
+	float topLeft[s_laneCount], topRight[s_laneCount], bottomLeft[s_laneCount], bottomRight[s_laneCount];
+	for (size_t lane = 0; lane < s_laneCount; ++lane)
+	{
+		auto index = topLeftIndices[lane];
+		topLeft[lane] = heightMap[index];
+		topRight[lane] = heightMap[index + 1];
+		bottomLeft[lane] = heightMap[index + m_width];
+		bottomRight[lane] = heightMap[index + m_width + 1];
+	}
+
+	auto top = XMVectorLerpV(LoadFloats(topLeft), LoadFloats(topRight), u);
+	auto bottom = XMVectorLerpV(LoadFloats(bottomLeft), LoadFloats(bottomRight), u);
+	return XMVectorLerpV(top, bottom, v);
+}
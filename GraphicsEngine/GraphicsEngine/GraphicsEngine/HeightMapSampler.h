@@ -0,0 +1,38 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+namespace GraphicsEngine
+{
+	// Interpolates the heights of a height map spanning the terrain, four positions at a time. The first and the last texels of each
+	// row and column lie on the borders of the terrain, and positions outside of the terrain are clamped to its borders.
+	class HeightMapSampler
+	{
+	public:
+		HeightMapSampler(const std::vector<float>& heightMap, uint32_t width, uint32_t height, float terrainWidth, float terrainDepth);
+
+		float SampleHeight(float x, float z) const;
+
+		// The positions are given as (x, z):
+		void SampleHeights(const DirectX::XMFLOAT2* positions, size_t count, float* heights) const;
+
+		// Also interpolates the normals of the normal map of the height map, normalizing them:
+		void SampleHeightsAndNormals(const DirectX::XMFLOAT2* positions, size_t count, const std::vector<DirectX::XMFLOAT4>& normalMap, float* heights, DirectX::XMFLOAT3* normals) const;
+
+	private:
+		// Calculates the index of the top left texel of the cell containing each of the four positions starting at first, and the
+		// position inside of the cell. The last position is repeated past the count:
+		void CalculateCells(const DirectX::XMFLOAT2* positions, size_t count, size_t first, size_t* topLeftIndices, DirectX::XMVECTOR& u, DirectX::XMVECTOR& v) const;
+
+		DirectX::XMVECTOR InterpolateHeights(const size_t* topLeftIndices, DirectX::FXMVECTOR u, DirectX::FXMVECTOR v) const;
+
+	private:
+		const std::vector<float>* m_heightMap;
+		uint32_t m_width;
+		uint32_t m_height;
+		float m_columnScale;
+		float m_rowScale;
+	};
+}
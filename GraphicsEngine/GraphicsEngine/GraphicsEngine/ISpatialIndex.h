@@ -0,0 +1,84 @@
+#pragma once
+
+#include <DirectXCollision.h>
+#include <array>
+#include <vector>
+
+#include "Common/ThreadPool.h"
+#include "Frustum.h"
+#include "FrustumCoherence.h"
+
+namespace GraphicsEngine
+{
+	// Spatial index which is built in bulk from a set of objects and queried with frustums.
+	// The objects must provide GetBounds() and Intersects(const Frustum&).
+	template<
+		typename Type
+	>
+		class ISpatialIndex
+	{
+	public:
+		struct RayHit
+		{
+			Type* Object;
+			float Distance;
+		};
+		struct NearestObject
+		{
+			Type* Object;
+			float DistanceSquared;
+		};
+
+	public:
+		virtual ~ISpatialIndex() = default;
+
+		// Replaces the content of the index:
+		virtual void Build(const std::vector<Type*>& objects) = 0;
+
+		// Same as above, but the work is split between the threads of the pool. Indices which can't build in parallel build serially:
+		virtual void Build(const std::vector<Type*>& objects, Common::ThreadPool&)
+		{
+			Build(objects);
+		}
+		virtual void Clear() = 0;
+
+		// Refits the nodes above an object of the index after its bounds changed, without rebuilding the index.
+		// Returns false if the object isn't in the index, or if the index can't keep its structure, in which case it must be rebuilt:
+		virtual bool UpdateObject(Type* object) = 0;
+
+		// Adds an object to a leaf of the index, or removes it, without rebuilding the index.
+		// Return false if the index can't keep its structure, in which case it must be rebuilt with the objects which changed:
+		virtual bool InsertObject(Type* object) = 0;
+		virtual bool RemoveObject(Type* object) = 0;
+
+		// Appends the objects which intersect the frustum to the output. Each object is added once.
+		virtual void CalculateIntersections(const Frustum& frustum, std::vector<Type*>& output) const = 0;
+
+		// Same as above, but the top level subtrees are traversed in parallel, each one writing into its own output:
+		virtual void CalculateIntersections(const Frustum& frustum, Common::ThreadPool& threadPool, std::array<std::vector<Type*>, 8>& outputs) const = 0;
+
+		// Same as above, but the nodes are tested in the order given by the results of the previous query of the viewer:
+		virtual void CalculateIntersections(const Frustum& frustum, FrustumCoherence& coherence, std::vector<Type*>& output) const = 0;
+		virtual void CalculateIntersections(const Frustum& frustum, FrustumCoherence& coherence, Common::ThreadPool& threadPool, std::array<std::vector<Type*>, 8>& outputs) const = 0;
+
+		// The following queries test the bounds of the objects and write into the buffers of the caller without allocating.
+		// They return the number of results, which may exceed the capacity of the buffer, in which case the rest are dropped.
+		virtual size_t CalculateIntersections(const DirectX::BoundingSphere& sphere, Type** output, size_t capacity) const = 0;
+		virtual size_t CalculateIntersections(const DirectX::BoundingBox& box, Type** output, size_t capacity) const = 0;
+
+		// Finds the closest object hit by the ray before the maximum distance:
+		virtual bool CalculateFirstRayHit(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, RayHit& hit) const = 0;
+
+		// Finds all the objects hit by the ray before the maximum distance, sorted by distance. If there are more than the capacity, the nearest ones are kept:
+		virtual size_t CalculateRayHits(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, RayHit* output, size_t capacity) const = 0;
+
+		// Finds up to count objects nearest to the position, sorted by distance, which is zero for the objects containing it:
+		virtual size_t CalculateNearestObjects(const DirectX::XMFLOAT3& position, NearestObject* output, size_t count) const = 0;
+
+		virtual size_t GetNodeCount() const = 0;
+		virtual size_t GetObjectCount() const = 0;
+
+		// Number of bytes allocated for the nodes and the object references:
+		virtual size_t GetMemoryUsage() const = 0;
+	};
+}
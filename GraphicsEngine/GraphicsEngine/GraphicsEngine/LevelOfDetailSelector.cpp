@@ -0,0 +1,57 @@
+#include "stdafx.h"
+#include "LevelOfDetailSelector.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace DirectX;
+using namespace GraphicsEngine;
+
+LevelOfDetailSelector::LevelOfDetailSelector() :
+	LevelOfDetailSelector({ 0.3f, 0.1f, 0.03f }, 0.15f)
+{
+}
+LevelOfDetailSelector::LevelOfDetailSelector(const std::array<float, MaxLevelCount - 1>& screenSizeThresholds, float hysteresis) :
+	m_screenSizeThresholds(screenSizeThresholds),
+	m_hysteresis(hysteresis)
+{
+}
+
+float LevelOfDetailSelector::CalculateScreenSize(const BoundingBox& bounds, FXMVECTOR cameraPosition, float projectionScale)
+{
+	auto radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Extents)));
+	auto distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&bounds.Center), cameraPosition)));
+
+	// The camera is inside of the bounds:
+	if (distance <= radius)
+		return std::numeric_limits<float>::max();
+
+	return projectionScale * radius / distance;
+}
+
+uint8_t LevelOfDetailSelector::Select(float screenSize, uint8_t currentLevel, size_t levelCount) const
+{
+	// Keep the current level while the screen size is inside of its band, widened by the hysteresis:
+	if (currentLevel < levelCount)
+	{
+		auto upperThreshold = GetUpperThreshold(currentLevel) * (1.0f + m_hysteresis);
+		auto lowerThreshold = GetLowerThreshold(currentLevel, levelCount) * (1.0f - m_hysteresis);
+		if (screenSize >= lowerThreshold && screenSize < upperThreshold)
+			return currentLevel;
+	}
+
+	size_t level = 0;
+	while (level + 1 < levelCount && screenSize < m_screenSizeThresholds[level])
+		++level;
+
+	return static_cast<uint8_t>(level);
+}
+
+float LevelOfDetailSelector::GetUpperThreshold(size_t level) const
+{
+	return level == 0 ? std::numeric_limits<float>::max() : m_screenSizeThresholds[level - 1];
+}
+float LevelOfDetailSelector::GetLowerThreshold(size_t level, size_t levelCount) const
+{
+	return level + 1 >= levelCount ? 0.0f : m_screenSizeThresholds[level];
+}
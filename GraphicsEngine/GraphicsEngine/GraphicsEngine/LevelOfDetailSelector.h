@@ -0,0 +1,35 @@
+#pragma once
+
+#include <DirectXCollision.h>
+#include <array>
+#include <cstdint>
+
+namespace GraphicsEngine
+{
+	// Selects the level of detail of instances from their size on the screen. The level i > 0 is used below the screen size threshold i - 1,
+	// and a band around each threshold keeps instances at their current level, so that they don't switch levels every frame when close to it.
+	class LevelOfDetailSelector
+	{
+	public:
+		static constexpr size_t MaxLevelCount = 4;
+
+	public:
+		LevelOfDetailSelector();
+		explicit LevelOfDetailSelector(const std::array<float, MaxLevelCount - 1>& screenSizeThresholds, float hysteresis);
+
+		// Ratio between the projected diameter of the bounds and the height of the screen, where the projection scale is
+		// the element (1, 1) of the projection matrix:
+		static float CalculateScreenSize(const DirectX::BoundingBox& bounds, DirectX::FXMVECTOR cameraPosition, float projectionScale);
+
+		// Returns the level for the screen size, given the level of the previous frame, or levelCount if there is none:
+		uint8_t Select(float screenSize, uint8_t currentLevel, size_t levelCount) const;
+
+	private:
+		float GetUpperThreshold(size_t level) const;
+		float GetLowerThreshold(size_t level, size_t levelCount) const;
+
+	private:
+		std::array<float, MaxLevelCount - 1> m_screenSizeThresholds;
+		float m_hysteresis;
+	};
+}
@@ -0,0 +1,638 @@
+#pragma once
+
+#include <DirectXCollision.h>
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "ISpatialIndex.h"
+#include "SpatialIndexQueries.h"
+
+namespace GraphicsEngineTester
+{
+	class LinearOctreeTest;
+}
+
+namespace GraphicsEngine
+{
+	// Octree built in bulk, whose nodes are stored contiguously and reference their children by index.
+	// Objects are sorted by the Morton code of their centers, so the objects of any subtree form a contiguous range of
+	// a single shared array. Each object belongs to exactly one node and node bounds are fitted to their objects.
+	template<
+		typename Type
+	>
+		class LinearOctree : public ISpatialIndex<Type>
+	{
+		friend class GraphicsEngineTester::LinearOctreeTest;
+
+	public:
+		static constexpr uint32_t MaxDepth = 10;
+
+		// Depth at which the parallel build hands the subtrees over to the workers, which gives up to 64 tasks:
+		static constexpr uint32_t TaskDepth = 2;
+
+	private:
+		struct Node
+		{
+			DirectX::BoundingBox Bounds;
+			uint32_t FirstChild;
+			uint32_t ChildCount;
+
+			// Range of the objects of the whole subtree:
+			uint32_t FirstObject;
+			uint32_t ObjectCount;
+		};
+		struct MortonObject
+		{
+			uint32_t Code;
+			Type* Object;
+		};
+		// Subtree built by a worker into its own nodes, which are appended to the octree afterwards:
+		struct SubtreeTask
+		{
+			uint32_t NodeIndex;
+			uint32_t Begin;
+			uint32_t End;
+			DirectX::XMFLOAT3 Extents;
+		};
+
+		using Queries = SpatialIndexQueries<Type, Node>;
+
+	public:
+		using RayHit = typename ISpatialIndex<Type>::RayHit;
+		using NearestObject = typename ISpatialIndex<Type>::NearestObject;
+
+		explicit LinearOctree(size_t objectsPerLeaf, const DirectX::BoundingBox& boundingBox, const DirectX::XMFLOAT3& minExtents) :
+			m_boundingBox(boundingBox),
+			m_objectsPerLeaf(objectsPerLeaf),
+			m_minExtents(minExtents)
+		{
+		}
+
+		// Replaces the content of the octree. Objects which don't intersect with the bounding box are ignored.
+		void Build(const std::vector<Type*>& objects) override
+		{
+			m_nodes.clear();
+			m_objects.clear();
+			m_objectSlots.clear();
+
+			m_mortonObjects.resize(objects.size());
+			CalculateMortonCodes(objects, 0, objects.size());
+			CompactMortonCodes();
+			SortByMortonCode();
+
+			if (m_mortonObjects.empty())
+				return;
+
+			m_objects.reserve(m_mortonObjects.size());
+			m_objectSlots.reserve(m_mortonObjects.size());
+			for (const auto& mortonObject : m_mortonObjects)
+			{
+				m_objectSlots.emplace(mortonObject.Object, static_cast<uint32_t>(m_objects.size()));
+				m_objects.push_back(mortonObject.Object);
+			}
+
+			m_nodes.emplace_back();
+			BuildNode(m_nodes, 0, 0, static_cast<uint32_t>(m_objects.size()), 0, m_boundingBox.Extents, nullptr);
+		}
+
+		// Same as above, but the Morton codes are calculated in parallel, and the subtrees below the task depth are built
+		// in parallel, each worker writing into its own nodes. The result is the same as the serial build.
+		void Build(const std::vector<Type*>& objects, Common::ThreadPool& threadPool) override
+		{
+			static constexpr size_t objectsPerTask = 16384;
+
+			m_nodes.clear();
+			m_objects.clear();
+			m_objectSlots.clear();
+
+			auto objectTaskCount = (objects.size() + objectsPerTask - 1) / objectsPerTask;
+			m_mortonObjects.resize(objects.size());
+			threadPool.ParallelFor(objectTaskCount, [this, &objects](size_t taskIndex)
+			{
+				auto begin = taskIndex * objectsPerTask;
+				CalculateMortonCodes(objects, begin, std::min(begin + objectsPerTask, objects.size()));
+			});
+			CompactMortonCodes();
+			SortByMortonCode();
+
+			if (m_mortonObjects.empty())
+				return;
+
+			m_objects.resize(m_mortonObjects.size());
+			threadPool.ParallelFor(objectTaskCount, [this](size_t taskIndex)
+			{
+				auto begin = taskIndex * objectsPerTask;
+				auto end = std::min(begin + objectsPerTask, m_mortonObjects.size());
+				for (auto i = begin; i < end; ++i)
+					m_objects[i] = m_mortonObjects[i].Object;
+			});
+
+			// The map isn't thread safe, so the slots are filled serially:
+			m_objectSlots.reserve(m_objects.size());
+			for (size_t i = 0; i < m_objects.size(); ++i)
+				m_objectSlots.emplace(m_objects[i], static_cast<uint32_t>(i));
+
+			// Build the top levels, collecting the subtrees below them:
+			m_subtreeTasks.clear();
+			m_nodes.emplace_back();
+			BuildNode(m_nodes, 0, 0, static_cast<uint32_t>(m_objects.size()), 0, m_boundingBox.Extents, &m_subtreeTasks);
+			if (m_subtreeTasks.empty())
+				return;
+
+			// Start with the largest subtrees, so that the workers finish at about the same time:
+			std::sort(m_subtreeTasks.begin(), m_subtreeTasks.end(), [](const SubtreeTask& task0, const SubtreeTask& task1)
+			{
+				return task0.End - task0.Begin > task1.End - task1.Begin;
+			});
+			if (m_subtreeNodes.size() < m_subtreeTasks.size())
+				m_subtreeNodes.resize(m_subtreeTasks.size());
+			threadPool.ParallelFor(m_subtreeTasks.size(), [this](size_t taskIndex)
+			{
+				const auto& task = m_subtreeTasks[taskIndex];
+				auto& nodes = m_subtreeNodes[taskIndex];
+				nodes.clear();
+				nodes.emplace_back();
+				BuildNode(nodes, 0, task.Begin, task.End, TaskDepth, task.Extents, nullptr);
+			});
+
+			// Append the nodes of each subtree. The root of a subtree replaces the node it was built for, so the indices of the
+			// other nodes are shifted past the nodes which are already in the octree, minus one:
+			auto topNodeCount = static_cast<uint32_t>(m_nodes.size());
+			auto nodeCount = m_nodes.size();
+			for (size_t taskIndex = 0; taskIndex < m_subtreeTasks.size(); ++taskIndex)
+				nodeCount += m_subtreeNodes[taskIndex].size() - 1;
+			m_nodes.reserve(nodeCount);
+			for (size_t taskIndex = 0; taskIndex < m_subtreeTasks.size(); ++taskIndex)
+			{
+				const auto& nodes = m_subtreeNodes[taskIndex];
+				auto offset = static_cast<uint32_t>(m_nodes.size()) - 1;
+
+				auto& root = m_nodes[m_subtreeTasks[taskIndex].NodeIndex];
+				root = nodes[0];
+				root.FirstChild += offset;
+				for (size_t i = 1; i < nodes.size(); ++i)
+				{
+					m_nodes.push_back(nodes[i]);
+					if (nodes[i].ChildCount != 0)
+						m_nodes.back().FirstChild += offset;
+				}
+			}
+
+			// The top levels were fitted before their subtrees were built, so fit them again. Children come after their parent,
+			// and only the nodes above the subtrees have their children among the top nodes:
+			for (auto nodeIndex = topNodeCount; nodeIndex-- > 0;)
+			{
+				auto& node = m_nodes[nodeIndex];
+				if (node.ChildCount != 0 && node.FirstChild < topNodeCount)
+					FitToChildren(m_nodes, nodeIndex);
+			}
+		}
+		void Clear() override
+		{
+			m_nodes.clear();
+			m_objects.clear();
+			m_objectSlots.clear();
+		}
+
+		// Refits the nodes above the object, as long as its center stays in the octant of its leaf. Otherwise the object belongs
+		// to another node, and the octree must be rebuilt:
+		bool UpdateObject(Type* object) override
+		{
+			auto objectSlot = m_objectSlots.find(object);
+			if (objectSlot == m_objectSlots.end())
+				return false;
+
+			auto objectIndex = objectSlot->second;
+
+			const auto& bounds = object->GetBounds();
+			if (!m_boundingBox.Intersects(bounds))
+				return false;
+
+			// The depth of the leaf gives the number of octants encoded by the Morton code:
+			Queries::FindLeafPath(m_nodes, objectIndex, m_updatePath);
+			auto shift = 3 * (MaxDepth - static_cast<uint32_t>(m_updatePath.size() - 1));
+			DirectX::XMVECTOR minimum, scale;
+			GetMortonGrid(minimum, scale);
+			auto code = CalculateMortonCode(bounds.Center, minimum, scale);
+			auto& mortonObject = m_mortonObjects[objectIndex];
+			if ((code >> shift) != (mortonObject.Code >> shift))
+				return false;
+
+			mortonObject.Code = code;
+			Queries::RefitPath(m_nodes, m_objects, m_updatePath);
+			return true;
+		}
+
+		// Adds the object to the leaf of the octants of its center. If one of them has no node, or if the leaf has grown to twice
+		// the objects which the build would keep in it, the octree must be rebuilt:
+		bool InsertObject(Type* object) override
+		{
+			using namespace DirectX;
+
+			const auto& bounds = object->GetBounds();
+			if (m_nodes.empty() || !m_boundingBox.Intersects(bounds) || m_objectSlots.count(object) != 0)
+				return false;
+
+			XMVECTOR minimum, scale;
+			GetMortonGrid(minimum, scale);
+			auto code = CalculateMortonCode(bounds.Center, minimum, scale);
+
+			// The objects of a node share the octants of their codes down to its depth, so its first object gives its octant:
+			m_updatePath.clear();
+			m_updatePath.push_back(0);
+			while (m_nodes[m_updatePath.back()].ChildCount != 0)
+			{
+				const auto& node = m_nodes[m_updatePath.back()];
+				auto shift = 3 * (MaxDepth - static_cast<uint32_t>(m_updatePath.size()));
+				auto childIndex = node.FirstChild;
+				while (childIndex < node.FirstChild + node.ChildCount && (m_mortonObjects[m_nodes[childIndex].FirstObject].Code >> shift) != (code >> shift))
+					++childIndex;
+
+				if (childIndex == node.FirstChild + node.ChildCount)
+					return false;
+
+				m_updatePath.push_back(childIndex);
+			}
+
+			auto depth = static_cast<uint32_t>(m_updatePath.size() - 1);
+			auto scaleFactor = 1.0f / static_cast<float>(1u << depth);
+			XMFLOAT3 leafExtents(m_boundingBox.Extents.x * scaleFactor, m_boundingBox.Extents.y * scaleFactor, m_boundingBox.Extents.z * scaleFactor);
+			if (m_nodes[m_updatePath.back()].ObjectCount >= 2 * m_objectsPerLeaf && depth < MaxDepth && !IsSmall(leafExtents))
+				return false;
+
+			auto objectIndex = Queries::InsertObject(m_nodes, m_objects, m_updatePath, object);
+			m_mortonObjects.insert(m_mortonObjects.begin() + objectIndex, { code, object });
+			Queries::UpdateObjectSlots(m_objects, objectIndex, m_objectSlots);
+			return true;
+		}
+
+		// Removes the object from its leaf, keeping the order of the other objects. Leaves can't be emptied, so the octree must be
+		// rebuilt to remove their last object:
+		bool RemoveObject(Type* object) override
+		{
+			auto objectSlot = m_objectSlots.find(object);
+			if (objectSlot == m_objectSlots.end())
+				return false;
+
+			auto objectIndex = objectSlot->second;
+			Queries::FindLeafPath(m_nodes, objectIndex, m_updatePath);
+			if (m_nodes[m_updatePath.back()].ObjectCount == 1)
+				return false;
+
+			Queries::RemoveObject(m_nodes, m_objects, m_updatePath, objectIndex);
+			m_mortonObjects.erase(m_mortonObjects.begin() + objectIndex);
+			m_objectSlots.erase(objectSlot);
+			Queries::UpdateObjectSlots(m_objects, objectIndex, m_objectSlots);
+			return true;
+		}
+
+		// Appends the objects which intersect the frustum to the output:
+		void CalculateIntersections(const Frustum& frustum, std::vector<Type*>& output) const override
+		{
+			CalculateIntersections(frustum, nullptr, output);
+		}
+		void CalculateIntersections(const Frustum& frustum, FrustumCoherence& coherence, std::vector<Type*>& output) const override
+		{
+			CalculateIntersections(frustum, &coherence, output);
+		}
+
+		// Same as above, but the children of the root node are traversed in parallel, each one writing into its own output:
+		void CalculateIntersections(const Frustum& frustum, Common::ThreadPool& threadPool, std::array<std::vector<Type*>, 8>& outputs) const override
+		{
+			CalculateIntersections(frustum, nullptr, threadPool, outputs);
+		}
+		void CalculateIntersections(const Frustum& frustum, FrustumCoherence& coherence, Common::ThreadPool& threadPool, std::array<std::vector<Type*>, 8>& outputs) const override
+		{
+			CalculateIntersections(frustum, &coherence, threadPool, outputs);
+		}
+
+		size_t CalculateIntersections(const DirectX::BoundingSphere& sphere, Type** output, size_t capacity) const override
+		{
+			return Queries::CalculateIntersections(m_nodes, m_objects, sphere, output, capacity);
+		}
+		size_t CalculateIntersections(const DirectX::BoundingBox& box, Type** output, size_t capacity) const override
+		{
+			return Queries::CalculateIntersections(m_nodes, m_objects, box, output, capacity);
+		}
+		bool CalculateFirstRayHit(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, RayHit& hit) const override
+		{
+			return Queries::CalculateFirstRayHit(m_nodes, m_objects, origin, direction, maxDistance, hit);
+		}
+		size_t CalculateRayHits(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, RayHit* output, size_t capacity) const override
+		{
+			return Queries::CalculateRayHits(m_nodes, m_objects, origin, direction, maxDistance, output, capacity);
+		}
+		size_t CalculateNearestObjects(const DirectX::XMFLOAT3& position, NearestObject* output, size_t count) const override
+		{
+			return Queries::CalculateNearestObjects(m_nodes, m_objects, position, output, count);
+		}
+
+		size_t GetNodeCount() const override
+		{
+			return m_nodes.size();
+		}
+		size_t GetObjectCount() const override
+		{
+			return m_objects.size();
+		}
+		size_t GetMemoryUsage() const override
+		{
+			return m_nodes.capacity() * sizeof(Node) + m_objects.capacity() * sizeof(Type*);
+		}
+
+	private:
+		// Writes the Morton codes of a range of objects into the same range of the Morton objects, which must be large enough.
+		// Objects which don't intersect with the bounding box are written without object and removed by CompactMortonCodes:
+		void CalculateMortonCodes(const std::vector<Type*>& objects, size_t begin, size_t end)
+		{
+			using namespace DirectX;
+
+			XMVECTOR minimum, scale;
+			GetMortonGrid(minimum, scale);
+			for (auto i = begin; i < end; ++i)
+			{
+				auto object = objects[i];
+				const auto& bounds = object->GetBounds();
+				if (!m_boundingBox.Intersects(bounds))
+				{
+					m_mortonObjects[i] = { 0, nullptr };
+					continue;
+				}
+
+				m_mortonObjects[i] = { CalculateMortonCode(bounds.Center, minimum, scale), object };
+			}
+		}
+		// Maps the bounding box into the grid of the deepest level:
+		void GetMortonGrid(DirectX::XMVECTOR& minimum, DirectX::XMVECTOR& scale) const
+		{
+			using namespace DirectX;
+
+			static const auto cellCount = static_cast<float>(1u << MaxDepth);
+			auto extents = XMLoadFloat3(&m_boundingBox.Extents);
+			minimum = XMVectorSubtract(XMLoadFloat3(&m_boundingBox.Center), extents);
+			scale = XMVectorDivide(XMVectorReplicate(cellCount * 0.5f), extents);
+		}
+		static uint32_t CalculateMortonCode(const DirectX::XMFLOAT3& center, DirectX::FXMVECTOR minimum, DirectX::FXMVECTOR scale)
+		{
+			using namespace DirectX;
+
+			// Objects which are partially outside are clamped to the border cells:
+			static const auto maximumCell = static_cast<float>((1u << MaxDepth) - 1);
+			auto cell = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&center), minimum), scale);
+			cell = XMVectorClamp(cell, XMVectorZero(), XMVectorReplicate(maximumCell));
+
+			XMFLOAT3 cellCoordinates;
+			XMStoreFloat3(&cellCoordinates, cell);
+			return
+				(ExpandBits(static_cast<uint32_t>(cellCoordinates.x)) << 2) |
+				(ExpandBits(static_cast<uint32_t>(cellCoordinates.y)) << 1) |
+				ExpandBits(static_cast<uint32_t>(cellCoordinates.z));
+		}
+		void CompactMortonCodes()
+		{
+			auto end = std::remove_if(m_mortonObjects.begin(), m_mortonObjects.end(), [](const MortonObject& mortonObject) { return mortonObject.Object == nullptr; });
+			m_mortonObjects.erase(end, m_mortonObjects.end());
+		}
+		void SortByMortonCode()
+		{
+			// Least significant digit radix sort, MaxDepth bits per pass, which keeps the order of equal codes:
+			static constexpr uint32_t bucketCount = 1u << MaxDepth;
+			static constexpr uint32_t bucketMask = bucketCount - 1;
+
+			m_sortBuffer.resize(m_mortonObjects.size());
+			std::vector<uint32_t> bucketOffsets(bucketCount);
+			for (uint32_t shift = 0; shift < 3 * MaxDepth; shift += MaxDepth)
+			{
+				std::fill(bucketOffsets.begin(), bucketOffsets.end(), 0);
+				for (const auto& mortonObject : m_mortonObjects)
+					++bucketOffsets[(mortonObject.Code >> shift) & bucketMask];
+
+				uint32_t offset = 0;
+				for (auto& bucketOffset : bucketOffsets)
+				{
+					auto count = bucketOffset;
+					bucketOffset = offset;
+					offset += count;
+				}
+
+				for (const auto& mortonObject : m_mortonObjects)
+					m_sortBuffer[bucketOffsets[(mortonObject.Code >> shift) & bucketMask]++] = mortonObject;
+
+				m_mortonObjects.swap(m_sortBuffer);
+			}
+		}
+		// Builds the subtree of a node into the given nodes. If subtree tasks are given, the nodes at the task depth which
+		// must be divided are left for the workers, with their range of objects:
+		void BuildNode(std::vector<Node>& nodes, uint32_t nodeIndex, uint32_t begin, uint32_t end, uint32_t depth, const DirectX::XMFLOAT3& extents, std::vector<SubtreeTask>* subtreeTasks) const
+		{
+			using namespace DirectX;
+
+			{
+				auto& node = nodes[nodeIndex];
+				node.FirstChild = 0;
+				node.ChildCount = 0;
+				node.FirstObject = begin;
+				node.ObjectCount = end - begin;
+			}
+
+			// If the node has few objects, or if it can't be divided further, it is a leaf:
+			if (end - begin <= m_objectsPerLeaf || depth == MaxDepth || IsSmall(extents))
+			{
+				auto minimum = XMVectorReplicate(FLT_MAX);
+				auto maximum = XMVectorReplicate(-FLT_MAX);
+				for (auto i = begin; i < end; ++i)
+				{
+					const auto& bounds = m_objects[i]->GetBounds();
+					auto center = XMLoadFloat3(&bounds.Center);
+					auto objectExtents = XMLoadFloat3(&bounds.Extents);
+					minimum = XMVectorMin(minimum, XMVectorSubtract(center, objectExtents));
+					maximum = XMVectorMax(maximum, XMVectorAdd(center, objectExtents));
+				}
+				BoundingBox::CreateFromPoints(nodes[nodeIndex].Bounds, minimum, maximum);
+				return;
+			}
+
+			if (subtreeTasks != nullptr && depth == TaskDepth)
+			{
+				subtreeTasks->push_back({ nodeIndex, begin, end, extents });
+				return;
+			}
+
+			// Objects are sorted, so the objects of each octant are contiguous:
+			auto shift = 3 * (MaxDepth - 1 - depth);
+			std::array<uint32_t, 9> octantRanges;
+			octantRanges[0] = begin;
+			for (uint32_t octant = 0; octant < 8; ++octant)
+			{
+				auto octantEnd = octantRanges[octant];
+				while (octantEnd < end && ((m_mortonObjects[octantEnd].Code >> shift) & 7) == octant)
+					++octantEnd;
+				octantRanges[octant + 1] = octantEnd;
+			}
+
+			// Create the non empty children next to each other:
+			auto firstChild = static_cast<uint32_t>(nodes.size());
+			uint32_t childCount = 0;
+			for (uint32_t octant = 0; octant < 8; ++octant)
+			{
+				if (octantRanges[octant] != octantRanges[octant + 1])
+					++childCount;
+			}
+			nodes.resize(nodes.size() + childCount);
+			nodes[nodeIndex].FirstChild = firstChild;
+			nodes[nodeIndex].ChildCount = childCount;
+
+			XMFLOAT3 childExtents(extents.x * 0.5f, extents.y * 0.5f, extents.z * 0.5f);
+			auto childIndex = firstChild;
+			for (uint32_t octant = 0; octant < 8; ++octant)
+			{
+				if (octantRanges[octant] != octantRanges[octant + 1])
+					BuildNode(nodes, childIndex++, octantRanges[octant], octantRanges[octant + 1], depth + 1, childExtents, subtreeTasks);
+			}
+
+			FitToChildren(nodes, nodeIndex);
+		}
+		static void FitToChildren(std::vector<Node>& nodes, uint32_t nodeIndex)
+		{
+			using namespace DirectX;
+
+			const auto& node = nodes[nodeIndex];
+			auto bounds = nodes[node.FirstChild].Bounds;
+			for (auto i = node.FirstChild + 1; i < node.FirstChild + node.ChildCount; ++i)
+				BoundingBox::CreateMerged(bounds, bounds, nodes[i].Bounds);
+			nodes[nodeIndex].Bounds = bounds;
+		}
+
+		void CalculateIntersections(const Frustum& frustum, FrustumCoherence* coherence, std::vector<Type*>& output) const
+		{
+			if (coherence != nullptr)
+				coherence->BeginQuery(m_nodes.size());
+
+			if (m_nodes.empty())
+				return;
+
+			FrustumCoherence::Statistics statistics;
+			CalculateIntersections(frustum, 0, Frustum::AllPlanesMask, coherence, statistics, output);
+
+			if (coherence != nullptr)
+				coherence->AddStatistics(statistics);
+		}
+		void CalculateIntersections(const Frustum& frustum, FrustumCoherence* coherence, Common::ThreadPool& threadPool, std::array<std::vector<Type*>, 8>& outputs) const
+		{
+			for (auto& output : outputs)
+				output.clear();
+
+			if (coherence != nullptr)
+				coherence->BeginQuery(m_nodes.size());
+
+			if (m_nodes.empty())
+				return;
+
+			// Each subtree collects its own statistics, which are merged at the end:
+			std::array<FrustumCoherence::Statistics, 8> statistics;
+			const auto& root = m_nodes[0];
+			if (root.ChildCount == 0)
+			{
+				CalculateIntersections(frustum, 0, Frustum::AllPlanesMask, coherence, statistics[0], outputs[0]);
+			}
+			else
+			{
+				// The children only test the planes which the root crosses:
+				auto planeMask = Frustum::AllPlanesMask;
+				if (TestNode(frustum, 0, planeMask, coherence, statistics[0]) != DirectX::ContainmentType::DISJOINT)
+				{
+					threadPool.ParallelFor(root.ChildCount, [this, &frustum, coherence, &root, planeMask, &statistics, &outputs](size_t childIndex)
+					{
+						CalculateIntersections(frustum, root.FirstChild + static_cast<uint32_t>(childIndex), planeMask, coherence, statistics[childIndex], outputs[childIndex]);
+					});
+				}
+			}
+
+			if (coherence != nullptr)
+			{
+				for (const auto& subtreeStatistics : statistics)
+					coherence->AddStatistics(subtreeStatistics);
+			}
+		}
+		void CalculateIntersections(const Frustum& frustum, uint32_t nodeIndex, uint32_t planeMask, FrustumCoherence* coherence, FrustumCoherence::Statistics& statistics, std::vector<Type*>& output) const
+		{
+			using namespace DirectX;
+
+			const auto& node = m_nodes[nodeIndex];
+
+			// Skip the node if it is outside of the frustum:
+			auto containment = TestNode(frustum, nodeIndex, planeMask, coherence, statistics);
+			if (containment == ContainmentType::DISJOINT)
+				return;
+
+			// If the node is completely inside, all of the objects of its subtree are visible:
+			auto firstObject = m_objects.begin() + node.FirstObject;
+			if (containment == ContainmentType::CONTAINS)
+			{
+				output.insert(output.end(), firstObject, firstObject + node.ObjectCount);
+				return;
+			}
+
+			if (node.ChildCount != 0)
+			{
+				for (auto i = node.FirstChild; i < node.FirstChild + node.ChildCount; ++i)
+					CalculateIntersections(frustum, i, planeMask, coherence, statistics, output);
+			}
+			else
+			{
+				for (auto object = firstObject; object != firstObject + node.ObjectCount; ++object)
+				{
+					if ((*object)->Intersects(frustum))
+						output.push_back(*object);
+				}
+			}
+		}
+		DirectX::ContainmentType TestNode(const Frustum& frustum, uint32_t nodeIndex, uint32_t& planeMask, FrustumCoherence* coherence, FrustumCoherence::Statistics& statistics) const
+		{
+			// Without a viewer state, the planes are tested in their default order:
+			uint8_t firstPlane = 0;
+			auto& nodeFirstPlane = coherence != nullptr ? coherence->GetFirstPlane(nodeIndex) : firstPlane;
+
+			++statistics.BoxTests;
+			return frustum.Contains(m_nodes[nodeIndex].Bounds, planeMask, nodeFirstPlane, statistics.PlaneTests, statistics.IndependentPlaneTests);
+		}
+
+		bool IsSmall(const DirectX::XMFLOAT3& extents) const
+		{
+			return extents.x <= m_minExtents.x || extents.y <= m_minExtents.y || extents.z <= m_minExtents.z;
+		}
+
+		// Inserts two zero bits between each of the lower 10 bits:
+		static uint32_t ExpandBits(uint32_t value)
+		{
+			value = (value * 0x00010001u) & 0xFF0000FFu;
+			value = (value * 0x00000101u) & 0x0F00F00Fu;
+			value = (value * 0x00000011u) & 0xC30C30C3u;
+			value = (value * 0x00000005u) & 0x49249249u;
+			return value;
+		}
+
+	private:
+		DirectX::BoundingBox m_boundingBox;
+		size_t m_objectsPerLeaf;
+		DirectX::XMFLOAT3 m_minExtents;
+
+		std::vector<Node> m_nodes;
+		std::vector<Type*> m_objects;
+
+		// Kept between builds to avoid reallocations:
+		std::vector<MortonObject> m_mortonObjects;
+		std::vector<MortonObject> m_sortBuffer;
+		std::vector<SubtreeTask> m_subtreeTasks;
+		std::vector<std::vector<Node>> m_subtreeNodes;
+		std::vector<uint32_t> m_updatePath;
+
+		// Position of each object in the objects of the index, so that it can be found when it moves. The slots belong to the
+		// index, so several indices can be built from the same objects:
+		std::unordered_map<const Type*, uint32_t> m_objectSlots;
+	};
+}
@@ -0,0 +1,281 @@
+#include "stdafx.h"
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <limits>
+#include <unordered_map>
+
+using namespace DirectX;
+using namespace GraphicsEngine;
+
+namespace
+{
+	uint64_t CreateEdgeKey(uint32_t vertex0, uint32_t vertex1)
+	{
+		return vertex0 < vertex1 ? (static_cast<uint64_t>(vertex0) << 32) | vertex1 : (static_cast<uint64_t>(vertex1) << 32) | vertex0;
+	}
+
+	XMVECTOR CalculateTriangleNormal(const XMFLOAT3& position0, const XMFLOAT3& position1, const XMFLOAT3& position2)
+	{
+		auto point0 = XMLoadFloat3(&position0);
+		return XMVector3Cross(XMVectorSubtract(XMLoadFloat3(&position1), point0), XMVectorSubtract(XMLoadFloat3(&position2), point0));
+	}
+}
+
+std::vector<uint32_t> MeshSimplifier::Simplify(const std::vector<XMFLOAT3>& positions, const std::vector<uint32_t>& indices, size_t targetIndexCount, float maxError, const AttributesEqualFunctionType& attributesEqual)
+{
+	auto vertexCount = positions.size();
+
+	// Weld the vertices with the same position and attributes into the first of them. The welded vertices sharing a position
+	// lie on an attribute seam, and are locked. Topology and quadrics use the first vertex of each position, so that the triangles
+	// on both sides of a seam are connected:
+	std::vector<uint32_t> weldedVertices(vertexCount);
+	std::vector<uint32_t> positionVertices(vertexCount);
+	std::vector<bool> lockedVertices(vertexCount, false);
+	{
+		struct PositionHash
+		{
+			size_t operator()(const XMFLOAT3& position) const
+			{
+				std::hash<float> hash;
+				return hash(position.x) ^ (hash(position.y) * 31) ^ (hash(position.z) * 961);
+			}
+		};
+		struct PositionEqual
+		{
+			bool operator()(const XMFLOAT3& position0, const XMFLOAT3& position1) const
+			{
+				return position0.x == position1.x && position0.y == position1.y && position0.z == position1.z;
+			}
+		};
+		std::unordered_map<XMFLOAT3, std::vector<uint32_t>, PositionHash, PositionEqual> weldedVerticesByPosition;
+		for (uint32_t vertex = 0; vertex < vertexCount; ++vertex)
+		{
+			auto& samePositionVertices = weldedVerticesByPosition[positions[vertex]];
+			positionVertices[vertex] = samePositionVertices.empty() ? vertex : samePositionVertices[0];
+
+			auto location = std::find_if(samePositionVertices.begin(), samePositionVertices.end(), [&attributesEqual, vertex](uint32_t weldedVertex) { return attributesEqual(weldedVertex, vertex); });
+			if (location != samePositionVertices.end())
+			{
+				weldedVertices[vertex] = *location;
+				continue;
+			}
+
+			weldedVertices[vertex] = vertex;
+			samePositionVertices.push_back(vertex);
+		}
+
+		for (const auto& location : weldedVerticesByPosition)
+		{
+			if (location.second.size() < 2)
+				continue;
+
+			for (auto vertex : location.second)
+				lockedVertices[vertex] = true;
+		}
+	}
+
+	std::vector<uint32_t> result(indices.size());
+	for (size_t i = 0; i < indices.size(); ++i)
+		result[i] = weldedVertices[indices[i]];
+
+	// Accumulate the planes of the triangles around each position, weighted by their area:
+	std::vector<Quadric> quadrics(vertexCount, Quadric());
+	std::unordered_map<uint64_t, uint32_t> edgeTriangleCounts;
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		auto normal = CalculateTriangleNormal(positions[result[i]], positions[result[i + 1]], positions[result[i + 2]]);
+		auto area = XMVectorGetX(XMVector3Length(normal));
+		if (area == 0.0f)
+			continue;
+
+		XMFLOAT3 unitNormal;
+		XMStoreFloat3(&unitNormal, XMVectorScale(normal, 1.0f / area));
+		const auto& point = positions[result[i]];
+		auto distance = -(unitNormal.x * point.x + unitNormal.y * point.y + unitNormal.z * point.z);
+		auto quadric = Quadric::FromPlane(unitNormal.x, unitNormal.y, unitNormal.z, distance, 0.5 * area);
+		for (size_t corner = 0; corner < 3; ++corner)
+		{
+			quadrics[positionVertices[result[i + corner]]] += quadric;
+			++edgeTriangleCounts[CreateEdgeKey(positionVertices[result[i + corner]], positionVertices[result[i + (corner + 1) % 3]])];
+		}
+	}
+
+	// Keep the border edges in place with planes perpendicular to their triangles:
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		for (size_t corner = 0; corner < 3; ++corner)
+		{
+			auto vertex0 = result[i + corner];
+			auto vertex1 = result[i + (corner + 1) % 3];
+			if (edgeTriangleCounts[CreateEdgeKey(positionVertices[vertex0], positionVertices[vertex1])] != 1)
+				continue;
+
+			auto point0 = XMLoadFloat3(&positions[vertex0]);
+			auto edge = XMVectorSubtract(XMLoadFloat3(&positions[vertex1]), point0);
+			auto normal = XMVector3Cross(edge, CalculateTriangleNormal(positions[result[i]], positions[result[i + 1]], positions[result[i + 2]]));
+			if (XMVectorGetX(XMVector3LengthSq(normal)) == 0.0f)
+				continue;
+
+			XMFLOAT3 unitNormal;
+			XMStoreFloat3(&unitNormal, XMVector3Normalize(normal));
+			auto distance = -XMVectorGetX(XMVector3Dot(XMLoadFloat3(&unitNormal), point0));
+			auto quadric = Quadric::FromPlane(unitNormal.x, unitNormal.y, unitNormal.z, distance, 10.0 * XMVectorGetX(XMVector3LengthSq(edge)));
+			quadrics[positionVertices[vertex0]] += quadric;
+			quadrics[positionVertices[vertex1]] += quadric;
+		}
+	}
+
+	// Collapse the cheapest edges in passes, in which the collapsed vertices don't share any triangle:
+	auto maxCost = static_cast<double>(maxError) * maxError;
+	std::vector<uint32_t> triangleOffsets(vertexCount + 1);
+	std::vector<uint32_t> vertexTriangles;
+	std::vector<Collapse> collapses;
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<bool> touchedVertices(vertexCount);
+	while (result.size() > targetIndexCount)
+	{
+		// Build the list of triangles around each vertex:
+		std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+		for (auto vertex : result)
+			++triangleOffsets[vertex + 1];
+		for (size_t vertex = 0; vertex < vertexCount; ++vertex)
+			triangleOffsets[vertex + 1] += triangleOffsets[vertex];
+		vertexTriangles.resize(result.size());
+		{
+			auto insertPositions = triangleOffsets;
+			for (size_t i = 0; i < result.size(); ++i)
+				vertexTriangles[insertPositions[result[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		// Find the cheapest direction in which each edge can collapse, edges shared by two triangles being found twice:
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (size_t corner = 0; corner < 3; ++corner)
+			{
+				auto vertex0 = result[i + corner];
+				auto vertex1 = result[i + (corner + 1) % 3];
+
+				auto quadric = quadrics[positionVertices[vertex0]];
+				quadric += quadrics[positionVertices[vertex1]];
+				auto cost0 = lockedVertices[vertex0] ? std::numeric_limits<double>::max() : quadric.Evaluate(positions[vertex1]);
+				auto cost1 = lockedVertices[vertex1] ? std::numeric_limits<double>::max() : quadric.Evaluate(positions[vertex0]);
+				if (cost0 <= cost1 && cost0 <= maxCost)
+					collapses.push_back({ cost0, vertex0, vertex1 });
+				else if (cost1 < cost0 && cost1 <= maxCost)
+					collapses.push_back({ cost1, vertex1, vertex0 });
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& collapse0, const Collapse& collapse1) { return collapse0.Cost < collapse1.Cost; });
+
+		// Collapse edges until enough triangles are removed:
+		for (uint32_t vertex = 0; vertex < vertexCount; ++vertex)
+			remap[vertex] = vertex;
+		std::fill(touchedVertices.begin(), touchedVertices.end(), false);
+		auto trianglesToRemove = (result.size() - targetIndexCount + 2) / 3;
+		size_t removedTriangles = 0;
+		for (const auto& collapse : collapses)
+		{
+			if (touchedVertices[collapse.From] || touchedVertices[collapse.To])
+				continue;
+
+			// Reject collapses which would flip a triangle around the collapsed vertex:
+			auto flips = false;
+			size_t sharedTriangles = 0;
+			for (auto offset = triangleOffsets[collapse.From]; offset < triangleOffsets[collapse.From + 1] && !flips; ++offset)
+			{
+				const auto* triangle = &result[3 * vertexTriangles[offset]];
+				if (triangle[0] == collapse.To || triangle[1] == collapse.To || triangle[2] == collapse.To)
+				{
+					++sharedTriangles;
+					continue;
+				}
+
+				std::array<XMFLOAT3, 3> newPositions;
+				for (size_t corner = 0; corner < 3; ++corner)
+					newPositions[corner] = positions[triangle[corner] == collapse.From ? collapse.To : triangle[corner]];
+
+				auto oldNormal = CalculateTriangleNormal(positions[triangle[0]], positions[triangle[1]], positions[triangle[2]]);
+				auto newNormal = CalculateTriangleNormal(newPositions[0], newPositions[1], newPositions[2]);
+				flips = XMVectorGetX(XMVector3Dot(oldNormal, newNormal)) <= 0.0f;
+			}
+			if (flips)
+				continue;
+
+			// The triangles around the collapsed vertex change, so none of their vertices can collapse again in this pass:
+			remap[collapse.From] = collapse.To;
+			quadrics[positionVertices[collapse.To]] += quadrics[positionVertices[collapse.From]];
+			for (auto offset = triangleOffsets[collapse.From]; offset < triangleOffsets[collapse.From + 1]; ++offset)
+			{
+				const auto* triangle = &result[3 * vertexTriangles[offset]];
+				for (size_t corner = 0; corner < 3; ++corner)
+					touchedVertices[triangle[corner]] = true;
+			}
+
+			removedTriangles += sharedTriangles;
+			if (removedTriangles >= trianglesToRemove)
+				break;
+		}
+		if (removedTriangles == 0)
+			break;
+
+		// Apply the collapses and remove the degenerate triangles:
+		size_t indexCount = 0;
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			auto vertex0 = remap[result[i]];
+			auto vertex1 = remap[result[i + 1]];
+			auto vertex2 = remap[result[i + 2]];
+			if (vertex0 == vertex1 || vertex1 == vertex2 || vertex2 == vertex0)
+				continue;
+
+			result[indexCount++] = vertex0;
+			result[indexCount++] = vertex1;
+			result[indexCount++] = vertex2;
+		}
+		result.resize(indexCount);
+	}
+
+	return result;
+}
+
+MeshSimplifier::Quadric MeshSimplifier::Quadric::FromPlane(double a, double b, double c, double d, double weight)
+{
+	return
+	{
+		weight * a * a, weight * a * b, weight * a * c, weight * a * d,
+		weight * b * b, weight * b * c, weight * b * d,
+		weight * c * c, weight * c * d,
+		weight * d * d,
+		weight,
+	};
+}
+MeshSimplifier::Quadric& MeshSimplifier::Quadric::operator+=(const Quadric& other)
+{
+	A00 += other.A00; A01 += other.A01; A02 += other.A02; A03 += other.A03;
+	A11 += other.A11; A12 += other.A12; A13 += other.A13;
+	A22 += other.A22; A23 += other.A23;
+	A33 += other.A33;
+	Weight += other.Weight;
+	return *this;
+}
+double MeshSimplifier::Quadric::Evaluate(const XMFLOAT3& position) const
+{
+	double x = position.x;
+	double y = position.y;
+	double z = position.z;
+
+	if (Weight == 0.0)
+		return 0.0;
+
+	// Evaluate v^T * A * v for v = (x, y, z, 1), and divide it by the weights, so that the error is a squared distance:
+	auto error =
+		A00 * x * x + 2.0 * A01 * x * y + 2.0 * A02 * x * z + 2.0 * A03 * x +
+		A11 * y * y + 2.0 * A12 * y * z + 2.0 * A13 * y +
+		A22 * z * z + 2.0 * A23 * z +
+		A33;
+	return error / Weight;
+}
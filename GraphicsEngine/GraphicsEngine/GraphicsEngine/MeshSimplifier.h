@@ -0,0 +1,45 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace GraphicsEngine
+{
+	// Simplifies triangle lists with quadric error metrics, collapsing edges until a target number of indices is reached.
+	// Vertices are only collapsed into other vertices, so the simplified index lists can share the vertex buffer of the original mesh.
+	// Vertices with the same position and attributes are welded first, as importers often give each triangle its own vertices.
+	// Vertices which share their position with vertices of different attributes lie on attribute seams and are never moved,
+	// so the seams don't open, and edges used by a single triangle are kept in place by planes perpendicular to them.
+	class MeshSimplifier
+	{
+	public:
+		using AttributesEqualFunctionType = std::function<bool(uint32_t vertex0, uint32_t vertex1)>;
+
+	public:
+		// The maximum error is the distance the surface may move away from its original position.
+		// The attributes function is only called for vertices with the same position:
+		static std::vector<uint32_t> Simplify(const std::vector<DirectX::XMFLOAT3>& positions, const std::vector<uint32_t>& indices, size_t targetIndexCount, float maxError, const AttributesEqualFunctionType& attributesEqual);
+
+	private:
+		// Symmetric 4x4 matrix whose quadratic form is the weighted sum of the squared distances to a set of planes:
+		struct Quadric
+		{
+			double A00, A01, A02, A03, A11, A12, A13, A22, A23, A33;
+			double Weight;
+
+			static Quadric FromPlane(double a, double b, double c, double d, double weight);
+			Quadric& operator+=(const Quadric& other);
+
+			// Weighted mean of the squared distances to the planes:
+			double Evaluate(const DirectX::XMFLOAT3& position) const;
+		};
+		struct Collapse
+		{
+			double Cost;
+			uint32_t From;
+			uint32_t To;
+		};
+	};
+}
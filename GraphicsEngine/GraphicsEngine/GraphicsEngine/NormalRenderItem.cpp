@@ -3,14 +3,29 @@
 #include "ImmutableMeshGeometry.h"
 #include "SubmeshGeometry.h"
 
+#include <algorithm>
+
+using namespace DirectX;
 using namespace GraphicsEngine;
 
 void NormalRenderItem::Render(ID3D11DeviceContext* deviceContext) const
 {
 	SetInputAssemblerData(deviceContext);
 
+	// Draw the instances of each level of detail, which are stored consecutively in the instance buffer:
 	const auto& submesh = GetSubmesh();
-	deviceContext->DrawIndexedInstanced(submesh.IndexCount, static_cast<UINT>(m_visibleInstanceCount), submesh.StartIndexLocation, submesh.BaseVertexLocation, 0);
+	UINT startInstanceLocation = 0;
+	for (size_t level = 0; level < GetLevelOfDetailCount(); ++level)
+	{
+		auto instanceCount = static_cast<UINT>(m_levelOfDetailInstanceCounts[level]);
+		if (instanceCount == 0)
+			continue;
+
+		auto indexCount = level == 0 ? submesh.IndexCount : submesh.LevelsOfDetail[level - 1].IndexCount;
+		auto startIndexLocation = level == 0 ? submesh.StartIndexLocation : submesh.LevelsOfDetail[level - 1].StartIndexLocation;
+		deviceContext->DrawIndexedInstanced(indexCount, instanceCount, startIndexLocation, submesh.BaseVertexLocation, startInstanceLocation);
+		startInstanceLocation += instanceCount;
+	}
 }
 void NormalRenderItem::RenderNonInstanced(ID3D11DeviceContext* deviceContext) const
 {
@@ -19,33 +34,111 @@ void NormalRenderItem::RenderNonInstanced(ID3D11DeviceContext* deviceContext) co
 	const auto& submesh = GetSubmesh();
 	deviceContext->DrawIndexed(submesh.IndexCount, submesh.StartIndexLocation, submesh.BaseVertexLocation);
 }
+void NormalRenderItem::RenderIndexRange(ID3D11DeviceContext* deviceContext, ID3D11Buffer* indexBuffer, UINT indexCount, UINT startIndexLocation) const
+{
+	SetInputAssemblerData(deviceContext);
+	deviceContext->IASetIndexBuffer(indexBuffer, m_mesh->GetIndexFormat(), 0);
+
+	const auto& submesh = GetSubmesh();
+	deviceContext->DrawIndexed(indexCount, startIndexLocation, submesh.BaseVertexLocation);
+}
+void NormalRenderItem::RenderShadowCasters(ID3D11DeviceContext* deviceContext) const
+{
+	SetInputAssemblerData(deviceContext);
+
+	const auto& submesh = GetSubmesh();
+	deviceContext->DrawIndexedInstanced(submesh.IndexCount, static_cast<UINT>(m_shadowCasterCount), submesh.StartIndexLocation, submesh.BaseVertexLocation, 0);
+}
+void NormalRenderItem::RenderCubeMapFace(ID3D11DeviceContext* deviceContext, size_t face) const
+{
+	auto instanceCount = m_cubeMapFaceInstanceCounts[face];
+	if (instanceCount == 0)
+		return;
+
+	SetInputAssemblerData(deviceContext);
+
+	const auto& submesh = GetSubmesh();
+	deviceContext->DrawIndexedInstanced(submesh.IndexCount, static_cast<UINT>(instanceCount), submesh.StartIndexLocation, submesh.BaseVertexLocation, 0);
+}
+
+NormalRenderItem::InstanceHandle NormalRenderItem::AddInstance(const ShaderBufferTypes::InstanceData& instanceData)
+{
+	// World space bounds can only be calculated after the mesh is set:
+	auto bounds = m_mesh ? CalculateInstanceBounds(instanceData) : BoundingBox();
+
+	auto instance = m_instances.Insert(instanceData);
+	m_colliders.emplace_back(this, instance, bounds);
+	m_instancesBounds.Add(bounds);
+	m_instancesLevelOfDetail.push_back(static_cast<uint8_t>(LevelOfDetailSelector::MaxLevelCount));
 
-void NormalRenderItem::AddInstance(const ShaderBufferTypes::InstanceData& instanceData)
+	return instance;
+}
+void NormalRenderItem::SetInstance(InstanceHandle instance, const ShaderBufferTypes::InstanceData& instanceData)
 {
-	//m_colliders.push_back(OctreeCollider(this, static_cast<uint32_t>(this->InstancesData.size())));
-	m_instancesData.push_back(instanceData);
+	auto instanceIndex = m_instances.GetIndex(instance);
+	m_instances[instance] = instanceData;
+
+	// The spatial index is rebuilt from the bounds of the colliders:
+	if (m_mesh)
+	{
+		auto bounds = CalculateInstanceBounds(instanceData);
+		m_instancesBounds.Set(instanceIndex, bounds);
+		m_colliders[instanceIndex].SetBounds(bounds);
+	}
 }
-void NormalRenderItem::SetInstance(size_t instanceID, const ShaderBufferTypes::InstanceData& instanceData)
+const ShaderBufferTypes::InstanceData& NormalRenderItem::GetInstance(InstanceHandle instance) const
 {
-	m_instancesData[instanceID] = instanceData;
+	return m_instances[instance];
 }
-const ShaderBufferTypes::InstanceData& NormalRenderItem::GetInstance(size_t instanceID)
+void NormalRenderItem::RemoveInstance(InstanceHandle instance)
 {
-	return m_instancesData[instanceID];
+	if (!m_instances.Contains(instance))
+		return;
+
+	// The last instance is moved into the place of the removed one:
+	auto instanceIndex = m_instances.Remove(instance);
+	auto lastIndex = m_instances.GetSize();
+	if (instanceIndex != lastIndex)
+	{
+		m_instancesBounds.Set(instanceIndex, m_instancesBounds.Get(lastIndex));
+		m_colliders[instanceIndex] = m_colliders[lastIndex];
+		m_instancesLevelOfDetail[instanceIndex] = m_instancesLevelOfDetail[lastIndex];
+	}
+	m_instancesBounds.RemoveLast();
+	m_colliders.pop_back();
+	m_instancesLevelOfDetail.pop_back();
 }
 void NormalRenderItem::RemoveLastInstance()
 {
-	if (!m_instancesData.empty())
-		m_instancesData.pop_back();
+	if (!m_instances.IsEmpty())
+		RemoveInstance(m_instances.GetHandle(m_instances.GetSize() - 1));
+}
+bool NormalRenderItem::ContainsInstance(InstanceHandle instance) const
+{
+	return m_instances.Contains(instance);
+}
+size_t NormalRenderItem::GetInstanceIndex(InstanceHandle instance) const
+{
+	return m_instances.GetIndex(instance);
+}
+NormalRenderItem::InstanceHandle NormalRenderItem::GetInstanceHandle(size_t instanceIndex) const
+{
+	return m_instances.GetHandle(instanceIndex);
+}
+size_t NormalRenderItem::GetInstanceCount() const
+{
+	return m_instances.GetSize();
 }
 void NormalRenderItem::InscreaseInstancesCapacity(size_t aditionalCapacity)
 {
-	m_instancesData.reserve(m_instancesData.capacity() + aditionalCapacity);
+	m_instances.Reserve(m_instances.GetCapacity() + aditionalCapacity);
+	m_instancesBounds.Reserve(m_instances.GetCapacity());
+	m_instancesLevelOfDetail.reserve(m_instances.GetCapacity());
 }
 
 void NormalRenderItem::InsertVisibleInstance(size_t instanceID)
 {
-	m_visibleInstances.insert(static_cast<uint32_t>(instanceID));
+	m_visibleInstances.push_back(static_cast<uint32_t>(instanceID));
 }
 void NormalRenderItem::ClearVisibleInstances()
 {
@@ -61,6 +154,17 @@ void NormalRenderItem::SetMesh(ImmutableMeshGeometry* mesh, const std::string& s
 {
 	m_mesh = mesh;
 	m_submeshName = submeshName;
+
+	// Recalculate the world space bounds of all instances, as the submesh bounds may have changed. Render items which were
+	// added to Graphics must change their mesh through it, so that their colliders are filed again in the spatial index:
+	m_instancesBounds.Clear();
+	m_instancesBounds.Reserve(m_instances.GetCapacity());
+	for (size_t i = 0; i < m_instances.GetSize(); ++i)
+	{
+		auto bounds = CalculateInstanceBounds(m_instances.GetElement(i));
+		m_instancesBounds.Add(bounds);
+		m_colliders[i].SetBounds(bounds);
+	}
 }
 
 const SubmeshGeometry& NormalRenderItem::GetSubmesh() const
@@ -70,13 +174,17 @@ const SubmeshGeometry& NormalRenderItem::GetSubmesh() const
 
 const std::vector<ShaderBufferTypes::InstanceData>& NormalRenderItem::GetInstancesData() const
 {
-	return m_instancesData;
+	return m_instances.GetElements();
+}
+const BoundingBoxArray& NormalRenderItem::GetInstancesBounds() const
+{
+	return m_instancesBounds;
 }
-const std::vector<OctreeCollider>& NormalRenderItem::GetColliders() const
+const std::deque<OctreeCollider>& NormalRenderItem::GetColliders() const
 {
 	return m_colliders;
 }
-std::vector<OctreeCollider>& NormalRenderItem::GetColliders()
+std::deque<OctreeCollider>& NormalRenderItem::GetColliders()
 {
 	return m_colliders;
 }
@@ -88,9 +196,49 @@ size_t NormalRenderItem::GetVisibleInstanceCount() const
 void NormalRenderItem::SetVisibleInstanceCount(size_t visibleInstanceCount)
 {
 	m_visibleInstanceCount = visibleInstanceCount;
+
+	// All instances are drawn at the highest level of detail, until the levels are set:
+	m_levelOfDetailInstanceCounts.fill(0);
+	m_levelOfDetailInstanceCounts[0] = visibleInstanceCount;
+}
+size_t NormalRenderItem::GetShadowCasterCount() const
+{
+	return m_shadowCasterCount;
+}
+void NormalRenderItem::SetShadowCasterCount(size_t shadowCasterCount)
+{
+	m_shadowCasterCount = shadowCasterCount;
+}
+size_t NormalRenderItem::GetCubeMapFaceInstanceCount(size_t face) const
+{
+	return m_cubeMapFaceInstanceCounts[face];
+}
+void NormalRenderItem::SetCubeMapFaceInstanceCount(size_t face, size_t instanceCount)
+{
+	m_cubeMapFaceInstanceCounts[face] = instanceCount;
+}
+size_t NormalRenderItem::GetLevelOfDetailCount() const
+{
+	return std::min(GetSubmesh().LevelsOfDetail.size() + 1, static_cast<size_t>(LevelOfDetailSelector::MaxLevelCount));
+}
+size_t NormalRenderItem::GetLevelOfDetailInstanceCount(size_t level) const
+{
+	return m_levelOfDetailInstanceCounts[level];
+}
+void NormalRenderItem::SetLevelOfDetailInstanceCount(size_t level, size_t instanceCount)
+{
+	m_levelOfDetailInstanceCounts[level] = instanceCount;
+}
+uint8_t NormalRenderItem::GetInstanceLevelOfDetail(size_t instanceID) const
+{
+	return m_instancesLevelOfDetail[instanceID];
+}
+void NormalRenderItem::SetInstanceLevelOfDetail(size_t instanceID, uint8_t level)
+{
+	m_instancesLevelOfDetail[instanceID] = level;
 }
 
-const std::unordered_set<uint32_t>& NormalRenderItem::GetVisibleInstances() const
+const std::vector<uint32_t>& NormalRenderItem::GetVisibleInstances() const
 {
 	return m_visibleInstances;
 }
@@ -104,3 +252,9 @@ void NormalRenderItem::SetInputAssemblerData(ID3D11DeviceContext* deviceContext)
 	deviceContext->IASetIndexBuffer(m_mesh->GetIndexBuffer(), m_mesh->GetIndexFormat(), 0);
 	deviceContext->IASetPrimitiveTopology(m_mesh->GetPrimitiveType());
 }
+BoundingBox NormalRenderItem::CalculateInstanceBounds(const ShaderBufferTypes::InstanceData& instanceData) const
+{
+	BoundingBox worldSpaceBounds;
+	GetSubmesh().Bounds.Transform(worldSpaceBounds, XMLoadFloat4x4(&instanceData.WorldMatrix));
+	return worldSpaceBounds;
+}
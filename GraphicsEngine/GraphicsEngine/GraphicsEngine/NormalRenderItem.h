@@ -3,8 +3,13 @@
 #include "RenderItem.h"
 #include "ShaderBufferTypes.h"
 #include "OctreeCollider.h"
+#include "BoundingBoxArray.h"
+#include "CubeMapFrustum.h"
+#include "LevelOfDetailSelector.h"
+#include "Common/SlotMap.h"
 
-#include <unordered_set>
+#include <deque>
+#include <vector>
 
 namespace GraphicsEngine
 {
@@ -13,16 +18,30 @@ namespace GraphicsEngine
 
 	class NormalRenderItem : public RenderItem
 	{
+	public:
+		using InstanceHandle = SlotMapHandle;
+
 	public:
 		NormalRenderItem() = default;
 		
 		void Render(ID3D11DeviceContext* deviceContext) const override;
 		void RenderNonInstanced(ID3D11DeviceContext* deviceContext) const override;
+		void RenderShadowCasters(ID3D11DeviceContext* deviceContext) const override;
+		void RenderCubeMapFace(ID3D11DeviceContext* deviceContext, size_t face) const override;
+		// Draws a range of an index buffer other than the one of the mesh, which indexes the vertices of the submesh:
+		void RenderIndexRange(ID3D11DeviceContext* deviceContext, ID3D11Buffer* indexBuffer, UINT indexCount, UINT startIndexLocation) const;
 
-		void AddInstance(const ShaderBufferTypes::InstanceData& instanceData);
-		void SetInstance(size_t instanceID, const ShaderBufferTypes::InstanceData& instanceData);
-		const ShaderBufferTypes::InstanceData& GetInstance(size_t instanceID);
+		// Instances are referenced through handles, which stay valid while other instances are removed.
+		// The instance data is kept contiguous, so the index of an instance changes when another one is removed.
+		InstanceHandle AddInstance(const ShaderBufferTypes::InstanceData& instanceData);
+		void SetInstance(InstanceHandle instance, const ShaderBufferTypes::InstanceData& instanceData);
+		const ShaderBufferTypes::InstanceData& GetInstance(InstanceHandle instance) const;
+		void RemoveInstance(InstanceHandle instance);
 		void RemoveLastInstance() override;
+		bool ContainsInstance(InstanceHandle instance) const;
+		size_t GetInstanceIndex(InstanceHandle instance) const;
+		InstanceHandle GetInstanceHandle(size_t instanceIndex) const;
+		size_t GetInstanceCount() const;
 		void InscreaseInstancesCapacity(size_t aditionalCapacity);
 
 		void InsertVisibleInstance(size_t instanceID);
@@ -32,21 +51,41 @@ namespace GraphicsEngine
 		void SetMesh(ImmutableMeshGeometry* mesh, const std::string& submeshName);
 		const SubmeshGeometry& GetSubmesh() const;
 		const std::vector<ShaderBufferTypes::InstanceData>& GetInstancesData() const;
-		const std::vector<OctreeCollider>& GetColliders() const;
-		std::vector<OctreeCollider>& GetColliders();
+		const BoundingBoxArray& GetInstancesBounds() const;
+		const std::deque<OctreeCollider>& GetColliders() const;
+		std::deque<OctreeCollider>& GetColliders();
 		size_t GetVisibleInstanceCount() const;
 		void SetVisibleInstanceCount(size_t visibleInstanceCount);
-		const std::unordered_set<uint32_t>& GetVisibleInstances() const;
+		size_t GetShadowCasterCount() const;
+		void SetShadowCasterCount(size_t shadowCasterCount);
+		size_t GetCubeMapFaceInstanceCount(size_t face) const;
+		void SetCubeMapFaceInstanceCount(size_t face, size_t instanceCount);
+		size_t GetLevelOfDetailCount() const;
+		size_t GetLevelOfDetailInstanceCount(size_t level) const;
+		void SetLevelOfDetailInstanceCount(size_t level, size_t instanceCount);
+		uint8_t GetInstanceLevelOfDetail(size_t instanceID) const;
+		void SetInstanceLevelOfDetail(size_t instanceID, uint8_t level);
+		const std::vector<uint32_t>& GetVisibleInstances() const;
 		
 	private:
 		void SetInputAssemblerData(ID3D11DeviceContext* deviceContext) const;
+		DirectX::BoundingBox CalculateInstanceBounds(const ShaderBufferTypes::InstanceData& instanceData) const;
 
 	private:
-		ImmutableMeshGeometry* m_mesh;
+		ImmutableMeshGeometry* m_mesh = nullptr;
 		std::string m_submeshName;
 		size_t m_visibleInstanceCount = 0;
-		std::vector<ShaderBufferTypes::InstanceData> m_instancesData;
-		std::vector<OctreeCollider> m_colliders;
-		std::unordered_set<uint32_t> m_visibleInstances;
+		size_t m_shadowCasterCount = 0;
+		std::array<size_t, CubeMapFrustum::FaceCount> m_cubeMapFaceInstanceCounts = {};
+		// The visible instances are sorted by level of detail, each level being drawn with its own index range:
+		std::array<size_t, LevelOfDetailSelector::MaxLevelCount> m_levelOfDetailInstanceCounts = {};
+		SlotMap<ShaderBufferTypes::InstanceData> m_instances;
+		// The following are stored in the same order as the instance data, and follow its moves when instances are removed:
+		BoundingBoxArray m_instancesBounds;
+		// A deque is used, so that adding instances doesn't move the colliders referenced by the spatial index:
+		std::deque<OctreeCollider> m_colliders;
+		// Level of detail selected for each instance in the last frame it was visible:
+		std::vector<uint8_t> m_instancesLevelOfDetail;
+		std::vector<uint32_t> m_visibleInstances;
 	};
 }
@@ -0,0 +1,351 @@
+#include "stdafx.h"
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+using namespace GraphicsEngine;
+
+OcclusionCuller::OcclusionCuller(uint32_t width, uint32_t height)
+{
+	XMStoreFloat4x4(&m_viewProjectionMatrix, XMMatrixIdentity());
+
+	// Round the width up, so that every row is made of whole groups of pixels:
+	DepthLevel depthBuffer;
+	depthBuffer.Width = (width + PixelGroupSize - 1) / PixelGroupSize * PixelGroupSize;
+	depthBuffer.Height = height;
+	depthBuffer.Depths.assign(depthBuffer.Width * depthBuffer.Height, 1.0f);
+	m_depthLevels.push_back(std::move(depthBuffer));
+
+	// Each level halves the size of the previous one, until a single texel is left:
+	while (m_depthLevels.back().Width > 1 || m_depthLevels.back().Height > 1)
+	{
+		const auto& previousLevel = m_depthLevels.back();
+
+		DepthLevel level;
+		level.Width = (previousLevel.Width + 1) / 2;
+		level.Height = (previousLevel.Height + 1) / 2;
+		level.Depths.assign(level.Width * level.Height, 1.0f);
+		m_depthLevels.push_back(std::move(level));
+	}
+}
+
+void OcclusionCuller::AddHeightMapOccluder(const std::vector<float>& heightMap, uint32_t heightMapWidth, uint32_t heightMapHeight, float terrainWidth, float terrainDepth, uint32_t cellCount)
+{
+	// Calculate the minimum height of the samples under each cell, including the samples on its borders:
+	std::vector<float> cellMinimumHeights(cellCount * cellCount);
+	for (uint32_t row = 0; row < cellCount; ++row)
+	{
+		auto firstSampleRow = row * (heightMapHeight - 1) / cellCount;
+		auto lastSampleRow = std::min(((row + 1) * (heightMapHeight - 1) + cellCount - 1) / cellCount, heightMapHeight - 1);
+
+		for (uint32_t column = 0; column < cellCount; ++column)
+		{
+			auto firstSampleColumn = column * (heightMapWidth - 1) / cellCount;
+			auto lastSampleColumn = std::min(((column + 1) * (heightMapWidth - 1) + cellCount - 1) / cellCount, heightMapWidth - 1);
+
+			auto minimumHeight = FLT_MAX;
+			for (auto sampleRow = firstSampleRow; sampleRow <= lastSampleRow; ++sampleRow)
+			{
+				for (auto sampleColumn = firstSampleColumn; sampleColumn <= lastSampleColumn; ++sampleColumn)
+					minimumHeight = std::min(minimumHeight, heightMap[sampleRow * heightMapWidth + sampleColumn]);
+			}
+			cellMinimumHeights[row * cellCount + column] = minimumHeight;
+		}
+	}
+
+	// Each vertex takes the lowest height of its adjacent cells, so that the triangles stay below the terrain:
+	auto baseVertex = static_cast<uint32_t>(m_occluderVertices.size());
+	auto vertexCount = cellCount + 1;
+	for (uint32_t row = 0; row < vertexCount; ++row)
+	{
+		for (uint32_t column = 0; column < vertexCount; ++column)
+		{
+			auto height = FLT_MAX;
+			for (auto cellRow = row == 0 ? 0 : row - 1; cellRow <= std::min(row, cellCount - 1); ++cellRow)
+			{
+				for (auto cellColumn = column == 0 ? 0 : column - 1; cellColumn <= std::min(column, cellCount - 1); ++cellColumn)
+					height = std::min(height, cellMinimumHeights[cellRow * cellCount + cellColumn]);
+			}
+
+			// Rows of the height map go from the positive to the negative z-axis:
+			auto x = (static_cast<float>(column) / cellCount - 0.5f) * terrainWidth;
+			auto z = (0.5f - static_cast<float>(row) / cellCount) * terrainDepth;
+			m_occluderVertices.emplace_back(x, height, z);
+		}
+	}
+
+	for (uint32_t row = 0; row < cellCount; ++row)
+	{
+		for (uint32_t column = 0; column < cellCount; ++column)
+		{
+			auto topLeft = baseVertex + row * vertexCount + column;
+			auto bottomLeft = topLeft + vertexCount;
+			m_occluderIndices.insert(m_occluderIndices.end(), { topLeft, topLeft + 1, bottomLeft, bottomLeft, topLeft + 1, bottomLeft + 1 });
+		}
+	}
+}
+void OcclusionCuller::AddMeshOccluder(const std::vector<XMFLOAT3>& vertices, const std::vector<uint32_t>& indices)
+{
+	auto baseVertex = static_cast<uint32_t>(m_occluderVertices.size());
+	m_occluderVertices.insert(m_occluderVertices.end(), vertices.begin(), vertices.end());
+
+	for (auto index : indices)
+		m_occluderIndices.push_back(baseVertex + index);
+}
+void OcclusionCuller::ClearOccluders()
+{
+	m_occluderVertices.clear();
+	m_occluderIndices.clear();
+}
+
+void OcclusionCuller::Render(CXMMATRIX viewProjectionMatrix)
+{
+	XMStoreFloat4x4(&m_viewProjectionMatrix, viewProjectionMatrix);
+
+	auto& depthBuffer = m_depthLevels[0];
+	std::fill(depthBuffer.Depths.begin(), depthBuffer.Depths.end(), 1.0f);
+
+	// Transform the occluders to clip space:
+	m_clipSpaceVertices.resize(m_occluderVertices.size());
+	for (size_t i = 0; i < m_occluderVertices.size(); ++i)
+	{
+		auto position = XMVectorSetW(XMLoadFloat3(&m_occluderVertices[i]), 1.0f);
+		XMStoreFloat4(&m_clipSpaceVertices[i], XMVector4Transform(position, viewProjectionMatrix));
+	}
+
+	// Map from normalized device coordinates to pixels, flipping the y-axis:
+	auto screenScale = XMVectorSet(0.5f * depthBuffer.Width, -0.5f * depthBuffer.Height, 1.0f, 0.0f);
+	auto screenOffset = XMVectorSet(0.5f * depthBuffer.Width, 0.5f * depthBuffer.Height, 0.0f, 0.0f);
+	auto toScreenSpace = [&screenScale, &screenOffset](FXMVECTOR clipSpaceVertex)
+	{
+		auto normalizedDeviceCoordinates = XMVectorDivide(clipSpaceVertex, XMVectorSplatW(clipSpaceVertex));
+		return XMVectorMultiplyAdd(normalizedDeviceCoordinates, screenScale, screenOffset);
+	};
+
+	for (size_t i = 0; i < m_occluderIndices.size(); i += 3)
+	{
+		std::array<const XMFLOAT4*, 3> vertices =
+		{
+			&m_clipSpaceVertices[m_occluderIndices[i]],
+			&m_clipSpaceVertices[m_occluderIndices[i + 1]],
+			&m_clipSpaceVertices[m_occluderIndices[i + 2]],
+		};
+
+		// Skip the triangle if all of its vertices are outside of the same plane:
+		auto outsideLeft = true, outsideRight = true, outsideBottom = true, outsideTop = true, outsideNear = true, outsideFar = true;
+		for (auto vertex : vertices)
+		{
+			outsideLeft = outsideLeft && vertex->x < -vertex->w;
+			outsideRight = outsideRight && vertex->x > vertex->w;
+			outsideBottom = outsideBottom && vertex->y < -vertex->w;
+			outsideTop = outsideTop && vertex->y > vertex->w;
+			outsideNear = outsideNear && vertex->z < 0.0f;
+			outsideFar = outsideFar && vertex->z > vertex->w;
+		}
+		if (outsideLeft || outsideRight || outsideBottom || outsideTop || outsideNear || outsideFar)
+			continue;
+
+		// Clip the triangle against the near plane, which results in a polygon with up to 4 vertices:
+		std::array<XMVECTOR, 4> polygon;
+		size_t polygonVertexCount = 0;
+		for (size_t edge = 0; edge < 3; ++edge)
+		{
+			const auto& start = *vertices[edge];
+			const auto& end = *vertices[(edge + 1) % 3];
+			if (start.z >= 0.0f)
+				polygon[polygonVertexCount++] = XMLoadFloat4(&start);
+
+			if ((start.z >= 0.0f) != (end.z >= 0.0f))
+			{
+				auto t = start.z / (start.z - end.z);
+				polygon[polygonVertexCount++] = XMVectorLerp(XMLoadFloat4(&start), XMLoadFloat4(&end), t);
+			}
+		}
+
+		for (size_t vertex = 0; vertex < polygonVertexCount; ++vertex)
+			polygon[vertex] = toScreenSpace(polygon[vertex]);
+
+		RasterizeTriangle(polygon[0], polygon[1], polygon[2]);
+		if (polygonVertexCount == 4)
+			RasterizeTriangle(polygon[0], polygon[2], polygon[3]);
+	}
+
+	BuildDepthPyramid();
+}
+
+bool OcclusionCuller::IsVisible(const BoundingBox& box) const
+{
+	const auto& depthBuffer = m_depthLevels[0];
+	auto viewProjectionMatrix = XMLoadFloat4x4(&m_viewProjectionMatrix);
+
+	std::array<XMFLOAT3, BoundingBox::CORNER_COUNT> corners;
+	box.GetCorners(corners.data());
+
+	// Project the corners to find the screen space bounds and the nearest depth of the box:
+	auto minimumX = FLT_MAX, minimumY = FLT_MAX, maximumX = -FLT_MAX, maximumY = -FLT_MAX;
+	auto minimumDepth = FLT_MAX;
+	for (const auto& corner : corners)
+	{
+		XMFLOAT4 clipSpaceCorner;
+		XMStoreFloat4(&clipSpaceCorner, XMVector4Transform(XMVectorSetW(XMLoadFloat3(&corner), 1.0f), viewProjectionMatrix));
+
+		// Boxes which cross the near plane are too close to be occluded:
+		if (clipSpaceCorner.z < 0.0f)
+			return true;
+
+		auto inverseW = 1.0f / clipSpaceCorner.w;
+		auto x = (clipSpaceCorner.x * inverseW * 0.5f + 0.5f) * depthBuffer.Width;
+		auto y = (0.5f - clipSpaceCorner.y * inverseW * 0.5f) * depthBuffer.Height;
+		minimumX = std::min(minimumX, x);
+		minimumY = std::min(minimumY, y);
+		maximumX = std::max(maximumX, x);
+		maximumY = std::max(maximumY, y);
+		minimumDepth = std::min(minimumDepth, clipSpaceCorner.z * inverseW);
+	}
+
+	// Boxes outside of the screen are left to frustum culling:
+	if (maximumX < 0.0f || maximumY < 0.0f || minimumX >= depthBuffer.Width || minimumY >= depthBuffer.Height)
+		return true;
+
+	// Find the pixels which the bounds touch:
+	auto firstX = static_cast<uint32_t>(std::max(minimumX, 0.0f));
+	auto firstY = static_cast<uint32_t>(std::max(minimumY, 0.0f));
+	auto lastX = static_cast<uint32_t>(std::min(maximumX, depthBuffer.Width - 1.0f));
+	auto lastY = static_cast<uint32_t>(std::min(maximumY, depthBuffer.Height - 1.0f));
+
+	// Choose the finest level where the bounds cover at most 4 x 4 texels:
+	size_t levelIndex = 0;
+	while (levelIndex + 1 < m_depthLevels.size() && ((lastX >> levelIndex) - (firstX >> levelIndex) >= 4 || (lastY >> levelIndex) - (firstY >> levelIndex) >= 4))
+		++levelIndex;
+
+	// The box is visible if it is in front of the farthest occluder of any of the texels:
+	const auto& level = m_depthLevels[levelIndex];
+	for (auto y = firstY >> levelIndex; y <= lastY >> levelIndex; ++y)
+	{
+		for (auto x = firstX >> levelIndex; x <= lastX >> levelIndex; ++x)
+		{
+			if (minimumDepth <= level.Depths[y * level.Width + x])
+				return true;
+		}
+	}
+
+	return false;
+}
+
+uint32_t OcclusionCuller::GetWidth() const
+{
+	return m_depthLevels[0].Width;
+}
+uint32_t OcclusionCuller::GetHeight() const
+{
+	return m_depthLevels[0].Height;
+}
+size_t OcclusionCuller::GetOccluderTriangleCount() const
+{
+	return m_occluderIndices.size() / 3;
+}
+
+void OcclusionCuller::RasterizeTriangle(FXMVECTOR vertex0, FXMVECTOR vertex1, FXMVECTOR vertex2)
+{
+	auto& depthBuffer = m_depthLevels[0];
+
+	std::array<XMFLOAT3, 3> vertices;
+	XMStoreFloat3(&vertices[0], vertex0);
+	XMStoreFloat3(&vertices[1], vertex1);
+	XMStoreFloat3(&vertices[2], vertex2);
+
+	// Make the winding counter clockwise, so that the edge functions are positive inside of the triangle:
+	auto area = (vertices[1].x - vertices[0].x) * (vertices[2].y - vertices[0].y) - (vertices[1].y - vertices[0].y) * (vertices[2].x - vertices[0].x);
+	if (std::abs(area) < 1e-6f)
+		return;
+	if (area < 0.0f)
+	{
+		std::swap(vertices[1], vertices[2]);
+		area = -area;
+	}
+
+	// Find the pixels whose centers may be covered by the triangle:
+	auto minimumX = std::min({ vertices[0].x, vertices[1].x, vertices[2].x });
+	auto minimumY = std::min({ vertices[0].y, vertices[1].y, vertices[2].y });
+	auto maximumX = std::max({ vertices[0].x, vertices[1].x, vertices[2].x });
+	auto maximumY = std::max({ vertices[0].y, vertices[1].y, vertices[2].y });
+	if (maximumX < 0.5f || maximumY < 0.5f || minimumX > depthBuffer.Width - 0.5f || minimumY > depthBuffer.Height - 0.5f)
+		return;
+
+	auto firstX = static_cast<uint32_t>(std::max(minimumX - 0.5f, 0.0f)) / PixelGroupSize * PixelGroupSize;
+	auto firstY = static_cast<uint32_t>(std::max(minimumY - 0.5f, 0.0f));
+	auto lastX = static_cast<uint32_t>(std::min(maximumX - 0.5f, depthBuffer.Width - 1.0f));
+	auto lastY = static_cast<uint32_t>(std::min(maximumY - 0.5f, depthBuffer.Height - 1.0f));
+
+	// Each edge function is A * x + B * y + C, and is the weight of the opposite vertex scaled by the area:
+	std::array<XMVECTOR, 3> edgeA, edgeB, edgeC;
+	for (size_t i = 0; i < 3; ++i)
+	{
+		const auto& start = vertices[(i + 1) % 3];
+		const auto& end = vertices[(i + 2) % 3];
+		auto a = start.y - end.y;
+		auto b = end.x - start.x;
+		edgeA[i] = XMVectorReplicate(a);
+		edgeB[i] = XMVectorReplicate(b);
+		edgeC[i] = XMVectorReplicate(-(a * start.x + b * start.y));
+	}
+
+	// Depth is linear in screen space, so it can be written as a plane equation too:
+	auto inverseArea = 1.0f / area;
+	auto depthA = XMVectorScale(XMVectorMultiplyAdd(edgeA[0], XMVectorReplicate(vertices[0].z), XMVectorMultiplyAdd(edgeA[1], XMVectorReplicate(vertices[1].z), XMVectorMultiply(edgeA[2], XMVectorReplicate(vertices[2].z)))), inverseArea);
+	auto depthB = XMVectorScale(XMVectorMultiplyAdd(edgeB[0], XMVectorReplicate(vertices[0].z), XMVectorMultiplyAdd(edgeB[1], XMVectorReplicate(vertices[1].z), XMVectorMultiply(edgeB[2], XMVectorReplicate(vertices[2].z)))), inverseArea);
+	auto depthC = XMVectorScale(XMVectorMultiplyAdd(edgeC[0], XMVectorReplicate(vertices[0].z), XMVectorMultiplyAdd(edgeC[1], XMVectorReplicate(vertices[1].z), XMVectorMultiply(edgeC[2], XMVectorReplicate(vertices[2].z)))), inverseArea);
+
+	// Test a group of pixels at once, keeping the nearest depth of the covered ones:
+	auto pixelOffsets = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);
+	for (auto y = firstY; y <= lastY; ++y)
+	{
+		auto pixelY = XMVectorReplicate(y + 0.5f);
+		auto row = depthBuffer.Depths.data() + y * depthBuffer.Width;
+
+		for (auto x = firstX; x <= lastX; x += PixelGroupSize)
+		{
+			auto pixelX = XMVectorAdd(XMVectorReplicate(static_cast<float>(x)), pixelOffsets);
+
+			auto inside = XMVectorTrueInt();
+			for (size_t i = 0; i < 3; ++i)
+			{
+				auto weight = XMVectorMultiplyAdd(edgeA[i], pixelX, XMVectorMultiplyAdd(edgeB[i], pixelY, edgeC[i]));
+				inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(weight, XMVectorZero()));
+			}
+			if (XMVector4EqualInt(inside, XMVectorFalseInt()))
+				continue;
+
+			auto depth = XMVectorMultiplyAdd(depthA, pixelX, XMVectorMultiplyAdd(depthB, pixelY, depthC));
+			auto pixels = reinterpret_cast<XMFLOAT4*>(row + x);
+			auto currentDepth = XMLoadFloat4(pixels);
+			XMStoreFloat4(pixels, XMVectorSelect(currentDepth, XMVectorMin(currentDepth, depth), inside));
+		}
+	}
+}
+void OcclusionCuller::BuildDepthPyramid()
+{
+	// Each texel keeps the farthest depth of the 2 x 2 texels of the previous level, clamping at the borders:
+	for (size_t levelIndex = 1; levelIndex < m_depthLevels.size(); ++levelIndex)
+	{
+		const auto& previousLevel = m_depthLevels[levelIndex - 1];
+		auto& level = m_depthLevels[levelIndex];
+
+		for (uint32_t y = 0; y < level.Height; ++y)
+		{
+			auto row0 = previousLevel.Depths.data() + 2 * y * previousLevel.Width;
+			auto row1 = previousLevel.Depths.data() + std::min(2 * y + 1, previousLevel.Height - 1) * previousLevel.Width;
+
+			for (uint32_t x = 0; x < level.Width; ++x)
+			{
+				auto x0 = 2 * x;
+				auto x1 = std::min(2 * x + 1, previousLevel.Width - 1);
+				level.Depths[y * level.Width + x] = std::max(std::max(row0[x0], row0[x1]), std::max(row1[x0], row1[x1]));
+			}
+		}
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <vector>
+
+namespace GraphicsEngineTester
+{
+	class OcclusionCullerTest;
+}
+
+namespace GraphicsEngine
+{
+	// Software occlusion culling on the CPU. Occluders are rasterized into a low resolution depth buffer, four pixels at a time,
+	// from which a hierarchical depth pyramid is built. Each texel of the pyramid keeps the farthest depth of the texels below it,
+	// so a box is occluded if its nearest depth is behind the depths of the few texels which cover its screen space bounds.
+	class OcclusionCuller
+	{
+		friend class GraphicsEngineTester::OcclusionCullerTest;
+
+	public:
+		static constexpr uint32_t PixelGroupSize = 4;
+
+	public:
+		// The width is rounded up to a multiple of PixelGroupSize:
+		explicit OcclusionCuller(uint32_t width, uint32_t height);
+
+		// Adds a coarse grid of cellCount x cellCount cells covering a height map centered at the origin.
+		// The height of each vertex is the minimum height of the adjacent cells, so the grid never rises above the terrain.
+		void AddHeightMapOccluder(const std::vector<float>& heightMap, uint32_t heightMapWidth, uint32_t heightMapHeight, float terrainWidth, float terrainDepth, uint32_t cellCount);
+
+		// Adds a world space triangle list, which should be completely inside of the object it stands for:
+		void AddMeshOccluder(const std::vector<DirectX::XMFLOAT3>& vertices, const std::vector<uint32_t>& indices);
+		void ClearOccluders();
+
+		// Rasterizes the occluders as seen by the view projection matrix and builds the depth pyramid:
+		void Render(DirectX::CXMMATRIX viewProjectionMatrix);
+
+		// Returns false if the box is completely hidden by the occluders of the last render. Thread safe.
+		bool IsVisible(const DirectX::BoundingBox& box) const;
+
+		uint32_t GetWidth() const;
+		uint32_t GetHeight() const;
+		size_t GetOccluderTriangleCount() const;
+
+	private:
+		struct DepthLevel
+		{
+			uint32_t Width;
+			uint32_t Height;
+			std::vector<float> Depths;
+		};
+
+	private:
+		void RasterizeTriangle(DirectX::FXMVECTOR vertex0, DirectX::FXMVECTOR vertex1, DirectX::FXMVECTOR vertex2);
+		void BuildDepthPyramid();
+
+	private:
+		DirectX::XMFLOAT4X4 m_viewProjectionMatrix;
+		std::vector<DirectX::XMFLOAT3> m_occluderVertices;
+		std::vector<uint32_t> m_occluderIndices;
+
+		// The first level is the depth buffer, with a width which is a multiple of PixelGroupSize:
+		std::vector<DepthLevel> m_depthLevels;
+
+		// Kept between renders to avoid reallocations:
+		std::vector<DirectX::XMFLOAT4> m_clipSpaceVertices;
+	};
+}
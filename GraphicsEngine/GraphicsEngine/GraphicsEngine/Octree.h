@@ -2,9 +2,14 @@
 
 #include <DirectXCollision.h>
 #include <array>
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include <vector>
 
-#include "Common/MemoryPool.h"
+#include "Common/PagedMemoryPool.h"
+#include "Common/ThreadPool.h"
+#include "Frustum.h"
 
 namespace GraphicsEngineTester
 {
@@ -27,60 +32,194 @@ namespace GraphicsEngine
 			std::vector<Type*> Objects;
 		};
 
+		// The child nodes are constructed in place by the node storage:
+		friend class MemoryPoolElement<Octree<Type>>;
+
 	public:
-		static constexpr size_t s_memoryPoolSize = 5000;
-		static MemoryPool<Octree<Type>, s_memoryPoolSize> s_memoryPool;
+		static constexpr size_t s_nodesPerPage = 256;
+		using NodeStorage = PagedMemoryPool<Octree<Type>, s_nodesPerPage>;
+
+	private:
+		static std::atomic<uint32_t> s_queryCounter;
 
 	public:
+		// Creates a root node, which owns the storage of all the nodes of the octree and releases it when destroyed:
 		explicit Octree(size_t objectsPerLeaf, DirectX::BoundingBox&& boundingBox, const DirectX::XMFLOAT3& minExtents) :
-			m_boundingBox(boundingBox),
-			m_isLeaf(true),
-			m_objectCount(0),
-			m_objectsPerLeaf(objectsPerLeaf),
-			m_minExtents(minExtents)
+			Octree(objectsPerLeaf, std::move(boundingBox), minExtents, std::make_unique<NodeStorage>())
 		{
 		}
 
-		void AddObject(Type* object)
+		// Returns true if the object was added, or false if it is outside of the octree or was already added:
+		bool AddObject(Type* object)
 		{
 			// Ignore if the object doesn't intersect with bounding box:
 			if (!object->Intersects(m_boundingBox))
-				return;
+				return false;
 
 			// If not a leaf node:
 			if (!m_isLeaf)
 			{
 				// Add object to child nodes:
-				AddObjectToChildNodes(object);
-				return;
+				return AddObjectToChildNodes(object);
 			}
 
 			// If leaf node has enough space, or if its bounding box is small:
 			if (m_objectCount < m_objectsPerLeaf || IsSmall())
+				return AddObjectToArray(object);
+
+			// If it contains a lot of objects:
+			return ConvertToNonLeaf(object);
+		}
+		// Must be called before the bounds of the object change, as only the nodes intersecting the object are visited.
+		// Returns true if the object was found.
+		bool RemoveObject(Type* object)
+		{
+			// The object can't be in this node if it doesn't intersect with bounding box:
+			if (!object->Intersects(m_boundingBox))
+				return false;
+
+			if (m_isLeaf)
+				return RemoveObjectFromArray(object);
+
+			// Remove object from all child nodes which contain it:
+			auto removed = false;
+			for (auto& child : m_state.Children)
+				removed = child->RemoveObject(object) || removed;
+
+			if (!removed)
+				return false;
+
+			// Merge the child nodes if they don't have enough objects to justify them. Half of the leaf capacity is used,
+			// so that adding and removing a single object doesn't split and merge the node repeatedly:
+			--m_objectCount;
+			if (m_objectCount <= m_objectsPerLeaf / 2)
+				ConvertToLeaf();
+
+			return true;
+		}
+		// Moves an object to its new bounds, visiting only the nodes which intersect the old and the new bounds:
+		void UpdateObject(Type* object, const DirectX::BoundingBox& bounds)
+		{
+			RemoveObject(object);
+			object->SetBounds(bounds);
+			AddObject(object);
+		}
+
+		// Appends the objects which intersect the frustum to the output. Objects shared by several nodes are added once.
+		void CalculateIntersections(const Frustum& frustum, std::vector<Type*>& output) const
+		{
+			CalculateIntersections(frustum, GenerateQueryID(), output);
+		}
+
+		// Same as above, but the children of the root node are traversed in parallel, each one writing into its own output:
+		void CalculateIntersections(const Frustum& frustum, Common::ThreadPool& threadPool, std::array<std::vector<Type*>, 8>& outputs) const
+		{
+			for (auto& output : outputs)
+				output.clear();
+
+			auto queryID = GenerateQueryID();
+			if (m_isLeaf)
 			{
-				AddObjectToArray(object);
+				CalculateIntersections(frustum, queryID, outputs[0]);
 				return;
 			}
 
-			// If it contains a lot of objects:
-			ConvertToNonLeaf(object);
+			if (frustum.Contains(m_boundingBox) == DirectX::ContainmentType::DISJOINT)
+				return;
+
+			const auto& children = m_state.Children;
+			threadPool.ParallelFor(children.size(), [&frustum, queryID, &children, &outputs](size_t childIndex)
+			{
+				children[childIndex]->CalculateIntersections(frustum, queryID, outputs[childIndex]);
+			});
+		}
+
+		size_t GetNodeCount() const
+		{
+			// The root node isn't stored in the node storage:
+			return m_nodeStorage->GetActiveElements() + 1;
+		}
+
+	private:
+		explicit Octree(size_t objectsPerLeaf, DirectX::BoundingBox&& boundingBox, const DirectX::XMFLOAT3& minExtents, std::unique_ptr<NodeStorage>&& ownedNodeStorage) :
+			m_boundingBox(boundingBox),
+			m_isLeaf(true),
+			m_objectCount(0),
+			m_objectsPerLeaf(objectsPerLeaf),
+			m_minExtents(minExtents),
+			m_ownedNodeStorage(std::move(ownedNodeStorage)),
+			m_nodeStorage(m_ownedNodeStorage.get())
+		{
+		}
+		explicit Octree(size_t objectsPerLeaf, DirectX::BoundingBox&& boundingBox, const DirectX::XMFLOAT3& minExtents, NodeStorage* nodeStorage) :
+			m_boundingBox(boundingBox),
+			m_isLeaf(true),
+			m_objectCount(0),
+			m_objectsPerLeaf(objectsPerLeaf),
+			m_minExtents(minExtents),
+			m_nodeStorage(nodeStorage)
+		{
+		}
+
+		static uint32_t GenerateQueryID()
+		{
+			// Zero is reserved for objects which were never visited:
+			auto queryID = ++s_queryCounter;
+			if (queryID == 0)
+				queryID = ++s_queryCounter;
+
+			return queryID;
+		}
+
+		void CalculateIntersections(const Frustum& frustum, uint32_t queryID, std::vector<Type*>& output) const
+		{
+			using namespace DirectX;
+
+			// Skip the node if it is outside of the frustum:
+			auto containment = frustum.Contains(m_boundingBox);
+			if (containment == ContainmentType::DISJOINT)
+				return;
+
+			// If the node is completely inside, all of its objects are visible:
+			if (containment == ContainmentType::CONTAINS)
+			{
+				AddAllObjects(queryID, output);
+				return;
+			}
+
+			if (!m_isLeaf)
+			{
+				for (const auto& child : m_state.Children)
+					child->CalculateIntersections(frustum, queryID, output);
+			}
+			else
+			{
+				for (const auto& object : m_state.Objects)
+				{
+					// Objects shared by several nodes are only tested once:
+					if (object->MarkAsVisited(queryID) && object->Intersects(frustum))
+						output.push_back(object);
+				}
+			}
 		}
-		void XM_CALLCONV CalculateIntersections(const DirectX::BoundingFrustum& viewSpaceBoundingFrustum, DirectX::FXMMATRIX inverseViewMatrix)
+		void AddAllObjects(uint32_t queryID, std::vector<Type*>& output) const
 		{
 			if (!m_isLeaf)
 			{
 				for (const auto& child : m_state.Children)
-					child->CalculateIntersections(viewSpaceBoundingFrustum, inverseViewMatrix);
+					child->AddAllObjects(queryID, output);
 			}
 			else
 			{
 				for (const auto& object : m_state.Objects)
-					object->Intersects(viewSpaceBoundingFrustum, inverseViewMatrix);
+				{
+					if (object->MarkAsVisited(queryID))
+						output.push_back(object);
+				}
 			}
 		}
 
-	private:
-		void AddObjectToArray(Type* object)
+		bool AddObjectToArray(Type* object)
 		{
 			auto& objects = m_state.Objects;
 
@@ -89,20 +228,39 @@ namespace GraphicsEngine
 
 			// If the array contains the object, we can return successfully:
 			if (location != objects.end())
-				return;
+				return false;
 
 			// Add object to array:
 			objects.push_back(object);
 			++m_objectCount;
+			return true;
 		}
-		void AddObjectToChildNodes(Type* object)
+		bool AddObjectToChildNodes(Type* object)
 		{
-			m_objectCount++;
-
+			auto added = false;
 			for (auto& child : m_state.Children)
-				child->AddObject(object);
+				added = child->AddObject(object) || added;
+
+			if (added)
+				++m_objectCount;
+
+			return added;
 		}
-		void ConvertToNonLeaf(Type* newObject)
+		bool RemoveObjectFromArray(Type* object)
+		{
+			auto& objects = m_state.Objects;
+
+			auto location = std::find(objects.begin(), objects.end(), object);
+			if (location == objects.end())
+				return false;
+
+			// Order of objects doesn't matter, so swap with the last one:
+			*location = objects.back();
+			objects.pop_back();
+			--m_objectCount;
+			return true;
+		}
+		bool ConvertToNonLeaf(Type* newObject)
 		{
 			using namespace DirectX;
 
@@ -110,7 +268,8 @@ namespace GraphicsEngine
 
 			// Move objects to a temporary list:
 			std::vector<Type*> objects(std::move(m_state.Objects));
-			m_objectCount -= m_objectsPerLeaf;
+			m_state.Objects.clear();
+			m_objectCount = 0;
 
 			// Create child nodes:
 			CreateChildNodes();
@@ -118,7 +277,46 @@ namespace GraphicsEngine
 			// Add objects from temporary list to the child nodes:
 			for (auto object : objects)
 				AddObjectToChildNodes(object);
-			AddObjectToChildNodes(newObject);
+			return AddObjectToChildNodes(newObject);
+		}
+		void ConvertToLeaf()
+		{
+			// Gather the objects of all descendants, as an object can be shared by several of them:
+			std::vector<Type*> objects;
+			objects.reserve(m_objectCount);
+			GatherObjects(objects);
+
+			DeleteChildNodes();
+
+			m_isLeaf = true;
+			m_state.Objects = std::move(objects);
+			m_objectCount = m_state.Objects.size();
+		}
+		void GatherObjects(std::vector<Type*>& objects) const
+		{
+			if (!m_isLeaf)
+			{
+				for (const auto& child : m_state.Children)
+					child->GatherObjects(objects);
+				return;
+			}
+
+			for (auto object : m_state.Objects)
+			{
+				if (std::find(objects.cbegin(), objects.cend(), object) == objects.cend())
+					objects.push_back(object);
+			}
+		}
+		void DeleteChildNodes()
+		{
+			for (auto& child : m_state.Children)
+			{
+				if (!child->m_isLeaf)
+					child->DeleteChildNodes();
+
+				m_nodeStorage->DeleteElement(*child);
+				child = nullptr;
+			}
 		}
 		void CreateChildNodes()
 		{
@@ -142,7 +340,7 @@ namespace GraphicsEngine
 		}
 		Octree& CreateChildOctree(size_t objectsPerLeaf, DirectX::BoundingBox&& boundingBox, const DirectX::XMFLOAT3& minExtents)
 		{
-			return s_memoryPool.NewElement(objectsPerLeaf, std::forward<DirectX::BoundingBox>(boundingBox), minExtents);
+			return m_nodeStorage->NewElement(objectsPerLeaf, std::forward<DirectX::BoundingBox>(boundingBox), minExtents, m_nodeStorage);
 		}
 
 		bool IsSmall() const
@@ -161,8 +359,11 @@ namespace GraphicsEngine
 		size_t m_objectCount;
 		size_t m_objectsPerLeaf;
 		DirectX::XMFLOAT3 m_minExtents;
+		// Only set on the root node, so that the storage of the child nodes is released with the octree:
+		std::unique_ptr<NodeStorage> m_ownedNodeStorage;
+		NodeStorage* m_nodeStorage;
 	};
 
 	template<typename Type>
-	MemoryPool<Octree<Type>, Octree<Type>::s_memoryPoolSize> Octree<Type>::s_memoryPool;
+	std::atomic<uint32_t> Octree<Type>::s_queryCounter(0);
 }
@@ -1,15 +1,40 @@
 #pragma once
 
 #include <DirectXCollision.h>
+#include <atomic>
+#include <cstdint>
 
 namespace GraphicsEngine
 {
+	class Frustum;
+
 	class OctreeBaseCollider
 	{
 	public:
+		OctreeBaseCollider() = default;
+		OctreeBaseCollider(const OctreeBaseCollider& other) :
+			m_lastQueryID(other.m_lastQueryID.load(std::memory_order_relaxed))
+		{
+		}
+		OctreeBaseCollider& operator=(const OctreeBaseCollider& other)
+		{
+			m_lastQueryID.store(other.m_lastQueryID.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			return *this;
+		}
 		virtual ~OctreeBaseCollider() = default;
 
 		virtual bool Intersects(const DirectX::BoundingBox& box) const = 0;
-		virtual bool XM_CALLCONV Intersects(const DirectX::BoundingFrustum& viewSpaceCameraFrustum, DirectX::FXMMATRIX inverseViewMatrix) const = 0;
+		virtual bool Intersects(const Frustum& frustum) const = 0;
+		virtual void SetBounds(const DirectX::BoundingBox& bounds) = 0;
+		virtual const DirectX::BoundingBox& GetBounds() const = 0;
+
+		// Returns true only for the first call with a given query ID, so that objects shared by several nodes are visited once:
+		bool MarkAsVisited(uint32_t queryID) const
+		{
+			return m_lastQueryID.exchange(queryID, std::memory_order_relaxed) != queryID;
+		}
+
+	private:
+		mutable std::atomic<uint32_t> m_lastQueryID { 0 };
 	};
-}
\ No newline at end of file
+}
@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 #include "OctreeBaseCollider.h"
+#include "Common/SlotMap.h"
 
 #include <DirectXCollision.h>
 
@@ -12,17 +13,26 @@ namespace GraphicsEngine
 	{
 	public:
 		OctreeCollider() = default;
-		explicit OctreeCollider(NormalRenderItem* renderItem, uint32_t instanceID) :
+		explicit OctreeCollider(NormalRenderItem* renderItem, SlotMapHandle instance, const DirectX::BoundingBox& bounds) :
 			m_renderItem(renderItem),
-			m_instanceID(instanceID)
+			m_instance(instance),
+			m_bounds(bounds)
 		{
 		}
 
 		bool Intersects(const DirectX::BoundingBox& box) const override;
-		bool XM_CALLCONV Intersects(const DirectX::BoundingFrustum& viewSpaceCameraFrustum, DirectX::FXMMATRIX inverseViewMatrix) const override;
+		bool Intersects(const Frustum& frustum) const override;
+		void SetBounds(const DirectX::BoundingBox& bounds) override;
+		const DirectX::BoundingBox& GetBounds() const override;
+
+		NormalRenderItem* GetRenderItem() const;
+		SlotMapHandle GetInstance() const;
 
 	private:
 		NormalRenderItem* m_renderItem;
-		uint32_t m_instanceID;
+		SlotMapHandle m_instance;
+
+		// World space bounds of the instance:
+		DirectX::BoundingBox m_bounds;
 	};
 }
@@ -19,3 +19,12 @@ DirectX::XMVECTOR Ray::CalculatePoint(float distance) const
 {
 	return m_origin + m_direction * distance;
 }
+
+DirectX::XMVECTOR Ray::GetOrigin() const
+{
+	return m_origin;
+}
+DirectX::XMVECTOR Ray::GetDirection() const
+{
+	return m_direction;
+}
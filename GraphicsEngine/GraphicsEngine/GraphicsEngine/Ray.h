@@ -33,6 +33,9 @@ namespace GraphicsEngine
 
 		DirectX::XMVECTOR CalculatePoint(float distance) const;
 
+		DirectX::XMVECTOR GetOrigin() const;
+		DirectX::XMVECTOR GetDirection() const;
+
 	private:
 		DirectX::XMVECTOR m_origin;
 		DirectX::XMVECTOR m_direction;
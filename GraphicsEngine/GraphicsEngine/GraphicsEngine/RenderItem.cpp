@@ -4,7 +4,16 @@
 
 using namespace GraphicsEngine;
 
-std::string RenderItem::GetName() const
+void RenderItem::RenderShadowCasters(ID3D11DeviceContext* deviceContext) const
+{
+	Render(deviceContext);
+}
+void RenderItem::RenderCubeMapFace(ID3D11DeviceContext* deviceContext, size_t face) const
+{
+	Render(deviceContext);
+}
+
+const std::string& RenderItem::GetName() const
 {
 	return m_name;
 }
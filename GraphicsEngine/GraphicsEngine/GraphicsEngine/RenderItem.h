@@ -16,9 +16,15 @@ namespace GraphicsEngine
 		virtual void Render(ID3D11DeviceContext* deviceContext) const = 0;
 		virtual void RenderNonInstanced(ID3D11DeviceContext* deviceContext) const = 0;
 
+		// Renders the instances which cast shadows into the view of the camera. By default, the same instances as Render:
+		virtual void RenderShadowCasters(ID3D11DeviceContext* deviceContext) const;
+
+		// Renders the instances visible from a face of the dynamic cube map. By default, the same instances as Render:
+		virtual void RenderCubeMapFace(ID3D11DeviceContext* deviceContext, size_t face) const;
+
 		virtual void RemoveLastInstance() = 0;
 
-		std::string GetName() const;
+		const std::string& GetName() const;
 		void SetName(const std::string& name);
 		Material* GetMaterial() const;
 		void SetMaterial(Material* material);
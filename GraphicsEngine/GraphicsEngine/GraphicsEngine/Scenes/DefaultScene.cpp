@@ -8,6 +8,7 @@
 #include "GraphicsEngine/GeometryGenerator.h"
 #include "Common/Helpers.h"
 
+#include <algorithm>
 #include <numeric>
 #include "GraphicsEngine/ImmutableMeshGeometry.h"
 #include "GraphicsEngine/NormalRenderItem.h"
@@ -101,13 +102,16 @@ void DefaultScene::AddNormalInstances(Graphics* graphics, const std::string& nam
 		renderItems.push_back(renderItem);
 	}
 
+	std::vector<float> heights;
+	GetInstanceHeights(instancesData, heights);
+
 	auto instanceDataCount = instancesData.size();
 	for (size_t i = 0; i < instanceDataCount; ++i)
 	{
 		const auto& instanceData = instancesData[i];
 		
 		const auto& position = instanceData.Position;
-		XMFLOAT3 positionW(position.x, m_terrain.GetTerrainHeight(position.x, position.y), position.y);
+		XMFLOAT3 positionW(position.x, heights[i], position.y);
 
 		ShaderBufferTypes::InstanceData instanceDataBuffer;
 
@@ -135,6 +139,9 @@ void DefaultScene::AddBillboardInstances(Graphics* graphics, const std::string&
 		renderItems.push_back(renderItem);
 	}
 
+	std::vector<float> heights;
+	GetInstanceHeights(instancesData, heights);
+
 	auto instanceDataCount = instancesData.size();
 	for (size_t i = 0; i < instanceDataCount; ++i)
 	{
@@ -143,7 +150,7 @@ void DefaultScene::AddBillboardInstances(Graphics* graphics, const std::string&
 		BillboardMeshGeometry::VertexType instanceDataBuffer;
 
 		const auto& position = instanceData.Position;
-		instanceDataBuffer.Center = XMFLOAT3(position.x, m_terrain.GetTerrainHeight(position.x, position.y) + yOffset, position.y);
+		instanceDataBuffer.Center = XMFLOAT3(position.x, heights[i] + yOffset, position.y);
 		instanceDataBuffer.Extents = XMFLOAT2(instanceData.Scale.x, instanceData.Scale.y);
 
 		for (auto renderItem : renderItems)
@@ -165,10 +172,7 @@ void DefaultScene::AddTreeInstances(Graphics* graphics, const std::vector<SceneB
 void DefaultScene::RemoveLastInstance(Graphics* graphics, const std::string& itemName, const std::initializer_list<std::string>& renderItemNames)
 {
 	for(const auto& renderItemName : renderItemNames)
-	{
-		auto renderItem = graphics->GetRenderItem(renderItemName);
-		(*renderItem)->RemoveLastInstance();
-	}
+		graphics->RemoveLastRenderItemInstance(renderItemName);
 
 	m_sceneBuilder.RemoveLastRenderItemInstance(itemName);
 }
@@ -611,3 +615,10 @@ void DefaultScene::InitializeLights(LightManager& lightManager)
 	//lightManager.AddLight(std::make_unique<Light>(Light::CreatePointLight({ 0.8f, 0.8f, 0.8f }, 50.0f, 100.0f, { -295.0f, 28.0f, 448.0f })));
 	//lightManager.AddLight(std::make_unique<Light>(Light::CreatePointLight({ 0.8f, 0.8f, 0.8f }, 100.0f, 500.0f, { 220.0f - 512.0f, 27.0f, -(0.0f - 512.0f) })));
 }
+void DefaultScene::GetInstanceHeights(const std::vector<SceneBuilder::RenderItemInstanceData>& instancesData, std::vector<float>& heights) const
+{
+	// Query the heights of all the instances at once:
+	std::vector<XMFLOAT2> positions(instancesData.size());
+	std::transform(instancesData.begin(), instancesData.end(), positions.begin(), [](const SceneBuilder::RenderItemInstanceData& instanceData) { return instanceData.Position; });
+	m_terrain.GetTerrainHeights(positions, heights);
+}
@@ -49,6 +49,7 @@ namespace GraphicsEngine
 		void InitializeMaterials(TextureManager& textureManager);
 		void InitializeRenderItems(Graphics* graphics, const D3DBase& d3dBase, TextureManager& textureManager);
 		void InitializeLights(LightManager& lightManager);
+		void GetInstanceHeights(const std::vector<SceneBuilder::RenderItemInstanceData>& instancesData, std::vector<float>& heights) const;
 
 	private:
 		bool m_initialized = false;
@@ -22,16 +22,17 @@ SceneBuilder::~SceneBuilder()
 	SaveToFile();
 }
 
-void SceneBuilder::AddRenderItemInstance(const std::string& renderItemID, const RenderItemInstanceData& data)
+SlotMapHandle SceneBuilder::AddRenderItemInstance(const std::string& renderItemID, const RenderItemInstanceData& data)
+{
+	return m_renderItemsData[renderItemID].Insert(data);
+}
+void SceneBuilder::RemoveRenderItemInstance(const std::string& renderItemID, SlotMapHandle instance)
 {
 	auto location = m_renderItemsData.find(renderItemID);
 	if (location == m_renderItemsData.end())
-	{
-		m_renderItemsData.emplace(renderItemID, std::vector<RenderItemInstanceData>(1, data));
 		return;
-	}
 
-	location->second.push_back(data);
+	location->second.Remove(instance);
 }
 void SceneBuilder::RemoveLastRenderItemInstance(const std::string& renderItemID)
 {
@@ -39,8 +40,9 @@ void SceneBuilder::RemoveLastRenderItemInstance(const std::string& renderItemID)
 	if (location == m_renderItemsData.end())
 		return;
 
-	if(!location->second.empty())
-		location->second.pop_back();
+	auto& renderItemInstancesData = location->second;
+	if (!renderItemInstancesData.IsEmpty())
+		renderItemInstancesData.Remove(renderItemInstancesData.GetHandle(renderItemInstancesData.GetSize() - 1));
 }
 
 const std::vector<SceneBuilder::RenderItemInstanceData>& SceneBuilder::GetRenderItemInstances(const std::string& renderItemID) const
@@ -49,7 +51,7 @@ const std::vector<SceneBuilder::RenderItemInstanceData>& SceneBuilder::GetRender
 	if (location == m_renderItemsData.end())
 		return s_renderItemsDataEmpty;
 
-	return location->second;
+	return location->second.GetElements();
 }
 
 void SceneBuilder::SaveToFile()
@@ -115,7 +117,7 @@ void SceneBuilder::LoadFromFile()
 			const auto& scaleJson = instanceData.at("Scale");
 			renderItemInstanceData.Scale = XMFLOAT3(scaleJson[0].get<float>(), scaleJson[1].get<float>(), scaleJson[2].get<float>());
 
-			renderItemInstancesData.push_back(renderItemInstanceData);
+			renderItemInstancesData.Insert(renderItemInstanceData);
 		}
 	}
 }
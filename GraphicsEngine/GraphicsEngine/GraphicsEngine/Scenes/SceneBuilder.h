@@ -4,6 +4,8 @@
 
 #include <DirectXMath.h>
 
+#include "Common/SlotMap.h"
+
 namespace GraphicsEngine
 {
 	class SceneBuilder
@@ -21,8 +23,10 @@ namespace GraphicsEngine
 		explicit SceneBuilder(const std::wstring& filename);
 		~SceneBuilder();
 
-		void AddRenderItemInstance(const std::string& renderItemID, const RenderItemInstanceData& data);
+		SlotMapHandle AddRenderItemInstance(const std::string& renderItemID, const RenderItemInstanceData& data);
+		void RemoveRenderItemInstance(const std::string& renderItemID, SlotMapHandle instance);
 		void RemoveLastRenderItemInstance(const std::string& renderItemID);
+		// Removing an instance moves the last instance into its place:
 		const std::vector<RenderItemInstanceData>& GetRenderItemInstances(const std::string& renderItemID) const;
 
 		void SaveToFile();
@@ -30,7 +34,7 @@ namespace GraphicsEngine
 
 	private:
 		std::wstring m_filename;
-		std::unordered_map<std::string, std::vector<RenderItemInstanceData>> m_renderItemsData;
+		std::unordered_map<std::string, SlotMap<RenderItemInstanceData>> m_renderItemsData;
 		static std::vector<RenderItemInstanceData> s_renderItemsDataEmpty;
 	};
 }
@@ -67,5 +67,12 @@ namespace GraphicsEngine
 			static constexpr auto MaxNumLights = 16;
 			std::array<LightData, MaxNumLights> Lights;
 		};
+
+		struct TerrainPatchData
+		{
+			// A constant buffer holds up to 4096 vectors, so the terrain patches are drawn in batches of this size:
+			static constexpr auto MaxPatchCount = 4096;
+			std::array<DirectX::XMFLOAT4, MaxPatchCount> EdgeTesselationFactors;
+		};
 	}
 }
@@ -1,8 +1,15 @@
 #define NUM_CONTROL_POINTS 4
+#define MAX_PATCH_COUNT 4096
 
 #include "LightingUtils.hlsli"
 #include "PassData.hlsli"
 
+// Edge tesselation factors of each patch of the draw call, selected by the terrain quadtree:
+cbuffer TerrainPatchData : register(b3)
+{
+    float4 PatchEdgeTesselationFactors[MAX_PATCH_COUNT];
+};
+
 struct VertexOutput
 {
     float3 PositionW : POSITION;
@@ -30,37 +37,20 @@ int PowerOfTwo(int x)
     return result;
 }
 
-float CalculateTesselationFactor(float3 positionW)
-{
-	// Calculate the distance from the vertex to the camera:
-    float distanceToEye = distance(EyePositionW, positionW);
-
-	// Calculate the tesselation factor:
-    float blendFactor = saturate((MinTesselationDistance - distanceToEye) / (MinTesselationDistance - MaxTesselationDistance));   
-    return (float) PowerOfTwo((int) lerp(MinTesselationFactor, MaxTesselationFactor, blendFactor));
-}
-
 TesselationPatch CalculatePatchConstants(InputPatch<VertexOutput, NUM_CONTROL_POINTS> inputPatch, uint patchID : SV_PrimitiveID)
 {
     TesselationPatch output;
 
-	// Calculate the center of each edge:
 	// 1st u==0, 2nd v==0, 3rd u==1, 4th v==1
-	// The ordering of the edges is clockwise, starting from the u==0, which is the left side of the patch, and from the v==0 edge, which is the top of the patch:
-    float3 leftEdgeCenter = 0.5f * (inputPatch[0].PositionW + inputPatch[2].PositionW);
-    float3 topEdgeCenter = 0.5f * (inputPatch[2].PositionW + inputPatch[3].PositionW);
-    float3 rightEdgeCenter = 0.5f * (inputPatch[1].PositionW + inputPatch[3].PositionW);
-    float3 bottomEdgeCenter = 0.5f * (inputPatch[0].PositionW + inputPatch[1].PositionW);
-
-	// Calculate the tesselation factor of each edge:
-    output.EdgeTesselationFactor[0] = CalculateTesselationFactor(leftEdgeCenter);
-    output.EdgeTesselationFactor[1] = CalculateTesselationFactor(topEdgeCenter);
-    output.EdgeTesselationFactor[2] = CalculateTesselationFactor(rightEdgeCenter);
-    output.EdgeTesselationFactor[3] = CalculateTesselationFactor(bottomEdgeCenter);
-
-	// Calculate the inside tesselation factors:
-    float3 center = 0.25f * (inputPatch[0].PositionW + inputPatch[1].PositionW + inputPatch[2].PositionW + inputPatch[3].PositionW);
-    output.InsideTesselationFactor[0] = CalculateTesselationFactor(center);
+	// The edges facing a coarser patch use half of the inside factor, so that their vertices match the ones of the coarser patch:
+    float4 edgeTesselationFactors = PatchEdgeTesselationFactors[patchID];
+    output.EdgeTesselationFactor[0] = edgeTesselationFactors.x;
+    output.EdgeTesselationFactor[1] = edgeTesselationFactors.y;
+    output.EdgeTesselationFactor[2] = edgeTesselationFactors.z;
+    output.EdgeTesselationFactor[3] = edgeTesselationFactors.w;
+
+	// The size of the patches is selected on the CPU, so every patch is tesselated with the maximum factor:
+    output.InsideTesselationFactor[0] = (float) PowerOfTwo((int) MaxTesselationFactor);
     output.InsideTesselationFactor[1] = output.InsideTesselationFactor[0];
 
     return output;
@@ -0,0 +1,194 @@
+#include "stdafx.h"
+#include "ShadowCasterVolume.h"
+#include "Frustum.h"
+
+#include <cassert>
+
+using namespace DirectX;
+using namespace GraphicsEngine;
+
+ShadowCasterVolume::ShadowCasterVolume(FXMVECTOR lightDirection, CXMMATRIX lightViewProjectionMatrix, CXMMATRIX cameraViewProjectionMatrix)
+{
+	// Casters must be inside of the light frustum to be rendered into the shadow map:
+	Frustum lightFrustum(lightViewProjectionMatrix);
+	for (size_t i = 0; i < Frustum::PlaneCount; ++i)
+		AddPlane(XMLoadFloat4(&lightFrustum.GetPlane(i)));
+
+	// Moving a point towards the light keeps it inside of the camera frustum planes which face away from the light:
+	Frustum cameraFrustum(cameraViewProjectionMatrix);
+	std::array<bool, Frustum::PlaneCount> keptPlanes;
+	for (size_t i = 0; i < Frustum::PlaneCount; ++i)
+	{
+		auto plane = XMLoadFloat4(&cameraFrustum.GetPlane(i));
+		keptPlanes[i] = XMVectorGetX(XMVector3Dot(plane, lightDirection)) <= 0.0f;
+		if (keptPlanes[i])
+			AddPlane(plane);
+	}
+
+	// Calculate the corners of the camera frustum, where the bits 0, 1 and 2 of the index select right, top and far:
+	auto determinant = XMMatrixDeterminant(cameraViewProjectionMatrix);
+	auto inverseViewProjectionMatrix = XMMatrixInverse(&determinant, cameraViewProjectionMatrix);
+	std::array<XMVECTOR, 8> corners;
+	auto center = XMVectorZero();
+	for (size_t i = 0; i < corners.size(); ++i)
+	{
+		auto ndcCorner = XMVectorSet((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : 0.0f, 1.0f);
+		corners[i] = XMVector3TransformCoord(ndcCorner, inverseViewProjectionMatrix);
+		center = XMVectorAdd(center, corners[i]);
+	}
+	center = XMVectorScale(center, 1.0f / corners.size());
+
+	// The plane of the face selected by an axis and the bit of a corner along that axis is 2 * axis + bit (left, right, bottom, top, near, far).
+	// An edge is on the silhouette of the extruded frustum if only one of its adjacent faces was kept:
+	for (size_t axis = 0; axis < 3; ++axis)
+	{
+		auto axisBit = static_cast<size_t>(1) << axis;
+		auto otherAxis0 = (axis + 1) % 3;
+		auto otherAxis1 = (axis + 2) % 3;
+
+		for (size_t corner = 0; corner < corners.size(); ++corner)
+		{
+			if ((corner & axisBit) != 0)
+				continue;
+
+			auto face0 = 2 * otherAxis0 + ((corner >> otherAxis0) & 1);
+			auto face1 = 2 * otherAxis1 + ((corner >> otherAxis1) & 1);
+			if (keptPlanes[face0] == keptPlanes[face1])
+				continue;
+
+			// Build the plane containing the edge and the light direction:
+			auto edgeBegin = corners[corner];
+			auto edgeEnd = corners[corner | axisBit];
+			auto normal = XMVector3Cross(XMVectorSubtract(edgeEnd, edgeBegin), lightDirection);
+			if (XMVectorGetX(XMVector3LengthSq(normal)) < 1e-8f)
+				continue;
+
+			normal = XMVector3Normalize(normal);
+			auto plane = XMVectorSetW(normal, -XMVectorGetX(XMVector3Dot(normal, edgeBegin)));
+
+			// Make the normal point inward:
+			if (XMVectorGetX(XMPlaneDotCoord(plane, center)) < 0.0f)
+				plane = XMVectorNegate(plane);
+
+			AddPlane(plane);
+		}
+	}
+}
+
+ContainmentType ShadowCasterVolume::Contains(const BoundingBox& box) const
+{
+	auto center = XMVectorSetW(XMLoadFloat3(&box.Center), 1.0f);
+	auto extents = XMLoadFloat3(&box.Extents);
+
+	auto containment = ContainmentType::CONTAINS;
+	for (size_t i = 0; i < m_planeCount; ++i)
+	{
+		auto planeVector = XMLoadFloat4(&m_planes[i]);
+
+		// Calculate the signed distance of the center and the projected radius of the box:
+		auto distance = XMVectorGetX(XMVector4Dot(planeVector, center));
+		auto radius = XMVectorGetX(XMVector3Dot(XMVectorAbs(planeVector), extents));
+
+		// If the box is completely behind the plane:
+		if (distance + radius < 0.0f)
+			return ContainmentType::DISJOINT;
+
+		// If the box crosses the plane:
+		if (distance - radius < 0.0f)
+			containment = ContainmentType::INTERSECTS;
+	}
+
+	return containment;
+}
+
+size_t ShadowCasterVolume::CalculateShadowCasters(const BoundingBoxArray& boxes, size_t begin, size_t end, uint32_t* casterIndices) const
+{
+	assert(begin % BoundingBoxArray::GroupSize == 0);
+
+	// Replicate every plane component across the lanes of a vector:
+	struct ReplicatedPlane
+	{
+		XMVECTOR NormalX, NormalY, NormalZ, Distance;
+		XMVECTOR AbsNormalX, AbsNormalY, AbsNormalZ;
+	};
+	std::array<ReplicatedPlane, MaxPlaneCount> planes;
+	for (size_t i = 0; i < m_planeCount; ++i)
+	{
+		const auto& plane = m_planes[i];
+		planes[i].NormalX = XMVectorReplicate(plane.x);
+		planes[i].NormalY = XMVectorReplicate(plane.y);
+		planes[i].NormalZ = XMVectorReplicate(plane.z);
+		planes[i].Distance = XMVectorReplicate(plane.w);
+		planes[i].AbsNormalX = XMVectorAbs(planes[i].NormalX);
+		planes[i].AbsNormalY = XMVectorAbs(planes[i].NormalY);
+		planes[i].AbsNormalZ = XMVectorAbs(planes[i].NormalZ);
+	}
+
+	const auto* centersX = boxes.GetComponent(BoundingBoxArray::Component::CenterX);
+	const auto* centersY = boxes.GetComponent(BoundingBoxArray::Component::CenterY);
+	const auto* centersZ = boxes.GetComponent(BoundingBoxArray::Component::CenterZ);
+	const auto* extentsX = boxes.GetComponent(BoundingBoxArray::Component::ExtentsX);
+	const auto* extentsY = boxes.GetComponent(BoundingBoxArray::Component::ExtentsY);
+	const auto* extentsZ = boxes.GetComponent(BoundingBoxArray::Component::ExtentsZ);
+
+	size_t casterCount = 0;
+	for (size_t group = begin; group < end; group += BoundingBoxArray::GroupSize)
+	{
+		// Load the next group of boxes:
+		auto centerX = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(centersX + group));
+		auto centerY = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(centersY + group));
+		auto centerZ = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(centersZ + group));
+		auto extentX = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(extentsX + group));
+		auto extentY = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(extentsY + group));
+		auto extentZ = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(extentsZ + group));
+
+		// A box is outside if it is completely behind any of the planes, stopping as soon as all boxes of the group are:
+		auto outside = XMVectorFalseInt();
+		for (size_t i = 0; i < m_planeCount; ++i)
+		{
+			const auto& plane = planes[i];
+			auto distance = XMVectorMultiplyAdd(plane.NormalX, centerX, plane.Distance);
+			distance = XMVectorMultiplyAdd(plane.NormalY, centerY, distance);
+			distance = XMVectorMultiplyAdd(plane.NormalZ, centerZ, distance);
+
+			auto radius = XMVectorMultiply(plane.AbsNormalX, extentX);
+			radius = XMVectorMultiplyAdd(plane.AbsNormalY, extentY, radius);
+			radius = XMVectorMultiplyAdd(plane.AbsNormalZ, extentZ, radius);
+
+			outside = XMVectorOrInt(outside, XMVectorLess(XMVectorAdd(distance, radius), XMVectorZero()));
+			if (XMVector4EqualInt(outside, XMVectorTrueInt()))
+				break;
+		}
+
+		// Skip the group if all boxes are outside:
+		if (XMVector4EqualInt(outside, XMVectorTrueInt()))
+			continue;
+
+		// Append the casters without branching on each lane:
+		std::array<uint32_t, BoundingBoxArray::GroupSize> lanes;
+		XMStoreInt4(lanes.data(), outside);
+		auto laneCount = end - group < BoundingBoxArray::GroupSize ? end - group : BoundingBoxArray::GroupSize;
+		for (size_t lane = 0; lane < laneCount; ++lane)
+		{
+			casterIndices[casterCount] = static_cast<uint32_t>(group + lane);
+			casterCount += lanes[lane] == 0 ? 1 : 0;
+		}
+	}
+
+	return casterCount;
+}
+
+size_t ShadowCasterVolume::GetPlaneCount() const
+{
+	return m_planeCount;
+}
+const XMFLOAT4& ShadowCasterVolume::GetPlane(size_t index) const
+{
+	return m_planes[index];
+}
+
+void ShadowCasterVolume::AddPlane(FXMVECTOR plane)
+{
+	assert(m_planeCount < MaxPlaneCount);
+	XMStoreFloat4(&m_planes[m_planeCount++], plane);
+}
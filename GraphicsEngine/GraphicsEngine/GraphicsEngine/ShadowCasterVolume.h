@@ -0,0 +1,41 @@
+#pragma once
+
+#include "BoundingBoxArray.h"
+
+#include <DirectXCollision.h>
+#include <array>
+#include <cstdint>
+
+namespace GraphicsEngine
+{
+	// Convex volume containing every object which can cast a shadow of a directional light into the view of the camera.
+	// It is the intersection of the light frustum with the camera frustum extruded towards the light, whose planes are
+	// the camera frustum planes facing away from the light and the planes through its silhouette edges parallel to the light direction.
+	class ShadowCasterVolume
+	{
+	public:
+		static constexpr size_t MaxPlaneCount = 24;
+
+	public:
+		ShadowCasterVolume() = default;
+
+		// The light direction is the direction in which the light travels:
+		explicit ShadowCasterVolume(DirectX::FXMVECTOR lightDirection, DirectX::CXMMATRIX lightViewProjectionMatrix, DirectX::CXMMATRIX cameraViewProjectionMatrix);
+
+		DirectX::ContainmentType Contains(const DirectX::BoundingBox& box) const;
+
+		// Tests the boxes in the range [begin, end) and writes the indices of the non-disjoint ones into casterIndices.
+		// The begin index must be a multiple of BoundingBoxArray::GroupSize. Returns the number of shadow casters.
+		size_t CalculateShadowCasters(const BoundingBoxArray& boxes, size_t begin, size_t end, uint32_t* casterIndices) const;
+
+		size_t GetPlaneCount() const;
+		const DirectX::XMFLOAT4& GetPlane(size_t index) const;
+
+	private:
+		void AddPlane(DirectX::FXMVECTOR plane);
+
+	private:
+		std::array<DirectX::XMFLOAT4, MaxPlaneCount> m_planes;
+		size_t m_planeCount = 0;
+	};
+}
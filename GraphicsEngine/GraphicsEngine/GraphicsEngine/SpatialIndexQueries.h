@@ -0,0 +1,355 @@
+#pragma once
+
+#include <DirectXCollision.h>
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "ISpatialIndex.h"
+
+namespace GraphicsEngine
+{
+	// Queries shared by the spatial indices whose nodes are stored contiguously, with adjacent children, and whose subtrees
+	// reference contiguous ranges of a single array of objects, each object belonging to a single leaf.
+	// The node type must provide Bounds, FirstChild, ChildCount, FirstObject and ObjectCount.
+	// Queries only read the index and write into the buffers of the caller, so they can run concurrently without allocating.
+	// The nodes above an object which moved are refitted with FindLeafPath and RefitPath, and objects are added to or removed
+	// from a leaf with InsertObject and RemoveObject, which shift the ranges of the nodes after them.
+	template<
+		typename Type,
+		typename NodeType
+	>
+		class SpatialIndexQueries
+	{
+	public:
+		using RayHit = typename ISpatialIndex<Type>::RayHit;
+		using NearestObject = typename ISpatialIndex<Type>::NearestObject;
+
+		// The volume type must provide Contains(const BoundingBox&) and Intersects(const BoundingBox&):
+		template<typename VolumeType>
+		static size_t CalculateIntersections(const std::vector<NodeType>& nodes, const std::vector<Type*>& objects, const VolumeType& volume, Type** output, size_t capacity)
+		{
+			size_t count = 0;
+			if (!nodes.empty())
+				CalculateIntersections(nodes, objects, 0, volume, output, capacity, count);
+
+			return count;
+		}
+
+		static bool CalculateFirstRayHit(const std::vector<NodeType>& nodes, const std::vector<Type*>& objects, const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, RayHit& hit)
+		{
+			using namespace DirectX;
+
+			hit.Object = nullptr;
+			hit.Distance = maxDistance;
+			if (nodes.empty())
+				return false;
+
+			auto rayOrigin = XMLoadFloat3(&origin);
+			auto rayDirection = XMVector3Normalize(XMLoadFloat3(&direction));
+			float distance;
+			if (!IntersectsRay(nodes[0].Bounds, rayOrigin, rayDirection, distance) || distance >= maxDistance)
+				return false;
+
+			CalculateFirstRayHit(nodes, objects, 0, rayOrigin, rayDirection, hit);
+			return hit.Object != nullptr;
+		}
+		static size_t CalculateRayHits(const std::vector<NodeType>& nodes, const std::vector<Type*>& objects, const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, RayHit* output, size_t capacity)
+		{
+			using namespace DirectX;
+
+			size_t count = 0;
+			if (!nodes.empty())
+				CalculateRayHits(nodes, objects, 0, XMLoadFloat3(&origin), XMVector3Normalize(XMLoadFloat3(&direction)), maxDistance, output, capacity, count);
+
+			// The output is a max-heap of the nearest hits:
+			std::sort_heap(output, output + std::min(count, capacity), IsNearerHit);
+			return count;
+		}
+
+		static size_t CalculateNearestObjects(const std::vector<NodeType>& nodes, const std::vector<Type*>& objects, const DirectX::XMFLOAT3& position, NearestObject* output, size_t count)
+		{
+			using namespace DirectX;
+
+			if (nodes.empty() || count == 0)
+				return 0;
+
+			// The output is used as a max-heap of the nearest objects found so far, so the farthest one can be replaced:
+			size_t foundCount = 0;
+			CalculateNearestObjects(nodes, objects, 0, XMLoadFloat3(&position), output, count, foundCount);
+
+			std::sort_heap(output, output + foundCount, IsNearer);
+			return foundCount;
+		}
+
+		// Writes the nodes from the root to the leaf which holds the object at the given position of the objects:
+		static void FindLeafPath(const std::vector<NodeType>& nodes, uint32_t objectIndex, std::vector<uint32_t>& path)
+		{
+			path.clear();
+			path.push_back(0);
+			while (nodes[path.back()].ChildCount != 0)
+			{
+				// The object ranges of the children split the range of their parent:
+				auto childIndex = nodes[path.back()].FirstChild;
+				while (objectIndex >= nodes[childIndex].FirstObject + nodes[childIndex].ObjectCount)
+					++childIndex;
+				path.push_back(childIndex);
+			}
+		}
+		// Fits the leaf at the end of the path to the bounds of its objects, and then each node above it to its children:
+		static void RefitPath(std::vector<NodeType>& nodes, const std::vector<Type*>& objects, const std::vector<uint32_t>& path)
+		{
+			using namespace DirectX;
+
+			auto& leaf = nodes[path.back()];
+			auto minimum = XMVectorReplicate(FLT_MAX);
+			auto maximum = XMVectorReplicate(-FLT_MAX);
+			for (auto i = leaf.FirstObject; i < leaf.FirstObject + leaf.ObjectCount; ++i)
+			{
+				const auto& bounds = objects[i]->GetBounds();
+				auto center = XMLoadFloat3(&bounds.Center);
+				auto extents = XMLoadFloat3(&bounds.Extents);
+				minimum = XMVectorMin(minimum, XMVectorSubtract(center, extents));
+				maximum = XMVectorMax(maximum, XMVectorAdd(center, extents));
+			}
+			BoundingBox::CreateFromPoints(leaf.Bounds, minimum, maximum);
+
+			for (auto i = path.size() - 1; i-- > 0;)
+			{
+				auto& node = nodes[path[i]];
+				auto bounds = nodes[node.FirstChild].Bounds;
+				for (auto childIndex = node.FirstChild + 1; childIndex < node.FirstChild + node.ChildCount; ++childIndex)
+					BoundingBox::CreateMerged(bounds, bounds, nodes[childIndex].Bounds);
+				node.Bounds = bounds;
+			}
+		}
+		// Inserts the object after the objects of the leaf at the end of the path, and returns its position in the objects.
+		// The leaf must have objects, so that its bounds can be fitted:
+		static uint32_t InsertObject(std::vector<NodeType>& nodes, std::vector<Type*>& objects, const std::vector<uint32_t>& path, Type* object)
+		{
+			const auto& leaf = nodes[path.back()];
+			auto objectIndex = leaf.FirstObject + leaf.ObjectCount;
+			objects.insert(objects.begin() + objectIndex, object);
+
+			// The nodes on the path are the only ones whose range contains the new object, the ones after it are shifted:
+			for (auto& node : nodes)
+			{
+				if (node.FirstObject >= objectIndex)
+					++node.FirstObject;
+			}
+			for (auto nodeIndex : path)
+				++nodes[nodeIndex].ObjectCount;
+
+			RefitPath(nodes, objects, path);
+			return objectIndex;
+		}
+		// Removes the object at the given position from the leaf at the end of the path, which must keep other objects:
+		static void RemoveObject(std::vector<NodeType>& nodes, std::vector<Type*>& objects, const std::vector<uint32_t>& path, uint32_t objectIndex)
+		{
+			objects.erase(objects.begin() + objectIndex);
+
+			for (auto& node : nodes)
+			{
+				if (node.FirstObject > objectIndex)
+					--node.FirstObject;
+			}
+			for (auto nodeIndex : path)
+				--nodes[nodeIndex].ObjectCount;
+
+			RefitPath(nodes, objects, path);
+		}
+		// Writes the positions of the objects starting from the given one, after they were shifted by an insertion or a removal:
+		static void UpdateObjectSlots(const std::vector<Type*>& objects, uint32_t firstObject, std::unordered_map<const Type*, uint32_t>& objectSlots)
+		{
+			for (auto i = firstObject; i < objects.size(); ++i)
+				objectSlots[objects[i]] = i;
+		}
+
+	private:
+		template<typename VolumeType>
+		static void CalculateIntersections(const std::vector<NodeType>& nodes, const std::vector<Type*>& objects, uint32_t nodeIndex, const VolumeType& volume, Type** output, size_t capacity, size_t& count)
+		{
+			using namespace DirectX;
+
+			const auto& node = nodes[nodeIndex];
+			auto containment = volume.Contains(node.Bounds);
+			if (containment == ContainmentType::DISJOINT)
+				return;
+
+			// If the node is completely inside, all of the objects of its subtree intersect:
+			auto firstObject = objects.begin() + node.FirstObject;
+			if (containment == ContainmentType::CONTAINS)
+			{
+				for (auto object = firstObject; object != firstObject + node.ObjectCount; ++object)
+					AddObject(*object, output, capacity, count);
+				return;
+			}
+
+			if (node.ChildCount != 0)
+			{
+				for (auto i = node.FirstChild; i < node.FirstChild + node.ChildCount; ++i)
+					CalculateIntersections(nodes, objects, i, volume, output, capacity, count);
+			}
+			else
+			{
+				for (auto object = firstObject; object != firstObject + node.ObjectCount; ++object)
+				{
+					if (volume.Intersects((*object)->GetBounds()))
+						AddObject(*object, output, capacity, count);
+				}
+			}
+		}
+		static void AddObject(Type* object, Type** output, size_t capacity, size_t& count)
+		{
+			// Objects beyond the capacity are only counted:
+			if (count < capacity)
+				output[count] = object;
+			++count;
+		}
+
+		static void CalculateFirstRayHit(const std::vector<NodeType>& nodes, const std::vector<Type*>& objects, uint32_t nodeIndex, DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, RayHit& hit)
+		{
+			const auto& node = nodes[nodeIndex];
+			if (node.ChildCount == 0)
+			{
+				for (auto i = node.FirstObject; i < node.FirstObject + node.ObjectCount; ++i)
+				{
+					float distance;
+					if (IntersectsRay(objects[i]->GetBounds(), origin, direction, distance) && distance < hit.Distance)
+					{
+						hit.Object = objects[i];
+						hit.Distance = distance;
+					}
+				}
+				return;
+			}
+
+			// Visit the children from front to back, so that the farther ones are skipped once a closer hit is found:
+			std::array<std::pair<float, uint32_t>, 8> children;
+			size_t childCount = 0;
+			for (auto i = node.FirstChild; i < node.FirstChild + node.ChildCount; ++i)
+			{
+				float distance;
+				if (IntersectsRay(nodes[i].Bounds, origin, direction, distance) && distance < hit.Distance)
+				{
+					// Insertion sort, as there are at most eight children:
+					auto position = childCount++;
+					for (; position > 0 && children[position - 1].first > distance; --position)
+						children[position] = children[position - 1];
+					children[position] = { distance, i };
+				}
+			}
+
+			for (size_t i = 0; i < childCount && children[i].first < hit.Distance; ++i)
+				CalculateFirstRayHit(nodes, objects, children[i].second, origin, direction, hit);
+		}
+		static void CalculateRayHits(const std::vector<NodeType>& nodes, const std::vector<Type*>& objects, uint32_t nodeIndex, DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float maxDistance, RayHit* output, size_t capacity, size_t& count)
+		{
+			const auto& node = nodes[nodeIndex];
+
+			float distance;
+			if (!IntersectsRay(node.Bounds, origin, direction, distance) || distance >= maxDistance)
+				return;
+
+			if (node.ChildCount != 0)
+			{
+				for (auto i = node.FirstChild; i < node.FirstChild + node.ChildCount; ++i)
+					CalculateRayHits(nodes, objects, i, origin, direction, maxDistance, output, capacity, count);
+				return;
+			}
+
+			for (auto i = node.FirstObject; i < node.FirstObject + node.ObjectCount; ++i)
+			{
+				if (!IntersectsRay(objects[i]->GetBounds(), origin, direction, distance) || distance >= maxDistance)
+					continue;
+
+				// The output is used as a max-heap of the nearest hits found so far, so the farthest one can be replaced:
+				if (count < capacity)
+				{
+					output[count] = { objects[i], distance };
+					std::push_heap(output, output + count + 1, IsNearerHit);
+				}
+				else if (capacity != 0 && distance < output[0].Distance)
+				{
+					std::pop_heap(output, output + capacity, IsNearerHit);
+					output[capacity - 1] = { objects[i], distance };
+					std::push_heap(output, output + capacity, IsNearerHit);
+				}
+				++count;
+			}
+		}
+		static bool IntersectsRay(const DirectX::BoundingBox& bounds, DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float& distance)
+		{
+			if (!bounds.Intersects(origin, direction, distance))
+				return false;
+
+			// Rays starting inside of the box hit it at the origin:
+			distance = std::max(distance, 0.0f);
+			return true;
+		}
+
+		static void CalculateNearestObjects(const std::vector<NodeType>& nodes, const std::vector<Type*>& objects, uint32_t nodeIndex, DirectX::FXMVECTOR position, NearestObject* output, size_t count, size_t& foundCount)
+		{
+			const auto& node = nodes[nodeIndex];
+			if (node.ChildCount == 0)
+			{
+				for (auto i = node.FirstObject; i < node.FirstObject + node.ObjectCount; ++i)
+				{
+					auto distanceSquared = CalculateDistanceSquared(objects[i]->GetBounds(), position);
+					if (foundCount < count)
+					{
+						output[foundCount++] = { objects[i], distanceSquared };
+						std::push_heap(output, output + foundCount, IsNearer);
+					}
+					else if (distanceSquared < output[0].DistanceSquared)
+					{
+						std::pop_heap(output, output + count, IsNearer);
+						output[count - 1] = { objects[i], distanceSquared };
+						std::push_heap(output, output + count, IsNearer);
+					}
+				}
+				return;
+			}
+
+			// Visit the nearest children first, which shrinks the search radius as early as possible:
+			std::array<std::pair<float, uint32_t>, 8> children;
+			size_t childCount = 0;
+			for (auto i = node.FirstChild; i < node.FirstChild + node.ChildCount; ++i)
+			{
+				auto distanceSquared = CalculateDistanceSquared(nodes[i].Bounds, position);
+				auto childPosition = childCount++;
+				for (; childPosition > 0 && children[childPosition - 1].first > distanceSquared; --childPosition)
+					children[childPosition] = children[childPosition - 1];
+				children[childPosition] = { distanceSquared, i };
+			}
+
+			for (size_t i = 0; i < childCount; ++i)
+			{
+				// Once enough objects are found, the nodes farther than all of them can be skipped:
+				if (foundCount == count && children[i].first >= output[0].DistanceSquared)
+					break;
+
+				CalculateNearestObjects(nodes, objects, children[i].second, position, output, count, foundCount);
+			}
+		}
+		static float CalculateDistanceSquared(const DirectX::BoundingBox& bounds, DirectX::FXMVECTOR position)
+		{
+			using namespace DirectX;
+
+			// Distance to the closest point of the box, which is zero inside of it:
+			auto offset = XMVectorSubtract(XMVectorAbs(XMVectorSubtract(position, XMLoadFloat3(&bounds.Center))), XMLoadFloat3(&bounds.Extents));
+			return XMVectorGetX(XMVector3LengthSq(XMVectorMax(offset, XMVectorZero())));
+		}
+		static bool IsNearer(const NearestObject& object0, const NearestObject& object1)
+		{
+			return object0.DistanceSquared < object1.DistanceSquared;
+		}
+		static bool IsNearerHit(const RayHit& hit0, const RayHit& hit1)
+		{
+			return hit0.Distance < hit1.Distance;
+		}
+	};
+}
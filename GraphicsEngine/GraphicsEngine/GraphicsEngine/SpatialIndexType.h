@@ -0,0 +1,10 @@
+#pragma once
+
+namespace GraphicsEngine
+{
+	enum class SpatialIndexType
+	{
+		Octree,
+		BoundingVolumeHierarchy
+	};
+}
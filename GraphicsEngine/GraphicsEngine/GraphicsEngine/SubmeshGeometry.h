@@ -3,14 +3,25 @@
 // ReSharper disable once CppUnusedIncludeDirective
 #include <cstdint>
 #include <DirectXCollision.h>
+#include <vector>
 
 namespace GraphicsEngine
 {
 	struct SubmeshGeometry
 	{
+		// Simplified index range, sharing the vertices of the submesh:
+		struct LevelOfDetail
+		{
+			uint32_t IndexCount = 0;
+			uint32_t StartIndexLocation = 0;
+		};
+
 		uint32_t IndexCount = 0;
 		uint32_t StartIndexLocation = 0;
 		uint32_t BaseVertexLocation = 0;
 		DirectX::BoundingBox Bounds;
+
+		// Levels of detail 1 and above, from the most to the least detailed:
+		std::vector<LevelOfDetail> LevelsOfDetail;
 	};
 }
@@ -4,6 +4,8 @@
 #include "IScene.h"
 #include "TextureManager.h"
 #include "Graphics.h"
+#include "HeightMapLoader.h"
+#include "Ray.h"
 
 #include <DirectXPackedVector.h>
 #include <algorithm>
@@ -22,7 +24,7 @@ Terrain::Terrain(const D3DBase& d3dBase, Graphics& graphics, TextureManager& tex
 	m_description(description)
 {
 	CreateGeometry(d3dBase, scene);
-	CreateMaterial(d3dBase, textureManager, scene);
+	CreateMaterial(d3dBase, textureManager, graphics.GetThreadPool(), scene);
 	CreateRenderItem(d3dBase, graphics, scene);
 }
 
@@ -39,77 +41,93 @@ std::vector<DirectX::XMFLOAT3> Terrain::GenerateRandomPositions(SIZE_T count) co
 	std::uniform_real_distribution<float> xDistribution(-halfTerrainWidth + offsetWidth, halfTerrainWidth - offsetWidth);
 	std::uniform_real_distribution<float> zDistribution(-halfTerrainDepth + offsetDepth, halfTerrainDepth - offsetDepth);
 
-	std::vector<DirectX::XMFLOAT3> randomPositions(count);
+	std::vector<DirectX::XMFLOAT2> positions(count);
 	for (SIZE_T i = 0; i < count; ++i)
 	{
-		auto x = xDistribution(randomEngine);
-		auto z = zDistribution(randomEngine);
-		auto y = GetTerrainHeight(x, z);
-
-		randomPositions[i] = XMFLOAT3(x, y, z);
+		positions[i].x = xDistribution(randomEngine);
+		positions[i].y = zDistribution(randomEngine);
 	}
 
+	std::vector<float> heights;
+	GetTerrainHeights(positions, heights);
+
+	std::vector<DirectX::XMFLOAT3> randomPositions(count);
+	for (SIZE_T i = 0; i < count; ++i)
+		randomPositions[i] = XMFLOAT3(positions[i].x, heights[i], positions[i].y);
+
 	return randomPositions;
 }
 
-float Terrain::GetTerrainHeight(float x, float z) const
+void Terrain::Update(const DirectX::XMFLOAT3& cameraPosition)
 {
-	// Clamp out of bounds values:
-	auto halfTerrainWidth = 0.5f * m_description.TerrainWidth;
-	auto halfTerrainDepth = 0.5f * m_description.TerrainDepth;
-	x = min(max(x, -halfTerrainWidth), halfTerrainWidth);
-	z = min(max(z, -halfTerrainDepth), halfTerrainDepth);
-
-	// Calculate texture coordinates in the range [0, height_map_{width|height}]:
-	auto textureCoordinatesS = static_cast<uint32_t>((x / m_description.TerrainWidth + 0.5f) * m_description.HeightMapWidth);
-	auto textureCoordinatesT = static_cast<uint32_t>((-z / m_description.TerrainDepth + 0.5f) * m_description.HeightMapHeight);
-
-	// Get the heights of the cell:
-	auto topLeftHeight = m_heightMap[textureCoordinatesT * m_description.HeightMapWidth + textureCoordinatesS];
-	auto topRightHeight = m_heightMap[textureCoordinatesT * m_description.HeightMapWidth + textureCoordinatesS + 1];
-	auto lowerLeftHeight = m_heightMap[(textureCoordinatesT + 1) * m_description.HeightMapWidth + textureCoordinatesS];
-	auto lowerRightHeight = m_heightMap[(textureCoordinatesT + 1) * m_description.HeightMapWidth + textureCoordinatesS + 1];
-
-	// Map from 0.5f * [-terrain_width, terrain_width] to [0, cell_x_count]:
-	auto cellRowFloat = (-z / m_description.TerrainDepth + 0.5f) * m_description.CellZCount;
-	auto cellColumnFloat = (x / m_description.TerrainWidth + 0.5f) * m_description.CellXCount;
-
-	// Calculate the row and column as integers:
-	auto cellRow = static_cast<uint32_t>(floorf(cellRowFloat));
-	auto cellColumn = static_cast<uint32_t>(floorf(cellColumnFloat));
-
-	// Calculate position in the range [0, 1] inside the cell:
-	auto s = cellColumnFloat - static_cast<float>(cellColumn);
-	auto t = cellRowFloat - static_cast<float>(cellRow);
+	if (m_tileCache)
+		m_tileCache->Update(cameraPosition);
+}
 
-	float height;
+float Terrain::GetTerrainHeight(float x, float z) const
+{
+	// Use the streamed tiles, which are finer than the resident height map, when they cover the position:
+	float streamedHeight;
+	if (m_tileCache && m_tileCache->TryGetHeight(x, z, streamedHeight))
+		return streamedHeight;
 
-	// If the position belongs to the upper triangle:
-	if (s + t <= 1.0f)
-	{
-		auto fromTopLeftToTopRight = topRightHeight - topLeftHeight;
-		auto fromTopLeftToLowerLeft = lowerLeftHeight - topLeftHeight;
-		height = topLeftHeight + s * fromTopLeftToTopRight + t * fromTopLeftToLowerLeft;
-	}
-	// If the position belongs to the lower triangle:
-	else
-	{
-		auto fromLowerRightToTopRight = topRightHeight - lowerRightHeight;
-		auto fromLowerRightToLowerLeft = lowerLeftHeight - lowerRightHeight;
-		height = lowerRightHeight + (1.0f - s) * fromLowerRightToTopRight + (1.0f - t) * fromLowerRightToLowerLeft;
-	}
+	return CreateHeightMapSampler().SampleHeight(x, z);
+}
+void Terrain::GetTerrainHeights(const std::vector<DirectX::XMFLOAT2>& positions, std::vector<float>& heights) const
+{
+	heights.resize(positions.size());
+	CreateHeightMapSampler().SampleHeights(positions.data(), positions.size(), heights.data());
+	SampleStreamedHeights(positions, heights);
+}
+void Terrain::GetTerrainHeightsAndNormals(const std::vector<DirectX::XMFLOAT2>& positions, std::vector<float>& heights, std::vector<DirectX::XMFLOAT3>& normals) const
+{
+	// The normals are interpolated from the normal map of the resident height map:
+	heights.resize(positions.size());
+	normals.resize(positions.size());
+	CreateHeightMapSampler().SampleHeightsAndNormals(positions.data(), positions.size(), m_normalMap, heights.data(), normals.data());
+	SampleStreamedHeights(positions, heights);
+}
 
-	return height;
+bool Terrain::Intersects(const Ray& ray, float maxDistance, float& distance) const
+{
+	return m_heightBounds.Intersects(m_heightMap, ray.GetOrigin(), ray.GetDirection(), maxDistance, distance);
+}
+bool Terrain::HasLineOfSight(const DirectX::XMFLOAT3& from, const DirectX::XMFLOAT3& to) const
+{
+	auto fromVector = XMLoadFloat3(&from);
+	auto segment = XMVectorSubtract(XMLoadFloat3(&to), fromVector);
+	auto length = XMVectorGetX(XMVector3Length(segment));
+	if (length <= 0.0f)
+		return true;
+
+	float distance;
+	return !m_heightBounds.Intersects(m_heightMap, fromVector, XMVectorScale(segment, 1.0f / length), length, distance);
 }
 
 const Terrain::Description& Terrain::GetDescription() const
 {
 	return m_description;
 }
+const std::vector<float>& Terrain::GetHeightMap() const
+{
+	return m_heightMap;
+}
+uint32_t Terrain::GetHeightMapWidth() const
+{
+	return m_heightMapWidth;
+}
+uint32_t Terrain::GetHeightMapHeight() const
+{
+	return m_heightMapHeight;
+}
+const HeightBoundsPyramid& Terrain::GetHeightBounds() const
+{
+	return m_heightBounds;
+}
 
 DirectX::XMFLOAT2 Terrain::GetTexelSize() const
 {
-	return XMFLOAT2(1.0f / static_cast<float>(m_description.HeightMapWidth), 1.0f / static_cast<float>(m_description.HeightMapHeight));
+	return XMFLOAT2(1.0f / static_cast<float>(m_heightMapWidth), 1.0f / static_cast<float>(m_heightMapHeight));
 }
 
 DirectX::XMFLOAT3 Terrain::TextureSpaceToWorldSpace(const DirectX::XMFLOAT2& position) const
@@ -153,7 +171,7 @@ void Terrain::CreateGeometry(const D3DBase& d3dBase, IScene& scene) const
 
 	scene.AddImmutableGeometry(std::move(terrainGeometry));
 }
-void Terrain::CreateMaterial(const D3DBase& d3dBase, TextureManager& textureManager, IScene& scene)
+void Terrain::CreateMaterial(const D3DBase& d3dBase, TextureManager& textureManager, Common::ThreadPool& threadPool, IScene& scene)
 {
 	auto device = d3dBase.GetDevice();
 
@@ -178,9 +196,8 @@ void Terrain::CreateMaterial(const D3DBase& d3dBase, TextureManager& textureMana
 		// Load height map:
 		{
 			// Load height map:
-			auto width = m_description.HeightMapWidth;
-			auto height = m_description.HeightMapHeight;
-			LoadRawHeightMap(m_description.HeightMapFilename, m_description.NormalMapFilename, m_description.TangentMapFilename, width, height, m_description.HeightMapFactor, m_heightMap, m_normalMap, m_tangentMap);
+			LoadHeightMap(threadPool);
+			m_heightBounds = HeightBoundsPyramid(m_heightMap, m_heightMapWidth, m_heightMapHeight, m_description.TerrainWidth, m_description.TerrainDepth);
 
 			// Create height map texture:
 			{
@@ -189,8 +206,8 @@ void Terrain::CreateMaterial(const D3DBase& d3dBase, TextureManager& textureMana
 				std::transform(m_heightMap.begin(), m_heightMap.end(), heightMapHalf.begin(), PackedVector::XMConvertFloatToHalf);
 
 				D3D11_TEXTURE2D_DESC heightMapDescription;
-				heightMapDescription.Width = m_description.HeightMapWidth;
-				heightMapDescription.Height = m_description.HeightMapHeight;
+				heightMapDescription.Width = m_heightMapWidth;
+				heightMapDescription.Height = m_heightMapHeight;
 				heightMapDescription.MipLevels = 1;
 				heightMapDescription.ArraySize = 1;
 				heightMapDescription.Format = DXGI_FORMAT_R16_FLOAT;
@@ -203,7 +220,7 @@ void Terrain::CreateMaterial(const D3DBase& d3dBase, TextureManager& textureMana
 
 				D3D11_SUBRESOURCE_DATA data;
 				data.pSysMem = &heightMapHalf[0];
-				data.SysMemPitch = static_cast<UINT>(m_description.HeightMapWidth * sizeof(PackedVector::HALF));
+				data.SysMemPitch = static_cast<UINT>(m_heightMapWidth * sizeof(PackedVector::HALF));
 				data.SysMemSlicePitch = 0;
 
 				ComPtr<ID3D11Texture2D> heightMapTexture;
@@ -226,8 +243,8 @@ void Terrain::CreateMaterial(const D3DBase& d3dBase, TextureManager& textureMana
 				std::transform(m_normalMap.begin(), m_normalMap.end(), normalMapHalf.begin(), MathHelper::ConvertFloat4ToHalf4);
 
 				D3D11_TEXTURE2D_DESC normalMapDescription;
-				normalMapDescription.Width = m_description.HeightMapWidth;
-				normalMapDescription.Height = m_description.HeightMapHeight;
+				normalMapDescription.Width = m_heightMapWidth;
+				normalMapDescription.Height = m_heightMapHeight;
 				normalMapDescription.MipLevels = 1;
 				normalMapDescription.ArraySize = 1;
 				normalMapDescription.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
@@ -240,7 +257,7 @@ void Terrain::CreateMaterial(const D3DBase& d3dBase, TextureManager& textureMana
 
 				D3D11_SUBRESOURCE_DATA data;
 				data.pSysMem = &normalMapHalf[0];
-				data.SysMemPitch = static_cast<UINT>(m_description.HeightMapWidth * sizeof(PackedVector::XMHALF4));
+				data.SysMemPitch = static_cast<UINT>(m_heightMapWidth * sizeof(PackedVector::XMHALF4));
 				data.SysMemSlicePitch = 0;
 
 				ComPtr<ID3D11Texture2D> normalMapTexture;
@@ -264,8 +281,8 @@ void Terrain::CreateMaterial(const D3DBase& d3dBase, TextureManager& textureMana
 				std::transform(m_tangentMap.begin(), m_tangentMap.end(), tangentMapHalf.begin(), MathHelper::ConvertFloat4ToHalf4);
 
 				D3D11_TEXTURE2D_DESC tangentMapDescription;
-				tangentMapDescription.Width = m_description.HeightMapWidth;
-				tangentMapDescription.Height = m_description.HeightMapHeight;
+				tangentMapDescription.Width = m_heightMapWidth;
+				tangentMapDescription.Height = m_heightMapHeight;
 				tangentMapDescription.MipLevels = 1;
 				tangentMapDescription.ArraySize = 1;
 				tangentMapDescription.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
@@ -278,7 +295,7 @@ void Terrain::CreateMaterial(const D3DBase& d3dBase, TextureManager& textureMana
 
 				D3D11_SUBRESOURCE_DATA data;
 				data.pSysMem = &tangentMapHalf[0];
-				data.SysMemPitch = static_cast<UINT>(m_description.HeightMapWidth * sizeof(PackedVector::XMHALF4));
+				data.SysMemPitch = static_cast<UINT>(m_heightMapWidth * sizeof(PackedVector::XMHALF4));
 				data.SysMemSlicePitch = 0;
 
 				ComPtr<ID3D11Texture2D> tangentMapTexture;
@@ -315,6 +332,53 @@ void Terrain::CreateRenderItem(const D3DBase& d3dBase, Graphics& graphics, IScen
 	graphics.AddNormalRenderItem(std::move(renderItem), { RenderLayer::Terrain });
 }
 
+void Terrain::LoadHeightMap(Common::ThreadPool& threadPool)
+{
+	if (m_description.TiledHeightMapFilename.empty())
+	{
+		m_heightMapWidth = m_description.HeightMapWidth;
+		m_heightMapHeight = m_description.HeightMapHeight;
+		LoadRawHeightMap(m_description.HeightMapFilename, m_heightMapWidth, m_heightMapHeight, m_description.HeightMapFactor, threadPool, m_heightMap, m_normalMap, m_tangentMap);
+		return;
+	}
+
+	m_tiledHeightMap = std::make_unique<TiledHeightMap>(m_description.TiledHeightMapFilename);
+	if (m_tiledHeightMap->GetWidth(0) != m_description.HeightMapWidth || m_tiledHeightMap->GetHeight(0) != m_description.HeightMapHeight)
+		ThrowEngineException(L"Terrain dimensions don't match with the height map dimensions!");
+
+	// Find the finest level which fits in the resident size:
+	uint32_t residentLevel = 0;
+	auto maxResidentSize = m_description.MaxResidentHeightMapSize;
+	while (residentLevel + 1 < m_tiledHeightMap->GetLevelCount() && (m_tiledHeightMap->GetWidth(residentLevel) > maxResidentSize || m_tiledHeightMap->GetHeight(residentLevel) > maxResidentSize))
+		++residentLevel;
+
+	m_heightMapWidth = m_tiledHeightMap->GetWidth(residentLevel);
+	m_heightMapHeight = m_tiledHeightMap->GetHeight(residentLevel);
+	m_tiledHeightMap->ReadLevel(residentLevel, m_description.HeightMapFactor, threadPool, m_heightMap);
+
+	// The texels of the coarser levels are further apart, which flattens their slopes:
+	auto texelSpacing = m_description.TerrainWidth / static_cast<float>(m_heightMapWidth);
+	HeightMapLoader::CalculateNormalsAndTangents(m_heightMap, m_heightMapWidth, m_heightMapHeight, threadPool, m_normalMap, m_tangentMap, texelSpacing);
+
+	// Stream the finer levels:
+	if (residentLevel > 0)
+		m_tileCache = std::make_unique<TerrainTileCache>(*m_tiledHeightMap, m_description.TerrainWidth, m_description.TerrainDepth, m_description.HeightMapFactor, residentLevel, m_description.TileCacheMemoryBudget);
+}
+
+HeightMapSampler Terrain::CreateHeightMapSampler() const
+{
+	return HeightMapSampler(m_heightMap, m_heightMapWidth, m_heightMapHeight, m_description.TerrainWidth, m_description.TerrainDepth);
+}
+void Terrain::SampleStreamedHeights(const std::vector<DirectX::XMFLOAT2>& positions, std::vector<float>& heights) const
+{
+	if (!m_tileCache)
+		return;
+
+	// Replace the heights of the positions covered by the streamed tiles, which are finer than the resident height map:
+	for (size_t i = 0; i < positions.size(); ++i)
+		m_tileCache->TryGetHeight(positions[i].x, positions[i].y, heights[i]);
+}
+
 GeometryGenerator::MeshData Terrain::CreateMeshData(float width, float depth, uint32_t xCellCount, uint32_t zCellCount)
 {
 	GeometryGenerator::MeshData output;
@@ -372,55 +436,8 @@ GeometryGenerator::MeshData Terrain::CreateMeshData(float width, float depth, ui
 
 	return output;
 }
-void Terrain::LoadRawHeightMap(const std::wstring& heightMapFilename, const std::wstring& normalMapFilename, const std::wstring& tangentMapFilename, uint32_t width, uint32_t height, float heightFactor, std::vector<float>& heightMap, std::vector<DirectX::XMFLOAT4>& normalMap, std::vector<DirectX::XMFLOAT4>& tangentMap)
+void Terrain::LoadRawHeightMap(const std::wstring& heightMapFilename, uint32_t width, uint32_t height, float heightFactor, Common::ThreadPool& threadPool, std::vector<float>& heightMap, std::vector<DirectX::XMFLOAT4>& normalMap, std::vector<DirectX::XMFLOAT4>& tangentMap)
 {
-	// Read file content into a buffer:
-	std::vector<uint16_t> buffer;
-	Helpers::ReadData(heightMapFilename, buffer);
-
-	if (width * height != buffer.size())
-		ThrowEngineException(L"Terrain dimensions don't match with the height map dimensions!");
-
-	heightMap.resize(static_cast<SIZE_T>(width * height));
-	for (uint32_t i = 0; i < width; ++i)
-	{
-		for (uint32_t j = 0; j < height; ++j)
-		{
-			auto index = i * width + j;
-
-			heightMap[index] = heightFactor * static_cast<float>(buffer[index]) / 65535.0f;
-			//heightMap[index] = heightFactor * 0.0f;
-		}
-	}
-
-	// Compute the tangent, bitangent and normal vectors.
-	// position = (x, f(x, z), z)
-	// tangent = d(position) / dx = (1.0f, d(f(x, z)) / dx, 0.0f)
-	// bitangent = d(position) / dz = (0.0f, d(f(x, z)) / dz, 1.0f)
-	// Calculate the derivative using the central differences method, with h = 2.
-	normalMap.resize(static_cast<SIZE_T>(heightMap.size()));
-	tangentMap.resize(static_cast<SIZE_T>(heightMap.size()));
-	for (uint32_t i = 0; i < width; ++i)
-	{
-		for (uint32_t j = 0; j < height; ++j)
-		{
-			auto iDown = i == height - 1 ? 0 : i + 1;
-			auto iUp = i == 0 ? height - 1 : i - 1;
-			auto jLeft = j == 0 ? width - 1 : j - 1;
-			auto jRight = j == width - 1 ? 0 : j + 1;
-
-			auto downValue = heightMap[iDown * width + j];
-			auto upValue = heightMap[iUp * width + j];
-			auto leftValue = heightMap[i * width + jLeft];
-			auto rightValue = heightMap[i * width + jRight];
-
-			auto tangentVector = XMVector3Normalize(XMVectorSet(2.0f, (upValue - downValue), 0.0f, 0.0f));
-			auto bitangentVector = XMVector3Normalize(XMVectorSet(0.0f, (rightValue - leftValue), -2.0f, 0.0f));
-			auto normalVector = XMVector3Cross(tangentVector, bitangentVector);
-
-			auto index = i * width + j;
-			XMStoreFloat4(&tangentMap[index], tangentVector);
-			XMStoreFloat4(&normalMap[index], normalVector);
-		}
-	}
-}
+	HeightMapLoader::Load(heightMapFilename, width, height, heightFactor, threadPool, heightMap);
+	HeightMapLoader::CalculateNormalsAndTangents(heightMap, width, height, threadPool, normalMap, tangentMap);
+}
\ No newline at end of file
@@ -1,15 +1,22 @@
 #pragma once
 
+#include "Common/ThreadPool.h"
 #include "D3DBase.h"
 #include "GeometryGenerator.h"
+#include "HeightBoundsPyramid.h"
+#include "HeightMapSampler.h"
+#include "TerrainTileCache.h"
+#include "TiledHeightMap.h"
 #include "VertexTypes.h"
 
+#include <memory>
 #include <unordered_set>
 
 namespace GraphicsEngine
 {
 	class Graphics;
 	class IScene;
+	class Ray;
 	class TextureManager;
 
 	class Terrain
@@ -29,6 +36,12 @@ namespace GraphicsEngine
 			uint32_t HeightMapHeight;
 			float HeightMapFactor;
 			float TiledTexelScale;
+
+			// Tiled height map used instead of the raw one when set. Its finest level which fits in MaxResidentHeightMapSize texels
+			// per side is loaded for rendering, and the tiles of the finer levels are streamed around the camera:
+			std::wstring TiledHeightMapFilename;
+			uint32_t MaxResidentHeightMapSize = 2048;
+			size_t TileCacheMemoryBudget = 64 * 1024 * 1024;
 		};
 
 	public:
@@ -37,8 +50,25 @@ namespace GraphicsEngine
 
 		std::vector<DirectX::XMFLOAT3> GenerateRandomPositions(SIZE_T count) const;
 
+		// Streams the tiles of the height map around the camera:
+		void Update(const DirectX::XMFLOAT3& cameraPosition);
+
 		float GetTerrainHeight(float x, float z) const;
+
+		// Interpolates the heights, and the normals, of many (x, z) positions at once, four at a time:
+		void GetTerrainHeights(const std::vector<DirectX::XMFLOAT2>& positions, std::vector<float>& heights) const;
+		void GetTerrainHeightsAndNormals(const std::vector<DirectX::XMFLOAT2>& positions, std::vector<float>& heights, std::vector<DirectX::XMFLOAT3>& normals) const;
+
+		// Finds the closest intersection of the ray with the resident height map, up to the maximum distance:
+		bool Intersects(const Ray& ray, float maxDistance, float& distance) const;
+		bool HasLineOfSight(const DirectX::XMFLOAT3& from, const DirectX::XMFLOAT3& to) const;
+
 		const Description& GetDescription() const;
+		// Height map loaded for rendering, which is a coarser level of the tiled height map when streaming:
+		const std::vector<float>& GetHeightMap() const;
+		uint32_t GetHeightMapWidth() const;
+		uint32_t GetHeightMapHeight() const;
+		const HeightBoundsPyramid& GetHeightBounds() const;
 		DirectX::XMFLOAT2 GetTexelSize() const;
 		DirectX::XMFLOAT3 TextureSpaceToWorldSpace(const DirectX::XMFLOAT2& position) const;
 
@@ -47,15 +77,24 @@ namespace GraphicsEngine
 
 	private:
 		void CreateGeometry(const D3DBase& d3dBase, IScene& scene) const;
-		void CreateMaterial(const D3DBase& d3dBase, TextureManager& textureManager, IScene& scene);
+		void CreateMaterial(const D3DBase& d3dBase, TextureManager& textureManager, Common::ThreadPool& threadPool, IScene& scene);
 		void CreateRenderItem(const D3DBase& d3dBase, Graphics& graphics, IScene& scene) const;
 
+		void LoadHeightMap(Common::ThreadPool& threadPool);
+		HeightMapSampler CreateHeightMapSampler() const;
+		void SampleStreamedHeights(const std::vector<DirectX::XMFLOAT2>& positions, std::vector<float>& heights) const;
+
 		static GeometryGenerator::MeshData CreateMeshData(float width, float depth, uint32_t xCellCount, uint32_t zCellCount);
-		static void LoadRawHeightMap(const std::wstring& heightMapFilename, const std::wstring& normalMapFilename, const std::wstring& tangentMapFilename, uint32_t width, uint32_t height, float heightFactor, std::vector<float>& heightMap, std::vector<DirectX::XMFLOAT4>& normalMap, std::vector<DirectX::XMFLOAT4>& tangentMap);
+		static void LoadRawHeightMap(const std::wstring& heightMapFilename, uint32_t width, uint32_t height, float heightFactor, Common::ThreadPool& threadPool, std::vector<float>& heightMap, std::vector<DirectX::XMFLOAT4>& normalMap, std::vector<DirectX::XMFLOAT4>& tangentMap);
 
 	public:
 		Description m_description;
 		std::vector<float> m_heightMap;
+		uint32_t m_heightMapWidth = 0;
+		uint32_t m_heightMapHeight = 0;
+		std::unique_ptr<TiledHeightMap> m_tiledHeightMap;
+		std::unique_ptr<TerrainTileCache> m_tileCache;
+		HeightBoundsPyramid m_heightBounds;
 		std::vector<DirectX::XMFLOAT4> m_normalMap;
 		std::vector<DirectX::XMFLOAT4> m_tangentMap;
 		std::vector<VertexTypes::PositionVertexType> m_vertices;
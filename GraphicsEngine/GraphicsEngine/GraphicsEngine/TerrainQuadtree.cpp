@@ -0,0 +1,217 @@
+#include "stdafx.h"
+#include "TerrainQuadtree.h"
+
+#include <algorithm>
+
+using namespace Common;
+using namespace DirectX;
+using namespace GraphicsEngine;
+
+namespace
+{
+	bool IsPowerOfTwo(uint32_t value)
+	{
+		return value != 0 && (value & (value - 1)) == 0;
+	}
+}
+
+TerrainQuadtree::TerrainQuadtree(float terrainWidth, float terrainDepth, uint32_t cellXCount, uint32_t cellZCount, float maxHeight, uint32_t tesselationFactor) :
+	m_terrainWidth(terrainWidth),
+	m_terrainDepth(terrainDepth),
+	m_cellCount(cellXCount),
+	m_maxHeight(maxHeight),
+	m_tesselationFactor(tesselationFactor),
+	m_cellPatchSizes(static_cast<size_t>(cellXCount) * cellXCount)
+{
+	if (cellXCount != cellZCount || !IsPowerOfTwo(cellXCount))
+		ThrowEngineException(L"The number of terrain cells must be the same power of two along both axes!");
+	if (!IsPowerOfTwo(tesselationFactor) || tesselationFactor < 2)
+		ThrowEngineException(L"The terrain tessellation factor must be a power of two greater than one!");
+}
+
+void TerrainQuadtree::SetHeightBounds(const HeightBoundsPyramid* heightBounds)
+{
+	m_heightBounds = heightBounds;
+}
+
+void TerrainQuadtree::SetMaxScreenSpaceError(float maxScreenSpaceError)
+{
+	m_maxScreenSpaceError = maxScreenSpaceError;
+}
+float TerrainQuadtree::GetMaxScreenSpaceError() const
+{
+	return m_maxScreenSpaceError;
+}
+
+uint32_t TerrainQuadtree::GetCellCount() const
+{
+	return m_cellCount;
+}
+uint32_t TerrainQuadtree::GetTesselationFactor() const
+{
+	return m_tesselationFactor;
+}
+
+void TerrainQuadtree::Select(const XMFLOAT3& cameraPosition, float projectionScale, std::vector<Patch>& patches)
+{
+	patches.clear();
+	if (m_cellCount == 0)
+		return;
+
+	SelectNode(XMLoadFloat3(&cameraPosition), projectionScale, 0, 0, m_cellCount, patches);
+	Balance(patches);
+
+	for (auto& patch : patches)
+		CalculateEdgeTesselationFactors(patch);
+}
+
+BoundingBox TerrainQuadtree::GetPatchBounds(const Patch& patch) const
+{
+	XMVECTOR minimum, maximum;
+	GetNodeBounds(patch.Row, patch.Column, patch.Size, minimum, maximum);
+
+	BoundingBox bounds;
+	BoundingBox::CreateFromPoints(bounds, minimum, maximum);
+	return bounds;
+}
+void TerrainQuadtree::CalculatePatchBounds(const std::vector<Patch>& patches, BoundingBoxArray& bounds) const
+{
+	bounds.Clear();
+	bounds.Reserve(patches.size());
+	for (const auto& patch : patches)
+		bounds.Add(GetPatchBounds(patch));
+}
+
+void TerrainQuadtree::SelectNode(FXMVECTOR cameraPosition, float projectionScale, uint32_t row, uint32_t column, uint32_t size, std::vector<Patch>& patches)
+{
+	if (size == 1 || !NeedsRefinement(cameraPosition, projectionScale, row, column, size))
+	{
+		AddPatch(row, column, size, patches);
+		return;
+	}
+
+	auto childSize = size / 2;
+	SelectNode(cameraPosition, projectionScale, row, column, childSize, patches);
+	SelectNode(cameraPosition, projectionScale, row, column + childSize, childSize, patches);
+	SelectNode(cameraPosition, projectionScale, row + childSize, column, childSize, patches);
+	SelectNode(cameraPosition, projectionScale, row + childSize, column + childSize, childSize, patches);
+}
+bool TerrainQuadtree::NeedsRefinement(FXMVECTOR cameraPosition, float projectionScale, uint32_t row, uint32_t column, uint32_t size) const
+{
+	auto cellWidth = m_terrainWidth / static_cast<float>(m_cellCount);
+	auto cellDepth = m_terrainDepth / static_cast<float>(m_cellCount);
+
+	XMVECTOR minimum, maximum;
+	GetNodeBounds(row, column, size, minimum, maximum);
+
+	// The camera is inside of the bounds:
+	auto closestPoint = XMVectorClamp(cameraPosition, minimum, maximum);
+	auto distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(cameraPosition, closestPoint)));
+	if (distance <= 0.0f)
+		return true;
+
+	// Project the spacing between the tessellated vertices at the closest point of the node:
+	auto vertexSpacing = static_cast<float>(size) * std::max(cellWidth, cellDepth) / static_cast<float>(m_tesselationFactor);
+	auto screenSpaceError = 0.5f * projectionScale * vertexSpacing / distance;
+	return screenSpaceError > m_maxScreenSpaceError;
+}
+
+void TerrainQuadtree::GetNodeBounds(uint32_t row, uint32_t column, uint32_t size, XMVECTOR& minimum, XMVECTOR& maximum) const
+{
+	auto cellWidth = m_terrainWidth / static_cast<float>(m_cellCount);
+	auto cellDepth = m_terrainDepth / static_cast<float>(m_cellCount);
+	auto minimumX = -0.5f * m_terrainWidth + static_cast<float>(column) * cellWidth;
+	auto maximumX = minimumX + static_cast<float>(size) * cellWidth;
+	auto maximumZ = 0.5f * m_terrainDepth - static_cast<float>(row) * cellDepth;
+	auto minimumZ = maximumZ - static_cast<float>(size) * cellDepth;
+
+	// Without a height pyramid, the bounds contain every height of the terrain:
+	auto minimumHeight = 0.0f;
+	auto maximumHeight = m_maxHeight;
+	if (m_heightBounds)
+		m_heightBounds->GetHeightBounds(minimumX, minimumZ, maximumX, maximumZ, minimumHeight, maximumHeight);
+
+	minimum = XMVectorSet(minimumX, minimumHeight, minimumZ, 0.0f);
+	maximum = XMVectorSet(maximumX, maximumHeight, maximumZ, 0.0f);
+}
+
+void TerrainQuadtree::Balance(std::vector<Patch>& patches)
+{
+	// Split the patches next to a patch more than one level finer, until there are none. The split patches are replaced by their
+	// first child and the other children are appended, so that they are checked later in the same pass:
+	auto balanced = false;
+	while (!balanced)
+	{
+		balanced = true;
+		for (size_t i = 0; i < patches.size(); ++i)
+		{
+			auto patch = patches[i];
+			if (patch.Size == 1 || !HasFinerNeighbour(patch))
+				continue;
+
+			auto childSize = patch.Size / 2;
+			patches[i].Size = childSize;
+			SetPatchSize(patch.Row, patch.Column, childSize);
+			AddPatch(patch.Row, patch.Column + childSize, childSize, patches);
+			AddPatch(patch.Row + childSize, patch.Column, childSize, patches);
+			AddPatch(patch.Row + childSize, patch.Column + childSize, childSize, patches);
+
+			balanced = false;
+			--i;
+		}
+	}
+}
+bool TerrainQuadtree::HasFinerNeighbour(const Patch& patch) const
+{
+	auto isFiner = [this, &patch](uint32_t row, uint32_t column)
+	{
+		return 2 * m_cellPatchSizes[row * m_cellCount + column] < patch.Size;
+	};
+
+	for (uint32_t offset = 0; offset < patch.Size; ++offset)
+	{
+		if (patch.Row > 0 && isFiner(patch.Row - 1, patch.Column + offset))
+			return true;
+		if (patch.Row + patch.Size < m_cellCount && isFiner(patch.Row + patch.Size, patch.Column + offset))
+			return true;
+		if (patch.Column > 0 && isFiner(patch.Row + offset, patch.Column - 1))
+			return true;
+		if (patch.Column + patch.Size < m_cellCount && isFiner(patch.Row + offset, patch.Column + patch.Size))
+			return true;
+	}
+
+	return false;
+}
+void TerrainQuadtree::CalculateEdgeTesselationFactors(Patch& patch) const
+{
+	// After balancing, a coarser neighbour is a single patch twice as large, so checking one cell per edge is enough:
+	auto fullFactor = static_cast<float>(m_tesselationFactor);
+	auto getFactor = [this, &patch, fullFactor](bool inside, uint32_t row, uint32_t column)
+	{
+		return inside && m_cellPatchSizes[row * m_cellCount + column] > patch.Size ? 0.5f * fullFactor : fullFactor;
+	};
+
+	patch.EdgeTesselationFactors = XMFLOAT4(
+		getFactor(patch.Row > 0, patch.Row - 1, patch.Column),
+		getFactor(patch.Column + patch.Size < m_cellCount, patch.Row, patch.Column + patch.Size),
+		getFactor(patch.Row + patch.Size < m_cellCount, patch.Row + patch.Size, patch.Column),
+		getFactor(patch.Column > 0, patch.Row, patch.Column - 1)
+	);
+}
+
+void TerrainQuadtree::AddPatch(uint32_t row, uint32_t column, uint32_t size, std::vector<Patch>& patches)
+{
+	Patch patch;
+	patch.Row = row;
+	patch.Column = column;
+	patch.Size = size;
+	patch.EdgeTesselationFactors = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+	patches.push_back(patch);
+
+	SetPatchSize(row, column, size);
+}
+void TerrainQuadtree::SetPatchSize(uint32_t row, uint32_t column, uint32_t size)
+{
+	for (auto cellRow = row; cellRow < row + size; ++cellRow)
+		std::fill_n(m_cellPatchSizes.begin() + cellRow * m_cellCount + column, size, size);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "BoundingBoxArray.h"
+#include "HeightBoundsPyramid.h"
+
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+namespace GraphicsEngine
+{
+	// Selects the terrain patches to draw from a quadtree over the terrain cells. A node is split while the spacing between its
+	// tessellated vertices covers too large a part of the screen, so that distant parts of the terrain are drawn with a few large
+	// patches. The selection is balanced so that neighbouring patches differ by one level at most, and the edges facing a coarser
+	// patch are tessellated with half the factor, which makes their vertices coincide with the ones of the coarser patch.
+	class TerrainQuadtree
+	{
+	public:
+		struct Patch
+		{
+			// Top-left cell of the patch:
+			uint32_t Row;
+			uint32_t Column;
+
+			// Number of cells per side, which is a power of two:
+			uint32_t Size;
+
+			// Ordered as the hull shader edges, which face the previous row, the next column, the next row and the previous column:
+			DirectX::XMFLOAT4 EdgeTesselationFactors;
+		};
+
+	public:
+		TerrainQuadtree() = default;
+
+		// The terrain is centered at the origin, with the first row of cells at its far z edge. The number of cells must be the
+		// same power of two along both axes, and the tessellation factor, used as the inside factor of every patch, a power of two:
+		TerrainQuadtree(float terrainWidth, float terrainDepth, uint32_t cellXCount, uint32_t cellZCount, float maxHeight, uint32_t tesselationFactor);
+
+		// Bounds the heights of the nodes tightly, instead of between zero and the maximum height. The pyramid must outlive the quadtree:
+		void SetHeightBounds(const HeightBoundsPyramid* heightBounds);
+
+		// Ratio between the projected vertex spacing and the height of the screen above which nodes are split:
+		void SetMaxScreenSpaceError(float maxScreenSpaceError);
+		float GetMaxScreenSpaceError() const;
+
+		uint32_t GetCellCount() const;
+		uint32_t GetTesselationFactor() const;
+
+		// The projection scale is the element (1, 1) of the projection matrix:
+		void Select(const DirectX::XMFLOAT3& cameraPosition, float projectionScale, std::vector<Patch>& patches);
+
+		DirectX::BoundingBox GetPatchBounds(const Patch& patch) const;
+
+		// Replaces the bounds with the ones of the patches, in the same order, so that the patches can be culled:
+		void CalculatePatchBounds(const std::vector<Patch>& patches, BoundingBoxArray& bounds) const;
+
+	private:
+		void SelectNode(DirectX::FXMVECTOR cameraPosition, float projectionScale, uint32_t row, uint32_t column, uint32_t size, std::vector<Patch>& patches);
+		bool NeedsRefinement(DirectX::FXMVECTOR cameraPosition, float projectionScale, uint32_t row, uint32_t column, uint32_t size) const;
+		void GetNodeBounds(uint32_t row, uint32_t column, uint32_t size, DirectX::XMVECTOR& minimum, DirectX::XMVECTOR& maximum) const;
+		void Balance(std::vector<Patch>& patches);
+		bool HasFinerNeighbour(const Patch& patch) const;
+		void CalculateEdgeTesselationFactors(Patch& patch) const;
+		void AddPatch(uint32_t row, uint32_t column, uint32_t size, std::vector<Patch>& patches);
+		void SetPatchSize(uint32_t row, uint32_t column, uint32_t size);
+
+	private:
+		float m_terrainWidth = 0.0f;
+		float m_terrainDepth = 0.0f;
+		uint32_t m_cellCount = 0;
+		float m_maxHeight = 0.0f;
+		uint32_t m_tesselationFactor = 2;
+		float m_maxScreenSpaceError = 0.005f;
+		const HeightBoundsPyramid* m_heightBounds = nullptr;
+
+		// Size of the selected patch which covers each cell:
+		std::vector<uint32_t> m_cellPatchSizes;
+	};
+}
@@ -0,0 +1,291 @@
+#include "stdafx.h"
+#include "TerrainTileCache.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace Common;
+using namespace DirectX;
+using namespace GraphicsEngine;
+
+namespace
+{
+	// The first and the last texels of a level are at the borders of the terrain:
+	float GetTexelSpan(uint32_t texelCount)
+	{
+		return static_cast<float>(std::max(texelCount, 2u) - 1);
+	}
+}
+
+TerrainTileCache::TerrainTileCache(const TiledHeightMap& heightMap, float terrainWidth, float terrainDepth, float heightFactor, uint32_t levelCount, size_t memoryBudget) :
+	m_heightMap(&heightMap),
+	m_terrainWidth(terrainWidth),
+	m_terrainDepth(terrainDepth),
+	m_heightFactor(heightFactor),
+	m_levelCount(std::min(levelCount, heightMap.GetLevelCount()))
+{
+	// All the memory of the cache is allocated up front:
+	auto tileBytes = heightMap.GetTileSampleCount() * sizeof(float);
+	auto slotCount = std::max<size_t>(memoryBudget / tileBytes, 1);
+	m_slots.resize(slotCount);
+	m_tileHeights.resize(slotCount * heightMap.GetTileSampleCount());
+	m_tileSlots.reserve(slotCount);
+	m_loadedSlots.reserve(slotCount);
+
+	// Free slots are taken from the back:
+	m_freeSlots.resize(slotCount);
+	for (size_t i = 0; i < slotCount; ++i)
+		m_freeSlots[i] = static_cast<uint32_t>(slotCount - 1 - i);
+
+	m_loaderThread = std::thread(&TerrainTileCache::LoaderLoop, this);
+}
+TerrainTileCache::~TerrainTileCache()
+{
+	// Signal the loader to stop and wait for it:
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_loadCondition.notify_one();
+
+	m_loaderThread.join();
+}
+
+void TerrainTileCache::SetLoadRadius(float loadRadius)
+{
+	m_loadRadius = loadRadius;
+}
+
+void TerrainTileCache::Update(const XMFLOAT3& cameraPosition)
+{
+	++m_frame;
+	ProcessLoadedTiles();
+
+	// Mark the tiles in range which are already cached as used, and gather the others:
+	m_tileRequests.clear();
+	for (uint32_t level = 0; level < m_levelCount; ++level)
+		GatherTileRequests(level, cameraPosition);
+
+	// Request the coarser levels first, so that they are the ones loaded when the budget is exceeded, and the nearest tiles first within a level:
+	std::sort(m_tileRequests.begin(), m_tileRequests.end(), [](const TileRequest& request0, const TileRequest& request1)
+	{
+		if (request0.Level != request1.Level)
+			return request0.Level > request1.Level;
+
+		return request0.DistanceSquared < request1.DistanceSquared;
+	});
+
+	// The remaining requests have a lower priority, so they would not find a slot either:
+	for (const auto& request : m_tileRequests)
+	{
+		if (!RequestTile(request.Level, request.TileRow, request.TileColumn))
+			break;
+	}
+}
+
+void TerrainTileCache::WaitForPendingTiles()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_loadedCondition.wait(lock, [this]() { return m_loadedSlots.size() == m_pendingTileCount; });
+	}
+
+	ProcessLoadedTiles();
+}
+
+bool TerrainTileCache::TryGetHeight(float x, float z, float& height) const
+{
+	// Map from 0.5f * [-terrain_width, terrain_width] to [0, 1]:
+	auto s = std::min(std::max(x / m_terrainWidth + 0.5f, 0.0f), 1.0f);
+	auto t = std::min(std::max(-z / m_terrainDepth + 0.5f, 0.0f), 1.0f);
+
+	auto tileSize = m_heightMap->GetTileSize();
+	for (uint32_t level = 0; level < m_levelCount; ++level)
+	{
+		// Calculate the position in texels of the level, and the tile which contains it:
+		auto column = s * GetTexelSpan(m_heightMap->GetWidth(level));
+		auto row = t * GetTexelSpan(m_heightMap->GetHeight(level));
+		auto tileColumn = std::min(static_cast<uint32_t>(column) / tileSize, m_heightMap->GetTileColumnCount(level) - 1);
+		auto tileRow = std::min(static_cast<uint32_t>(row) / tileSize, m_heightMap->GetTileRowCount(level) - 1);
+
+		auto location = m_tileSlots.find(GetTileKey(level, tileRow, tileColumn));
+		if (location == m_tileSlots.end() || m_slots[location->second].State != SlotState::Resident)
+			continue;
+
+		// Interpolate the heights of the texel, which the tile contains thanks to its shared row and column:
+		auto localColumn = column - static_cast<float>(tileColumn * tileSize);
+		auto localRow = row - static_cast<float>(tileRow * tileSize);
+		auto texelColumn = std::min(static_cast<uint32_t>(localColumn), tileSize - 1);
+		auto texelRow = std::min(static_cast<uint32_t>(localRow), tileSize - 1);
+		auto u = localColumn - static_cast<float>(texelColumn);
+		auto v = localRow - static_cast<float>(texelRow);
+
+		auto tileHeights = GetTileHeights(location->second);
+		auto rowPitch = tileSize + 1;
+		auto topLeft = tileHeights + texelRow * rowPitch + texelColumn;
+		auto top = topLeft[0] + u * (topLeft[1] - topLeft[0]);
+		auto bottom = topLeft[rowPitch] + u * (topLeft[rowPitch + 1] - topLeft[rowPitch]);
+		height = top + v * (bottom - top);
+		return true;
+	}
+
+	return false;
+}
+
+size_t TerrainTileCache::GetSlotCount() const
+{
+	return m_slots.size();
+}
+size_t TerrainTileCache::GetResidentTileCount() const
+{
+	return static_cast<size_t>(std::count_if(m_slots.begin(), m_slots.end(), [](const Slot& slot) { return slot.State == SlotState::Resident; }));
+}
+
+uint64_t TerrainTileCache::GetTileKey(uint32_t level, uint32_t tileRow, uint32_t tileColumn)
+{
+	return (static_cast<uint64_t>(level) << 48) | (static_cast<uint64_t>(tileRow) << 24) | tileColumn;
+}
+
+void TerrainTileCache::GatherTileRequests(uint32_t level, const XMFLOAT3& cameraPosition)
+{
+	auto tileColumnCount = m_heightMap->GetTileColumnCount(level);
+	auto tileRowCount = m_heightMap->GetTileRowCount(level);
+
+	// Calculate the size of a tile of the level in world space:
+	auto tileSize = static_cast<float>(m_heightMap->GetTileSize());
+	auto tileWidth = m_terrainWidth * tileSize / GetTexelSpan(m_heightMap->GetWidth(level));
+	auto tileDepth = m_terrainDepth * tileSize / GetTexelSpan(m_heightMap->GetHeight(level));
+	auto radius = m_loadRadius * std::max(tileWidth, tileDepth);
+
+	// Find the tiles which overlap with the square around the camera, the rows growing towards -z:
+	auto x = cameraPosition.x + 0.5f * m_terrainWidth;
+	auto z = 0.5f * m_terrainDepth - cameraPosition.z;
+	auto toTileRange = [radius](float position, float tileExtent, uint32_t tileCount, uint32_t& begin, uint32_t& end)
+	{
+		auto first = std::floor((position - radius) / tileExtent);
+		auto last = std::floor((position + radius) / tileExtent);
+		begin = static_cast<uint32_t>(std::min(std::max(first, 0.0f), static_cast<float>(tileCount)));
+		end = static_cast<uint32_t>(std::min(std::max(last + 1.0f, 0.0f), static_cast<float>(tileCount)));
+	};
+	uint32_t beginColumn, endColumn, beginRow, endRow;
+	toTileRange(x, tileWidth, tileColumnCount, beginColumn, endColumn);
+	toTileRange(z, tileDepth, tileRowCount, beginRow, endRow);
+
+	for (auto tileRow = beginRow; tileRow < endRow; ++tileRow)
+	{
+		for (auto tileColumn = beginColumn; tileColumn < endColumn; ++tileColumn)
+		{
+			// Skip the tiles farther than the radius, outside of the circle:
+			auto closestX = std::min(std::max(x, static_cast<float>(tileColumn) * tileWidth), static_cast<float>(tileColumn + 1) * tileWidth);
+			auto closestZ = std::min(std::max(z, static_cast<float>(tileRow) * tileDepth), static_cast<float>(tileRow + 1) * tileDepth);
+			auto distanceX = x - closestX;
+			auto distanceZ = z - closestZ;
+			auto distanceSquared = distanceX * distanceX + distanceZ * distanceZ;
+			if (distanceSquared > radius * radius)
+				continue;
+
+			// Keep the tile if it is already resident or being loaded:
+			auto location = m_tileSlots.find(GetTileKey(level, tileRow, tileColumn));
+			if (location != m_tileSlots.end())
+				m_slots[location->second].LastUsedFrame = m_frame;
+			else
+				m_tileRequests.push_back({ level, tileRow, tileColumn, distanceSquared });
+		}
+	}
+}
+bool TerrainTileCache::RequestTile(uint32_t level, uint32_t tileRow, uint32_t tileColumn)
+{
+	auto key = GetTileKey(level, tileRow, tileColumn);
+
+	uint32_t slotIndex;
+	if (!AcquireSlot(slotIndex))
+		return false;
+
+	auto& slot = m_slots[slotIndex];
+	slot.Key = key;
+	slot.LastUsedFrame = m_frame;
+	slot.State = SlotState::Loading;
+	m_tileSlots.emplace(key, slotIndex);
+	++m_pendingTileCount;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_requestedSlots.push_back(slotIndex);
+	}
+	m_loadCondition.notify_one();
+
+	return true;
+}
+bool TerrainTileCache::AcquireSlot(uint32_t& slotIndex)
+{
+	if (!m_freeSlots.empty())
+	{
+		slotIndex = m_freeSlots.back();
+		m_freeSlots.pop_back();
+		return true;
+	}
+
+	// Replace the least recently used resident tile, unless it is in range in this frame:
+	auto leastRecentlyUsed = m_slots.end();
+	for (auto slot = m_slots.begin(); slot != m_slots.end(); ++slot)
+	{
+		if (slot->State == SlotState::Resident && slot->LastUsedFrame < m_frame && (leastRecentlyUsed == m_slots.end() || slot->LastUsedFrame < leastRecentlyUsed->LastUsedFrame))
+			leastRecentlyUsed = slot;
+	}
+	if (leastRecentlyUsed == m_slots.end())
+		return false;
+
+	m_tileSlots.erase(leastRecentlyUsed->Key);
+	leastRecentlyUsed->State = SlotState::Free;
+	slotIndex = static_cast<uint32_t>(leastRecentlyUsed - m_slots.begin());
+	return true;
+}
+void TerrainTileCache::ProcessLoadedTiles()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (auto slotIndex : m_loadedSlots)
+		m_slots[slotIndex].State = SlotState::Resident;
+
+	m_pendingTileCount -= m_loadedSlots.size();
+	m_loadedSlots.clear();
+}
+void TerrainTileCache::LoaderLoop()
+{
+	while (true)
+	{
+		// Wait for a request:
+		uint32_t slotIndex;
+		uint64_t key;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_loadCondition.wait(lock, [this]() { return m_stop || !m_requestedSlots.empty(); });
+			if (m_stop)
+				return;
+
+			slotIndex = m_requestedSlots.front();
+			m_requestedSlots.pop_front();
+			key = m_slots[slotIndex].Key;
+		}
+
+		// The slot isn't touched by the main thread while it is loading:
+		auto level = static_cast<uint32_t>(key >> 48);
+		auto tileRow = static_cast<uint32_t>((key >> 24) & 0xFFFFFF);
+		auto tileColumn = static_cast<uint32_t>(key & 0xFFFFFF);
+		m_heightMap->ReadTile(level, tileRow, tileColumn, m_heightFactor, GetTileHeights(slotIndex));
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_loadedSlots.push_back(slotIndex);
+		}
+		m_loadedCondition.notify_all();
+	}
+}
+
+const float* TerrainTileCache::GetTileHeights(uint32_t slotIndex) const
+{
+	return m_tileHeights.data() + slotIndex * m_heightMap->GetTileSampleCount();
+}
+float* TerrainTileCache::GetTileHeights(uint32_t slotIndex)
+{
+	return m_tileHeights.data() + slotIndex * m_heightMap->GetTileSampleCount();
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "TiledHeightMap.h"
+
+#include <DirectXMath.h>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace GraphicsEngine
+{
+	// Keeps the tiles of a tiled height map around the camera in memory, within a fixed budget. Each frame, the tiles of every level
+	// inside a radius which doubles with each coarser level are requested, from the coarsest level to the finest one and from the
+	// nearest tile to the farthest one within a level, and read by a loader thread. All the tiles in range are marked as used before
+	// any is requested, so that when the budget is full, only the least recently used tiles which are out of range are replaced.
+	class TerrainTileCache
+	{
+	public:
+		// Only the levels below levelCount are streamed, the coarser ones being expected to be resident elsewhere:
+		TerrainTileCache(const TiledHeightMap& heightMap, float terrainWidth, float terrainDepth, float heightFactor, uint32_t levelCount, size_t memoryBudget);
+		TerrainTileCache(const TerrainTileCache&) = delete;
+		TerrainTileCache& operator=(const TerrainTileCache&) = delete;
+		~TerrainTileCache();
+
+		// Radius around the camera, in tiles of each level, inside of which tiles are requested:
+		void SetLoadRadius(float loadRadius);
+
+		void Update(const DirectX::XMFLOAT3& cameraPosition);
+
+		// Blocks until the requested tiles have been read, and makes them resident:
+		void WaitForPendingTiles();
+
+		// Interpolates the height from the finest resident tile which contains the position. Returns false if there is none:
+		bool TryGetHeight(float x, float z, float& height) const;
+
+		size_t GetSlotCount() const;
+		size_t GetResidentTileCount() const;
+
+	private:
+		enum class SlotState
+		{
+			Free,
+			Loading,
+			Resident
+		};
+
+		struct Slot
+		{
+			uint64_t Key = 0;
+			uint64_t LastUsedFrame = 0;
+			SlotState State = SlotState::Free;
+		};
+
+		struct TileRequest
+		{
+			uint32_t Level;
+			uint32_t TileRow;
+			uint32_t TileColumn;
+			float DistanceSquared;
+		};
+
+	private:
+		static uint64_t GetTileKey(uint32_t level, uint32_t tileRow, uint32_t tileColumn);
+
+		void GatherTileRequests(uint32_t level, const DirectX::XMFLOAT3& cameraPosition);
+		bool RequestTile(uint32_t level, uint32_t tileRow, uint32_t tileColumn);
+		bool AcquireSlot(uint32_t& slotIndex);
+		void ProcessLoadedTiles();
+		void LoaderLoop();
+
+		const float* GetTileHeights(uint32_t slotIndex) const;
+		float* GetTileHeights(uint32_t slotIndex);
+
+	private:
+		const TiledHeightMap* m_heightMap;
+		float m_terrainWidth;
+		float m_terrainDepth;
+		float m_heightFactor;
+		uint32_t m_levelCount;
+		float m_loadRadius = 1.5f;
+		uint64_t m_frame = 0;
+
+		std::vector<Slot> m_slots;
+		std::vector<float> m_tileHeights;
+		std::vector<uint32_t> m_freeSlots;
+		std::unordered_map<uint64_t, uint32_t> m_tileSlots;
+		std::vector<TileRequest> m_tileRequests;
+		size_t m_pendingTileCount = 0;
+
+		// Shared with the loader thread:
+		std::thread m_loaderThread;
+		std::mutex m_mutex;
+		std::condition_variable m_loadCondition;
+		std::condition_variable m_loadedCondition;
+		std::deque<uint32_t> m_requestedSlots;
+		std::vector<uint32_t> m_loadedSlots;
+		bool m_stop = false;
+	};
+}
@@ -0,0 +1,229 @@
+#include "stdafx.h"
+#include "TiledHeightMap.h"
+
+#include <algorithm>
+#include <fstream>
+
+using namespace Common;
+using namespace GraphicsEngine;
+
+namespace
+{
+	constexpr uint32_t s_magic = 0x504D4854; // "THMP"
+	constexpr uint32_t s_version = 1;
+
+	// Number of rows processed by a single task:
+	constexpr uint32_t s_rowsPerTask = 16;
+
+	uint32_t GetTaskCount(uint32_t height)
+	{
+		return (height + s_rowsPerTask - 1) / s_rowsPerTask;
+	}
+	uint32_t GetLevelSize(uint32_t size, uint32_t level)
+	{
+		return std::max(size >> level, 1u);
+	}
+	uint32_t GetTileCount(uint32_t size, uint32_t tileSize)
+	{
+		return (size + tileSize - 1) / tileSize;
+	}
+}
+
+void TiledHeightMap::Convert(const std::wstring& rawFilename, uint32_t width, uint32_t height, uint32_t tileSize, const std::wstring& tiledFilename, ThreadPool& threadPool)
+{
+	MemoryMappedFile rawFile(rawFilename);
+	if (rawFile.GetSize() != static_cast<size_t>(width) * height * sizeof(uint16_t))
+		ThrowEngineException(L"Terrain dimensions don't match with the height map dimensions!");
+	if (tileSize == 0)
+		ThrowEngineException(L"The tile size of a tiled height map must be greater than zero!");
+
+	std::ofstream file(tiledFilename, std::ios::out | std::ios::binary);
+	if (!file.good())
+		ThrowEngineException(L"Couldn't create the tiled height map file!");
+
+	Header header;
+	header.Magic = s_magic;
+	header.Version = s_version;
+	header.Width = width;
+	header.Height = height;
+	header.TileSize = tileSize;
+	header.LevelCount = CalculateLevelCount(width, height, tileSize);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+
+	// Write the first level and downsample each level into the next one:
+	auto levelHeights = rawFile.GetData<uint16_t>();
+	std::vector<uint16_t> level;
+	std::vector<uint16_t> nextLevel;
+	for (uint32_t levelIndex = 0; levelIndex < header.LevelCount; ++levelIndex)
+	{
+		auto levelWidth = GetLevelSize(width, levelIndex);
+		auto levelHeight = GetLevelSize(height, levelIndex);
+		WriteLevel(file, levelHeights, levelWidth, levelHeight, tileSize, threadPool);
+
+		if (levelIndex + 1 < header.LevelCount)
+		{
+			Downsample(levelHeights, levelWidth, levelHeight, threadPool, nextLevel);
+			level.swap(nextLevel);
+			levelHeights = level.data();
+		}
+	}
+
+	if (!file.good())
+		ThrowEngineException(L"Error while writing the tiled height map file!");
+}
+
+TiledHeightMap::TiledHeightMap(const std::wstring& filename) :
+	m_file(filename)
+{
+	if (m_file.GetSize() < sizeof(Header))
+		ThrowEngineException(L"Invalid tiled height map file!");
+
+	m_header = *m_file.GetData<Header>();
+	if (m_header.Magic != s_magic || m_header.Version != s_version || m_header.TileSize == 0)
+		ThrowEngineException(L"Invalid tiled height map file!");
+
+	// Calculate where each level begins:
+	auto tileBytes = GetTileSampleCount() * sizeof(uint16_t);
+	auto offset = sizeof(Header);
+	m_levelOffsets.resize(m_header.LevelCount);
+	for (uint32_t level = 0; level < m_header.LevelCount; ++level)
+	{
+		m_levelOffsets[level] = offset;
+		offset += static_cast<size_t>(GetTileColumnCount(level)) * GetTileRowCount(level) * tileBytes;
+	}
+
+	if (m_file.GetSize() != offset)
+		ThrowEngineException(L"The size of the tiled height map file doesn't match with its header!");
+}
+
+uint32_t TiledHeightMap::GetLevelCount() const
+{
+	return m_header.LevelCount;
+}
+uint32_t TiledHeightMap::GetTileSize() const
+{
+	return m_header.TileSize;
+}
+uint32_t TiledHeightMap::GetWidth(uint32_t level) const
+{
+	return GetLevelSize(m_header.Width, level);
+}
+uint32_t TiledHeightMap::GetHeight(uint32_t level) const
+{
+	return GetLevelSize(m_header.Height, level);
+}
+uint32_t TiledHeightMap::GetTileColumnCount(uint32_t level) const
+{
+	return GetTileCount(GetWidth(level), m_header.TileSize);
+}
+uint32_t TiledHeightMap::GetTileRowCount(uint32_t level) const
+{
+	return GetTileCount(GetHeight(level), m_header.TileSize);
+}
+size_t TiledHeightMap::GetTileSampleCount() const
+{
+	auto tileSamples = static_cast<size_t>(m_header.TileSize) + 1;
+	return tileSamples * tileSamples;
+}
+
+void TiledHeightMap::ReadTile(uint32_t level, uint32_t tileRow, uint32_t tileColumn, float heightFactor, float* heights) const
+{
+	auto tileData = GetTileData(level, tileRow, tileColumn);
+	auto sampleCount = GetTileSampleCount();
+	for (size_t i = 0; i < sampleCount; ++i)
+		heights[i] = heightFactor * static_cast<float>(tileData[i]) / 65535.0f;
+}
+void TiledHeightMap::ReadLevel(uint32_t level, float heightFactor, ThreadPool& threadPool, std::vector<float>& heights) const
+{
+	auto width = GetWidth(level);
+	auto height = GetHeight(level);
+	heights.resize(static_cast<size_t>(width) * height);
+
+	threadPool.ParallelFor(GetTaskCount(height), [this, level, heightFactor, width, height, &heights](size_t taskIndex)
+	{
+		auto tileSize = m_header.TileSize;
+		auto begin = static_cast<uint32_t>(taskIndex) * s_rowsPerTask;
+		auto end = std::min(begin + s_rowsPerTask, height);
+		for (auto row = begin; row < end; ++row)
+		{
+			// Copy the part of the row held by each tile, skipping the shared column:
+			auto output = heights.data() + static_cast<size_t>(row) * width;
+			for (uint32_t column = 0; column < width; column += tileSize)
+			{
+				auto tileData = GetTileData(level, row / tileSize, column / tileSize) + (row % tileSize) * (tileSize + 1);
+				auto count = std::min(tileSize, width - column);
+				for (uint32_t i = 0; i < count; ++i)
+					output[column + i] = heightFactor * static_cast<float>(tileData[i]) / 65535.0f;
+			}
+		}
+	});
+}
+
+uint32_t TiledHeightMap::CalculateLevelCount(uint32_t width, uint32_t height, uint32_t tileSize)
+{
+	uint32_t levelCount = 1;
+	while (GetLevelSize(width, levelCount - 1) > tileSize || GetLevelSize(height, levelCount - 1) > tileSize)
+		++levelCount;
+
+	return levelCount;
+}
+void TiledHeightMap::WriteLevel(std::ofstream& file, const uint16_t* heights, uint32_t width, uint32_t height, uint32_t tileSize, ThreadPool& threadPool)
+{
+	auto tileSamples = tileSize + 1;
+	auto tileSampleCount = static_cast<size_t>(tileSamples) * tileSamples;
+	auto tileColumnCount = GetTileCount(width, tileSize);
+	auto tileRowCount = GetTileCount(height, tileSize);
+
+	// Write a row of tiles at a time. The samples past the border of the level repeat its last row and column:
+	std::vector<uint16_t> tileRowData(tileColumnCount * tileSampleCount);
+	for (uint32_t tileRow = 0; tileRow < tileRowCount; ++tileRow)
+	{
+		threadPool.ParallelFor(tileColumnCount, [heights, width, height, tileSize, tileSamples, tileSampleCount, tileRow, &tileRowData](size_t tileColumn)
+		{
+			auto tileData = tileRowData.data() + tileColumn * tileSampleCount;
+			for (uint32_t i = 0; i < tileSamples; ++i)
+			{
+				auto row = std::min(tileRow * tileSize + i, height - 1);
+				for (uint32_t j = 0; j < tileSamples; ++j)
+				{
+					auto column = std::min(static_cast<uint32_t>(tileColumn) * tileSize + j, width - 1);
+					tileData[i * tileSamples + j] = heights[static_cast<size_t>(row) * width + column];
+				}
+			}
+		});
+
+		file.write(reinterpret_cast<const char*>(tileRowData.data()), tileRowData.size() * sizeof(uint16_t));
+	}
+}
+void TiledHeightMap::Downsample(const uint16_t* heights, uint32_t width, uint32_t height, ThreadPool& threadPool, std::vector<uint16_t>& downsampledHeights)
+{
+	auto downsampledWidth = std::max(width / 2, 1u);
+	auto downsampledHeight = std::max(height / 2, 1u);
+	downsampledHeights.resize(static_cast<size_t>(downsampledWidth) * downsampledHeight);
+
+	// Average each block of 2x2 heights:
+	threadPool.ParallelFor(GetTaskCount(downsampledHeight), [heights, width, height, downsampledWidth, downsampledHeight, &downsampledHeights](size_t taskIndex)
+	{
+		auto begin = static_cast<uint32_t>(taskIndex) * s_rowsPerTask;
+		auto end = std::min(begin + s_rowsPerTask, downsampledHeight);
+		for (auto row = begin; row < end; ++row)
+		{
+			auto row0 = heights + static_cast<size_t>(std::min(2 * row, height - 1)) * width;
+			auto row1 = heights + static_cast<size_t>(std::min(2 * row + 1, height - 1)) * width;
+			for (uint32_t column = 0; column < downsampledWidth; ++column)
+			{
+				auto column0 = std::min(2 * column, width - 1);
+				auto column1 = std::min(2 * column + 1, width - 1);
+				auto sum = static_cast<uint32_t>(row0[column0]) + row0[column1] + row1[column0] + row1[column1];
+				downsampledHeights[static_cast<size_t>(row) * downsampledWidth + column] = static_cast<uint16_t>((sum + 2) / 4);
+			}
+		}
+	});
+}
+
+const uint16_t* TiledHeightMap::GetTileData(uint32_t level, uint32_t tileRow, uint32_t tileColumn) const
+{
+	auto tileIndex = static_cast<size_t>(tileRow) * GetTileColumnCount(level) + tileColumn;
+	auto offset = m_levelOffsets[level] + tileIndex * GetTileSampleCount() * sizeof(uint16_t);
+	return reinterpret_cast<const uint16_t*>(m_file.GetData<uint8_t>() + offset);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Common/MemoryMappedFile.h"
+#include "Common/ThreadPool.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace GraphicsEngine
+{
+	// Height map stored as a pyramid of square tiles, so that parts of it can be read without loading the whole map. Each level
+	// halves the resolution of the previous one, down to a level which fits in a single tile. A tile holds one row and one column
+	// more than its size, shared with the next tiles, so that it can be interpolated up to its border without its neighbours.
+	class TiledHeightMap
+	{
+	public:
+		// Converts a raw 16-bit height map, level by level. The first level is read from the mapped raw file, so only the
+		// downsampled levels, a quarter of its size at most, are kept in memory:
+		static void Convert(const std::wstring& rawFilename, uint32_t width, uint32_t height, uint32_t tileSize, const std::wstring& tiledFilename, Common::ThreadPool& threadPool);
+
+	public:
+		explicit TiledHeightMap(const std::wstring& filename);
+
+		uint32_t GetLevelCount() const;
+		uint32_t GetTileSize() const;
+		uint32_t GetWidth(uint32_t level) const;
+		uint32_t GetHeight(uint32_t level) const;
+		uint32_t GetTileColumnCount(uint32_t level) const;
+		uint32_t GetTileRowCount(uint32_t level) const;
+
+		// Number of heights of a tile, including its shared row and column:
+		size_t GetTileSampleCount() const;
+
+		// Reads the heights of a tile, scaled from [0, 65535] to [0, heightFactor]. Reading is thread-safe:
+		void ReadTile(uint32_t level, uint32_t tileRow, uint32_t tileColumn, float heightFactor, float* heights) const;
+
+		// Reads the heights of a whole level, without the shared rows and columns:
+		void ReadLevel(uint32_t level, float heightFactor, Common::ThreadPool& threadPool, std::vector<float>& heights) const;
+
+	private:
+		struct Header
+		{
+			uint32_t Magic;
+			uint32_t Version;
+			uint32_t Width;
+			uint32_t Height;
+			uint32_t TileSize;
+			uint32_t LevelCount;
+		};
+
+	private:
+		static uint32_t CalculateLevelCount(uint32_t width, uint32_t height, uint32_t tileSize);
+		static void WriteLevel(std::ofstream& file, const uint16_t* heights, uint32_t width, uint32_t height, uint32_t tileSize, Common::ThreadPool& threadPool);
+		static void Downsample(const uint16_t* heights, uint32_t width, uint32_t height, Common::ThreadPool& threadPool, std::vector<uint16_t>& downsampledHeights);
+
+		const uint16_t* GetTileData(uint32_t level, uint32_t tileRow, uint32_t tileColumn) const;
+
+	private:
+		Common::MemoryMappedFile m_file;
+		Header m_header;
+		std::vector<size_t> m_levelOffsets;
+	};
+}
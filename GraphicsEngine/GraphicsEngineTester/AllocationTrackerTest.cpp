@@ -0,0 +1,147 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+
+#include "Common/AllocationHook.h"
+#include "Common/AllocationTracker.h"
+#include "Common/FrameArena.h"
+#include "Common/ThreadPool.h"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace Common;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+
+namespace
+{
+	size_t s_failures = 0;
+	size_t s_failedAllocations = 0;
+	string s_failedScopeName;
+
+	void CountFailure(const char* scopeName, size_t allocations)
+	{
+		++s_failures;
+		s_failedAllocations = allocations;
+		s_failedScopeName = scopeName;
+	}
+}
+
+namespace GraphicsEngineTester
+{
+	TEST_CLASS(AllocationTrackerTest)
+	{
+	public:
+		TEST_METHOD_CLEANUP(DisableAllocationTracking)
+		{
+			AllocationTracker::SetEnabled(false);
+			AllocationTracker::SetFailureHandler(nullptr);
+		}
+
+		TEST_METHOD(TestAllocationTracker)
+		{
+			AllocationTracker::SetEnabled(true);
+			AllocationTracker::BeginFrame();
+
+			// Allocations and deallocations are attributed to the tag of the innermost scope of the thread.
+			// Arrays are allocated, as debug builds of standard containers make extra allocations for their iterators:
+			{
+				AllocationTracker::TagScope sceneTag(AllocationTag::Scene);
+				auto values = make_unique<array<int, 100>>();
+				auto moreValues = unique_ptr<int[]>(new int[100]);
+				void* value;
+				{
+					AllocationTracker::TagScope terrainTag(AllocationTag::Terrain);
+					value = ::operator new(sizeof(double));
+				}
+				::operator delete(value);
+			}
+			auto frame = AllocationTracker::GetCurrentFrameStatistics();
+			Assert::AreEqual(static_cast<size_t>(2), frame.Get(AllocationTag::Scene).Allocations);
+			Assert::AreEqual(static_cast<size_t>(0), frame.Get(AllocationTag::Terrain).Deallocations);
+			Assert::AreEqual(static_cast<size_t>(3), frame.Get(AllocationTag::Scene).Deallocations);
+			Assert::IsTrue(frame.Get(AllocationTag::Scene).AllocatedBytes >= 2 * 100 * sizeof(int));
+			Assert::AreEqual(static_cast<size_t>(1), frame.Get(AllocationTag::Terrain).Allocations);
+			Assert::AreEqual(sizeof(double), frame.Get(AllocationTag::Terrain).AllocatedBytes);
+
+			// Beginning a frame keeps the counters of the frame that ended:
+			AllocationTracker::BeginFrame();
+			const auto& lastFrame = AllocationTracker::GetLastFrameStatistics();
+			Assert::AreEqual(static_cast<size_t>(1), lastFrame.Get(AllocationTag::Terrain).Allocations);
+			Assert::IsTrue(lastFrame.GetTotal().Allocations >= 3);
+			Assert::AreEqual(static_cast<size_t>(0), AllocationTracker::GetCurrentFrameStatistics().Get(AllocationTag::Terrain).Allocations);
+
+			// Nothing is counted while tracking is disabled:
+			AllocationTracker::SetEnabled(false);
+			{
+				AllocationTracker::TagScope terrainTag(AllocationTag::Terrain);
+				::operator delete(::operator new(sizeof(double)));
+			}
+			Assert::AreEqual(static_cast<size_t>(0), AllocationTracker::GetCurrentFrameStatistics().Get(AllocationTag::Terrain).Allocations);
+		}
+
+		TEST_METHOD(TestNoAllocationScope)
+		{
+			AllocationTracker::SetEnabled(true);
+			AllocationTracker::SetFailureHandler(&CountFailure);
+			s_failures = 0;
+
+			// Allocating inside of a scope fails when the scope is left:
+			{
+				AllocationTracker::NoAllocationScope scope("Allocating");
+				auto value = make_unique<int>(1);
+				Assert::AreEqual(static_cast<size_t>(1), scope.GetAllocations());
+				Assert::AreEqual(static_cast<size_t>(0), s_failures);
+			}
+			Assert::AreEqual(static_cast<size_t>(1), s_failures);
+			Assert::AreEqual(static_cast<size_t>(1), s_failedAllocations);
+			Assert::AreEqual(string("Allocating"), s_failedScopeName);
+
+			// Freeing is allowed:
+			auto value = make_unique<int>(1);
+			{
+				AllocationTracker::NoAllocationScope scope("Freeing");
+				value.reset();
+			}
+			Assert::AreEqual(static_cast<size_t>(1), s_failures);
+		}
+
+		TEST_METHOD(TestSteadyStateDoesNotAllocate)
+		{
+			FrameArena frameArena(4096);
+			ThreadPool threadPool(3);
+			vector<atomic<size_t>> counts(64);
+
+			auto runFrame = [&frameArena, &threadPool, &counts]()
+			{
+				frameArena.BeginFrame();
+				ArenaVector<int> values { ArenaAllocator<int>(frameArena) };
+				for (int i = 0; i < 1000; ++i)
+					values.push_back(i);
+
+				threadPool.ParallelFor(counts.size(), [&counts, &values](size_t taskIndex)
+				{
+					counts[taskIndex].fetch_add(values[taskIndex], memory_order_relaxed);
+				});
+			};
+
+			// Both arenas grow during their first frame and merge their blocks when they are reset, after which frames only use
+			// memory which was allocated before:
+			for (size_t frame = 0; frame < 4; ++frame)
+				runFrame();
+
+			AllocationTracker::SetEnabled(true);
+			AllocationTracker::SetFailureHandler(&CountFailure);
+			s_failures = 0;
+			for (size_t frame = 0; frame < 4; ++frame)
+			{
+				AllocationTracker::NoAllocationScope scope("Frame");
+				runFrame();
+			}
+			Assert::AreEqual(static_cast<size_t>(0), s_failures);
+		}
+	};
+}
@@ -0,0 +1,67 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+
+#include "GraphicsEngine/Frustum.h"
+#include "GraphicsEngine/CubeMapFrustum.h"
+#include "GraphicsEngine/CubeMappingCamera.h"
+#include "TestHelpers.h"
+
+#include <vector>
+
+using namespace DirectX;
+using namespace GraphicsEngine;
+using namespace GraphicsEngineTester::TestHelpers;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+
+namespace GraphicsEngineTester
+{
+	TEST_CLASS(CubeMapFrustumTest)
+	{
+	public:
+		TEST_METHOD(TestCubeMapFrustumFaceMasks)
+		{
+			auto position = XMVectorSet(10.0f, 20.0f, 30.0f, 1.0f);
+			CubeMappingCamera camera(position);
+			CubeMapFrustum cubeMapFrustum(position, camera.GetFarZ());
+
+			// Boxes along the axes are only visible from the face looking at them:
+			for (uint32_t face = 0; face < CubeMapFrustum::FaceCount; ++face)
+			{
+				XMFLOAT3 center(10.0f, 20.0f, 30.0f);
+				(&center.x)[face / 2] += face % 2 == 0 ? 100.0f : -100.0f;
+				Assert::AreEqual(1u << face, cubeMapFrustum.CalculateFaceMask(BoundingBox(center, { 1.0f, 1.0f, 1.0f })));
+			}
+
+			// Boxes around the center are visible from all faces, boxes on the diagonals from the adjacent faces and far boxes from none:
+			Assert::AreEqual(static_cast<uint32_t>(CubeMapFrustum::AllFacesMask), cubeMapFrustum.CalculateFaceMask(BoundingBox({ 10.0f, 20.0f, 30.0f }, { 1.0f, 1.0f, 1.0f })));
+			Assert::AreEqual(0x05u, cubeMapFrustum.CalculateFaceMask(BoundingBox({ 60.0f, 70.0f, 30.0f }, { 1.0f, 1.0f, 1.0f })));
+			Assert::AreEqual(0u, cubeMapFrustum.CalculateFaceMask(BoundingBox({ 10.0f, 20.0f, 2000.0f }, { 1.0f, 1.0f, 1.0f })));
+
+			// Random boxes:
+			auto boxes = CreateRandomBoxArray(10001, 1200.0f, 1.0f, 0.5f, 50.0f);
+
+			vector<uint8_t> faceMasks(boxes.GetSize());
+			cubeMapFrustum.CalculateFaceMasks(boxes, 0, boxes.GetSize(), faceMasks.data());
+
+			array<Frustum, CubeMapFrustum::FaceCount> faceFrusta;
+			for (size_t face = 0; face < CubeMapFrustum::FaceCount; ++face)
+				faceFrusta[face] = Frustum(XMMatrixMultiply(camera.GetViewMatrix(face), camera.GetProjectionMatrix()));
+
+			for (size_t i = 0; i < boxes.GetSize(); ++i)
+			{
+				// The vectorized masks agree with the scalar ones:
+				auto box = boxes.Get(i);
+				auto faceMask = cubeMapFrustum.CalculateFaceMask(box);
+				Assert::AreEqual(faceMask, static_cast<uint32_t>(faceMasks[i]));
+
+				// Boxes intersecting the frustum of a face are always visible from it:
+				for (size_t face = 0; face < CubeMapFrustum::FaceCount; ++face)
+				{
+					if (faceFrusta[face].Contains(box) != ContainmentType::DISJOINT)
+						Assert::IsTrue((faceMask & (1u << face)) != 0);
+				}
+			}
+		}
+	};
+}
@@ -0,0 +1,78 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+
+#include "Common/FrameArena.h"
+
+#include <cstdint>
+
+using namespace Common;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+
+namespace GraphicsEngineTester
+{
+	TEST_CLASS(FrameArenaTest)
+	{
+	public:
+		TEST_METHOD(TestLinearArena)
+		{
+			LinearArena arena(256);
+
+			// Allocations are aligned and don't overlap:
+			auto bytes = arena.NewArray<uint8_t>(3);
+			auto value = arena.New<double>(1.5);
+			Assert::IsTrue(reinterpret_cast<uintptr_t>(value) % alignof(double) == 0);
+			Assert::IsTrue(reinterpret_cast<uint8_t*>(value) >= bytes + 3);
+			Assert::AreEqual(1.5, *value);
+			Assert::AreEqual(static_cast<size_t>(3 + sizeof(double)), arena.GetUsedSize());
+			Assert::AreEqual(static_cast<size_t>(1), arena.GetBlockCount());
+
+			// Allocations which don't fit into the block add blocks, of at least the size of the allocation:
+			auto largeArray = arena.NewArray<uint32_t>(100);
+			Assert::AreEqual(static_cast<size_t>(2), arena.GetBlockCount());
+			Assert::AreEqual(static_cast<uint32_t>(0), largeArray[99]);
+			arena.NewArray<uint32_t>(1000);
+			Assert::AreEqual(static_cast<size_t>(3), arena.GetBlockCount());
+			auto capacity = arena.GetCapacity();
+			auto peakUsedSize = arena.GetPeakUsedSize();
+
+			// Resetting merges the blocks into one, so the same allocations then fit without adding blocks:
+			arena.Reset();
+			Assert::AreEqual(static_cast<size_t>(0), arena.GetUsedSize());
+			Assert::AreEqual(static_cast<size_t>(1), arena.GetBlockCount());
+			Assert::AreEqual(capacity, arena.GetCapacity());
+			arena.NewArray<uint8_t>(3);
+			arena.New<double>(1.5);
+			arena.NewArray<uint32_t>(100);
+			arena.NewArray<uint32_t>(1000);
+			Assert::AreEqual(static_cast<size_t>(1), arena.GetBlockCount());
+			Assert::AreEqual(capacity, arena.GetCapacity());
+			Assert::AreEqual(peakUsedSize, arena.GetPeakUsedSize());
+		}
+
+		TEST_METHOD(TestFrameArena)
+		{
+			FrameArena frameArena(4096);
+
+			// Data allocated in a frame survives the next frame, and its memory is reused in the frame after:
+			frameArena.BeginFrame();
+			auto value0 = frameArena.New<int>(0);
+			frameArena.BeginFrame();
+			auto value1 = frameArena.New<int>(1);
+			Assert::AreEqual(0, *value0);
+			Assert::AreEqual(sizeof(int), frameArena.GetPrevious().GetUsedSize());
+			frameArena.BeginFrame();
+			auto value2 = frameArena.New<int>(2);
+			Assert::IsTrue(value2 == value0);
+			Assert::AreEqual(1, *value1);
+
+			// Standard containers can allocate from the current frame:
+			ArenaVector<int> values{ ArenaAllocator<int>(frameArena) };
+			for (int i = 0; i < 100; ++i)
+				values.push_back(i);
+			Assert::AreEqual(99, values.back());
+			Assert::IsTrue(frameArena.GetCurrent().GetUsedSize() >= 100 * sizeof(int));
+			Assert::AreEqual(static_cast<size_t>(1), frameArena.GetCurrent().GetBlockCount());
+		}
+	};
+}
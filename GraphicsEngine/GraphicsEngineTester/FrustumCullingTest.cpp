@@ -0,0 +1,205 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+
+#include "GraphicsEngine/Camera.h"
+#include "GraphicsEngine/Frustum.h"
+#include "GraphicsEngine/BoundingBoxArray.h"
+#include "Common/PerformanceTimer.h"
+#include "TestHelpers.h"
+
+#include <string>
+#include <vector>
+
+using namespace DirectX;
+using namespace GraphicsEngine;
+using namespace GraphicsEngineTester::TestHelpers;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+
+namespace GraphicsEngineTester
+{
+	TEST_CLASS(FrustumCullingTest)
+	{
+	private:
+		static Frustum CreateCameraFrustum(Camera& camera)
+		{
+			camera.Update();
+			return Frustum(XMMatrixMultiply(camera.GetViewMatrix(), camera.GetProjectionMatrix()));
+		}
+
+	public:
+		TEST_METHOD(TestFrustumContainment)
+		{
+			Camera camera(16.0f / 9.0f, XM_PIDIV2, 0.01f, 1000.0f, XMMatrixIdentity());
+			auto frustum = CreateCameraFrustum(camera);
+
+			// Box in front of the camera:
+			Assert::IsTrue(frustum.Contains(BoundingBox({ 0.0f, 0.0f, 5.0f }, { 0.5f, 0.5f, 0.5f })) == ContainmentType::CONTAINS);
+
+			// Box behind the camera:
+			Assert::IsTrue(frustum.Contains(BoundingBox({ 0.0f, 0.0f, -5.0f }, { 0.5f, 0.5f, 0.5f })) == ContainmentType::DISJOINT);
+
+			// Box crossing the near plane:
+			Assert::IsTrue(frustum.Contains(BoundingBox({ 0.0f, 0.0f, 0.0f }, { 0.5f, 0.5f, 0.5f })) == ContainmentType::INTERSECTS);
+
+			// Box beyond the far plane:
+			Assert::IsTrue(frustum.Contains(BoundingBox({ 0.0f, 0.0f, 1100.0f }, { 0.5f, 0.5f, 0.5f })) == ContainmentType::DISJOINT);
+		}
+
+		TEST_METHOD(TestFrustumPlaneMasking)
+		{
+			Camera camera(16.0f / 9.0f, XM_PIDIV2, 0.01f, 1000.0f, XMMatrixIdentity());
+			auto frustum = CreateCameraFrustum(camera);
+
+			// A box inside of every plane clears the mask:
+			auto planeMask = Frustum::AllPlanesMask;
+			uint8_t firstPlane = 0;
+			size_t planeTestCount = 0;
+			size_t independentPlaneTestCount = 0;
+			Assert::IsTrue(frustum.Contains(BoundingBox({ 0.0f, 0.0f, 5.0f }, { 0.5f, 0.5f, 0.5f }), planeMask, firstPlane, planeTestCount, independentPlaneTestCount) == ContainmentType::CONTAINS);
+			Assert::AreEqual(static_cast<uint32_t>(0), planeMask);
+			Assert::AreEqual(static_cast<size_t>(Frustum::PlaneCount), planeTestCount);
+			Assert::AreEqual(static_cast<size_t>(Frustum::PlaneCount), independentPlaneTestCount);
+
+			// A box crossing the far plane only keeps the far plane:
+			planeMask = Frustum::AllPlanesMask;
+			Assert::IsTrue(frustum.Contains(BoundingBox({ 0.0f, 0.0f, 1000.0f }, { 50.0f, 50.0f, 50.0f }), planeMask, firstPlane, planeTestCount, independentPlaneTestCount) == ContainmentType::INTERSECTS);
+			Assert::AreEqual(static_cast<uint32_t>(1u << 5), planeMask);
+
+			// Planes outside of the mask are not tested:
+			planeTestCount = 0;
+			independentPlaneTestCount = 0;
+			Assert::IsTrue(frustum.Contains(BoundingBox({ 0.0f, 0.0f, 1100.0f }, { 0.5f, 0.5f, 0.5f }), planeMask, firstPlane, planeTestCount, independentPlaneTestCount) == ContainmentType::DISJOINT);
+			Assert::AreEqual(static_cast<size_t>(1), planeTestCount);
+			Assert::AreEqual(static_cast<size_t>(1), independentPlaneTestCount);
+
+			// The rejecting plane is reported, and tested first next time, while testing from the first plane tests all of them:
+			Assert::AreEqual(static_cast<uint8_t>(5), firstPlane);
+			planeMask = Frustum::AllPlanesMask;
+			planeTestCount = 0;
+			independentPlaneTestCount = 0;
+			Assert::IsTrue(frustum.Contains(BoundingBox({ 0.0f, 0.0f, 1100.0f }, { 0.5f, 0.5f, 0.5f }), planeMask, firstPlane, planeTestCount, independentPlaneTestCount) == ContainmentType::DISJOINT);
+			Assert::AreEqual(static_cast<size_t>(1), planeTestCount);
+			Assert::AreEqual(static_cast<size_t>(Frustum::PlaneCount), independentPlaneTestCount);
+
+			// A box behind the left and the far planes, tested from the top plane, is rejected by the far plane,
+			// while testing from the first plane stops at the left plane:
+			planeMask = Frustum::AllPlanesMask;
+			firstPlane = 3;
+			planeTestCount = 0;
+			independentPlaneTestCount = 0;
+			Assert::IsTrue(frustum.Contains(BoundingBox({ -3000.0f, 0.0f, 1100.0f }, { 0.5f, 0.5f, 0.5f }), planeMask, firstPlane, planeTestCount, independentPlaneTestCount) == ContainmentType::DISJOINT);
+			Assert::AreEqual(static_cast<uint8_t>(5), firstPlane);
+			Assert::AreEqual(static_cast<size_t>(3), planeTestCount);
+			Assert::AreEqual(static_cast<size_t>(1), independentPlaneTestCount);
+		}
+
+		TEST_METHOD(TestBoundingBoxArray)
+		{
+			BoundingBoxArray boxes;
+			for (size_t i = 0; i < 5; ++i)
+				boxes.Add(BoundingBox({ static_cast<float>(i), 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }));
+			Assert::AreEqual(static_cast<size_t>(5), boxes.GetSize());
+			Assert::AreEqual(3.0f, boxes.Get(3).Center.x);
+
+			// Padding must contain empty boxes:
+			Assert::AreEqual(0.0f, boxes.GetComponent(BoundingBoxArray::Component::ExtentsX)[7]);
+
+			boxes.Set(1, BoundingBox({ 10.0f, 0.0f, 0.0f }, { 2.0f, 1.0f, 1.0f }));
+			Assert::AreEqual(10.0f, boxes.Get(1).Center.x);
+			Assert::AreEqual(2.0f, boxes.Get(1).Extents.x);
+
+			boxes.RemoveLast();
+			Assert::AreEqual(static_cast<size_t>(4), boxes.GetSize());
+			Assert::AreEqual(0.0f, boxes.GetComponent(BoundingBoxArray::Component::ExtentsX)[4]);
+		}
+
+		TEST_METHOD(TestCalculateVisibleBoxes)
+		{
+			Camera camera(16.0f / 9.0f, XM_PIDIV4, 0.01f, 1000.0f, XMMatrixIdentity());
+			camera.RotateWorldY(0.7f);
+			auto frustum = CreateCameraFrustum(camera);
+
+			// Use a count which isn't a multiple of the group size, to exercise the last partial group:
+			auto boxes = CreateRandomBoxArray(1003, 512.0f, 0.25f, 0.5f, 4.0f);
+
+			vector<uint32_t> visibleIndices(boxes.GetSize());
+			auto visibleCount = frustum.CalculateVisibleBoxes(boxes, 0, boxes.GetSize(), visibleIndices.data());
+
+			// Compare with the scalar test:
+			vector<uint32_t> expectedIndices;
+			for (size_t i = 0; i < boxes.GetSize(); ++i)
+			{
+				if (frustum.Contains(boxes.Get(i)) != ContainmentType::DISJOINT)
+					expectedIndices.push_back(static_cast<uint32_t>(i));
+			}
+
+			Assert::AreEqual(expectedIndices.size(), visibleCount);
+			for (size_t i = 0; i < visibleCount; ++i)
+				Assert::AreEqual(expectedIndices[i], visibleIndices[i]);
+
+			// Test a sub range:
+			auto rangeCount = frustum.CalculateVisibleBoxes(boxes, 500, 700, visibleIndices.data());
+			size_t expectedRangeCount = 0;
+			for (auto index : expectedIndices)
+				expectedRangeCount += (index >= 500 && index < 700) ? 1 : 0;
+			Assert::AreEqual(expectedRangeCount, rangeCount);
+		}
+
+		TEST_METHOD(BenchmarkFrustumCulling)
+		{
+			constexpr size_t instanceCount = 100000;
+
+			Camera camera(16.0f / 9.0f, XM_PIDIV4, 0.01f, 1000.0f, XMMatrixIdentity());
+			auto frustum = CreateCameraFrustum(camera);
+			auto boxes = CreateRandomBoxArray(instanceCount, 512.0f, 0.25f, 0.5f, 4.0f);
+
+			// Each instance is a unit box placed with a world matrix, as done by the renderer:
+			BoundingBox localBounds({ 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f });
+			vector<XMFLOAT4X4> worldMatrices(instanceCount);
+			for (size_t i = 0; i < instanceCount; ++i)
+			{
+				auto box = boxes.Get(i);
+				XMStoreFloat4x4(&worldMatrices[i], XMMatrixScaling(box.Extents.x, box.Extents.y, box.Extents.z) * XMMatrixTranslation(box.Center.x, box.Center.y, box.Center.z));
+			}
+
+			// Per instance frustum transform:
+			Common::PerformanceTimer timer;
+			size_t scalarVisibleCount = 0;
+			{
+				auto viewMatrix = camera.GetViewMatrix();
+				auto viewMatrixDeterminant = XMMatrixDeterminant(viewMatrix);
+				auto inverseViewMatrix = XMMatrixInverse(&viewMatrixDeterminant, viewMatrix);
+				auto viewSpaceCameraFrustum = camera.BuildViewSpaceBoundingFrustum();
+
+				timer.Start();
+				for (const auto& worldMatrix : worldMatrices)
+				{
+					auto world = XMLoadFloat4x4(&worldMatrix);
+					auto worldDeterminant = XMMatrixDeterminant(world);
+					auto inverseWorldMatrix = XMMatrixInverse(&worldDeterminant, world);
+
+					BoundingFrustum localSpaceCameraFrustum;
+					viewSpaceCameraFrustum.Transform(localSpaceCameraFrustum, XMMatrixMultiply(inverseViewMatrix, inverseWorldMatrix));
+					if (localSpaceCameraFrustum.Contains(localBounds) != ContainmentType::DISJOINT)
+						++scalarVisibleCount;
+				}
+				timer.End();
+			}
+			auto scalarTime = timer.ElapsedTime<float, milli>().count();
+
+			// Structure of arrays kernel:
+			vector<uint32_t> visibleIndices(instanceCount);
+			timer.Start();
+			auto visibleCount = frustum.CalculateVisibleBoxes(boxes, 0, boxes.GetSize(), visibleIndices.data());
+			timer.End();
+			auto kernelTime = timer.ElapsedTime<float, milli>().count();
+
+			auto message =
+				L"Frustum culling of " + to_wstring(instanceCount) + L" instances:\n" +
+				L"  Per instance transform: " + to_wstring(instanceCount / scalarTime) + L" instances/ms (" + to_wstring(scalarVisibleCount) + L" visible)\n" +
+				L"  SoA kernel: " + to_wstring(instanceCount / kernelTime) + L" instances/ms (" + to_wstring(visibleCount) + L" visible)\n";
+			Logger::WriteMessage(message.c_str());
+		}
+	};
+}
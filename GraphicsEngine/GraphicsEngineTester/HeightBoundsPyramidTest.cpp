@@ -0,0 +1,159 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+
+#include "GraphicsEngine/HeightBoundsPyramid.h"
+
+#include <DirectXCollision.h>
+#include <algorithm>
+#include <cfloat>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+using namespace GraphicsEngine;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+
+namespace GraphicsEngineTester
+{
+	TEST_CLASS(HeightBoundsPyramidTest)
+	{
+	public:
+		TEST_METHOD(TestHeightBounds)
+		{
+			auto heightMap = CreateHeightMap();
+			HeightBoundsPyramid pyramid(heightMap, s_width, s_height, s_terrainWidth, s_terrainDepth);
+
+			// Levels of 36x22, 18x11, 9x6, 5x3, 3x2, 2x1 and 1x1 nodes:
+			Assert::AreEqual(7u, pyramid.GetLevelCount());
+
+			// Rectangles inside of a cell get the bounds of its four texels:
+			for (uint32_t row = 0; row + 1 < s_height; ++row)
+			{
+				for (uint32_t column = 0; column + 1 < s_width; ++column)
+				{
+					auto minimumX = GetX(static_cast<float>(column) + 0.25f);
+					auto maximumZ = GetZ(static_cast<float>(row) + 0.25f);
+					float minimumHeight, maximumHeight;
+					pyramid.GetHeightBounds(minimumX, maximumZ - 0.1f, minimumX + 0.1f, maximumZ, minimumHeight, maximumHeight);
+
+					auto topLeft = row * s_width + column;
+					auto corners = { heightMap[topLeft], heightMap[topLeft + 1], heightMap[topLeft + s_width], heightMap[topLeft + s_width + 1] };
+					Assert::AreEqual(min(corners), minimumHeight);
+					Assert::AreEqual(max(corners), maximumHeight);
+				}
+			}
+
+			// Larger rectangles get bounds which contain the heights of every texel inside of them:
+			default_random_engine randomEngine(3);
+			uniform_real_distribution<float> xDistribution(-0.5f * s_terrainWidth, 0.5f * s_terrainWidth);
+			uniform_real_distribution<float> zDistribution(-0.5f * s_terrainDepth, 0.5f * s_terrainDepth);
+			for (size_t i = 0; i < 200; ++i)
+			{
+				auto x0 = xDistribution(randomEngine);
+				auto x1 = xDistribution(randomEngine);
+				auto z0 = zDistribution(randomEngine);
+				auto z1 = zDistribution(randomEngine);
+				float minimumHeight, maximumHeight;
+				pyramid.GetHeightBounds(min(x0, x1), min(z0, z1), max(x0, x1), max(z0, z1), minimumHeight, maximumHeight);
+
+				for (uint32_t row = 0; row < s_height; ++row)
+				{
+					for (uint32_t column = 0; column < s_width; ++column)
+					{
+						auto x = GetX(static_cast<float>(column));
+						auto z = GetZ(static_cast<float>(row));
+						if (x < min(x0, x1) || x > max(x0, x1) || z < min(z0, z1) || z > max(z0, z1))
+							continue;
+
+						Assert::IsTrue(minimumHeight <= heightMap[row * s_width + column]);
+						Assert::IsTrue(maximumHeight >= heightMap[row * s_width + column]);
+					}
+				}
+			}
+		}
+
+		TEST_METHOD(TestIntersects)
+		{
+			auto heightMap = CreateHeightMap();
+			HeightBoundsPyramid pyramid(heightMap, s_width, s_height, s_terrainWidth, s_terrainDepth);
+
+			// Rays from above the terrain, some of which leave it without hitting it:
+			default_random_engine randomEngine(5);
+			uniform_real_distribution<float> positionDistribution(-40.0f, 40.0f);
+			uniform_real_distribution<float> directionDistribution(-1.0f, 1.0f);
+			size_t hitCount = 0;
+			for (size_t i = 0; i < 300; ++i)
+			{
+				auto origin = XMVectorSet(positionDistribution(randomEngine), 40.0f, positionDistribution(randomEngine), 0.0f);
+				auto direction = XMVector3Normalize(XMVectorSet(directionDistribution(randomEngine), -0.5f, directionDistribution(randomEngine), 0.0f));
+
+				float expectedDistance;
+				auto expectedIntersects = IntersectsAllCells(heightMap, origin, direction, expectedDistance);
+
+				float distance;
+				Assert::AreEqual(expectedIntersects, pyramid.Intersects(heightMap, origin, direction, FLT_MAX, distance));
+				if (!expectedIntersects)
+					continue;
+
+				++hitCount;
+				Assert::AreEqual(expectedDistance, distance, 0.001f);
+
+				// Intersections beyond the maximum distance are ignored:
+				Assert::IsFalse(pyramid.Intersects(heightMap, origin, direction, 0.9f * expectedDistance, distance));
+			}
+
+			Assert::IsTrue(hitCount > 50);
+		}
+
+	private:
+		static constexpr uint32_t s_width = 37;
+		static constexpr uint32_t s_height = 23;
+		static constexpr float s_terrainWidth = 72.0f;
+		static constexpr float s_terrainDepth = 44.0f;
+
+		static vector<float> CreateHeightMap()
+		{
+			default_random_engine randomEngine(11);
+			uniform_real_distribution<float> heightDistribution(0.0f, 20.0f);
+
+			vector<float> heightMap(s_width * s_height);
+			for (auto& height : heightMap)
+				height = heightDistribution(randomEngine);
+
+			return heightMap;
+		}
+
+		static float GetX(float column)
+		{
+			return -0.5f * s_terrainWidth + column * s_terrainWidth / (s_width - 1);
+		}
+		static float GetZ(float row)
+		{
+			return 0.5f * s_terrainDepth - row * s_terrainDepth / (s_height - 1);
+		}
+
+		static bool IntersectsAllCells(const vector<float>& heightMap, FXMVECTOR origin, FXMVECTOR direction, float& distance)
+		{
+			auto getPosition = [&heightMap](uint32_t row, uint32_t column)
+			{
+				return XMVectorSet(GetX(static_cast<float>(column)), heightMap[row * s_width + column], GetZ(static_cast<float>(row)), 0.0f);
+			};
+
+			distance = FLT_MAX;
+			for (uint32_t row = 0; row + 1 < s_height; ++row)
+			{
+				for (uint32_t column = 0; column + 1 < s_width; ++column)
+				{
+					float triangleDistance;
+					if (TriangleTests::Intersects(origin, direction, getPosition(row, column), getPosition(row, column + 1), getPosition(row + 1, column), triangleDistance))
+						distance = min(distance, triangleDistance);
+					if (TriangleTests::Intersects(origin, direction, getPosition(row, column + 1), getPosition(row + 1, column + 1), getPosition(row + 1, column), triangleDistance))
+						distance = min(distance, triangleDistance);
+				}
+			}
+
+			return distance < FLT_MAX;
+		}
+	};
+}
@@ -0,0 +1,106 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+
+#include "GraphicsEngine/HeightMapLoader.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace Common;
+using namespace DirectX;
+using namespace GraphicsEngine;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+
+namespace GraphicsEngineTester
+{
+	TEST_CLASS(HeightMapLoaderTest)
+	{
+	public:
+		TEST_METHOD(TestConvertHeights)
+		{
+			uint32_t width = 19;
+			uint32_t height = 37;
+			vector<uint16_t> rawHeights(width * height);
+			for (size_t i = 0; i < rawHeights.size(); ++i)
+				rawHeights[i] = static_cast<uint16_t>(i * 1777);
+
+			ThreadPool threadPool(3);
+			vector<float> heightMap;
+			HeightMapLoader::ConvertHeights(rawHeights.data(), width, height, 100.0f, threadPool, heightMap);
+
+			Assert::AreEqual(rawHeights.size(), heightMap.size());
+			for (size_t i = 0; i < rawHeights.size(); ++i)
+				Assert::AreEqual(100.0f * static_cast<float>(rawHeights[i]) / 65535.0f, heightMap[i]);
+		}
+
+		TEST_METHOD(TestCalculateNormalsAndTangents)
+		{
+			// Sizes which aren't multiples of four, so that the rows end with texels processed one at a time:
+			for (auto size : { make_pair(37u, 29u), make_pair(64u, 64u), make_pair(3u, 5u) })
+			{
+				auto width = size.first;
+				auto height = size.second;
+
+				default_random_engine randomEngine(width);
+				uniform_real_distribution<float> heightDistribution(0.0f, 50.0f);
+				vector<float> heightMap(width * height);
+				for (auto& value : heightMap)
+					value = heightDistribution(randomEngine);
+
+				for (auto workerThreadCount : { 0, 3 })
+				{
+					ThreadPool threadPool(workerThreadCount);
+					vector<XMFLOAT4> normalMap;
+					vector<XMFLOAT4> tangentMap;
+					HeightMapLoader::CalculateNormalsAndTangents(heightMap, width, height, threadPool, normalMap, tangentMap);
+
+					for (uint32_t i = 0; i < height; ++i)
+					{
+						for (uint32_t j = 0; j < width; ++j)
+						{
+							XMFLOAT4 expectedNormal;
+							XMFLOAT4 expectedTangent;
+							CalculateExpectedNormalAndTangent(heightMap, width, height, i, j, expectedNormal, expectedTangent);
+
+							auto index = i * width + j;
+							AssertNearEqual(expectedNormal, normalMap[index]);
+							AssertNearEqual(expectedTangent, tangentMap[index]);
+						}
+					}
+				}
+			}
+		}
+
+	private:
+		// Reference implementation, one texel at a time:
+		static void CalculateExpectedNormalAndTangent(const vector<float>& heightMap, uint32_t width, uint32_t height, uint32_t i, uint32_t j, XMFLOAT4& normal, XMFLOAT4& tangent)
+		{
+			auto iDown = i == height - 1 ? 0 : i + 1;
+			auto iUp = i == 0 ? height - 1 : i - 1;
+			auto jLeft = j == 0 ? width - 1 : j - 1;
+			auto jRight = j == width - 1 ? 0 : j + 1;
+
+			auto downValue = heightMap[iDown * width + j];
+			auto upValue = heightMap[iUp * width + j];
+			auto leftValue = heightMap[i * width + jLeft];
+			auto rightValue = heightMap[i * width + jRight];
+
+			auto tangentVector = XMVector3Normalize(XMVectorSet(2.0f, (upValue - downValue), 0.0f, 0.0f));
+			auto bitangentVector = XMVector3Normalize(XMVectorSet(0.0f, (rightValue - leftValue), -2.0f, 0.0f));
+			auto normalVector = XMVector3Cross(tangentVector, bitangentVector);
+
+			XMStoreFloat4(&tangent, tangentVector);
+			XMStoreFloat4(&normal, normalVector);
+		}
+
+		static void AssertNearEqual(const XMFLOAT4& expected, const XMFLOAT4& actual)
+		{
+			Assert::AreEqual(expected.x, actual.x, 0.0001f);
+			Assert::AreEqual(expected.y, actual.y, 0.0001f);
+			Assert::AreEqual(expected.z, actual.z, 0.0001f);
+			Assert::AreEqual(expected.w, actual.w, 0.0001f);
+		}
+	};
+}
@@ -0,0 +1,119 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+
+#include "GraphicsEngine/HeightMapSampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+using namespace GraphicsEngine;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+
+namespace GraphicsEngineTester
+{
+	TEST_CLASS(HeightMapSamplerTest)
+	{
+	public:
+		TEST_METHOD(TestSampleHeights)
+		{
+			// Bilinear interpolation reproduces a planar height map exactly:
+			auto heightMap = CreateHeightMap([](float column, float row) { return 2.0f * column + 3.0f * row + 1.0f; });
+			HeightMapSampler sampler(heightMap, s_width, s_height, s_terrainWidth, s_terrainDepth);
+
+			// A count which isn't a multiple of four, with positions outside of the terrain and on its borders:
+			auto positions = CreatePositions(1003);
+			positions[0] = XMFLOAT2(0.5f * s_terrainWidth, -0.5f * s_terrainDepth);
+			positions[1] = XMFLOAT2(-0.5f * s_terrainWidth, 0.5f * s_terrainDepth);
+
+			vector<float> heights(positions.size());
+			sampler.SampleHeights(positions.data(), positions.size(), heights.data());
+
+			for (size_t i = 0; i < positions.size(); ++i)
+			{
+				float column, row;
+				GetTexelPosition(positions[i], column, row);
+				auto expectedHeight = 2.0f * column + 3.0f * row + 1.0f;
+				Assert::AreEqual(expectedHeight, heights[i], 0.001f);
+				Assert::AreEqual(heights[i], sampler.SampleHeight(positions[i].x, positions[i].y), 0.001f);
+			}
+
+			Assert::AreEqual(2.0f * (s_width - 1) + 3.0f * (s_height - 1) + 1.0f, heights[0], 0.001f);
+			Assert::AreEqual(1.0f, heights[1], 0.001f);
+		}
+
+		TEST_METHOD(TestSampleHeightsAndNormals)
+		{
+			auto heightMap = CreateHeightMap([](float column, float row) { return column * row; });
+			HeightMapSampler sampler(heightMap, s_width, s_height, s_terrainWidth, s_terrainDepth);
+
+			// Normals which change linearly along the columns, and which aren't normalized:
+			vector<XMFLOAT4> normalMap(s_width * s_height);
+			for (uint32_t row = 0; row < s_height; ++row)
+			{
+				for (uint32_t column = 0; column < s_width; ++column)
+					normalMap[row * s_width + column] = XMFLOAT4(static_cast<float>(column) - 4.0f, 10.0f, 0.0f, 0.0f);
+			}
+
+			auto positions = CreatePositions(37);
+			vector<float> heights(positions.size());
+			vector<XMFLOAT3> normals(positions.size());
+			sampler.SampleHeightsAndNormals(positions.data(), positions.size(), normalMap, heights.data(), normals.data());
+
+			for (size_t i = 0; i < positions.size(); ++i)
+			{
+				Assert::AreEqual(sampler.SampleHeight(positions[i].x, positions[i].y), heights[i], 0.001f);
+
+				float column, row;
+				GetTexelPosition(positions[i], column, row);
+				auto length = sqrtf((column - 4.0f) * (column - 4.0f) + 100.0f);
+				Assert::AreEqual((column - 4.0f) / length, normals[i].x, 0.001f);
+				Assert::AreEqual(10.0f / length, normals[i].y, 0.001f);
+				Assert::AreEqual(0.0f, normals[i].z, 0.001f);
+			}
+		}
+
+	private:
+		static constexpr uint32_t s_width = 9;
+		static constexpr uint32_t s_height = 7;
+		static constexpr float s_terrainWidth = 80.0f;
+		static constexpr float s_terrainDepth = 60.0f;
+
+		template<typename FunctionType>
+		static vector<float> CreateHeightMap(FunctionType&& function)
+		{
+			vector<float> heightMap(s_width * s_height);
+			for (uint32_t row = 0; row < s_height; ++row)
+			{
+				for (uint32_t column = 0; column < s_width; ++column)
+					heightMap[row * s_width + column] = function(static_cast<float>(column), static_cast<float>(row));
+			}
+
+			return heightMap;
+		}
+
+		// Positions spread over an area larger than the terrain:
+		static vector<XMFLOAT2> CreatePositions(size_t count)
+		{
+			default_random_engine randomEngine(7);
+			uniform_real_distribution<float> xDistribution(-0.6f * s_terrainWidth, 0.6f * s_terrainWidth);
+			uniform_real_distribution<float> zDistribution(-0.6f * s_terrainDepth, 0.6f * s_terrainDepth);
+
+			vector<XMFLOAT2> positions(count);
+			for (auto& position : positions)
+				position = XMFLOAT2(xDistribution(randomEngine), zDistribution(randomEngine));
+
+			return positions;
+		}
+
+		// The texels of the first row lie on the border at +z:
+		static void GetTexelPosition(const XMFLOAT2& position, float& column, float& row)
+		{
+			column = min(max((position.x / s_terrainWidth + 0.5f) * (s_width - 1), 0.0f), static_cast<float>(s_width - 1));
+			row = min(max((-position.y / s_terrainDepth + 0.5f) * (s_height - 1), 0.0f), static_cast<float>(s_height - 1));
+		}
+	};
+}
@@ -0,0 +1,196 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+
+#include "GraphicsEngine/LevelOfDetailSelector.h"
+#include "GraphicsEngine/MeshSimplifier.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace DirectX;
+using namespace GraphicsEngine;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+
+namespace GraphicsEngineTester
+{
+	TEST_CLASS(LevelOfDetailTest)
+	{
+	private:
+		// Grid of size x size quads on the plane y = height(x, z):
+		template<typename HeightFunctionType>
+		static void CreateGrid(uint32_t size, HeightFunctionType&& height, vector<XMFLOAT3>& positions, vector<uint32_t>& indices)
+		{
+			for (uint32_t row = 0; row <= size; ++row)
+			{
+				for (uint32_t column = 0; column <= size; ++column)
+				{
+					auto x = static_cast<float>(column);
+					auto z = static_cast<float>(row);
+					positions.emplace_back(x, height(x, z), z);
+				}
+			}
+
+			for (uint32_t row = 0; row < size; ++row)
+			{
+				for (uint32_t column = 0; column < size; ++column)
+				{
+					auto vertex = row * (size + 1) + column;
+					indices.insert(indices.end(), { vertex, vertex + size + 1, vertex + 1, vertex + 1, vertex + size + 1, vertex + size + 2 });
+				}
+			}
+		}
+
+		// Gives each triangle its own vertices, as importers often do:
+		static void Unweld(const vector<XMFLOAT3>& positions, const vector<uint32_t>& indices, vector<XMFLOAT3>& unweldedPositions, vector<uint32_t>& unweldedIndices)
+		{
+			for (auto index : indices)
+			{
+				unweldedIndices.push_back(static_cast<uint32_t>(unweldedPositions.size()));
+				unweldedPositions.push_back(positions[index]);
+			}
+		}
+
+		// Vertices which share their position only differ in their attributes in indexed meshes:
+		static bool AttributesNeverEqual(uint32_t, uint32_t)
+		{
+			return false;
+		}
+
+		static float CalculateArea(const vector<XMFLOAT3>& positions, const vector<uint32_t>& indices)
+		{
+			float area = 0.0f;
+			for (size_t i = 0; i < indices.size(); i += 3)
+				area += 0.5f * XMVectorGetX(XMVector3Length(CalculateNormal(positions, &indices[i])));
+
+			return area;
+		}
+		static XMVECTOR CalculateNormal(const vector<XMFLOAT3>& positions, const uint32_t* triangle)
+		{
+			auto position0 = XMLoadFloat3(&positions[triangle[0]]);
+			return XMVector3Cross(XMVectorSubtract(XMLoadFloat3(&positions[triangle[1]]), position0), XMVectorSubtract(XMLoadFloat3(&positions[triangle[2]]), position0));
+		}
+
+	public:
+		TEST_METHOD(TestMeshSimplifierFlatGrid)
+		{
+			vector<XMFLOAT3> positions;
+			vector<uint32_t> indices;
+			CreateGrid(32, [](float, float) { return 0.0f; }, positions, indices);
+
+			// A flat grid can be simplified without any error, down to a few triangles:
+			auto simplifiedIndices = MeshSimplifier::Simplify(positions, indices, indices.size() / 10, 0.001f, AttributesNeverEqual);
+			Assert::IsTrue(simplifiedIndices.size() <= indices.size() / 10);
+			Assert::IsTrue(simplifiedIndices.size() % 3 == 0 && !simplifiedIndices.empty());
+
+			// The triangles keep their orientation and the border stays in place, so the grid covers the same area:
+			for (size_t i = 0; i < simplifiedIndices.size(); i += 3)
+				Assert::IsTrue(XMVectorGetY(CalculateNormal(positions, &simplifiedIndices[i])) > 0.0f);
+			Assert::AreEqual(32.0f * 32.0f, CalculateArea(positions, simplifiedIndices), 0.01f);
+		}
+
+		TEST_METHOD(TestMeshSimplifierUnweldedMesh)
+		{
+			vector<XMFLOAT3> gridPositions;
+			vector<uint32_t> gridIndices;
+			CreateGrid(32, [](float, float) { return 0.0f; }, gridPositions, gridIndices);
+			vector<XMFLOAT3> positions;
+			vector<uint32_t> indices;
+			Unweld(gridPositions, gridIndices, positions, indices);
+
+			// Corners with the same attributes are welded, so the grid is simplified as if it was indexed:
+			auto simplifiedIndices = MeshSimplifier::Simplify(positions, indices, indices.size() / 10, 0.001f, [](uint32_t, uint32_t) { return true; });
+			Assert::IsTrue(simplifiedIndices.size() <= indices.size() / 10);
+			Assert::AreEqual(32.0f * 32.0f, CalculateArea(positions, simplifiedIndices), 0.01f);
+
+			// The texture coordinates of each half of the grid differ along the column in the middle, which stays in place:
+			auto getSide = [&positions, &indices](uint32_t vertex)
+			{
+				const auto* triangle = &indices[vertex / 3 * 3];
+				return positions[triangle[0]].x + positions[triangle[1]].x + positions[triangle[2]].x < 3.0f * 16.0f;
+			};
+			auto seamIndices = MeshSimplifier::Simplify(positions, indices, 0, 0.001f, [&getSide](uint32_t vertex0, uint32_t vertex1) { return getSide(vertex0) == getSide(vertex1); });
+			Assert::IsTrue(seamIndices.size() < indices.size() / 10);
+			Assert::AreEqual(32.0f * 32.0f, CalculateArea(positions, seamIndices), 0.01f);
+			for (uint32_t row = 0; row <= 32; ++row)
+			{
+				auto isSeamVertex = [&positions, row](uint32_t vertex) { return positions[vertex].x == 16.0f && positions[vertex].z == static_cast<float>(row); };
+				Assert::IsTrue(any_of(seamIndices.begin(), seamIndices.end(), isSeamVertex));
+			}
+
+			// Each triangle keeps the vertices of its side:
+			for (size_t i = 0; i < seamIndices.size(); i += 3)
+			{
+				auto center = (positions[seamIndices[i]].x + positions[seamIndices[i + 1]].x + positions[seamIndices[i + 2]].x) / 3.0f;
+				for (size_t corner = 0; corner < 3; ++corner)
+					Assert::AreEqual(center < 16.0f, getSide(seamIndices[i + corner]));
+			}
+		}
+
+		TEST_METHOD(TestMeshSimplifierMaxError)
+		{
+			// Hill in the middle of a grid:
+			vector<XMFLOAT3> positions;
+			vector<uint32_t> indices;
+			auto height = [](float x, float z) { return 8.0f * exp(-((x - 16.0f) * (x - 16.0f) + (z - 16.0f) * (z - 16.0f)) / 32.0f); };
+			CreateGrid(32, height, positions, indices);
+
+			// The error limit stops the simplification before the target is reached, and the looser it is, the fewer triangles are kept:
+			auto fineIndices = MeshSimplifier::Simplify(positions, indices, 0, 0.01f, AttributesNeverEqual);
+			auto coarseIndices = MeshSimplifier::Simplify(positions, indices, 0, 0.5f, AttributesNeverEqual);
+			Assert::IsTrue(fineIndices.size() < indices.size());
+			Assert::IsTrue(coarseIndices.size() < fineIndices.size());
+
+			// The simplified triangles only reference vertices of the original mesh and aren't degenerate:
+			for (size_t i = 0; i < coarseIndices.size(); i += 3)
+			{
+				Assert::IsTrue(*max_element(coarseIndices.begin() + i, coarseIndices.begin() + i + 3) < positions.size());
+				Assert::IsTrue(XMVectorGetX(XMVector3LengthSq(CalculateNormal(positions, &coarseIndices[i]))) > 0.0f);
+			}
+
+			// The maximum error is a distance, so scaling the mesh and the error together keeps about the same number of triangles.
+			// Only the order of the collapses without error, around the hill, can change with the rounding errors:
+			vector<XMFLOAT3> scaledPositions(positions);
+			for (auto& position : scaledPositions)
+				position = XMFLOAT3(10.0f * position.x, 10.0f * position.y, 10.0f * position.z);
+			auto scaledFineIndices = MeshSimplifier::Simplify(scaledPositions, indices, 0, 0.1f, AttributesNeverEqual);
+			Assert::AreEqual(static_cast<float>(fineIndices.size()), static_cast<float>(scaledFineIndices.size()), 0.01f * fineIndices.size());
+
+			// Vertices sharing a position with other vertices are on seams, such as the top of the hill here, and are never collapsed:
+			auto topVertex = static_cast<uint32_t>(16 * 33 + 16);
+			auto seamVertex = static_cast<uint32_t>(positions.size());
+			positions.push_back(positions[topVertex]);
+			*find(indices.begin(), indices.end(), topVertex) = seamVertex;
+			auto seamIndices = MeshSimplifier::Simplify(positions, indices, 0, 0.5f, AttributesNeverEqual);
+			Assert::IsTrue(find(seamIndices.begin(), seamIndices.end(), topVertex) != seamIndices.end());
+			Assert::IsTrue(find(seamIndices.begin(), seamIndices.end(), seamVertex) != seamIndices.end());
+		}
+
+		TEST_METHOD(TestLevelOfDetailSelector)
+		{
+			LevelOfDetailSelector selector({ 0.3f, 0.1f, 0.03f }, 0.15f);
+
+			// Without a current level, the thresholds select the level:
+			Assert::AreEqual(static_cast<uint8_t>(0), selector.Select(1.0f, 4, 4));
+			Assert::AreEqual(static_cast<uint8_t>(1), selector.Select(0.2f, 4, 4));
+			Assert::AreEqual(static_cast<uint8_t>(2), selector.Select(0.05f, 4, 4));
+			Assert::AreEqual(static_cast<uint8_t>(3), selector.Select(0.01f, 4, 4));
+
+			// Meshes with fewer levels use their last level for smaller sizes:
+			Assert::AreEqual(static_cast<uint8_t>(1), selector.Select(0.01f, 2, 2));
+			Assert::AreEqual(static_cast<uint8_t>(0), selector.Select(0.01f, 1, 1));
+
+			// Close to a threshold, the current level is kept in both directions:
+			Assert::AreEqual(static_cast<uint8_t>(0), selector.Select(0.28f, 0, 4));
+			Assert::AreEqual(static_cast<uint8_t>(1), selector.Select(0.32f, 1, 4));
+			Assert::AreEqual(static_cast<uint8_t>(1), selector.Select(0.2f, 0, 4));
+			Assert::AreEqual(static_cast<uint8_t>(0), selector.Select(0.4f, 1, 4));
+
+			// The screen size is inversely proportional to the distance:
+			BoundingBox bounds({ 0.0f, 0.0f, 100.0f }, { 3.0f, 4.0f, 0.0f });
+			auto screenSize = LevelOfDetailSelector::CalculateScreenSize(bounds, XMVectorZero(), 2.0f);
+			Assert::AreEqual(0.1f, screenSize, 0.0001f);
+			Assert::IsTrue(LevelOfDetailSelector::CalculateScreenSize(bounds, XMVectorSet(0.0f, 0.0f, 99.0f, 1.0f), 2.0f) > 1.0f);
+		}
+	};
+}
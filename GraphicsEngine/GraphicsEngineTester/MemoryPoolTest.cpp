@@ -1,7 +1,19 @@
 #include "stdafx.h"
 #include "CppUnitTest.h"
 
+#include "Common/ConcurrentMemoryPool.h"
 #include "Common/MemoryPool.h"
+#include "Common/PagedMemoryPool.h"
+#include "Common/PerformanceTimer.h"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
 
 using namespace GraphicsEngine;
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
@@ -27,8 +39,126 @@ namespace GraphicsEngineTester
 		size_t m_id = -1;
 	};
 
+	// Counts its constructions, and has no default constructor:
+	class MemoryPoolConstructionTestClass
+	{
+	public:
+		explicit MemoryPoolConstructionTestClass(size_t id) :
+			m_id(id)
+		{
+			++s_constructionCount;
+		}
+
+		size_t GetID() const
+		{
+			return m_id;
+		}
+
+	public:
+		static size_t s_constructionCount;
+
+	private:
+		size_t m_id;
+	};
+	size_t MemoryPoolConstructionTestClass::s_constructionCount = 0;
+
+	// Same layout as an octree node: bounds, children and the objects of the node.
+	class MemoryPoolNodeTestClass
+	{
+	public:
+		explicit MemoryPoolNodeTestClass(size_t objectCount) :
+			m_objects(objectCount)
+		{
+		}
+
+	private:
+		array<float, 6> m_bounds = {};
+		array<MemoryPoolNodeTestClass*, 8> m_children = {};
+		vector<void*> m_objects;
+	};
+
 	TEST_CLASS(MemoryPoolTest)
 	{
+	private:
+		// Splits and merges random nodes, like an octree whose objects move, keeping about the initial number of nodes alive.
+		// Returns the elapsed time in milliseconds:
+		template<typename NewNodeType, typename DeleteNodeType>
+		static float RunNodeChurn(size_t nodeCount, size_t operationCount, NewNodeType&& newNode, DeleteNodeType&& deleteNode)
+		{
+			mt19937 randomEngine(0);
+			vector<MemoryPoolNodeTestClass*> nodes;
+			nodes.reserve(nodeCount + 8);
+
+			Common::PerformanceTimer timer;
+			timer.Start();
+
+			for (size_t i = 0; i < nodeCount; ++i)
+				nodes.push_back(newNode());
+
+			for (size_t operation = 0; operation < operationCount; ++operation)
+			{
+				if (nodes.size() < nodeCount)
+				{
+					// Split a node into eight children:
+					for (size_t i = 0; i < 8; ++i)
+						nodes.push_back(newNode());
+				}
+				else
+				{
+					// Merge eight nodes, taken from anywhere in the tree:
+					for (size_t i = 0; i < 8; ++i)
+					{
+						auto index = randomEngine() % nodes.size();
+						deleteNode(nodes[index]);
+						nodes[index] = nodes.back();
+						nodes.pop_back();
+					}
+				}
+			}
+
+			for (auto node : nodes)
+				deleteNode(node);
+
+			timer.End();
+			return timer.ElapsedTime<float, milli>().count();
+		}
+
+		// Each thread repeatedly creates a batch of elements and deletes them. Returns the elapsed time in milliseconds:
+		template<typename NewElementType, typename DeleteElementType>
+		static float RunThreads(size_t threadCount, size_t batchCount, NewElementType&& newElement, DeleteElementType&& deleteElement)
+		{
+			Common::PerformanceTimer timer;
+			timer.Start();
+
+			atomic<bool> sharedElement { false };
+			vector<thread> threads;
+			for (size_t threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+			{
+				threads.emplace_back([threadIndex, batchCount, &newElement, &deleteElement, &sharedElement]()
+				{
+					array<MemoryPoolTestClass*, 64> elements;
+					for (size_t batch = 0; batch < batchCount; ++batch)
+					{
+						for (size_t i = 0; i < elements.size(); ++i)
+							elements[i] = newElement(threadIndex, threadIndex * elements.size() + i);
+						for (size_t i = 0; i < elements.size(); ++i)
+						{
+							// Another thread using the same element would have overwritten it:
+							if (elements[i]->GetID() != threadIndex * elements.size() + i)
+								sharedElement = true;
+							deleteElement(threadIndex, elements[i]);
+						}
+					}
+				});
+			}
+			for (auto& thread : threads)
+				thread.join();
+
+			timer.End();
+			Assert::IsFalse(sharedElement.load());
+			return timer.ElapsedTime<float, milli>().count();
+		}
+
 	public:
 		TEST_METHOD(TestMemoryPool)
 		{
@@ -67,5 +197,199 @@ namespace GraphicsEngineTester
 			memoryPool.DeleteElement(element5);
 			Assert::AreEqual(static_cast<size_t>(3), memoryPool.GetActiveElements());
 		}
+
+		TEST_METHOD(TestPagedMemoryPool)
+		{
+			PagedMemoryPool<MemoryPoolTestClass, 4> memoryPool;
+			Assert::AreEqual(static_cast<size_t>(0), memoryPool.GetCapacity());
+
+			// Fill the first page:
+			vector<MemoryPoolTestClass*> elements;
+			for (size_t i = 0; i < 4; ++i)
+				elements.push_back(&memoryPool.NewElement(i));
+			Assert::AreEqual(static_cast<size_t>(4), memoryPool.GetCapacity());
+
+			// Adding an element to a full pool adds a page, without moving the existing elements:
+			elements.push_back(&memoryPool.NewElement(4));
+			Assert::AreEqual(static_cast<size_t>(8), memoryPool.GetCapacity());
+			Assert::AreEqual(static_cast<size_t>(5), memoryPool.GetActiveElements());
+			for (size_t i = 0; i < elements.size(); ++i)
+				Assert::AreEqual(i, elements[i]->GetID());
+
+			// Deleted elements are reused before adding pages:
+			memoryPool.DeleteElement(*elements[1]);
+			memoryPool.DeleteElement(*elements[1]);
+			Assert::AreEqual(static_cast<size_t>(4), memoryPool.GetActiveElements());
+			auto& element = memoryPool.NewElement(5);
+			Assert::IsTrue(&element == elements[1]);
+			Assert::AreEqual(static_cast<size_t>(5), element.GetID());
+			Assert::AreEqual(static_cast<size_t>(8), memoryPool.GetCapacity());
+
+			// Statistics:
+			Assert::AreEqual(static_cast<size_t>(2), memoryPool.GetPageCount());
+			Assert::AreEqual(static_cast<size_t>(5), memoryPool.GetPeakActiveElements());
+			Assert::AreEqual(2 * 4 * sizeof(MemoryPoolElement<MemoryPoolTestClass>), memoryPool.GetMemoryUsage());
+
+			// Reserving adds whole pages, and only when the capacity is too small:
+			memoryPool.Reserve(9);
+			Assert::AreEqual(static_cast<size_t>(12), memoryPool.GetCapacity());
+			memoryPool.Reserve(4);
+			Assert::AreEqual(static_cast<size_t>(12), memoryPool.GetCapacity());
+			for (size_t i = 0; i < 7; ++i)
+				memoryPool.NewElement(i);
+			Assert::AreEqual(static_cast<size_t>(12), memoryPool.GetCapacity());
+			Assert::AreEqual(static_cast<size_t>(12), memoryPool.GetPeakActiveElements());
+		}
+		TEST_METHOD(TestPagedMemoryPoolConstruction)
+		{
+			MemoryPoolConstructionTestClass::s_constructionCount = 0;
+			PagedMemoryPool<MemoryPoolConstructionTestClass, 4> memoryPool;
+
+			// Adding pages doesn't construct the elements of their free slots:
+			memoryPool.Reserve(8);
+			Assert::AreEqual(static_cast<size_t>(0), MemoryPoolConstructionTestClass::s_constructionCount);
+
+			// Each new element is constructed once, in place:
+			auto& element = memoryPool.NewElement(7);
+			Assert::AreEqual(static_cast<size_t>(1), MemoryPoolConstructionTestClass::s_constructionCount);
+			Assert::AreEqual(static_cast<size_t>(7), element.GetID());
+
+			memoryPool.DeleteElement(element);
+			memoryPool.NewElement(8);
+			Assert::AreEqual(static_cast<size_t>(2), MemoryPoolConstructionTestClass::s_constructionCount);
+		}
+
+		TEST_METHOD(TestConcurrentMemoryPool)
+		{
+			ConcurrentMemoryPool<MemoryPoolTestClass, 4> memoryPool;
+			Assert::AreEqual(static_cast<size_t>(0), memoryPool.GetCapacity());
+
+			// Same behaviour as the paged pool from a single thread:
+			vector<MemoryPoolTestClass*> elements;
+			for (size_t i = 0; i < 5; ++i)
+				elements.push_back(&memoryPool.NewElement(i));
+			Assert::AreEqual(static_cast<size_t>(8), memoryPool.GetCapacity());
+			Assert::AreEqual(static_cast<size_t>(5), memoryPool.GetActiveElements());
+			for (size_t i = 0; i < elements.size(); ++i)
+				Assert::AreEqual(i, elements[i]->GetID());
+
+			memoryPool.DeleteElement(*elements[1]);
+			auto& element = memoryPool.NewElement(5);
+			Assert::IsTrue(&element == elements[1]);
+			Assert::AreEqual(static_cast<size_t>(5), memoryPool.GetActiveElements());
+
+			// Elements created through a cache can be deleted without it, and the other way around:
+			{
+				ConcurrentMemoryPool<MemoryPoolTestClass, 4>::Cache<8> cache(memoryPool);
+				auto& cachedElement = cache.NewElement(6);
+				Assert::AreEqual(static_cast<size_t>(6), cachedElement.GetID());
+				cache.DeleteElement(*elements[0]);
+				memoryPool.DeleteElement(cachedElement);
+			}
+			Assert::AreEqual(static_cast<size_t>(4), memoryPool.GetActiveElements());
+
+			// The cache took the three available elements at once, instead of adding a page for the fourth one:
+			Assert::AreEqual(static_cast<size_t>(8), memoryPool.GetCapacity());
+
+			// Elements are never handed to two threads at once:
+			ConcurrentMemoryPool<MemoryPoolTestClass, 64> concurrentPool;
+			RunThreads(4, 1000,
+				[&concurrentPool](size_t, size_t id) { return &concurrentPool.NewElement(id); },
+				[&concurrentPool](size_t, MemoryPoolTestClass* element) { concurrentPool.DeleteElement(*element); }
+			);
+			Assert::AreEqual(static_cast<size_t>(0), concurrentPool.GetActiveElements());
+
+			{
+				vector<unique_ptr<ConcurrentMemoryPool<MemoryPoolTestClass, 64>::Cache<>>> caches;
+				for (size_t i = 0; i < 4; ++i)
+					caches.push_back(make_unique<ConcurrentMemoryPool<MemoryPoolTestClass, 64>::Cache<>>(concurrentPool));
+				RunThreads(4, 1000,
+					[&caches](size_t threadIndex, size_t id) { return &caches[threadIndex]->NewElement(id); },
+					[&caches](size_t threadIndex, MemoryPoolTestClass* element) { caches[threadIndex]->DeleteElement(*element); }
+				);
+			}
+			Assert::AreEqual(static_cast<size_t>(0), concurrentPool.GetActiveElements());
+
+			// At most the elements of four batches and four caches are in use at once:
+			Assert::IsTrue(concurrentPool.GetCapacity() <= 4 * (64 + 64));
+		}
+
+		TEST_METHOD(BenchmarkMemoryPools)
+		{
+			constexpr size_t nodeCount = 50000;
+			constexpr size_t operationCount = 1000000;
+
+			auto newDeleteTime = RunNodeChurn(nodeCount, operationCount,
+				[]() { return new MemoryPoolNodeTestClass(0); },
+				[](MemoryPoolNodeTestClass* node) { delete node; }
+			);
+
+			// The fixed pool must be sized for the peak number of nodes up front:
+			auto fixedPool = make_unique<MemoryPool<MemoryPoolNodeTestClass, nodeCount + 8>>();
+			auto fixedPoolTime = RunNodeChurn(nodeCount, operationCount,
+				[&fixedPool]() { return &fixedPool->NewElement(0); },
+				[&fixedPool](MemoryPoolNodeTestClass* node) { fixedPool->DeleteElement(*node); }
+			);
+
+			PagedMemoryPool<MemoryPoolNodeTestClass, 256> pagedPool;
+			auto pagedPoolTime = RunNodeChurn(nodeCount, operationCount,
+				[&pagedPool]() { return &pagedPool.NewElement(0); },
+				[&pagedPool](MemoryPoolNodeTestClass* node) { pagedPool.DeleteElement(*node); }
+			);
+			Assert::AreEqual(static_cast<size_t>(0), pagedPool.GetActiveElements());
+
+			auto message =
+				L"Octree node churn with " + to_wstring(nodeCount) + L" nodes and " + to_wstring(operationCount) + L" splits and merges:\n" +
+				L"  new/delete: " + to_wstring(newDeleteTime) + L" ms\n" +
+				L"  MemoryPool: " + to_wstring(fixedPoolTime) + L" ms\n" +
+				L"  PagedMemoryPool: " + to_wstring(pagedPoolTime) + L" ms (" + to_wstring(pagedPool.GetPageCount()) + L" pages, " +
+				to_wstring(pagedPool.GetMemoryUsage() / 1024) + L" KiB, peak " + to_wstring(pagedPool.GetPeakActiveElements()) + L" nodes)\n";
+			Logger::WriteMessage(message.c_str());
+		}
+
+		TEST_METHOD(BenchmarkConcurrentMemoryPool)
+		{
+			constexpr size_t elementCount = 4000000;
+
+			wstring message = L"Creating and deleting " + to_wstring(elementCount) + L" elements, split between threads:\n";
+			for (size_t threadCount = 1; threadCount <= 8; threadCount *= 2)
+			{
+				auto batchCount = elementCount / 64 / threadCount;
+
+				auto newDeleteTime = RunThreads(threadCount, batchCount,
+					[](size_t, size_t id) { return new MemoryPoolTestClass(id); },
+					[](size_t, MemoryPoolTestClass* element) { delete element; }
+				);
+
+				mutex pagedPoolMutex;
+				PagedMemoryPool<MemoryPoolTestClass, 256> pagedPool;
+				auto pagedPoolTime = RunThreads(threadCount, batchCount,
+					[&pagedPool, &pagedPoolMutex](size_t, size_t id) { lock_guard<mutex> lock(pagedPoolMutex); return &pagedPool.NewElement(id); },
+					[&pagedPool, &pagedPoolMutex](size_t, MemoryPoolTestClass* element) { lock_guard<mutex> lock(pagedPoolMutex); pagedPool.DeleteElement(*element); }
+				);
+
+				ConcurrentMemoryPool<MemoryPoolTestClass, 256> concurrentPool;
+				auto concurrentPoolTime = RunThreads(threadCount, batchCount,
+					[&concurrentPool](size_t, size_t id) { return &concurrentPool.NewElement(id); },
+					[&concurrentPool](size_t, MemoryPoolTestClass* element) { concurrentPool.DeleteElement(*element); }
+				);
+
+				using CacheType = ConcurrentMemoryPool<MemoryPoolTestClass, 256>::Cache<>;
+				vector<unique_ptr<CacheType>> caches;
+				for (size_t i = 0; i < threadCount; ++i)
+					caches.push_back(make_unique<CacheType>(concurrentPool));
+				auto cachedPoolTime = RunThreads(threadCount, batchCount,
+					[&caches](size_t threadIndex, size_t id) { return &caches[threadIndex]->NewElement(id); },
+					[&caches](size_t threadIndex, MemoryPoolTestClass* element) { caches[threadIndex]->DeleteElement(*element); }
+				);
+
+				message +=
+					L"  " + to_wstring(threadCount) + L" threads: new/delete " + to_wstring(newDeleteTime) + L" ms, " +
+					L"PagedMemoryPool with a mutex " + to_wstring(pagedPoolTime) + L" ms, " +
+					L"ConcurrentMemoryPool " + to_wstring(concurrentPoolTime) + L" ms, " +
+					L"with caches " + to_wstring(cachedPoolTime) + L" ms\n";
+			}
+			Logger::WriteMessage(message.c_str());
+		}
 	};
 }
\ No newline at end of file
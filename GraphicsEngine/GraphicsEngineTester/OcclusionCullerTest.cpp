@@ -0,0 +1,216 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+
+#include "GraphicsEngine/Camera.h"
+#include "GraphicsEngine/Frustum.h"
+#include "GraphicsEngine/OcclusionCuller.h"
+#include "Common/Helpers.h"
+#include "Common/PerformanceTimer.h"
+#include "TestHelpers.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace DirectX;
+using namespace GraphicsEngine;
+using namespace GraphicsEngineTester::TestHelpers;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+
+namespace GraphicsEngineTester
+{
+	TEST_CLASS(OcclusionCullerTest)
+	{
+	private:
+		static XMMATRIX CreateViewProjectionMatrix(Camera& camera)
+		{
+			camera.Update();
+			return XMMatrixMultiply(camera.GetViewMatrix(), camera.GetProjectionMatrix());
+		}
+
+		// Flat valley along the x-axis, closed by a ridge on the positive z-axis:
+		static vector<float> CreateValleyHeightMap(uint32_t size, float terrainDepth)
+		{
+			vector<float> heightMap(size * size);
+			for (uint32_t row = 0; row < size; ++row)
+			{
+				auto z = (0.5f - static_cast<float>(row) / (size - 1)) * terrainDepth;
+				auto height = z > 40.0f && z < 100.0f ? 60.0f : 0.0f;
+				fill(heightMap.begin() + row * size, heightMap.begin() + (row + 1) * size, height);
+			}
+
+			return heightMap;
+		}
+
+	public:
+		TEST_METHOD(TestOcclusionCullerMeshOccluder)
+		{
+			// Wall in front of a camera looking at the positive z-axis:
+			OcclusionCuller occlusionCuller(128, 72);
+			vector<XMFLOAT3> vertices =
+			{
+				{ -100.0f, -100.0f, 50.0f },
+				{ 100.0f, -100.0f, 50.0f },
+				{ 100.0f, 100.0f, 50.0f },
+				{ -100.0f, 100.0f, 50.0f },
+			};
+			occlusionCuller.AddMeshOccluder(vertices, { 0, 1, 2, 0, 2, 3 });
+			Assert::AreEqual(static_cast<size_t>(2), occlusionCuller.GetOccluderTriangleCount());
+
+			Camera camera(16.0f / 9.0f, XM_PIDIV2, 0.1f, 1000.0f, XMMatrixIdentity());
+			occlusionCuller.Render(CreateViewProjectionMatrix(camera));
+
+			// Boxes behind the wall are occluded, boxes in front of it or beside it are not:
+			Assert::IsFalse(occlusionCuller.IsVisible(BoundingBox({ 0.0f, 0.0f, 100.0f }, { 1.0f, 1.0f, 1.0f })));
+			Assert::IsFalse(occlusionCuller.IsVisible(BoundingBox({ 30.0f, -20.0f, 500.0f }, { 20.0f, 20.0f, 20.0f })));
+			Assert::IsTrue(occlusionCuller.IsVisible(BoundingBox({ 0.0f, 0.0f, 20.0f }, { 1.0f, 1.0f, 1.0f })));
+			Assert::IsTrue(occlusionCuller.IsVisible(BoundingBox({ 250.0f, 0.0f, 100.0f }, { 1.0f, 1.0f, 1.0f })));
+
+			// A box crossing the wall is in front of it:
+			Assert::IsTrue(occlusionCuller.IsVisible(BoundingBox({ 0.0f, 0.0f, 50.0f }, { 1.0f, 1.0f, 1.0f })));
+
+			// Boxes crossing the near plane are never occluded:
+			Assert::IsTrue(occlusionCuller.IsVisible(BoundingBox({ 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f })));
+
+			// Every texel of the pyramid keeps the farthest depth of the texels below it:
+			for (size_t levelIndex = 1; levelIndex < occlusionCuller.m_depthLevels.size(); ++levelIndex)
+			{
+				const auto& previousLevel = occlusionCuller.m_depthLevels[levelIndex - 1];
+				const auto& level = occlusionCuller.m_depthLevels[levelIndex];
+				for (uint32_t y = 0; y < previousLevel.Height; ++y)
+				{
+					for (uint32_t x = 0; x < previousLevel.Width; ++x)
+						Assert::IsTrue(previousLevel.Depths[y * previousLevel.Width + x] <= level.Depths[(y / 2) * level.Width + x / 2]);
+				}
+			}
+			Assert::AreEqual(static_cast<uint32_t>(1), occlusionCuller.m_depthLevels.back().Width);
+			Assert::AreEqual(static_cast<uint32_t>(1), occlusionCuller.m_depthLevels.back().Height);
+
+			// Moving the camera behind the wall reveals the box:
+			camera.SetPosition(0.0f, 0.0f, 60.0f);
+			occlusionCuller.Render(CreateViewProjectionMatrix(camera));
+			Assert::IsTrue(occlusionCuller.IsVisible(BoundingBox({ 0.0f, 0.0f, 100.0f }, { 1.0f, 1.0f, 1.0f })));
+		}
+
+		TEST_METHOD(TestOcclusionCullerHeightMapOccluder)
+		{
+			constexpr uint32_t heightMapSize = 129;
+			constexpr float terrainSize = 256.0f;
+			auto heightMap = CreateValleyHeightMap(heightMapSize, terrainSize);
+
+			OcclusionCuller occlusionCuller(128, 72);
+			occlusionCuller.AddHeightMapOccluder(heightMap, heightMapSize, heightMapSize, terrainSize, terrainSize, 32);
+			Assert::AreEqual(static_cast<size_t>(2 * 32 * 32), occlusionCuller.GetOccluderTriangleCount());
+
+			// The grid must never rise above the height map:
+			for (const auto& vertex : occlusionCuller.m_occluderVertices)
+			{
+				auto column = static_cast<uint32_t>((vertex.x / terrainSize + 0.5f) * (heightMapSize - 1) + 0.5f);
+				auto row = static_cast<uint32_t>((0.5f - vertex.z / terrainSize) * (heightMapSize - 1) + 0.5f);
+				Assert::IsTrue(vertex.y <= heightMap[row * heightMapSize + column]);
+			}
+
+			// Camera in the valley, looking at the ridge:
+			Camera camera(16.0f / 9.0f, XM_PIDIV2, 0.2f, 1000.0f, XMMatrixIdentity());
+			camera.SetPosition(0.0f, 5.0f, -100.0f);
+			auto viewProjectionMatrix = CreateViewProjectionMatrix(camera);
+			Frustum frustum(viewProjectionMatrix);
+			occlusionCuller.Render(viewProjectionMatrix);
+
+			// Objects behind the ridge are hidden, unless they are higher than it:
+			BoundingBox hiddenBox({ 0.0f, 2.0f, 110.0f }, { 2.0f, 2.0f, 2.0f });
+			BoundingBox highBox({ 0.0f, 250.0f, 300.0f }, { 2.0f, 2.0f, 2.0f });
+			BoundingBox nearBox({ 0.0f, 2.0f, 30.0f }, { 2.0f, 2.0f, 2.0f });
+			for (const auto& box : { hiddenBox, highBox, nearBox })
+				Assert::IsTrue(frustum.Contains(box) != ContainmentType::DISJOINT);
+			Assert::IsFalse(occlusionCuller.IsVisible(hiddenBox));
+			Assert::IsTrue(occlusionCuller.IsVisible(highBox));
+			Assert::IsTrue(occlusionCuller.IsVisible(nearBox));
+
+			// Looking down from above the ridge, nothing is hidden:
+			camera.SetPosition(0.0f, 400.0f, 0.0f);
+			camera.RotateLocalX(-XM_PI / 3.0f);
+			viewProjectionMatrix = CreateViewProjectionMatrix(camera);
+			Assert::IsTrue(Frustum(viewProjectionMatrix).Contains(hiddenBox) != ContainmentType::DISJOINT);
+			occlusionCuller.Render(viewProjectionMatrix);
+			Assert::IsTrue(occlusionCuller.IsVisible(hiddenBox));
+		}
+
+		TEST_METHOD(BenchmarkOcclusionCulling)
+		{
+			// The tests run from the output directory, which is next to the working directory of the application:
+			vector<uint16_t> buffer;
+			wstring heightMapFilename(L"../WorkingDirectory/Textures/TerrainHeightMap.r16");
+			if (!Common::Helpers::FileExists(heightMapFilename))
+			{
+				Logger::WriteMessage(L"Occlusion culling: skipped, height map not found\n");
+				return;
+			}
+			Common::Helpers::ReadData(heightMapFilename, buffer);
+
+			// Same terrain as the default scene:
+			constexpr uint32_t heightMapSize = 1024;
+			constexpr float terrainSize = 1024.0f;
+			constexpr float heightFactor = 256.0f;
+			vector<float> heightMap(buffer.size());
+			transform(buffer.begin(), buffer.end(), heightMap.begin(), [](uint16_t height) { return heightFactor * height / 65535.0f; });
+			auto getHeight = [&heightMap](float x, float z)
+			{
+				auto column = min(static_cast<uint32_t>((x / terrainSize + 0.5f) * heightMapSize), heightMapSize - 1);
+				auto row = min(static_cast<uint32_t>((-z / terrainSize + 0.5f) * heightMapSize), heightMapSize - 1);
+				return heightMap[row * heightMapSize + column];
+			};
+
+			// Trees scattered over the terrain, standing on the ground:
+			auto instancesBounds = CreateRandomBoxes(100000, 480.0f, 0.0f, 2.0f, 4.0f);
+			for (auto& bounds : instancesBounds)
+				bounds.Center.y = getHeight(bounds.Center.x, bounds.Center.z) + bounds.Extents.y;
+
+			Common::PerformanceTimer timer;
+			timer.Start();
+			OcclusionCuller occlusionCuller(256, 144);
+			occlusionCuller.AddHeightMapOccluder(heightMap, heightMapSize, heightMapSize, terrainSize, terrainSize, 64);
+			timer.End();
+			auto setupTime = timer.ElapsedTime<float, milli>().count();
+
+			// Start position of the camera of the application, turning around in the valley:
+			Camera camera(16.0f / 9.0f, XM_PIDIV4, 0.2f, 1500.0f, XMMatrixIdentity());
+			camera.SetPosition(220.0f - 512.0f, 27.0f, 512.0f);
+			camera.RotateWorldY(XM_PI);
+
+			wstring message = L"Occlusion culling of " + to_wstring(instancesBounds.size()) + L" instances with a terrain of " + to_wstring(occlusionCuller.GetOccluderTriangleCount()) + L" triangles (" + to_wstring(setupTime) + L" ms setup):\n";
+			for (size_t view = 0; view < 4; ++view)
+			{
+				auto viewProjectionMatrix = CreateViewProjectionMatrix(camera);
+				Frustum frustum(viewProjectionMatrix);
+				camera.RotateWorldY(XM_PIDIV2);
+
+				timer.Start();
+				occlusionCuller.Render(viewProjectionMatrix);
+				timer.End();
+				auto renderTime = timer.ElapsedTime<float, milli>().count();
+
+				size_t insideFrustumCount = 0;
+				size_t visibleCount = 0;
+				timer.Start();
+				for (const auto& bounds : instancesBounds)
+				{
+					if (frustum.Contains(bounds) == ContainmentType::DISJOINT)
+						continue;
+
+					++insideFrustumCount;
+					if (occlusionCuller.IsVisible(bounds))
+						++visibleCount;
+				}
+				timer.End();
+				auto testTime = timer.ElapsedTime<float, milli>().count();
+
+				message +=
+					L"  View " + to_wstring(view) + L": " + to_wstring(visibleCount) + L" of " + to_wstring(insideFrustumCount) + L" instances inside the frustum are visible, " +
+					L"render: " + to_wstring(renderTime) + L" ms, tests: " + to_wstring(testTime) + L" ms\n";
+			}
+			Logger::WriteMessage(message.c_str());
+		}
+	};
+}
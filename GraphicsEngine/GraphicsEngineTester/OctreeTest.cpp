@@ -2,12 +2,21 @@
 #include "CppUnitTest.h"
 
 #include "GraphicsEngine/Octree.h"
+#include "GraphicsEngine/LinearOctree.h"
 #include "GraphicsEngine/Camera.h"
-#include "GraphicsEngine/OctreeCollider.h"
-#include "GraphicsEngine/RenderItem.h"
+#include "GraphicsEngine/Frustum.h"
+#include "GraphicsEngine/OctreeBaseCollider.h"
+#include "Common/PerformanceTimer.h"
+#include "TestHelpers.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <string>
 
 using namespace DirectX;
 using namespace GraphicsEngine;
+using namespace GraphicsEngineTester::TestHelpers;
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 using namespace std;
 
@@ -38,10 +47,21 @@ namespace GraphicsEngineTester
 		{
 			return box.Intersects(m_box);
 		}
-		bool __vectorcall Intersects(const DirectX::BoundingFrustum& viewSpaceCameraFrustum, DirectX::FXMMATRIX inverseViewMatrix) const override
+		bool Intersects(const Frustum& frustum) const override
+		{
+			++s_frustumTestCount;
+			return frustum.Contains(m_box) != ContainmentType::DISJOINT;
+		}
+		void SetBounds(const DirectX::BoundingBox& bounds) override
 		{
-			throw runtime_error("Not Implemented");
+			m_box = bounds;
 		}
+		const DirectX::BoundingBox& GetBounds() const override
+		{
+			return m_box;
+		}
+
+		static size_t s_frustumTestCount;
 
 	private:
 		size_t m_id;
@@ -49,6 +69,7 @@ namespace GraphicsEngineTester
 		static size_t s_counter;
 	};
 	size_t ColliderTestClass::s_counter = 0;
+	size_t ColliderTestClass::s_frustumTestCount = 0;
 
 	TEST_CLASS(OctreeTest)
 	{
@@ -147,39 +168,376 @@ namespace GraphicsEngineTester
 
 		TEST_METHOD(TestOctreeFrustumIntersection)
 		{
-			Camera camera(16.0f / 9.0f, 90.0f, 0.01f, 1000.0f, XMMatrixIdentity());
-			
-			// Get view matrix and calculate its inverse:
+			// Camera at the origin, looking along the positive Z-axis:
+			Camera camera(16.0f / 9.0f, XM_PIDIV2, 0.01f, 1000.0f, XMMatrixIdentity());
 			camera.Update();
-			auto viewMatrix = camera.GetViewMatrix();
-			auto viewMatrixDeterminant = XMMatrixDeterminant(viewMatrix);
-			auto inverseViewMatrix = XMMatrixInverse(&viewMatrixDeterminant, viewMatrix);
-			auto cameraFrustum = camera.BuildViewSpaceBoundingFrustum();
+			Frustum cameraFrustum(XMMatrixMultiply(camera.GetViewMatrix(), camera.GetProjectionMatrix()));
 
 			auto octree = Octree<OctreeBaseCollider>(
-				4,
+				1,
 				BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(8.0f, 8.0f, 8.0f)),
 				XMFLOAT3(1.0f, 1.0f, 1.0f)
 				);
 
-			RenderItem renderItem;
-			renderItem.Bounds = { { 0.0f, 0.0f, 0.0f },{ 0.5f, 0.5f, 0.5f } };
+			array<ColliderTestClass, 3> objects =
 			{
-				ShaderBufferTypes::InstanceData data;
+				ColliderTestClass({ { 0.0f, 0.0f, 5.0f },{ 0.5f, 0.5f, 0.5f } }),
+				ColliderTestClass({ { 0.0f, 0.0f, -5.0f },{ 0.5f, 0.5f, 0.5f } }),
 
-				XMStoreFloat4x4(&data.WorldMatrix, XMMatrixTranslation(0.0f, 0.0f, 5.0f));
-				renderItem.AddInstance(data);
+				// Shared by several leaves:
+				ColliderTestClass({ { 0.0f, 0.0f, 1.0f },{ 0.5f, 0.5f, 0.5f } }),
+			};
+			for (auto& object : objects)
+				octree.AddObject(&object);
+			Assert::IsFalse(octree.m_isLeaf);
 
-				XMStoreFloat4x4(&data.WorldMatrix, XMMatrixTranslation(0.0f, 0.0f, -5.0f));
-				renderItem.AddInstance(data);
-			}
+			// Each visible object must be reported exactly once:
+			vector<OctreeBaseCollider*> visibleObjects;
+			octree.CalculateIntersections(cameraFrustum, visibleObjects);
+			Assert::AreEqual(static_cast<size_t>(2), visibleObjects.size());
+			Assert::IsTrue(find(visibleObjects.begin(), visibleObjects.end(), &objects[0]) != visibleObjects.end());
+			Assert::IsTrue(find(visibleObjects.begin(), visibleObjects.end(), &objects[2]) != visibleObjects.end());
+
+			// A second query must return the same objects:
+			visibleObjects.clear();
+			octree.CalculateIntersections(cameraFrustum, visibleObjects);
+			Assert::AreEqual(static_cast<size_t>(2), visibleObjects.size());
+
+			// The parallel traversal must return the same objects:
+			Common::ThreadPool threadPool(2);
+			array<vector<OctreeBaseCollider*>, 8> visibleObjectsPerChild;
+			octree.CalculateIntersections(cameraFrustum, threadPool, visibleObjectsPerChild);
+			size_t parallelVisibleCount = 0;
+			for (const auto& childVisibleObjects : visibleObjectsPerChild)
+				parallelVisibleCount += childVisibleObjects.size();
+			Assert::AreEqual(static_cast<size_t>(2), parallelVisibleCount);
+		}
+
+		TEST_METHOD(TestOctreeNodeRejection)
+		{
+			Camera camera(16.0f / 9.0f, XM_PIDIV2, 0.01f, 1000.0f, XMMatrixIdentity());
+			camera.Update();
+			Frustum cameraFrustum(XMMatrixMultiply(camera.GetViewMatrix(), camera.GetProjectionMatrix()));
+
+			// Octree whose root node lies completely in front of the camera:
+			auto containedOctree = Octree<OctreeBaseCollider>(
+				4,
+				BoundingBox(XMFLOAT3(0.0f, 0.0f, 20.0f), XMFLOAT3(4.0f, 4.0f, 4.0f)),
+				XMFLOAT3(1.0f, 1.0f, 1.0f)
+				);
+
+			// Octree whose root node lies completely behind the camera:
+			auto disjointOctree = Octree<OctreeBaseCollider>(
+				4,
+				BoundingBox(XMFLOAT3(0.0f, 0.0f, -20.0f), XMFLOAT3(4.0f, 4.0f, 4.0f)),
+				XMFLOAT3(1.0f, 1.0f, 1.0f)
+				);
+
+			array<ColliderTestClass, 2> objects =
+			{
+				ColliderTestClass({ { 0.0f, 0.0f, 20.0f },{ 0.5f, 0.5f, 0.5f } }),
+				ColliderTestClass({ { 0.0f, 0.0f, -20.0f },{ 0.5f, 0.5f, 0.5f } }),
+			};
+			containedOctree.AddObject(&objects[0]);
+			disjointOctree.AddObject(&objects[1]);
+
+			// Objects of fully contained or disjoint nodes must not be tested individually:
+			ColliderTestClass::s_frustumTestCount = 0;
+			vector<OctreeBaseCollider*> visibleObjects;
+			containedOctree.CalculateIntersections(cameraFrustum, visibleObjects);
+			disjointOctree.CalculateIntersections(cameraFrustum, visibleObjects);
+			Assert::AreEqual(static_cast<size_t>(1), visibleObjects.size());
+			Assert::IsTrue(visibleObjects[0] == &objects[0]);
+			Assert::AreEqual(static_cast<size_t>(0), ColliderTestClass::s_frustumTestCount);
+		}
+
+		TEST_METHOD(TestOctreeRemoveAndUpdate)
+		{
+			auto octree = Octree<OctreeBaseCollider>(
+				4,
+				BoundingBox(XMFLOAT3(0.0f, 6.0f, 0.0f), XMFLOAT3(8.0f, 8.0f, 8.0f)),
+				XMFLOAT3(1.0f, 1.0f, 1.0f)
+				);
+
+			// Add enough objects to split the root node (the fourth one lies outside of the octree):
+			for (size_t i = 0; i < 6; ++i)
+				octree.AddObject(&m_gameObjects[i]);
+			Assert::IsFalse(octree.m_isLeaf);
+			Assert::AreEqual(static_cast<size_t>(5), octree.m_objectCount);
+
+			// Remove an object:
+			Assert::IsTrue(octree.RemoveObject(&m_gameObjects[0]));
+			Assert::AreEqual(static_cast<size_t>(4), octree.m_objectCount);
+			Assert::AreEqual(static_cast<size_t>(2), octree.m_state.Children[0]->m_objectCount);
+
+			// Removing it again must fail:
+			Assert::IsFalse(octree.RemoveObject(&m_gameObjects[0]));
+			Assert::IsFalse(octree.RemoveObject(&m_gameObjects[3]));
+			Assert::AreEqual(static_cast<size_t>(4), octree.m_objectCount);
+
+			// Move an object from the first child node to the sixth one:
+			octree.UpdateObject(&m_gameObjects[1], BoundingBox({ 3.5f, 0.0f, -4.5f }, { 0.5f, 0.5f, 0.5f }));
+			Assert::IsFalse(octree.m_isLeaf);
+			Assert::AreEqual(static_cast<size_t>(4), octree.m_objectCount);
+			Assert::AreEqual(static_cast<size_t>(1), octree.m_state.Children[0]->m_objectCount);
+			Assert::AreEqual(static_cast<size_t>(2), octree.m_state.Children[5]->m_objectCount);
+
+			// Remove objects until the children are merged back into the root node:
+			Assert::IsTrue(octree.RemoveObject(&m_gameObjects[2]));
+			Assert::IsFalse(octree.m_isLeaf);
+			Assert::IsTrue(octree.RemoveObject(&m_gameObjects[4]));
+			Assert::IsTrue(octree.m_isLeaf);
+			Assert::AreEqual(static_cast<size_t>(2), octree.m_objectCount);
+			Assert::AreEqual(static_cast<size_t>(2), octree.m_state.Objects.size());
+
+			// Objects must still be found after merging:
+			Assert::IsTrue(octree.RemoveObject(&m_gameObjects[1]));
+			Assert::IsTrue(octree.RemoveObject(&m_gameObjects[5]));
+			Assert::AreEqual(static_cast<size_t>(0), octree.m_objectCount);
+		}
+
+		TEST_METHOD(TestOctreeNodeStorage)
+		{
+			// Each octree owns the storage of its nodes:
+			auto octree = Octree<OctreeBaseCollider>(
+				1,
+				BoundingBox(XMFLOAT3(16.0f, 16.0f, 16.0f), XMFLOAT3(16.0f, 16.0f, 16.0f)),
+				XMFLOAT3(0.25f, 0.25f, 0.25f)
+				);
+			auto otherOctree = Octree<OctreeBaseCollider>(
+				4,
+				BoundingBox(XMFLOAT3(0.0f, 6.0f, 0.0f), XMFLOAT3(8.0f, 8.0f, 8.0f)),
+				XMFLOAT3(1.0f, 1.0f, 1.0f)
+				);
+			for (size_t i = 0; i < 6; ++i)
+				otherOctree.AddObject(&m_gameObjects[i]);
+			Assert::AreEqual(static_cast<size_t>(9), otherOctree.GetNodeCount());
 
-			for (auto& object : renderItem.m_colliders)
+			// One object per cell of a 32x32x32 grid splits the octree down to the cells, which needs more nodes than a single page:
+			vector<ColliderTestClass> objects;
+			objects.reserve(32 * 32 * 32);
+			for (size_t i = 0; i < 32 * 32 * 32; ++i)
+				objects.emplace_back(BoundingBox(XMFLOAT3(i % 32 + 0.5f, (i / 32) % 32 + 0.5f, i / (32 * 32) + 0.5f), XMFLOAT3(0.25f, 0.25f, 0.25f)));
+			for (auto& object : objects)
 				octree.AddObject(&object);
 
-			octree.CalculateIntersections(cameraFrustum, inverseViewMatrix);
-			Assert::AreEqual(static_cast<size_t>(1), renderItem.m_visibleInstances.size());
-			Assert::AreEqual(0U, *renderItem.m_visibleInstances.begin());
+			auto nodeCount = static_cast<size_t>(1 + 8 + 64 + 512 + 4096 + 32768);
+			Assert::AreEqual(nodeCount, octree.GetNodeCount());
+			Assert::IsTrue(octree.m_nodeStorage->GetCapacity() >= nodeCount - 1);
+			Assert::AreEqual(static_cast<size_t>(9), otherOctree.GetNodeCount());
+
+			// Removing the objects merges the nodes, which are returned to the storage of their octree:
+			for (auto& object : objects)
+				octree.RemoveObject(&object);
+			Assert::IsTrue(octree.m_isLeaf);
+			Assert::AreEqual(static_cast<size_t>(1), octree.GetNodeCount());
+			Assert::AreEqual(static_cast<size_t>(9), otherOctree.GetNodeCount());
+		}
+	};
+
+	TEST_CLASS(LinearOctreeTest)
+	{
+	private:
+		static vector<ColliderTestClass> CreateRandomColliders(size_t count)
+		{
+			return CreateColliders<ColliderTestClass>(CreateRandomBoxes(count, 512.0f, 0.25f, 0.5f, 4.0f));
+		}
+		template<typename NodeType>
+		static void AssertEqualSubtrees(const vector<NodeType>& nodes0, uint32_t nodeIndex0, const vector<NodeType>& nodes1, uint32_t nodeIndex1)
+		{
+			const auto& node0 = nodes0[nodeIndex0];
+			const auto& node1 = nodes1[nodeIndex1];
+			Assert::AreEqual(node0.FirstObject, node1.FirstObject);
+			Assert::AreEqual(node0.ObjectCount, node1.ObjectCount);
+			Assert::AreEqual(node0.ChildCount, node1.ChildCount);
+			Assert::IsTrue(memcmp(&node0.Bounds, &node1.Bounds, sizeof(BoundingBox)) == 0);
+
+			// The nodes may be stored in a different order, so compare the children through their parents:
+			for (uint32_t i = 0; i < node0.ChildCount; ++i)
+				AssertEqualSubtrees(nodes0, node0.FirstChild + i, nodes1, node1.FirstChild + i);
+		}
+
+	public:
+		TEST_METHOD(TestLinearOctreeBuild)
+		{
+			auto colliders = CreateRandomColliders(1000);
+			auto objects = GetPointers(colliders);
+
+			// Object which lies outside of the bounding box (it should be ignored):
+			ColliderTestClass outsideCollider({ { 0.0f, 2000.0f, 0.0f },{ 1.0f, 1.0f, 1.0f } });
+			objects.push_back(&outsideCollider);
+
+			LinearOctree<OctreeBaseCollider> octree(8, BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1024.0f, 1024.0f, 1024.0f)), XMFLOAT3(1.0f, 1.0f, 1.0f));
+			octree.Build(objects);
+			Assert::AreEqual(colliders.size(), octree.GetObjectCount());
+			Assert::IsTrue(octree.GetNodeCount() > 1);
+
+			// The root node must reference all objects:
+			const auto& nodes = octree.m_nodes;
+			Assert::AreEqual(static_cast<uint32_t>(0), nodes[0].FirstObject);
+			Assert::AreEqual(static_cast<uint32_t>(colliders.size()), nodes[0].ObjectCount);
+
+			for (const auto& node : nodes)
+			{
+				if (node.ChildCount == 0)
+				{
+					// Leaves must not exceed their capacity and must contain the bounds of their objects:
+					Assert::IsTrue(node.ObjectCount <= 8);
+					for (auto i = node.FirstObject; i < node.FirstObject + node.ObjectCount; ++i)
+						Assert::IsTrue(Encloses(node.Bounds, octree.m_objects[i]->GetBounds()));
+				}
+				else
+				{
+					// The object ranges of the children must split the range of the parent:
+					auto firstObject = node.FirstObject;
+					for (auto i = node.FirstChild; i < node.FirstChild + node.ChildCount; ++i)
+					{
+						Assert::AreEqual(firstObject, nodes[i].FirstObject);
+						Assert::IsTrue(Encloses(node.Bounds, nodes[i].Bounds));
+						firstObject += nodes[i].ObjectCount;
+					}
+					Assert::AreEqual(node.FirstObject + node.ObjectCount, firstObject);
+				}
+			}
+
+			// Rebuilding must replace the previous content:
+			objects.resize(10);
+			octree.Build(objects);
+			Assert::AreEqual(static_cast<size_t>(10), octree.GetObjectCount());
+		}
+
+		TEST_METHOD(TestLinearOctreeParallelBuild)
+		{
+			auto colliders = CreateRandomColliders(100000);
+			auto objects = GetPointers(colliders);
+
+			LinearOctree<OctreeBaseCollider> serialOctree(8, BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1024.0f, 1024.0f, 1024.0f)), XMFLOAT3(1.0f, 1.0f, 1.0f));
+			serialOctree.Build(objects);
+
+			// The parallel build must produce the same tree as the serial one:
+			Common::ThreadPool threadPool(4);
+			LinearOctree<OctreeBaseCollider> parallelOctree(8, BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1024.0f, 1024.0f, 1024.0f)), XMFLOAT3(1.0f, 1.0f, 1.0f));
+			for (auto buildIndex = 0; buildIndex < 2; ++buildIndex)
+			{
+				parallelOctree.Build(objects, threadPool);
+				Assert::AreEqual(serialOctree.GetNodeCount(), parallelOctree.GetNodeCount());
+				Assert::IsTrue(serialOctree.m_objects == parallelOctree.m_objects);
+				AssertEqualSubtrees(serialOctree.m_nodes, 0, parallelOctree.m_nodes, 0);
+			}
+
+			// Few objects don't reach the depth of the parallel subtrees:
+			objects.resize(10);
+			serialOctree.Build(objects);
+			parallelOctree.Build(objects, threadPool);
+			Assert::AreEqual(static_cast<size_t>(10), parallelOctree.GetObjectCount());
+			Assert::AreEqual(serialOctree.GetNodeCount(), parallelOctree.GetNodeCount());
+			AssertEqualSubtrees(serialOctree.m_nodes, 0, parallelOctree.m_nodes, 0);
+		}
+
+		TEST_METHOD(TestLinearOctreeFrustumIntersection)
+		{
+			Camera camera(16.0f / 9.0f, XM_PIDIV4, 0.01f, 1000.0f, XMMatrixIdentity());
+			camera.Update();
+			Frustum cameraFrustum(XMMatrixMultiply(camera.GetViewMatrix(), camera.GetProjectionMatrix()));
+
+			auto colliders = CreateRandomColliders(5000);
+			auto objects = GetPointers(colliders);
+
+			LinearOctree<OctreeBaseCollider> octree(8, BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1024.0f, 1024.0f, 1024.0f)), XMFLOAT3(1.0f, 1.0f, 1.0f));
+			octree.Build(objects);
+
+			// Calculate the expected result by testing every object:
+			vector<OctreeBaseCollider*> expectedObjects;
+			for (auto object : objects)
+			{
+				if (object->Intersects(cameraFrustum))
+					expectedObjects.push_back(object);
+			}
+			sort(expectedObjects.begin(), expectedObjects.end());
+			Assert::IsFalse(expectedObjects.empty());
+
+			// Each visible object must be reported exactly once:
+			vector<OctreeBaseCollider*> visibleObjects;
+			octree.CalculateIntersections(cameraFrustum, visibleObjects);
+			sort(visibleObjects.begin(), visibleObjects.end());
+			Assert::IsTrue(expectedObjects == visibleObjects);
+
+			// The parallel traversal must return the same objects:
+			Common::ThreadPool threadPool(2);
+			array<vector<OctreeBaseCollider*>, 8> visibleObjectsPerChild;
+			octree.CalculateIntersections(cameraFrustum, threadPool, visibleObjectsPerChild);
+			visibleObjects.clear();
+			for (const auto& childVisibleObjects : visibleObjectsPerChild)
+				visibleObjects.insert(visibleObjects.end(), childVisibleObjects.begin(), childVisibleObjects.end());
+			sort(visibleObjects.begin(), visibleObjects.end());
+			Assert::IsTrue(expectedObjects == visibleObjects);
+		}
+
+		TEST_METHOD(BenchmarkLinearOctreeBuild)
+		{
+			constexpr size_t objectCount = 1000000;
+
+			auto colliders = CreateRandomColliders(objectCount);
+			auto objects = GetPointers(colliders);
+
+			LinearOctree<OctreeBaseCollider> octree(32, BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1024.0f, 1024.0f, 1024.0f)), XMFLOAT3(1.0f, 1.0f, 1.0f));
+			Common::PerformanceTimer timer;
+			timer.Start();
+			octree.Build(objects);
+			timer.End();
+			auto buildTime = timer.ElapsedTime<float, milli>().count();
+
+			Common::ThreadPool threadPool;
+			timer.Start();
+			octree.Build(objects, threadPool);
+			timer.End();
+			auto parallelBuildTime = timer.ElapsedTime<float, milli>().count();
+
+			Camera camera(16.0f / 9.0f, XM_PIDIV4, 0.01f, 1000.0f, XMMatrixIdentity());
+			camera.Update();
+			Frustum cameraFrustum(XMMatrixMultiply(camera.GetViewMatrix(), camera.GetProjectionMatrix()));
+
+			vector<OctreeBaseCollider*> visibleObjects;
+			timer.Start();
+			octree.CalculateIntersections(cameraFrustum, visibleObjects);
+			timer.End();
+			auto queryTime = timer.ElapsedTime<float, milli>().count();
+
+			// Move some of the objects a little, refitting the octree around each one:
+			constexpr size_t movedObjectCount = 10000;
+			mt19937 randomEngine(1);
+			uniform_real_distribution<float> offsetDistribution(-1.0f, 1.0f);
+			size_t refitCount = 0;
+			timer.Start();
+			for (size_t i = 0; i < movedObjectCount; ++i)
+			{
+				auto& collider = colliders[i * (objectCount / movedObjectCount)];
+				auto bounds = collider.GetBounds();
+				bounds.Center.x += offsetDistribution(randomEngine);
+				collider.SetBounds(bounds);
+				if (octree.UpdateObject(&collider))
+					++refitCount;
+			}
+			timer.End();
+			auto updateTime = timer.ElapsedTime<float, milli>().count();
+
+			// Compare with the pointer octree, which inserts the objects one at a time:
+			Octree<OctreeBaseCollider> insertionOctree(32, BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1024.0f, 1024.0f, 1024.0f)), XMFLOAT3(1.0f, 1.0f, 1.0f));
+			timer.Start();
+			for (auto object : objects)
+				insertionOctree.AddObject(object);
+			timer.End();
+			auto insertionBuildTime = timer.ElapsedTime<float, milli>().count();
+
+			auto message =
+				L"Linear octree with " + to_wstring(objectCount) + L" objects:\n" +
+				L"  Build: " + to_wstring(buildTime) + L" ms (" + to_wstring(octree.GetNodeCount()) + L" nodes)\n" +
+				L"  Parallel build: " + to_wstring(parallelBuildTime) + L" ms (" + to_wstring(threadPool.GetThreadCount()) + L" threads)\n" +
+				L"  Frustum query: " + to_wstring(queryTime) + L" ms (" + to_wstring(visibleObjects.size()) + L" visible)\n" +
+				L"  Update of " + to_wstring(movedObjectCount) + L" moved objects: " + to_wstring(updateTime) + L" ms (" + to_wstring(movedObjectCount - refitCount) + L" need a rebuild)\n" +
+				L"Pointer octree with " + to_wstring(objectCount) + L" objects:\n" +
+				L"  Build by insertion: " + to_wstring(insertionBuildTime) + L" ms (" + to_wstring(insertionOctree.GetNodeCount()) + L" nodes)\n";
+			Logger::WriteMessage(message.c_str());
 		}
 	};
 }
\ No newline at end of file
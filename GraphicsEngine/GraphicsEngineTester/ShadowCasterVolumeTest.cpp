@@ -0,0 +1,95 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+
+#include "GraphicsEngine/Camera.h"
+#include "GraphicsEngine/Frustum.h"
+#include "GraphicsEngine/ShadowCasterVolume.h"
+#include "TestHelpers.h"
+
+#include <vector>
+
+using namespace DirectX;
+using namespace GraphicsEngine;
+using namespace GraphicsEngineTester::TestHelpers;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+
+namespace GraphicsEngineTester
+{
+	TEST_CLASS(ShadowCasterVolumeTest)
+	{
+	private:
+		// Same light matrices as Light::UpdateMatrices:
+		static XMMATRIX CreateLightViewProjectionMatrix(FXMVECTOR lightDirection, FXMVECTOR cameraPosition)
+		{
+			auto lightPosition = XMVectorSubtract(cameraPosition, XMVectorScale(lightDirection, 50.0f));
+			auto viewMatrix = XMMatrixLookAtLH(lightPosition, cameraPosition, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+			auto projectionMatrix = XMMatrixOrthographicOffCenterLH(-100.0f, 100.0f, -100.0f, 100.0f, 1.0f, 500.0f);
+			return XMMatrixMultiply(viewMatrix, projectionMatrix);
+		}
+
+	public:
+		TEST_METHOD(TestShadowCasterVolume)
+		{
+			// Camera at the origin looking at the positive z-axis, lit from above:
+			Camera camera(16.0f / 9.0f, XM_PIDIV4, 0.2f, 1000.0f, XMMatrixIdentity());
+			camera.Update();
+			auto cameraViewProjectionMatrix = XMMatrixMultiply(camera.GetViewMatrix(), camera.GetProjectionMatrix());
+			auto lightDirection = XMVector3Normalize(XMVectorSet(0.2f, -1.0f, 0.1f, 0.0f));
+			auto lightViewProjectionMatrix = CreateLightViewProjectionMatrix(lightDirection, camera.GetPosition());
+			ShadowCasterVolume volume(lightDirection, lightViewProjectionMatrix, cameraViewProjectionMatrix);
+			Assert::IsTrue(volume.GetPlaneCount() > Frustum::PlaneCount);
+
+			Frustum cameraFrustum(cameraViewProjectionMatrix);
+			Frustum lightFrustum(lightViewProjectionMatrix);
+
+			// A box above the view of the camera casts a shadow into it:
+			BoundingBox aboveBox({ 0.0f, 40.0f, 50.0f }, { 2.0f, 2.0f, 2.0f });
+			Assert::IsTrue(cameraFrustum.Contains(aboveBox) == ContainmentType::DISJOINT);
+			Assert::IsTrue(volume.Contains(aboveBox) != ContainmentType::DISJOINT);
+
+			// Boxes beside, behind or below the view of the camera are inside of the light frustum, but their shadows miss the view:
+			BoundingBox besideBox({ 80.0f, 0.0f, 50.0f }, { 2.0f, 2.0f, 2.0f });
+			BoundingBox behindBox({ 0.0f, 0.0f, -30.0f }, { 2.0f, 2.0f, 2.0f });
+			BoundingBox belowBox({ 0.0f, -80.0f, 50.0f }, { 2.0f, 2.0f, 2.0f });
+			for (const auto& box : { besideBox, behindBox, belowBox })
+			{
+				Assert::IsTrue(lightFrustum.Contains(box) != ContainmentType::DISJOINT);
+				Assert::IsTrue(volume.Contains(box) == ContainmentType::DISJOINT);
+			}
+
+			// A box visible to the camera, but outside of the light frustum, is not rendered into the shadow map:
+			BoundingBox farBox({ 0.0f, 0.0f, 400.0f }, { 2.0f, 2.0f, 2.0f });
+			Assert::IsTrue(cameraFrustum.Contains(farBox) != ContainmentType::DISJOINT);
+			Assert::IsTrue(volume.Contains(farBox) == ContainmentType::DISJOINT);
+
+			// Random boxes:
+			auto boxes = CreateRandomBoxArray(10000, 150.0f, 1.0f, 0.5f, 5.0f);
+
+			// The vectorized test agrees with the scalar one:
+			vector<uint32_t> casterIndices(boxes.GetSize());
+			auto casterCount = volume.CalculateShadowCasters(boxes, 0, boxes.GetSize(), casterIndices.data());
+			casterIndices.resize(casterCount);
+			size_t expectedCasterCount = 0;
+			for (size_t i = 0; i < boxes.GetSize(); ++i)
+			{
+				auto box = boxes.Get(i);
+				if (volume.Contains(box) == ContainmentType::DISJOINT)
+					continue;
+
+				// Casters are a subset of the light frustum:
+				Assert::IsTrue(lightFrustum.Contains(box) != ContainmentType::DISJOINT);
+				Assert::AreEqual(static_cast<uint32_t>(i), casterIndices[expectedCasterCount++]);
+			}
+			Assert::AreEqual(expectedCasterCount, casterCount);
+
+			// Visible boxes inside of the light frustum shadow themselves, so they are never culled:
+			for (size_t i = 0; i < boxes.GetSize(); ++i)
+			{
+				auto box = boxes.Get(i);
+				if (cameraFrustum.Contains(box) != ContainmentType::DISJOINT && lightFrustum.Contains(box) != ContainmentType::DISJOINT)
+					Assert::IsTrue(volume.Contains(box) != ContainmentType::DISJOINT);
+			}
+		}
+	};
+}
@@ -0,0 +1,89 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+
+#include "Common/SlotMap.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace GraphicsEngine;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+
+namespace GraphicsEngineTester
+{
+	TEST_CLASS(SlotMapTest)
+	{
+	public:
+		TEST_METHOD(TestSlotMap)
+		{
+			SlotMap<string> slotMap;
+			Assert::IsFalse(slotMap.Contains(SlotMapHandle()));
+
+			auto handle0 = slotMap.Insert("0");
+			auto handle1 = slotMap.Insert("1");
+			auto handle2 = slotMap.Emplace(1, '2');
+			auto handle3 = slotMap.Insert("3");
+			Assert::AreEqual(static_cast<size_t>(4), slotMap.GetSize());
+			Assert::AreEqual(string("2"), slotMap[handle2]);
+
+			// Removing an element moves the last one into its place, without invalidating its handle:
+			Assert::AreEqual(static_cast<size_t>(1), slotMap.Remove(handle1));
+			Assert::AreEqual(static_cast<size_t>(3), slotMap.GetSize());
+			Assert::IsFalse(slotMap.Contains(handle1));
+			Assert::IsTrue(slotMap.Find(handle1) == nullptr);
+			Assert::AreEqual(static_cast<size_t>(1), slotMap.GetIndex(handle3));
+			Assert::AreEqual(string("3"), slotMap[handle3]);
+			Assert::IsTrue(slotMap.GetHandle(1) == handle3);
+
+			// The elements stay contiguous:
+			vector<string> expectedElements = { "0", "3", "2" };
+			Assert::IsTrue(expectedElements == slotMap.GetElements());
+			Assert::IsTrue(equal(slotMap.begin(), slotMap.end(), expectedElements.begin()));
+
+			// Removing an element twice does nothing:
+			Assert::AreEqual(slotMap.GetSize(), slotMap.Remove(handle1));
+			Assert::AreEqual(static_cast<size_t>(3), slotMap.GetSize());
+
+			// A reused slot gets a new generation, so the handles to the removed element stay invalid:
+			auto handle4 = slotMap.Insert("4");
+			Assert::AreEqual(handle1.GetIndex(), handle4.GetIndex());
+			Assert::IsTrue(handle1 != handle4);
+			Assert::IsFalse(slotMap.Contains(handle1));
+			Assert::AreEqual(string("4"), *slotMap.Find(handle4));
+
+			// Removing the last element doesn't move any element:
+			Assert::AreEqual(static_cast<size_t>(3), slotMap.Remove(handle4));
+			Assert::AreEqual(static_cast<size_t>(0), slotMap.GetIndex(handle0));
+			Assert::AreEqual(static_cast<size_t>(1), slotMap.GetIndex(handle3));
+			Assert::AreEqual(static_cast<size_t>(2), slotMap.GetIndex(handle2));
+
+			// Clearing invalidates all handles:
+			slotMap.Clear();
+			Assert::IsTrue(slotMap.IsEmpty());
+			for (auto handle : { handle0, handle1, handle2, handle3, handle4 })
+				Assert::IsFalse(slotMap.Contains(handle));
+			auto handle5 = slotMap.Insert("5");
+			Assert::IsFalse(slotMap.Contains(handle0));
+			Assert::AreEqual(string("5"), slotMap[handle5]);
+		}
+
+		TEST_METHOD(TestSlotMapGenerations)
+		{
+			SlotMap<int> slotMap;
+			auto firstHandle = slotMap.Insert(0);
+
+			// Generations wrap around after the largest one, but never back to zero, which is reserved for null handles:
+			auto handle = firstHandle;
+			for (uint32_t i = 0; i < SlotMapHandle::MaxGeneration; ++i)
+			{
+				slotMap.Remove(handle);
+				handle = slotMap.Insert(static_cast<int>(i));
+				Assert::AreEqual(firstHandle.GetIndex(), handle.GetIndex());
+				Assert::IsFalse(handle.IsNull());
+			}
+			Assert::IsTrue(handle == firstHandle);
+		}
+	};
+}
@@ -0,0 +1,593 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+
+#include "GraphicsEngine/BoundingVolumeHierarchy.h"
+#include "GraphicsEngine/LinearOctree.h"
+#include "GraphicsEngine/Camera.h"
+#include "GraphicsEngine/Frustum.h"
+#include "GraphicsEngine/FrustumCoherence.h"
+#include "GraphicsEngine/OctreeBaseCollider.h"
+#include "GraphicsEngine/SpatialIndexType.h"
+#include "Common/Helpers.h"
+#include "Common/PerformanceTimer.h"
+#include "nlohmann/json/json.hpp"
+#include "TestHelpers.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace DirectX;
+using namespace GraphicsEngine;
+using namespace GraphicsEngineTester::TestHelpers;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+
+namespace GraphicsEngineTester
+{
+	TEST_CLASS(SpatialIndexTest)
+	{
+	private:
+		static unique_ptr<ISpatialIndex<OctreeBaseCollider>> CreateSpatialIndex(SpatialIndexType spatialIndexType)
+		{
+			if (spatialIndexType == SpatialIndexType::BoundingVolumeHierarchy)
+				return make_unique<BoundingVolumeHierarchy<OctreeBaseCollider>>(8);
+
+			return make_unique<LinearOctree<OctreeBaseCollider>>(32, BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1024.0f, 1024.0f, 1024.0f)), XMFLOAT3(4.0f, 4.0f, 4.0f));
+		}
+
+		static vector<BoxCollider> CreateClusteredColliders(size_t count)
+		{
+			return CreateColliders<BoxCollider>(CreateClusteredBoxes(count, 1000.0f, 0.5f, 4.0f));
+		}
+		// The file is parsed directly, as a scene builder saves it again when it is destroyed:
+		static vector<BoxCollider> LoadSceneColliders(const wstring& filename)
+		{
+			vector<BoxCollider> colliders;
+			if (!Common::Helpers::FileExists(filename))
+				return colliders;
+
+			ifstream fileStream(Common::Helpers::WStringToString(filename), ios::in);
+			nlohmann::json sceneJson;
+			fileStream >> sceneJson;
+
+			static const array<string, 5> renderItemIDs = { "Tree", "BillboardGrass0001", "BillboardGrass0002", "BillboardRedFlowers", "BillboardBlueFlowers" };
+			for (const auto& renderItemJson : sceneJson)
+			{
+				if (find(renderItemIDs.begin(), renderItemIDs.end(), renderItemJson.at("ID").get<string>()) == renderItemIDs.end())
+					continue;
+
+				for (const auto& instanceJson : renderItemJson.at("Instances"))
+				{
+					const auto& position = instanceJson.at("Position");
+					const auto& scale = instanceJson.at("Scale");
+					BoundingBox box(XMFLOAT3(position[0].get<float>(), 0.0f, position[1].get<float>()), XMFLOAT3(scale[0].get<float>(), scale[1].get<float>(), scale[2].get<float>()));
+					colliders.emplace_back(box);
+				}
+			}
+
+			return colliders;
+		}
+		static vector<Frustum> CreateCameraFrustums()
+		{
+			// Camera above the ground, turning around the Y-axis:
+			Camera camera(16.0f / 9.0f, XM_PIDIV4, 0.2f, 1500.0f, XMMatrixIdentity());
+			camera.SetPosition(0.0f, 20.0f, 0.0f);
+
+			vector<Frustum> frustums;
+			for (size_t i = 0; i < 8; ++i)
+			{
+				camera.Update();
+				frustums.emplace_back(XMMatrixMultiply(camera.GetViewMatrix(), camera.GetProjectionMatrix()));
+				camera.RotateWorldY(XM_PIDIV4);
+			}
+
+			return frustums;
+		}
+		static wstring BenchmarkSpatialIndex(SpatialIndexType spatialIndexType, const vector<OctreeBaseCollider*>& objects, const vector<Frustum>& frustums)
+		{
+			auto spatialIndex = CreateSpatialIndex(spatialIndexType);
+
+			Common::PerformanceTimer timer;
+			timer.Start();
+			spatialIndex->Build(objects);
+			timer.End();
+			auto buildTime = timer.ElapsedTime<float, milli>().count();
+
+			vector<OctreeBaseCollider*> visibleObjects;
+			visibleObjects.reserve(objects.size());
+			size_t visibleCount = 0;
+			timer.Start();
+			for (const auto& frustum : frustums)
+			{
+				visibleObjects.clear();
+				spatialIndex->CalculateIntersections(frustum, visibleObjects);
+				visibleCount += visibleObjects.size();
+			}
+			timer.End();
+			auto queryTime = timer.ElapsedTime<float, milli>().count() / frustums.size();
+
+			// Proximity queries around random positions on the ground:
+			static const size_t proximityQueryCount = 10000;
+			mt19937 randomEngine(0);
+			uniform_real_distribution<float> positionDistribution(-1000.0f, 1000.0f);
+			vector<XMFLOAT3> positions(proximityQueryCount);
+			for (auto& position : positions)
+				position = XMFLOAT3(positionDistribution(randomEngine), 1.0f, positionDistribution(randomEngine));
+
+			array<OctreeBaseCollider*, 256> sphereObjects;
+			timer.Start();
+			for (const auto& position : positions)
+				spatialIndex->CalculateIntersections(BoundingSphere(position, 10.0f), sphereObjects.data(), sphereObjects.size());
+			timer.End();
+			auto sphereQueryTime = timer.ElapsedTime<float, milli>().count();
+
+			ISpatialIndex<OctreeBaseCollider>::RayHit hit;
+			timer.Start();
+			for (const auto& position : positions)
+				spatialIndex->CalculateFirstRayHit(position, XMFLOAT3(position.z, 0.0f, -position.x), 100.0f, hit);
+			timer.End();
+			auto rayQueryTime = timer.ElapsedTime<float, milli>().count();
+
+			array<ISpatialIndex<OctreeBaseCollider>::NearestObject, 8> nearestObjects;
+			timer.Start();
+			for (const auto& position : positions)
+				spatialIndex->CalculateNearestObjects(position, nearestObjects.data(), nearestObjects.size());
+			timer.End();
+			auto nearestQueryTime = timer.ElapsedTime<float, milli>().count();
+
+			return
+				L"    Build: " + to_wstring(buildTime) + L" ms, " +
+				L"memory: " + to_wstring(spatialIndex->GetMemoryUsage() / 1024) + L" KiB (" + to_wstring(spatialIndex->GetNodeCount()) + L" nodes), " +
+				L"frustum query: " + to_wstring(queryTime) + L" ms (" + to_wstring(visibleCount / frustums.size()) + L" visible)\n" +
+				L"    " + to_wstring(proximityQueryCount) + L" queries: sphere " + to_wstring(sphereQueryTime) + L" ms, " +
+				L"first ray hit " + to_wstring(rayQueryTime) + L" ms, " +
+				L"8 nearest " + to_wstring(nearestQueryTime) + L" ms\n";
+		}
+
+	public:
+		TEST_METHOD(TestBoundingVolumeHierarchyBuild)
+		{
+			auto colliders = CreateClusteredColliders(2000);
+			auto objects = GetPointers(colliders);
+
+			BoundingVolumeHierarchy<OctreeBaseCollider> boundingVolumeHierarchy(4);
+			boundingVolumeHierarchy.Build(objects);
+			Assert::AreEqual(colliders.size(), boundingVolumeHierarchy.GetObjectCount());
+
+			const auto& nodes = boundingVolumeHierarchy.m_nodes;
+			Assert::AreEqual(static_cast<uint32_t>(colliders.size()), nodes[0].ObjectCount);
+			for (const auto& node : nodes)
+			{
+				if (node.ChildCount == 0)
+				{
+					// Leaves must not exceed their capacity and must contain the bounds of their objects:
+					Assert::IsTrue(node.ObjectCount <= 4);
+					for (auto i = node.FirstObject; i < node.FirstObject + node.ObjectCount; ++i)
+						Assert::IsTrue(Encloses(node.Bounds, boundingVolumeHierarchy.m_objects[i]->GetBounds()));
+				}
+				else
+				{
+					// Both children must have objects and together cover the range of the parent:
+					Assert::AreEqual(static_cast<uint32_t>(2), node.ChildCount);
+					const auto& left = nodes[node.FirstChild];
+					const auto& right = nodes[node.FirstChild + 1];
+					Assert::IsTrue(left.ObjectCount > 0 && right.ObjectCount > 0);
+					Assert::AreEqual(node.FirstObject, left.FirstObject);
+					Assert::AreEqual(left.FirstObject + left.ObjectCount, right.FirstObject);
+					Assert::AreEqual(node.ObjectCount, left.ObjectCount + right.ObjectCount);
+					Assert::IsTrue(Encloses(node.Bounds, left.Bounds));
+					Assert::IsTrue(Encloses(node.Bounds, right.Bounds));
+				}
+			}
+
+			// Objects at the same position can only be split by count:
+			vector<BoxCollider> stackedColliders(10, BoxCollider(BoundingBox(XMFLOAT3(1.0f, 2.0f, 3.0f), XMFLOAT3(1.0f, 1.0f, 1.0f))));
+			boundingVolumeHierarchy.Build(GetPointers(stackedColliders));
+			Assert::AreEqual(stackedColliders.size(), boundingVolumeHierarchy.GetObjectCount());
+			for (const auto& node : boundingVolumeHierarchy.m_nodes)
+				Assert::IsTrue(node.ChildCount != 0 || node.ObjectCount <= 4);
+		}
+
+		TEST_METHOD(TestSpatialIndexFrustumIntersection)
+		{
+			auto colliders = CreateClusteredColliders(5000);
+			auto objects = GetPointers(colliders);
+			auto frustums = CreateCameraFrustums();
+			Common::ThreadPool threadPool(2);
+
+			for (auto spatialIndexType : { SpatialIndexType::Octree, SpatialIndexType::BoundingVolumeHierarchy })
+			{
+				auto spatialIndex = CreateSpatialIndex(spatialIndexType);
+				spatialIndex->Build(objects);
+
+				for (const auto& frustum : frustums)
+				{
+					// Calculate the expected result by testing every object:
+					vector<OctreeBaseCollider*> expectedObjects;
+					for (auto object : objects)
+					{
+						if (object->Intersects(frustum))
+							expectedObjects.push_back(object);
+					}
+					sort(expectedObjects.begin(), expectedObjects.end());
+
+					// Each visible object must be reported exactly once:
+					vector<OctreeBaseCollider*> visibleObjects;
+					spatialIndex->CalculateIntersections(frustum, visibleObjects);
+					sort(visibleObjects.begin(), visibleObjects.end());
+					Assert::IsTrue(expectedObjects == visibleObjects);
+
+					// The parallel traversal must return the same objects:
+					array<vector<OctreeBaseCollider*>, 8> visibleObjectsPerSubtree;
+					spatialIndex->CalculateIntersections(frustum, threadPool, visibleObjectsPerSubtree);
+					visibleObjects.clear();
+					for (const auto& subtreeVisibleObjects : visibleObjectsPerSubtree)
+						visibleObjects.insert(visibleObjects.end(), subtreeVisibleObjects.begin(), subtreeVisibleObjects.end());
+					sort(visibleObjects.begin(), visibleObjects.end());
+					Assert::IsTrue(expectedObjects == visibleObjects);
+				}
+			}
+		}
+
+		TEST_METHOD(TestSpatialIndexQueries)
+		{
+			using RayHit = ISpatialIndex<OctreeBaseCollider>::RayHit;
+			using NearestObject = ISpatialIndex<OctreeBaseCollider>::NearestObject;
+
+			auto colliders = CreateClusteredColliders(5000);
+			auto objects = GetPointers(colliders);
+			mt19937 randomEngine(1);
+			uniform_real_distribution<float> positionDistribution(-1000.0f, 1000.0f);
+			uniform_real_distribution<float> directionDistribution(-1.0f, 1.0f);
+
+			for (auto spatialIndexType : { SpatialIndexType::Octree, SpatialIndexType::BoundingVolumeHierarchy })
+			{
+				auto spatialIndex = CreateSpatialIndex(spatialIndexType);
+				spatialIndex->Build(objects);
+
+				vector<OctreeBaseCollider*> output(objects.size());
+				vector<RayHit> rayHits(objects.size());
+				array<NearestObject, 8> nearestObjects;
+				for (size_t query = 0; query < 50; ++query)
+				{
+					XMFLOAT3 position(positionDistribution(randomEngine), 0.0f, positionDistribution(randomEngine));
+
+					// Sphere and box queries must return the objects whose bounds intersect the volume:
+					BoundingSphere sphere(position, 100.0f);
+					BoundingBox box(position, XMFLOAT3(100.0f, 10.0f, 50.0f));
+					auto sphereCount = spatialIndex->CalculateIntersections(sphere, output.data(), output.size());
+					vector<OctreeBaseCollider*> sphereObjects(output.begin(), output.begin() + sphereCount);
+					auto boxCount = spatialIndex->CalculateIntersections(box, output.data(), output.size());
+					vector<OctreeBaseCollider*> boxObjects(output.begin(), output.begin() + boxCount);
+
+					vector<OctreeBaseCollider*> expectedSphereObjects;
+					vector<OctreeBaseCollider*> expectedBoxObjects;
+					for (auto object : objects)
+					{
+						if (sphere.Intersects(object->GetBounds()))
+							expectedSphereObjects.push_back(object);
+						if (box.Intersects(object->GetBounds()))
+							expectedBoxObjects.push_back(object);
+					}
+					sort(sphereObjects.begin(), sphereObjects.end());
+					sort(expectedSphereObjects.begin(), expectedSphereObjects.end());
+					sort(boxObjects.begin(), boxObjects.end());
+					sort(expectedBoxObjects.begin(), expectedBoxObjects.end());
+					Assert::IsTrue(expectedSphereObjects == sphereObjects);
+					Assert::IsTrue(expectedBoxObjects == boxObjects);
+
+					// A small buffer only receives the first results, but the count includes all of them:
+					Assert::AreEqual(sphereCount, spatialIndex->CalculateIntersections(sphere, output.data(), 1));
+
+					// Rays slightly above the ground, which must hit the same objects as when testing every object:
+					XMFLOAT3 origin(position.x, 1.0f, position.z);
+					XMFLOAT3 direction;
+					XMStoreFloat3(&direction, XMVector3Normalize(XMVectorSet(directionDistribution(randomEngine), -0.01f, directionDistribution(randomEngine), 0.0f)));
+					vector<float> expectedDistances;
+					for (auto object : objects)
+					{
+						float distance;
+						if (object->GetBounds().Intersects(XMLoadFloat3(&origin), XMLoadFloat3(&direction), distance) && max(distance, 0.0f) < 500.0f)
+							expectedDistances.push_back(max(distance, 0.0f));
+					}
+					sort(expectedDistances.begin(), expectedDistances.end());
+
+					RayHit firstHit;
+					auto hit = spatialIndex->CalculateFirstRayHit(origin, direction, 500.0f, firstHit);
+					Assert::AreEqual(!expectedDistances.empty(), hit);
+					if (hit)
+						Assert::AreEqual(expectedDistances[0], firstHit.Distance, 0.001f);
+
+					auto hitCount = spatialIndex->CalculateRayHits(origin, direction, 500.0f, rayHits.data(), rayHits.size());
+					Assert::AreEqual(expectedDistances.size(), hitCount);
+					for (size_t i = 0; i < hitCount; ++i)
+						Assert::AreEqual(expectedDistances[i], rayHits[i].Distance, 0.001f);
+
+					// With a smaller buffer, the nearest hits are kept:
+					Assert::AreEqual(expectedDistances.size(), spatialIndex->CalculateRayHits(origin, direction, 500.0f, rayHits.data(), 3));
+					for (size_t i = 0; i < min(hitCount, static_cast<size_t>(3)); ++i)
+						Assert::AreEqual(expectedDistances[i], rayHits[i].Distance, 0.001f);
+
+					// The nearest objects must be sorted and as near as the nearest ones found by testing every object:
+					vector<float> distancesSquared;
+					for (auto object : objects)
+					{
+						const auto& bounds = object->GetBounds();
+						auto offset = XMVectorMax(XMVectorSubtract(XMVectorAbs(XMVectorSubtract(XMLoadFloat3(&position), XMLoadFloat3(&bounds.Center))), XMLoadFloat3(&bounds.Extents)), XMVectorZero());
+						distancesSquared.push_back(XMVectorGetX(XMVector3LengthSq(offset)));
+					}
+					sort(distancesSquared.begin(), distancesSquared.end());
+
+					auto nearestCount = spatialIndex->CalculateNearestObjects(position, nearestObjects.data(), nearestObjects.size());
+					Assert::AreEqual(nearestObjects.size(), nearestCount);
+					for (size_t i = 0; i < nearestCount; ++i)
+						Assert::AreEqual(distancesSquared[i], nearestObjects[i].DistanceSquared, 0.001f);
+				}
+
+				// Queries on an empty index don't find anything:
+				spatialIndex->Clear();
+				RayHit firstHit;
+				Assert::AreEqual(static_cast<size_t>(0), spatialIndex->CalculateIntersections(BoundingSphere(XMFLOAT3(0.0f, 0.0f, 0.0f), 100.0f), output.data(), output.size()));
+				Assert::IsFalse(spatialIndex->CalculateFirstRayHit(XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), 500.0f, firstHit));
+				Assert::AreEqual(static_cast<size_t>(0), spatialIndex->CalculateNearestObjects(XMFLOAT3(0.0f, 0.0f, 0.0f), nearestObjects.data(), nearestObjects.size()));
+			}
+		}
+
+		TEST_METHOD(TestSpatialIndexUpdate)
+		{
+			auto colliders = CreateClusteredColliders(5000);
+			auto objects = GetPointers(colliders);
+			auto frustums = CreateCameraFrustums();
+			mt19937 randomEngine(2);
+			uniform_real_distribution<float> offsetDistribution(-2.0f, 2.0f);
+
+			for (auto spatialIndexType : { SpatialIndexType::Octree, SpatialIndexType::BoundingVolumeHierarchy })
+			{
+				auto spatialIndex = CreateSpatialIndex(spatialIndexType);
+				spatialIndex->Build(objects);
+
+				// Move every object a little, rebuilding the index when it can't be refitted:
+				size_t updateCount = 0;
+				for (auto& collider : colliders)
+				{
+					auto bounds = collider.GetBounds();
+					bounds.Center.x += offsetDistribution(randomEngine);
+					bounds.Center.z += offsetDistribution(randomEngine);
+					collider.SetBounds(bounds);
+
+					if (spatialIndex->UpdateObject(&collider))
+						++updateCount;
+					else
+						spatialIndex->Build(objects);
+				}
+
+				// The hierarchy refits every object, and the octree the ones which stay in the octant of their leaf:
+				if (spatialIndexType == SpatialIndexType::BoundingVolumeHierarchy)
+					Assert::AreEqual(colliders.size(), updateCount);
+				else
+					Assert::IsTrue(updateCount > colliders.size() / 2);
+
+				// The queries must return the same objects as when testing every object:
+				for (const auto& frustum : frustums)
+				{
+					vector<OctreeBaseCollider*> expectedObjects;
+					for (auto object : objects)
+					{
+						if (object->Intersects(frustum))
+							expectedObjects.push_back(object);
+					}
+					sort(expectedObjects.begin(), expectedObjects.end());
+
+					vector<OctreeBaseCollider*> visibleObjects;
+					spatialIndex->CalculateIntersections(frustum, visibleObjects);
+					sort(visibleObjects.begin(), visibleObjects.end());
+					Assert::IsTrue(expectedObjects == visibleObjects);
+				}
+
+				// An object moved to the other side of the scene leaves the octant of its leaf:
+				auto bounds = colliders[0].GetBounds();
+				bounds.Center.x = -bounds.Center.x;
+				bounds.Center.z = -bounds.Center.z;
+				colliders[0].SetBounds(bounds);
+				Assert::AreEqual(spatialIndexType == SpatialIndexType::BoundingVolumeHierarchy, spatialIndex->UpdateObject(&colliders[0]));
+
+				// Objects which aren't in the index can't be updated:
+				BoxCollider otherCollider(BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f)));
+				Assert::IsFalse(spatialIndex->UpdateObject(&otherCollider));
+				spatialIndex->Clear();
+				Assert::IsFalse(spatialIndex->UpdateObject(&colliders[0]));
+			}
+
+			// Each index finds the objects by itself, so building another index from the same objects doesn't affect it:
+			auto octree = CreateSpatialIndex(SpatialIndexType::Octree);
+			auto hierarchy = CreateSpatialIndex(SpatialIndexType::BoundingVolumeHierarchy);
+			octree->Build(objects);
+			hierarchy->Build(objects);
+			auto bounds = colliders[1].GetBounds();
+			bounds.Center.y += 0.001f;
+			colliders[1].SetBounds(bounds);
+			Assert::IsTrue(octree->UpdateObject(&colliders[1]));
+			Assert::IsTrue(hierarchy->UpdateObject(&colliders[1]));
+		}
+
+		TEST_METHOD(TestSpatialIndexInsertRemove)
+		{
+			auto colliders = CreateClusteredColliders(10000);
+			auto objects = GetPointers(colliders);
+			auto frustums = CreateCameraFrustums();
+			mt19937 randomEngine(3);
+
+			for (auto spatialIndexType : { SpatialIndexType::Octree, SpatialIndexType::BoundingVolumeHierarchy })
+			{
+				// Build the index from half of the objects, and insert the other half, rebuilding the index when it must be divided:
+				vector<OctreeBaseCollider*> indexedObjects(objects.begin(), objects.begin() + objects.size() / 2);
+				auto spatialIndex = CreateSpatialIndex(spatialIndexType);
+				spatialIndex->Build(indexedObjects);
+
+				size_t insertCount = 0;
+				for (auto object = objects.begin() + objects.size() / 2; object != objects.end(); ++object)
+				{
+					indexedObjects.push_back(*object);
+					if (spatialIndex->InsertObject(*object))
+						++insertCount;
+					else
+						spatialIndex->Build(indexedObjects);
+				}
+				Assert::IsTrue(insertCount > objects.size() / 4);
+				Assert::AreEqual(indexedObjects.size(), spatialIndex->GetObjectCount());
+
+				// Remove a random half of the objects, rebuilding the index when a leaf would be emptied:
+				shuffle(indexedObjects.begin(), indexedObjects.end(), randomEngine);
+				size_t removeCount = 0;
+				OctreeBaseCollider* removedObject = nullptr;
+				while (indexedObjects.size() > objects.size() / 2)
+				{
+					auto object = indexedObjects.back();
+					indexedObjects.pop_back();
+					removedObject = object;
+					if (spatialIndex->RemoveObject(object))
+						++removeCount;
+					else
+						spatialIndex->Build(indexedObjects);
+				}
+				Assert::IsTrue(removeCount > objects.size() / 4);
+				Assert::AreEqual(indexedObjects.size(), spatialIndex->GetObjectCount());
+
+				// The queries must return the same objects as when testing every object of the index:
+				for (const auto& frustum : frustums)
+				{
+					vector<OctreeBaseCollider*> expectedObjects;
+					for (auto object : indexedObjects)
+					{
+						if (object->Intersects(frustum))
+							expectedObjects.push_back(object);
+					}
+					sort(expectedObjects.begin(), expectedObjects.end());
+
+					vector<OctreeBaseCollider*> visibleObjects;
+					spatialIndex->CalculateIntersections(frustum, visibleObjects);
+					sort(visibleObjects.begin(), visibleObjects.end());
+					Assert::IsTrue(expectedObjects == visibleObjects);
+				}
+
+				// The removed objects can't be removed or updated again, and the objects in the index can't be inserted twice:
+				Assert::IsFalse(spatialIndex->RemoveObject(removedObject));
+				Assert::IsFalse(spatialIndex->UpdateObject(removedObject));
+				Assert::IsFalse(spatialIndex->InsertObject(indexedObjects[0]));
+
+				// The objects keep being found when they move after the insertions and removals:
+				for (auto object : indexedObjects)
+				{
+					auto bounds = object->GetBounds();
+					bounds.Center.y += 0.001f;
+					object->SetBounds(bounds);
+					Assert::IsTrue(spatialIndex->UpdateObject(object));
+				}
+			}
+		}
+
+		TEST_METHOD(TestSpatialIndexFrustumCoherence)
+		{
+			auto colliders = CreateClusteredColliders(20000);
+			auto objects = GetPointers(colliders);
+			Common::ThreadPool threadPool(2);
+
+			for (auto spatialIndexType : { SpatialIndexType::Octree, SpatialIndexType::BoundingVolumeHierarchy })
+			{
+				auto spatialIndex = CreateSpatialIndex(spatialIndexType);
+				spatialIndex->Build(objects);
+
+				// Fly through the scene, moving and turning a little every frame:
+				Camera camera(16.0f / 9.0f, XM_PIDIV4, 0.2f, 500.0f, XMMatrixIdentity());
+				camera.SetPosition(-500.0f, 20.0f, -500.0f);
+				FrustumCoherence coherence;
+				FrustumCoherence parallelCoherence;
+				size_t coherentPlaneTests = 0;
+				size_t independentPlaneTests = 0;
+				size_t planeTestsSaved = 0;
+				for (size_t frame = 0; frame < 120; ++frame)
+				{
+					camera.RotateWorldY(0.01f);
+					camera.MoveForward(5.0f);
+					camera.Update();
+					Frustum frustum(XMMatrixMultiply(camera.GetViewMatrix(), camera.GetProjectionMatrix()));
+
+					vector<OctreeBaseCollider*> expectedObjects;
+					spatialIndex->CalculateIntersections(frustum, expectedObjects);
+					sort(expectedObjects.begin(), expectedObjects.end());
+
+					// The order of the plane tests must not change the result:
+					vector<OctreeBaseCollider*> visibleObjects;
+					spatialIndex->CalculateIntersections(frustum, coherence, visibleObjects);
+					sort(visibleObjects.begin(), visibleObjects.end());
+					Assert::IsTrue(expectedObjects == visibleObjects);
+
+					array<vector<OctreeBaseCollider*>, 8> visibleObjectsPerSubtree;
+					spatialIndex->CalculateIntersections(frustum, parallelCoherence, threadPool, visibleObjectsPerSubtree);
+					visibleObjects.clear();
+					for (const auto& subtreeVisibleObjects : visibleObjectsPerSubtree)
+						visibleObjects.insert(visibleObjects.end(), subtreeVisibleObjects.begin(), subtreeVisibleObjects.end());
+					sort(visibleObjects.begin(), visibleObjects.end());
+					Assert::IsTrue(expectedObjects == visibleObjects);
+
+					// Compare with a viewer which doesn't remember the previous frame:
+					FrustumCoherence independentCoherence;
+					visibleObjects.clear();
+					spatialIndex->CalculateIntersections(frustum, independentCoherence, visibleObjects);
+					Assert::AreEqual(independentCoherence.GetStatistics().BoxTests, coherence.GetStatistics().BoxTests);
+
+					// The saved plane tests are counted against that viewer:
+					Assert::AreEqual(independentCoherence.GetStatistics().PlaneTests, coherence.GetStatistics().IndependentPlaneTests);
+					Assert::AreEqual(independentCoherence.GetStatistics().PlaneTests, independentCoherence.GetStatistics().IndependentPlaneTests);
+
+					coherentPlaneTests += coherence.GetStatistics().PlaneTests;
+					independentPlaneTests += independentCoherence.GetStatistics().PlaneTests;
+					planeTestsSaved += coherence.GetStatistics().GetPlaneTestsSaved();
+				}
+
+				Assert::IsTrue(coherentPlaneTests < independentPlaneTests);
+
+				auto message =
+					wstring(spatialIndexType == SpatialIndexType::Octree ? L"Octree" : L"Bounding volume hierarchy") + L" fly-through:\n" +
+					L"  Plane tests per frame: " + to_wstring(coherentPlaneTests / 120) + L" (" + to_wstring(independentPlaneTests / 120) + L" without the previous frame), " + to_wstring(planeTestsSaved / 120) + L" saved\n";
+				Logger::WriteMessage(message.c_str());
+			}
+		}
+
+		TEST_METHOD(BenchmarkSpatialIndices)
+		{
+			auto frustums = CreateCameraFrustums();
+
+			// The tests run from the output directory, which is next to the working directory of the application:
+			auto sceneColliders = LoadSceneColliders(L"../WorkingDirectory/Instances.json");
+			auto clusteredColliders = CreateClusteredColliders(1000000);
+
+			vector<pair<wstring, vector<BoxCollider>*>> dataSets =
+			{
+				{ L"Instances.json", &sceneColliders },
+				{ L"Clustered", &clusteredColliders },
+			};
+
+			wstring message;
+			for (const auto& dataSet : dataSets)
+			{
+				if (dataSet.second->empty())
+				{
+					message += L"Spatial indices with " + dataSet.first + L": skipped, file not found\n";
+					continue;
+				}
+
+				auto objects = GetPointers(*dataSet.second);
+				message += L"Spatial indices with " + dataSet.first + L" (" + to_wstring(objects.size()) + L" objects):\n";
+				message += L"  Octree:\n" + BenchmarkSpatialIndex(SpatialIndexType::Octree, objects, frustums);
+				message += L"  Bounding volume hierarchy:\n" + BenchmarkSpatialIndex(SpatialIndexType::BoundingVolumeHierarchy, objects, frustums);
+			}
+			Logger::WriteMessage(message.c_str());
+		}
+	};
+}
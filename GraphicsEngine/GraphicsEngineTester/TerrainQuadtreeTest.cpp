@@ -0,0 +1,184 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+
+#include "GraphicsEngine/Frustum.h"
+#include "GraphicsEngine/HeightBoundsPyramid.h"
+#include "GraphicsEngine/TerrainQuadtree.h"
+
+#include <vector>
+
+using namespace DirectX;
+using namespace GraphicsEngine;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+
+namespace GraphicsEngineTester
+{
+	TEST_CLASS(TerrainQuadtreeTest)
+	{
+	public:
+		TEST_METHOD(TestDistantCameraSelectsRoot)
+		{
+			TerrainQuadtree quadtree(1024.0f, 1024.0f, 32, 32, 200.0f, 32);
+			vector<TerrainQuadtree::Patch> patches;
+			quadtree.Select(XMFLOAT3(0.0f, 100000.0f, 0.0f), 2.4f, patches);
+
+			Assert::AreEqual(static_cast<size_t>(1), patches.size());
+			Assert::AreEqual(32u, patches[0].Size);
+			Assert::AreEqual(32.0f, patches[0].EdgeTesselationFactors.x);
+			Assert::AreEqual(32.0f, patches[0].EdgeTesselationFactors.y);
+			Assert::AreEqual(32.0f, patches[0].EdgeTesselationFactors.z);
+			Assert::AreEqual(32.0f, patches[0].EdgeTesselationFactors.w);
+		}
+
+		TEST_METHOD(TestCellsBelowCameraUseFinestPatches)
+		{
+			TerrainQuadtree quadtree(1024.0f, 1024.0f, 32, 32, 200.0f, 32);
+			vector<TerrainQuadtree::Patch> patches;
+			quadtree.Select(XMFLOAT3(-500.0f, 10.0f, 500.0f), 2.4f, patches);
+
+			auto cellPatches = GetCellPatches(patches, 32);
+			Assert::AreEqual(1u, patches[cellPatches[0]].Size);
+
+			// Distant patches are larger than the cells:
+			Assert::IsTrue(patches[cellPatches[32 * 32 - 1]].Size > 1);
+			Assert::IsTrue(patches.size() < 32 * 32);
+		}
+
+		TEST_METHOD(TestSelectionIsBalancedAndCrackFree)
+		{
+			TerrainQuadtree quadtree(512.0f, 256.0f, 64, 64, 100.0f, 16);
+			quadtree.SetMaxScreenSpaceError(0.002f);
+
+			vector<TerrainQuadtree::Patch> patches;
+			for (auto cameraPosition : { XMFLOAT3(0.0f, 5.0f, 0.0f), XMFLOAT3(-250.0f, 1.0f, 120.0f), XMFLOAT3(300.0f, 50.0f, -200.0f), XMFLOAT3(100.0f, 400.0f, 30.0f) })
+			{
+				quadtree.Select(cameraPosition, 2.4f, patches);
+				auto cellPatches = GetCellPatches(patches, 64);
+
+				for (uint32_t row = 0; row < 64; ++row)
+				{
+					for (uint32_t column = 0; column < 64; ++column)
+					{
+						const auto& patch = patches[cellPatches[row * 64 + column]];
+
+						// Check the cells across the next column and the next row, when they belong to another patch:
+						if (column + 1 < 64 && column + 1 == patch.Column + patch.Size)
+						{
+							const auto& neighbour = patches[cellPatches[row * 64 + column + 1]];
+							AssertMatchingEdges(patch, patch.EdgeTesselationFactors.y, neighbour, neighbour.EdgeTesselationFactors.w);
+						}
+						if (row + 1 < 64 && row + 1 == patch.Row + patch.Size)
+						{
+							const auto& neighbour = patches[cellPatches[(row + 1) * 64 + column]];
+							AssertMatchingEdges(patch, patch.EdgeTesselationFactors.z, neighbour, neighbour.EdgeTesselationFactors.x);
+						}
+					}
+				}
+			}
+		}
+
+		TEST_METHOD(TestPatchBoundsFromHeightBounds)
+		{
+			// A flat terrain, lying at half of its maximum height:
+			vector<float> heightMap(65 * 65, 100.0f);
+			HeightBoundsPyramid heightBounds(heightMap, 65, 65, 1024.0f, 1024.0f);
+
+			TerrainQuadtree quadtree(1024.0f, 1024.0f, 32, 32, 200.0f, 32);
+			quadtree.SetMaxScreenSpaceError(0.05f);
+			vector<TerrainQuadtree::Patch> patches;
+			auto cameraPosition = XMFLOAT3(0.0f, 150.0f, 0.0f);
+			quadtree.Select(cameraPosition, 2.4f, patches);
+			auto patchCount = patches.size();
+
+			// Without the heights, the bounds span the whole height range:
+			auto bounds = quadtree.GetPatchBounds(patches[0]);
+			Assert::AreEqual(100.0f, bounds.Center.y);
+			Assert::AreEqual(100.0f, bounds.Extents.y);
+
+			// The camera is no longer inside of the bounds of the patches below it, which are split less:
+			quadtree.SetHeightBounds(&heightBounds);
+			quadtree.Select(cameraPosition, 2.4f, patches);
+			Assert::IsTrue(patches.size() < patchCount);
+
+			for (const auto& patch : patches)
+			{
+				bounds = quadtree.GetPatchBounds(patch);
+				Assert::AreEqual(100.0f, bounds.Center.y);
+				Assert::AreEqual(0.0f, bounds.Extents.y);
+				Assert::AreEqual(16.0f * static_cast<float>(patch.Size), bounds.Extents.x);
+			}
+		}
+
+		TEST_METHOD(TestCullPatchBounds)
+		{
+			vector<float> heightMap(65 * 65, 100.0f);
+			HeightBoundsPyramid heightBounds(heightMap, 65, 65, 1024.0f, 1024.0f);
+
+			TerrainQuadtree quadtree(1024.0f, 1024.0f, 32, 32, 200.0f, 32);
+			quadtree.SetHeightBounds(&heightBounds);
+			vector<TerrainQuadtree::Patch> patches;
+			quadtree.Select(XMFLOAT3(0.0f, 150.0f, 0.0f), 2.4f, patches);
+
+			BoundingBoxArray bounds;
+			quadtree.CalculatePatchBounds(patches, bounds);
+			Assert::AreEqual(patches.size(), bounds.GetSize());
+
+			// A camera looking towards -z only sees the patches in front of it:
+			auto viewMatrix = XMMatrixLookToLH(XMVectorSet(0.0f, 150.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 0.0f, -1.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+			auto projectionMatrix = XMMatrixPerspectiveFovLH(XM_PIDIV4, 1.0f, 1.0f, 2000.0f);
+			Frustum frustum(XMMatrixMultiply(viewMatrix, projectionMatrix));
+			vector<uint32_t> visiblePatches(patches.size());
+			auto visibleCount = frustum.CalculateVisibleBoxes(bounds, 0, bounds.GetSize(), visiblePatches.data());
+			Assert::IsTrue(visibleCount > 0 && visibleCount < patches.size());
+
+			vector<bool> visible(patches.size(), false);
+			for (size_t i = 0; i < visibleCount; ++i)
+				visible[visiblePatches[i]] = true;
+
+			for (size_t i = 0; i < patches.size(); ++i)
+			{
+				auto patchBounds = quadtree.GetPatchBounds(patches[i]);
+				auto box = bounds.Get(i);
+				Assert::AreEqual(patchBounds.Center.x, box.Center.x);
+				Assert::AreEqual(patchBounds.Center.z, box.Center.z);
+				Assert::AreEqual(patchBounds.Extents.x, box.Extents.x);
+
+				Assert::AreEqual(frustum.Contains(patchBounds) != DISJOINT, static_cast<bool>(visible[i]));
+				if (patchBounds.Center.z - patchBounds.Extents.z > 0.0f)
+					Assert::IsFalse(visible[i]);
+			}
+		}
+
+	private:
+		// Returns the index of the patch covering each cell, checking that each cell is covered exactly once:
+		static vector<size_t> GetCellPatches(const vector<TerrainQuadtree::Patch>& patches, uint32_t cellCount)
+		{
+			vector<size_t> cellPatches(cellCount * cellCount, patches.size());
+			for (size_t i = 0; i < patches.size(); ++i)
+			{
+				const auto& patch = patches[i];
+				for (auto row = patch.Row; row < patch.Row + patch.Size; ++row)
+				{
+					for (auto column = patch.Column; column < patch.Column + patch.Size; ++column)
+					{
+						Assert::AreEqual(patches.size(), cellPatches[row * cellCount + column]);
+						cellPatches[row * cellCount + column] = i;
+					}
+				}
+			}
+
+			for (auto cellPatch : cellPatches)
+				Assert::IsTrue(cellPatch < patches.size());
+
+			return cellPatches;
+		}
+
+		// Neighbours differ by one level at most, and place the vertices of their shared edge at the same spacing:
+		static void AssertMatchingEdges(const TerrainQuadtree::Patch& patch, float edgeFactor, const TerrainQuadtree::Patch& neighbour, float neighbourEdgeFactor)
+		{
+			Assert::IsTrue(patch.Size <= 2 * neighbour.Size && neighbour.Size <= 2 * patch.Size);
+			Assert::AreEqual(static_cast<float>(patch.Size) / edgeFactor, static_cast<float>(neighbour.Size) / neighbourEdgeFactor);
+		}
+	};
+}
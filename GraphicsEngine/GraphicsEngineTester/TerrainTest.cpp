@@ -0,0 +1,80 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+
+#include "GraphicsEngine/Ray.h"
+#include "GraphicsEngine/Terrain.h"
+
+#include <cfloat>
+#include <vector>
+
+using namespace DirectX;
+using namespace GraphicsEngine;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+
+namespace GraphicsEngineTester
+{
+	TEST_CLASS(TerrainTest)
+	{
+	public:
+		TEST_METHOD(TestIntersects)
+		{
+			Terrain terrain;
+			InitializeTerrain(terrain);
+
+			// Straight down onto the flat ground:
+			float distance;
+			Assert::IsTrue(terrain.Intersects(Ray(XMFLOAT3(10.0f, 50.0f, 10.0f), XMFLOAT3(0.0f, -1.0f, 0.0f)), FLT_MAX, distance));
+			Assert::AreEqual(50.0f, distance, 0.001f);
+
+			// Towards the ridge, whose slope reaches half of its height at one unit before its crest:
+			Ray ray(XMFLOAT3(-20.0f, 0.5f * s_ridgeHeight, 4.0f), XMFLOAT3(1.0f, 0.0f, 0.0f));
+			Assert::IsTrue(terrain.Intersects(ray, FLT_MAX, distance));
+			Assert::AreEqual(19.0f, distance, 0.001f);
+
+			// Intersections beyond the maximum distance are ignored:
+			Assert::IsFalse(terrain.Intersects(ray, 18.0f, distance));
+
+			// Over the ridge:
+			Assert::IsFalse(terrain.Intersects(Ray(XMFLOAT3(-20.0f, s_ridgeHeight + 1.0f, 4.0f), XMFLOAT3(1.0f, 0.0f, 0.0f)), FLT_MAX, distance));
+		}
+
+		TEST_METHOD(TestHasLineOfSight)
+		{
+			Terrain terrain;
+			InitializeTerrain(terrain);
+
+			// The ridge blocks the view between both of its sides:
+			Assert::IsFalse(terrain.HasLineOfSight(XMFLOAT3(-20.0f, 5.0f, -8.0f), XMFLOAT3(20.0f, 5.0f, 8.0f)));
+			Assert::IsFalse(terrain.HasLineOfSight(XMFLOAT3(20.0f, 5.0f, 8.0f), XMFLOAT3(-20.0f, 5.0f, -8.0f)));
+
+			// But not from above it:
+			Assert::IsTrue(terrain.HasLineOfSight(XMFLOAT3(-20.0f, s_ridgeHeight + 1.0f, -8.0f), XMFLOAT3(20.0f, s_ridgeHeight + 1.0f, 8.0f)));
+			Assert::IsTrue(terrain.HasLineOfSight(XMFLOAT3(-20.0f, 5.0f, 0.0f), XMFLOAT3(0.0f, 30.0f, 0.0f)));
+
+			// Nor between points on the same side of it, even when the ridge is further along the line:
+			Assert::IsTrue(terrain.HasLineOfSight(XMFLOAT3(-20.0f, 5.0f, 0.0f), XMFLOAT3(-5.0f, 5.0f, 0.0f)));
+			Assert::IsTrue(terrain.HasLineOfSight(XMFLOAT3(5.0f, 1.0f, 0.0f), XMFLOAT3(5.0f, 1.0f, 0.0f)));
+		}
+
+	private:
+		static constexpr uint32_t s_size = 33;
+		static constexpr float s_terrainSize = 64.0f;
+		static constexpr float s_ridgeHeight = 10.0f;
+
+		// Flat ground crossed from north to south by a ridge along the middle column, at x = 0:
+		static void InitializeTerrain(Terrain& terrain)
+		{
+			terrain.m_description.TerrainWidth = s_terrainSize;
+			terrain.m_description.TerrainDepth = s_terrainSize;
+			terrain.m_heightMapWidth = s_size;
+			terrain.m_heightMapHeight = s_size;
+
+			terrain.m_heightMap.assign(s_size * s_size, 0.0f);
+			for (uint32_t row = 0; row < s_size; ++row)
+				terrain.m_heightMap[row * s_size + s_size / 2] = s_ridgeHeight;
+
+			terrain.m_heightBounds = HeightBoundsPyramid(terrain.m_heightMap, s_size, s_size, s_terrainSize, s_terrainSize);
+		}
+	};
+}
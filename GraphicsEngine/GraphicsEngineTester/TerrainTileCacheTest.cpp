@@ -0,0 +1,162 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+
+#include "GraphicsEngine/TerrainTileCache.h"
+#include "Common/Helpers.h"
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace Common;
+using namespace DirectX;
+using namespace GraphicsEngine;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+
+namespace GraphicsEngineTester
+{
+	TEST_CLASS(TerrainTileCacheTest)
+	{
+	public:
+		TEST_METHOD(TestHeightsAroundCamera)
+		{
+			auto heightMap = CreateHeightMap();
+			vector<float> levelHeights;
+			ThreadPool threadPool(0);
+			heightMap->ReadLevel(0, 100.0f, threadPool, levelHeights);
+
+			{
+				TerrainTileCache tileCache(*heightMap, 512.0f, 512.0f, 100.0f, 2, 16 * 1024 * 1024);
+
+				// Nothing is resident before the first update:
+				float height;
+				Assert::IsFalse(tileCache.TryGetHeight(0.0f, 0.0f, height));
+
+				tileCache.Update(XMFLOAT3(-100.0f, 10.0f, 50.0f));
+				tileCache.WaitForPendingTiles();
+
+				// The texels of the first level span the whole terrain, from its first to its last one:
+				for (auto position : { XMFLOAT2(-100.0f, 50.0f), XMFLOAT2(-130.3f, 21.7f), XMFLOAT2(-64.0f, 64.0f), XMFLOAT2(-75.5f, 80.25f) })
+				{
+					Assert::IsTrue(tileCache.TryGetHeight(position.x, position.y, height));
+
+					auto column = (position.x / 512.0f + 0.5f) * 255.0f;
+					auto row = (-position.y / 512.0f + 0.5f) * 255.0f;
+					auto texelColumn = static_cast<uint32_t>(column);
+					auto texelRow = static_cast<uint32_t>(row);
+					auto u = column - static_cast<float>(texelColumn);
+					auto v = row - static_cast<float>(texelRow);
+					auto topLeft = levelHeights.data() + texelRow * 256 + texelColumn;
+					auto top = topLeft[0] + u * (topLeft[1] - topLeft[0]);
+					auto bottom = topLeft[256] + u * (topLeft[257] - topLeft[256]);
+					Assert::AreEqual(top + v * (bottom - top), height, 0.001f);
+				}
+			}
+
+			RemoveFiles();
+		}
+
+		TEST_METHOD(TestMemoryBudget)
+		{
+			auto heightMap = CreateHeightMap();
+
+			{
+				// Budget for four tiles, which isn't enough for the finest tiles around the camera:
+				auto tileBytes = heightMap->GetTileSampleCount() * sizeof(float);
+				TerrainTileCache tileCache(*heightMap, 512.0f, 512.0f, 100.0f, 3, 4 * tileBytes);
+				Assert::AreEqual(static_cast<size_t>(4), tileCache.GetSlotCount());
+
+				for (auto cameraPosition : { XMFLOAT3(-200.0f, 10.0f, 200.0f), XMFLOAT3(200.0f, 10.0f, -200.0f), XMFLOAT3(-200.0f, 10.0f, 200.0f) })
+				{
+					// The tiles requested first are the coarsest ones, which always cover the camera:
+					for (size_t frame = 0; frame < 3; ++frame)
+					{
+						tileCache.Update(cameraPosition);
+						tileCache.WaitForPendingTiles();
+						Assert::IsTrue(tileCache.GetResidentTileCount() <= 4);
+					}
+
+					float height;
+					Assert::IsTrue(tileCache.TryGetHeight(cameraPosition.x, cameraPosition.z, height));
+				}
+			}
+
+			RemoveFiles();
+		}
+
+		TEST_METHOD(TestNearestTilesFirst)
+		{
+			auto heightMap = CreateHeightMap();
+			vector<float> levelHeights;
+			ThreadPool threadPool(0);
+			heightMap->ReadLevel(0, 100.0f, threadPool, levelHeights);
+
+			{
+				// Budget for two of the nine tiles around the camera, which is inside of the tile at the third row and column:
+				auto tileBytes = heightMap->GetTileSampleCount() * sizeof(float);
+				TerrainTileCache tileCache(*heightMap, 512.0f, 512.0f, 100.0f, 1, 2 * tileBytes);
+				XMFLOAT3 cameraPosition(70.0f, 10.0f, -70.0f);
+
+				// The tile of the camera is loaded first, and it isn't replaced by the other tiles in range in the next frames:
+				for (size_t frame = 0; frame < 4; ++frame)
+				{
+					tileCache.Update(cameraPosition);
+					tileCache.WaitForPendingTiles();
+					Assert::AreEqual(static_cast<size_t>(2), tileCache.GetResidentTileCount());
+
+					float height;
+					Assert::IsTrue(tileCache.TryGetHeight(cameraPosition.x, cameraPosition.z, height));
+
+					auto column = (cameraPosition.x / 512.0f + 0.5f) * 255.0f;
+					auto row = (-cameraPosition.z / 512.0f + 0.5f) * 255.0f;
+					auto texelColumn = static_cast<uint32_t>(column);
+					auto texelRow = static_cast<uint32_t>(row);
+					auto u = column - static_cast<float>(texelColumn);
+					auto v = row - static_cast<float>(texelRow);
+					auto topLeft = levelHeights.data() + texelRow * 256 + texelColumn;
+					auto top = topLeft[0] + u * (topLeft[1] - topLeft[0]);
+					auto bottom = topLeft[256] + u * (topLeft[257] - topLeft[256]);
+					Assert::AreEqual(top + v * (bottom - top), height, 0.001f);
+				}
+			}
+
+			RemoveFiles();
+		}
+
+	private:
+		// Height map of 256x256 texels, with tiles of 64 texels:
+		static unique_ptr<TiledHeightMap> CreateHeightMap()
+		{
+			default_random_engine randomEngine(7);
+			uniform_int_distribution<int> heightDistribution(0, 65535);
+			vector<uint16_t> rawHeights(256 * 256);
+			for (auto& value : rawHeights)
+				value = static_cast<uint16_t>(heightDistribution(randomEngine));
+
+			{
+				ofstream file(Helpers::WStringToString(s_rawFilename), ios::out | ios::binary);
+				file.write(reinterpret_cast<const char*>(rawHeights.data()), rawHeights.size() * sizeof(uint16_t));
+			}
+
+			ThreadPool threadPool(0);
+			TiledHeightMap::Convert(s_rawFilename, 256, 256, 64, s_tiledFilename, threadPool);
+			return make_unique<TiledHeightMap>(s_tiledFilename);
+		}
+
+		static void RemoveFiles()
+		{
+			std::remove(Helpers::WStringToString(s_rawFilename).c_str());
+			std::remove(Helpers::WStringToString(s_tiledFilename).c_str());
+		}
+
+	private:
+		static const wchar_t* const s_rawFilename;
+		static const wchar_t* const s_tiledFilename;
+	};
+
+	const wchar_t* const TerrainTileCacheTest::s_rawFilename = L"TestTerrainTileCache.r16";
+	const wchar_t* const TerrainTileCacheTest::s_tiledFilename = L"TestTerrainTileCache.thm";
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "GraphicsEngine/BoundingBoxArray.h"
+#include "GraphicsEngine/Frustum.h"
+#include "GraphicsEngine/OctreeBaseCollider.h"
+
+#include <DirectXCollision.h>
+#include <random>
+#include <vector>
+
+namespace GraphicsEngineTester
+{
+	namespace TestHelpers
+	{
+		class BoxCollider : public GraphicsEngine::OctreeBaseCollider
+		{
+		public:
+			explicit BoxCollider(const DirectX::BoundingBox& box) :
+				m_box(box)
+			{
+			}
+
+			bool Intersects(const DirectX::BoundingBox& box) const override
+			{
+				return box.Intersects(m_box);
+			}
+			bool Intersects(const GraphicsEngine::Frustum& frustum) const override
+			{
+				return frustum.Contains(m_box) != DirectX::ContainmentType::DISJOINT;
+			}
+			void SetBounds(const DirectX::BoundingBox& bounds) override
+			{
+				m_box = bounds;
+			}
+			const DirectX::BoundingBox& GetBounds() const override
+			{
+				return m_box;
+			}
+
+		private:
+			DirectX::BoundingBox m_box;
+		};
+
+		// Boxes uniformly distributed in a cube of the given half size, flattened along the Y-axis by heightScale.
+		// The random engine is always seeded with the same value, so that tests and benchmarks are reproducible:
+		inline std::vector<DirectX::BoundingBox> CreateRandomBoxes(size_t count, float halfSize, float heightScale, float minimumExtent, float maximumExtent)
+		{
+			using namespace DirectX;
+			using namespace std;
+
+			mt19937 randomEngine(0);
+			uniform_real_distribution<float> positionDistribution(-halfSize, halfSize);
+			uniform_real_distribution<float> extentsDistribution(minimumExtent, maximumExtent);
+
+			vector<BoundingBox> boxes;
+			boxes.reserve(count);
+			for (size_t i = 0; i < count; ++i)
+			{
+				XMFLOAT3 center(positionDistribution(randomEngine), positionDistribution(randomEngine) * heightScale, positionDistribution(randomEngine));
+				XMFLOAT3 extents(extentsDistribution(randomEngine), extentsDistribution(randomEngine), extentsDistribution(randomEngine));
+				boxes.emplace_back(center, extents);
+			}
+
+			return boxes;
+		}
+		inline GraphicsEngine::BoundingBoxArray CreateRandomBoxArray(size_t count, float halfSize, float heightScale, float minimumExtent, float maximumExtent)
+		{
+			auto boxes = CreateRandomBoxes(count, halfSize, heightScale, minimumExtent, maximumExtent);
+
+			GraphicsEngine::BoundingBoxArray boxArray;
+			boxArray.Reserve(boxes.size());
+			for (const auto& box : boxes)
+				boxArray.Add(box);
+
+			return boxArray;
+		}
+
+		// Dense forests surrounded by large areas with few objects, on the ground:
+		inline std::vector<DirectX::BoundingBox> CreateClusteredBoxes(size_t count, float halfSize, float minimumExtent, float maximumExtent)
+		{
+			using namespace DirectX;
+			using namespace std;
+
+			mt19937 randomEngine(0);
+			uniform_real_distribution<float> positionDistribution(-halfSize, halfSize);
+			uniform_real_distribution<float> extentsDistribution(minimumExtent, maximumExtent);
+			normal_distribution<float> clusterDistribution(0.0f, 20.0f);
+
+			vector<XMFLOAT2> clusterCenters(16);
+			for (auto& clusterCenter : clusterCenters)
+				clusterCenter = XMFLOAT2(positionDistribution(randomEngine), positionDistribution(randomEngine));
+
+			vector<BoundingBox> boxes;
+			boxes.reserve(count);
+			for (size_t i = 0; i < count; ++i)
+			{
+				XMFLOAT3 center;
+				if (i % 10 == 0)
+				{
+					center = XMFLOAT3(positionDistribution(randomEngine), 0.0f, positionDistribution(randomEngine));
+				}
+				else
+				{
+					const auto& clusterCenter = clusterCenters[i % clusterCenters.size()];
+					center = XMFLOAT3(clusterCenter.x + clusterDistribution(randomEngine), 0.0f, clusterCenter.y + clusterDistribution(randomEngine));
+				}
+
+				XMFLOAT3 extents(extentsDistribution(randomEngine), extentsDistribution(randomEngine), extentsDistribution(randomEngine));
+				boxes.emplace_back(center, extents);
+			}
+
+			return boxes;
+		}
+
+		template<typename ColliderType>
+		std::vector<ColliderType> CreateColliders(const std::vector<DirectX::BoundingBox>& boxes)
+		{
+			std::vector<ColliderType> colliders;
+			colliders.reserve(boxes.size());
+			for (auto box : boxes)
+				colliders.emplace_back(std::move(box));
+
+			return colliders;
+		}
+		template<typename ColliderType>
+		std::vector<GraphicsEngine::OctreeBaseCollider*> GetPointers(std::vector<ColliderType>& colliders)
+		{
+			std::vector<GraphicsEngine::OctreeBaseCollider*> pointers;
+			pointers.reserve(colliders.size());
+			for (auto& collider : colliders)
+				pointers.push_back(&collider);
+
+			return pointers;
+		}
+
+		inline bool Encloses(const DirectX::BoundingBox& outer, const DirectX::BoundingBox& inner)
+		{
+			using namespace DirectX;
+
+			// Merged bounds are stored as center and extents, so allow for rounding errors:
+			BoundingBox inflatedOuter(outer.Center, XMFLOAT3(outer.Extents.x + 0.001f, outer.Extents.y + 0.001f, outer.Extents.z + 0.001f));
+			return inflatedOuter.Contains(inner) == ContainmentType::CONTAINS;
+		}
+	}
+}
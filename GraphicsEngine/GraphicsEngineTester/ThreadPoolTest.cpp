@@ -0,0 +1,53 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+
+#include "Common/ThreadPool.h"
+
+#include <atomic>
+#include <vector>
+
+using namespace Common;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+
+namespace GraphicsEngineTester
+{
+	TEST_CLASS(ThreadPoolTest)
+	{
+	public:
+		TEST_METHOD(TestParallelFor)
+		{
+			ThreadPool threadPool(3);
+			Assert::AreEqual(static_cast<size_t>(4), threadPool.GetThreadCount());
+
+			// Every task must be executed exactly once:
+			vector<atomic<int>> executionCounts(1000);
+			for (auto& executionCount : executionCounts)
+				executionCount = 0;
+
+			threadPool.ParallelFor(executionCounts.size(), [&executionCounts](size_t taskIndex)
+			{
+				++executionCounts[taskIndex];
+			});
+
+			for (const auto& executionCount : executionCounts)
+				Assert::AreEqual(1, executionCount.load());
+
+			// The pool must be reusable:
+			atomic<size_t> sum(0);
+			for (size_t i = 0; i < 100; ++i)
+				threadPool.ParallelFor(10, [&sum](size_t taskIndex) { sum += taskIndex; });
+			Assert::AreEqual(static_cast<size_t>(100 * 45), sum.load());
+		}
+
+		TEST_METHOD(TestParallelForWithoutWorkers)
+		{
+			ThreadPool threadPool(0);
+			Assert::AreEqual(static_cast<size_t>(1), threadPool.GetThreadCount());
+
+			size_t sum = 0;
+			threadPool.ParallelFor(10, [&sum](size_t taskIndex) { sum += taskIndex; });
+			Assert::AreEqual(static_cast<size_t>(45), sum);
+		}
+	};
+}
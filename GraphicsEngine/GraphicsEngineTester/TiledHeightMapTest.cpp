@@ -0,0 +1,139 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+
+#include "GraphicsEngine/TiledHeightMap.h"
+#include "Common/Helpers.h"
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <vector>
+
+using namespace Common;
+using namespace GraphicsEngine;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+
+namespace GraphicsEngineTester
+{
+	TEST_CLASS(TiledHeightMapTest)
+	{
+	public:
+		TEST_METHOD(TestReadLevels)
+		{
+			// Sizes which aren't multiples of the tile size, so that the last tiles are partially outside of the levels:
+			uint32_t width = 300;
+			uint32_t height = 200;
+			auto rawHeights = CreateRawHeightMap(width, height);
+
+			ThreadPool threadPool(3);
+			TiledHeightMap::Convert(s_rawFilename, width, height, 64, s_tiledFilename, threadPool);
+
+			{
+				TiledHeightMap heightMap(s_tiledFilename);
+				Assert::AreEqual(4u, heightMap.GetLevelCount());
+				Assert::AreEqual(37u, heightMap.GetWidth(3));
+				Assert::AreEqual(25u, heightMap.GetHeight(3));
+				Assert::AreEqual(5u, heightMap.GetTileColumnCount(0));
+				Assert::AreEqual(4u, heightMap.GetTileRowCount(0));
+
+				auto expectedHeights = rawHeights;
+				for (uint32_t level = 0; level < heightMap.GetLevelCount(); ++level)
+				{
+					if (level > 0)
+						expectedHeights = Downsample(expectedHeights, heightMap.GetWidth(level - 1), heightMap.GetHeight(level - 1));
+
+					vector<float> heights;
+					heightMap.ReadLevel(level, 100.0f, threadPool, heights);
+
+					Assert::AreEqual(expectedHeights.size(), heights.size());
+					for (size_t i = 0; i < heights.size(); ++i)
+						Assert::AreEqual(100.0f * static_cast<float>(expectedHeights[i]) / 65535.0f, heights[i]);
+				}
+			}
+
+			RemoveFiles();
+		}
+
+		TEST_METHOD(TestReadTile)
+		{
+			uint32_t width = 300;
+			uint32_t height = 200;
+			auto rawHeights = CreateRawHeightMap(width, height);
+
+			ThreadPool threadPool(0);
+			TiledHeightMap::Convert(s_rawFilename, width, height, 64, s_tiledFilename, threadPool);
+
+			{
+				TiledHeightMap heightMap(s_tiledFilename);
+				vector<float> tileHeights(heightMap.GetTileSampleCount());
+
+				// The tiles hold the first row and column of the next tiles, and repeat the last row and column of the level:
+				for (auto tile : { make_pair(1u, 2u), make_pair(3u, 4u) })
+				{
+					heightMap.ReadTile(0, tile.first, tile.second, 1.0f, tileHeights.data());
+					for (uint32_t i = 0; i <= 64; ++i)
+					{
+						for (uint32_t j = 0; j <= 64; ++j)
+						{
+							auto row = min(tile.first * 64 + i, height - 1);
+							auto column = min(tile.second * 64 + j, width - 1);
+							Assert::AreEqual(static_cast<float>(rawHeights[row * width + column]) / 65535.0f, tileHeights[i * 65 + j]);
+						}
+					}
+				}
+			}
+
+			RemoveFiles();
+		}
+
+	private:
+		static vector<uint16_t> CreateRawHeightMap(uint32_t width, uint32_t height)
+		{
+			default_random_engine randomEngine(width);
+			uniform_int_distribution<int> heightDistribution(0, 65535);
+			vector<uint16_t> rawHeights(width * height);
+			for (auto& value : rawHeights)
+				value = static_cast<uint16_t>(heightDistribution(randomEngine));
+
+			ofstream file(Helpers::WStringToString(s_rawFilename), ios::out | ios::binary);
+			file.write(reinterpret_cast<const char*>(rawHeights.data()), rawHeights.size() * sizeof(uint16_t));
+			return rawHeights;
+		}
+
+		// Reference implementation, averaging each block of 2x2 heights:
+		static vector<uint16_t> Downsample(const vector<uint16_t>& heights, uint32_t width, uint32_t height)
+		{
+			auto downsampledWidth = max(width / 2, 1u);
+			auto downsampledHeight = max(height / 2, 1u);
+			vector<uint16_t> downsampledHeights(downsampledWidth * downsampledHeight);
+			for (uint32_t i = 0; i < downsampledHeight; ++i)
+			{
+				for (uint32_t j = 0; j < downsampledWidth; ++j)
+				{
+					uint32_t sum = 0;
+					for (auto row : { 2 * i, 2 * i + 1 })
+						for (auto column : { 2 * j, 2 * j + 1 })
+							sum += heights[min(row, height - 1) * width + min(column, width - 1)];
+
+					downsampledHeights[i * downsampledWidth + j] = static_cast<uint16_t>((sum + 2) / 4);
+				}
+			}
+
+			return downsampledHeights;
+		}
+
+		static void RemoveFiles()
+		{
+			std::remove(Helpers::WStringToString(s_rawFilename).c_str());
+			std::remove(Helpers::WStringToString(s_tiledFilename).c_str());
+		}
+
+	private:
+		static const wchar_t* const s_rawFilename;
+		static const wchar_t* const s_tiledFilename;
+	};
+
+	const wchar_t* const TiledHeightMapTest::s_rawFilename = L"TestTiledHeightMap.r16";
+	const wchar_t* const TiledHeightMapTest::s_tiledFilename = L"TestTiledHeightMap.thm";
+}